@@ -223,6 +223,54 @@ void MEM_enable_fail_on_memleak(void);
 /* Switch allocator to slower but fully guarded mode. */
 void MEM_use_guarded_allocator(void);
 
+/* Let the lock-free allocator keep small blocks in per-thread caches, which avoids contention
+ * when many threads allocate at once. Freed memory is only reused for blocks of similar size,
+ * so this can use more memory. No effect on the guarded allocator. */
+void MEM_use_thread_cached_allocator(void);
+
+/* Accounting of the lock-free allocator, which doesn't keep the names of the blocks otherwise.
+ * Memory is aggregated by the name passed to the allocation functions, names are identified by
+ * their pointer (string literals or `__func__` in most cases). Only blocks allocated after
+ * enabling are counted. No effect on the guarded allocator, which keeps all blocks already. */
+void MEM_enable_memory_accounting(void);
+bool MEM_memory_accounting_is_enabled(void);
+/* Record the call stack of one in \a interval allocations on average, zero disables sampling.
+ * Enables memory accounting. */
+void MEM_set_memory_sampling_interval(unsigned int interval);
+unsigned int MEM_get_memory_sampling_interval(void);
+
+typedef struct MemAccountingTag {
+  const char *name;
+  /* Memory allocated with this name. */
+  size_t bytes;
+  size_t peak_bytes;
+  unsigned int blocks;
+} MemAccountingTag;
+
+typedef struct MemAccountingSample {
+  const char *name;
+  size_t len;
+  /* Return addresses of the allocating call stack, innermost first. */
+  void *const *stack;
+  int stack_len;
+} MemAccountingSample;
+
+/* Calls the function for every allocation name that has been used. The same name can be
+ * reported more than once when it is defined in multiple places. */
+void MEM_memory_accounting_foreach_tag(void (*func)(const MemAccountingTag *tag,
+                                                    void *user_data),
+                                       void *user_data);
+/* Calls the function for every sampled block that hasn't been freed. The function can
+ * allocate memory. */
+void MEM_memory_accounting_foreach_sample(void (*func)(const MemAccountingSample *sample,
+                                                       void *user_data),
+                                          void *user_data);
+/* Returns the symbol names of the stack of a sample, or NULL when they can't be resolved on
+ * this platform. Free the result with `free()`. */
+char **MEM_memory_accounting_stack_symbols(void *const *stack, int stack_len);
+/* Print the memory by name and the sampled call stacks, largest first. */
+void MEM_memory_accounting_print(FILE *file);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
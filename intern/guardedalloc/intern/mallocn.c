@@ -123,3 +123,8 @@ void MEM_use_guarded_allocator(void)
   MEM_name_ptr = MEM_guarded_name_ptr;
 #endif
 }
+
+void MEM_use_thread_cached_allocator(void)
+{
+  mem_thread_cache_enabled = true;
+}
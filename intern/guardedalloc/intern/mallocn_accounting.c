@@ -0,0 +1,463 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup MEM
+ *
+ * Memory accounting for the lock-free allocator.
+ *
+ * Blocks allocated while accounting is enabled have a #MemHeadTag in front of their header,
+ * with the index of their allocation name in a fixed size table of tags. Tags are found by the
+ * pointer of the name without locking, and count the memory of their blocks with atomics.
+ *
+ * On top of that one in N allocations can be sampled: the call stack is recorded and kept until
+ * the block is freed, so the code responsible for large amounts of memory can be found even
+ * when it uses generic names. Only sampling takes a lock.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#ifdef WIN32
+#  include <windows.h>
+#else
+#  include <execinfo.h>
+#endif
+
+#include "MEM_guardedalloc.h"
+
+/* to ensure strict conversions */
+#include "../../source/blender/blenlib/BLI_strict_flags.h"
+
+#include "atomic_ops.h"
+#include "mallocn_intern.h"
+
+/* Names that don't fit in the table are counted in the first tag. */
+#define TAGS_NUM (1 << 13)
+#define TAG_NAME_MAX 64
+#define TAG_PROBE_MAX 64
+
+#define SAMPLE_BUCKETS_NUM 1024
+#define SAMPLE_STACK_MAX 40
+
+typedef struct MemTag {
+  /* Key of the tag, only compared. */
+  const char *name_ptr;
+  /* Copy of the name, the original may not outlive the blocks. */
+  char name[TAG_NAME_MAX];
+  size_t bytes;
+  size_t peak_bytes;
+  unsigned int blocks;
+} MemTag;
+
+typedef struct MemSample {
+  struct MemSample *next;
+  const void *ptr;
+  size_t len;
+  unsigned int tag;
+  int stack_len;
+  void *stack[SAMPLE_STACK_MAX];
+} MemSample;
+
+bool mem_accounting_enabled = false;
+
+static MemTag *tags = NULL;
+static pthread_mutex_t tags_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int sample_interval = 0;
+static MemSample *sample_buckets[SAMPLE_BUCKETS_NUM];
+static pthread_mutex_t samples_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Allocations left until the next sample of this thread. */
+static MEM_THREAD_LOCAL unsigned int sample_countdown = 0;
+static MEM_THREAD_LOCAL unsigned int sample_random_state = 0;
+
+MEM_INLINE unsigned int pointer_hash(const void *ptr)
+{
+  const uint64_t key = (uint64_t)(uintptr_t)ptr;
+  return (unsigned int)((key * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+static unsigned int tag_index_ensure(const char *name)
+{
+  const unsigned int hash = pointer_hash(name);
+  for (unsigned int probe = 0; probe < TAG_PROBE_MAX; probe++) {
+    const unsigned int index = 1 + (hash + probe) % (TAGS_NUM - 1);
+    MemTag *tag = &tags[index];
+    const char *tag_name_ptr = tag->name_ptr;
+    if (tag_name_ptr == name) {
+      return index;
+    }
+    if (tag_name_ptr == NULL) {
+      tag_name_ptr = atomic_cas_ptr((void **)&tag->name_ptr, NULL, (void *)name);
+      if (tag_name_ptr == NULL) {
+        strncpy(tag->name, name, TAG_NAME_MAX - 1);
+        return index;
+      }
+      if (tag_name_ptr == name) {
+        return index;
+      }
+    }
+  }
+  return 0;
+}
+
+/* Sample intervals are random, so that allocations in loops are not always skipped. */
+static bool sample_next(void)
+{
+  const unsigned int interval = sample_interval;
+  if (interval == 0) {
+    return false;
+  }
+  if (sample_countdown > 1) {
+    sample_countdown--;
+    return false;
+  }
+  /* Threads start at a random point in the interval. */
+  const bool is_due = (sample_countdown == 1);
+  if (sample_random_state == 0) {
+    sample_random_state = pointer_hash(&sample_random_state) | 1;
+  }
+  /* Xorshift, uniform interval between 1 and `2 * interval - 1`, so the average is kept. */
+  sample_random_state ^= sample_random_state << 13;
+  sample_random_state ^= sample_random_state >> 17;
+  sample_random_state ^= sample_random_state << 5;
+  sample_countdown = 1 + (unsigned int)(sample_random_state % (2 * (uint64_t)interval - 1));
+  return is_due;
+}
+
+static int stack_capture(void **stack, const int stack_max)
+{
+#ifdef WIN32
+  return (int)CaptureStackBackTrace(0, (DWORD)stack_max, stack, NULL);
+#else
+  return backtrace(stack, stack_max);
+#endif
+}
+
+static void sample_add(MemHeadTag *head_tag, const void *ptr, const size_t len)
+{
+  /* Not allocated with #MEM_mallocN, which could take another sample. */
+  MemSample *sample = malloc(sizeof(MemSample));
+  if (sample == NULL) {
+    return;
+  }
+  sample->ptr = ptr;
+  sample->len = len;
+  sample->tag = head_tag->tag;
+  /* The frames of the allocator are included, skipping them depends on inlining. */
+  sample->stack_len = stack_capture(sample->stack, SAMPLE_STACK_MAX);
+
+  const unsigned int bucket = pointer_hash(ptr) % SAMPLE_BUCKETS_NUM;
+  pthread_mutex_lock(&samples_mutex);
+  sample->next = sample_buckets[bucket];
+  sample_buckets[bucket] = sample;
+  pthread_mutex_unlock(&samples_mutex);
+
+  head_tag->is_sampled = 1;
+}
+
+static void sample_remove(const void *ptr)
+{
+  const unsigned int bucket = pointer_hash(ptr) % SAMPLE_BUCKETS_NUM;
+  MemSample *sample = NULL;
+  pthread_mutex_lock(&samples_mutex);
+  for (MemSample **sample_p = &sample_buckets[bucket]; *sample_p; sample_p = &(*sample_p)->next) {
+    if ((*sample_p)->ptr == ptr) {
+      sample = *sample_p;
+      *sample_p = sample->next;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&samples_mutex);
+  free(sample);
+}
+
+void mem_accounting_alloc(MemHeadTag *head_tag, const void *ptr, size_t len, const char *name)
+{
+  /* Copies of blocks get the name of the original from its tag. */
+  const unsigned int index = (name >= (const char *)tags &&
+                              name < (const char *)(tags + TAGS_NUM)) ?
+                                 (unsigned int)((size_t)(name - (const char *)tags) /
+                                                sizeof(MemTag)) :
+                                 tag_index_ensure(name);
+  MemTag *tag = &tags[index];
+  const size_t bytes = atomic_add_and_fetch_z(&tag->bytes, len);
+  atomic_fetch_and_update_max_z(&tag->peak_bytes, bytes);
+  atomic_add_and_fetch_u(&tag->blocks, 1);
+
+  head_tag->tag = index;
+  head_tag->is_sampled = 0;
+  if (UNLIKELY(sample_next())) {
+    sample_add(head_tag, ptr, len);
+  }
+}
+
+void mem_accounting_free(const MemHeadTag *head_tag, const void *ptr, size_t len)
+{
+  MemTag *tag = &tags[head_tag->tag];
+  atomic_sub_and_fetch_z(&tag->bytes, len);
+  atomic_sub_and_fetch_u(&tag->blocks, 1);
+  if (UNLIKELY(head_tag->is_sampled)) {
+    sample_remove(ptr);
+  }
+}
+
+const char *mem_accounting_tag_name(const MemHeadTag *head_tag)
+{
+  return tags[head_tag->tag].name;
+}
+
+void MEM_enable_memory_accounting(void)
+{
+  pthread_mutex_lock(&tags_mutex);
+  if (tags == NULL) {
+    tags = calloc(TAGS_NUM, sizeof(MemTag));
+    if (tags != NULL) {
+      strcpy(tags[0].name, "(other names)");
+      mem_accounting_enabled = true;
+    }
+  }
+  pthread_mutex_unlock(&tags_mutex);
+}
+
+bool MEM_memory_accounting_is_enabled(void)
+{
+  return mem_accounting_enabled;
+}
+
+void MEM_set_memory_sampling_interval(unsigned int interval)
+{
+  if (interval != 0) {
+    MEM_enable_memory_accounting();
+  }
+  sample_interval = interval;
+}
+
+unsigned int MEM_get_memory_sampling_interval(void)
+{
+  return sample_interval;
+}
+
+void MEM_memory_accounting_foreach_tag(void (*func)(const MemAccountingTag *tag,
+                                                    void *user_data),
+                                       void *user_data)
+{
+  if (!mem_accounting_enabled) {
+    return;
+  }
+  for (unsigned int index = 0; index < TAGS_NUM; index++) {
+    const MemTag *tag = &tags[index];
+    if (tag->peak_bytes == 0 && tag->blocks == 0) {
+      continue;
+    }
+    MemAccountingTag result;
+    result.name = tag->name;
+    result.bytes = tag->bytes;
+    result.peak_bytes = tag->peak_bytes;
+    result.blocks = tag->blocks;
+    func(&result, user_data);
+  }
+}
+
+/* Copy of the samples, so that they can be used without holding the lock. */
+static MemSample *samples_copy(size_t *r_samples_num)
+{
+  pthread_mutex_lock(&samples_mutex);
+  size_t samples_num = 0;
+  for (int bucket = 0; bucket < SAMPLE_BUCKETS_NUM; bucket++) {
+    for (const MemSample *sample = sample_buckets[bucket]; sample; sample = sample->next) {
+      samples_num++;
+    }
+  }
+  MemSample *samples = malloc(sizeof(MemSample) * (samples_num + 1));
+  if (samples != NULL) {
+    size_t i = 0;
+    for (int bucket = 0; bucket < SAMPLE_BUCKETS_NUM; bucket++) {
+      for (const MemSample *sample = sample_buckets[bucket]; sample; sample = sample->next) {
+        samples[i++] = *sample;
+      }
+    }
+  }
+  pthread_mutex_unlock(&samples_mutex);
+  *r_samples_num = (samples != NULL) ? samples_num : 0;
+  return samples;
+}
+
+void MEM_memory_accounting_foreach_sample(void (*func)(const MemAccountingSample *sample,
+                                                       void *user_data),
+                                          void *user_data)
+{
+  if (!mem_accounting_enabled) {
+    return;
+  }
+  size_t samples_num;
+  MemSample *samples = samples_copy(&samples_num);
+  for (size_t i = 0; i < samples_num; i++) {
+    MemAccountingSample result;
+    result.name = tags[samples[i].tag].name;
+    result.len = samples[i].len;
+    result.stack = samples[i].stack;
+    result.stack_len = samples[i].stack_len;
+    func(&result, user_data);
+  }
+  free(samples);
+}
+
+char **MEM_memory_accounting_stack_symbols(void *const *stack, int stack_len)
+{
+#ifdef WIN32
+  (void)stack;
+  (void)stack_len;
+  return NULL;
+#else
+  return backtrace_symbols(stack, stack_len);
+#endif
+}
+
+static int tag_compare_name(const void *a_v, const void *b_v)
+{
+  const MemTag *a = a_v, *b = b_v;
+  return strcmp(a->name, b->name);
+}
+
+static int tag_compare_peak(const void *a_v, const void *b_v)
+{
+  const MemTag *a = a_v, *b = b_v;
+  if (a->peak_bytes != b->peak_bytes) {
+    return (a->peak_bytes > b->peak_bytes) ? -1 : 1;
+  }
+  return 0;
+}
+
+static int sample_compare_stack(const void *a_v, const void *b_v)
+{
+  const MemSample *a = a_v, *b = b_v;
+  if (a->stack_len != b->stack_len) {
+    return (a->stack_len < b->stack_len) ? -1 : 1;
+  }
+  return memcmp(a->stack, b->stack, sizeof(void *) * (size_t)a->stack_len);
+}
+
+static int sample_compare_len(const void *a_v, const void *b_v)
+{
+  const MemSample *a = a_v, *b = b_v;
+  if (a->len != b->len) {
+    return (a->len > b->len) ? -1 : 1;
+  }
+  return 0;
+}
+
+static void print_tags(FILE *file)
+{
+  MemTag *sorted = malloc(sizeof(MemTag) * TAGS_NUM);
+  if (sorted == NULL) {
+    return;
+  }
+  size_t sorted_num = 0;
+  for (unsigned int index = 0; index < TAGS_NUM; index++) {
+    if (tags[index].peak_bytes != 0 || tags[index].blocks != 0) {
+      sorted[sorted_num++] = tags[index];
+    }
+  }
+
+  /* Merge the tags of equal names. The peaks are added, which overestimates the peak of names
+   * used in multiple places, since they are not necessarily reached at the same time. */
+  qsort(sorted, sorted_num, sizeof(MemTag), tag_compare_name);
+  size_t merged_num = 0;
+  for (size_t i = 0; i < sorted_num; i++) {
+    if (merged_num > 0 && strcmp(sorted[merged_num - 1].name, sorted[i].name) == 0) {
+      MemTag *merged = &sorted[merged_num - 1];
+      merged->bytes += sorted[i].bytes;
+      merged->peak_bytes += sorted[i].peak_bytes;
+      merged->blocks += sorted[i].blocks;
+    }
+    else {
+      sorted[merged_num++] = sorted[i];
+    }
+  }
+  qsort(sorted, merged_num, sizeof(MemTag), tag_compare_peak);
+
+  fprintf(file, "\nMemory by name (MB in use, peak MB, blocks in use):\n");
+  for (size_t i = 0; i < merged_num; i++) {
+    fprintf(file,
+            "%10.3f %10.3f %10u  %s\n",
+            (double)sorted[i].bytes / (double)(1024 * 1024),
+            (double)sorted[i].peak_bytes / (double)(1024 * 1024),
+            sorted[i].blocks,
+            sorted[i].name);
+  }
+  free(sorted);
+}
+
+static void print_samples(FILE *file)
+{
+  size_t samples_num;
+  MemSample *samples = samples_copy(&samples_num);
+  if (samples == NULL) {
+    return;
+  }
+
+  /* Group the samples by call stack, the total length is stored in the first one. */
+  qsort(samples, samples_num, sizeof(MemSample), sample_compare_stack);
+  size_t groups_num = 0;
+  for (size_t i = 0; i < samples_num; i++) {
+    if (groups_num > 0 && sample_compare_stack(&samples[groups_num - 1], &samples[i]) == 0) {
+      samples[groups_num - 1].len += samples[i].len;
+    }
+    else {
+      samples[groups_num++] = samples[i];
+    }
+  }
+  qsort(samples, groups_num, sizeof(MemSample), sample_compare_len);
+
+  fprintf(file,
+          "\nSampled allocations in use, one in %u on average (estimated MB in use):\n",
+          sample_interval);
+  for (size_t i = 0; i < groups_num; i++) {
+    const MemSample *sample = &samples[i];
+    fprintf(file,
+            "\n%10.3f  %s\n",
+            (double)sample->len * (double)sample_interval / (double)(1024 * 1024),
+            tags[sample->tag].name);
+    char **symbols = MEM_memory_accounting_stack_symbols(sample->stack, sample->stack_len);
+    for (int frame = 0; frame < sample->stack_len; frame++) {
+      if (symbols) {
+        fprintf(file, "    %s\n", symbols[frame]);
+      }
+      else {
+        fprintf(file, "    %p\n", sample->stack[frame]);
+      }
+    }
+    free(symbols);
+  }
+  free(samples);
+}
+
+void MEM_memory_accounting_print(FILE *file)
+{
+  if (!mem_accounting_enabled) {
+    return;
+  }
+  print_tags(file);
+  if (sample_interval != 0) {
+    print_samples(file);
+  }
+  fflush(file);
+}
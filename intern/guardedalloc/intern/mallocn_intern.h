@@ -112,6 +112,37 @@ void aligned_free(void *ptr);
 extern bool leak_detector_has_run;
 extern char free_after_leak_detection_message[];
 
+#ifdef _MSC_VER
+#  define MEM_THREAD_LOCAL __declspec(thread)
+#else
+#  define MEM_THREAD_LOCAL __thread
+#endif
+
+/* Size class allocator with per-thread caches, used by the lock-free allocator for blocks up to
+ * #MEM_THREAD_CACHE_SIZE_MAX bytes when enabled, see #MEM_use_thread_cached_allocator. */
+#define MEM_THREAD_CACHE_SIZE_MAX 1024
+
+extern bool mem_thread_cache_enabled;
+
+void *mem_thread_cache_alloc(size_t size);
+void mem_thread_cache_free(void *ptr, size_t size);
+size_t mem_thread_cache_reserved_memory(void);
+
+/* Stored in front of the header of blocks allocated while memory accounting is enabled, see
+ * #MEM_enable_memory_accounting. */
+typedef struct MemHeadTag {
+  /* Index of the allocation name in the accounting tags. */
+  unsigned int tag;
+  /* The block is in the sampled allocations. */
+  unsigned int is_sampled;
+} MemHeadTag;
+
+extern bool mem_accounting_enabled;
+
+void mem_accounting_alloc(MemHeadTag *head_tag, const void *ptr, size_t len, const char *name);
+void mem_accounting_free(const MemHeadTag *head_tag, const void *ptr, size_t len);
+const char *mem_accounting_tag_name(const MemHeadTag *head_tag);
+
 /* Prototypes for counted allocator functions */
 size_t MEM_lockfree_allocN_len(const void *vmemh) ATTR_WARN_UNUSED_RESULT;
 void MEM_lockfree_freeN(void *vmemh);
@@ -51,12 +51,21 @@ static void (*error_callback)(const char *) = NULL;
 
 enum {
   MEMHEAD_ALIGN_FLAG = 1,
+  /* Allocated from the thread cache, see #MEM_use_thread_cached_allocator. */
+  MEMHEAD_CACHED_FLAG = 2,
 };
 
 #define MEMHEAD_FROM_PTR(ptr) (((MemHead *)ptr) - 1)
 #define PTR_FROM_MEMHEAD(memhead) (memhead + 1)
 #define MEMHEAD_ALIGNED_FROM_PTR(ptr) (((MemHeadAligned *)ptr) - 1)
 #define MEMHEAD_IS_ALIGNED(memhead) ((memhead)->len & (size_t)MEMHEAD_ALIGN_FLAG)
+#define MEMHEAD_IS_CACHED(memhead) ((memhead)->len & (size_t)MEMHEAD_CACHED_FLAG)
+/* Preceded by a #MemHeadTag, see #MEM_enable_memory_accounting. The highest bit is used, since
+ * the low bits are taken and allocations this large fail anyway. */
+#define MEMHEAD_TAGGED_FLAG ((size_t)1 << (sizeof(size_t) * 8 - 1))
+#define MEMHEAD_IS_TAGGED(memhead) ((memhead)->len & MEMHEAD_TAGGED_FLAG)
+#define MEMHEAD_LEN_FLAGS \
+  ((size_t)(MEMHEAD_ALIGN_FLAG | MEMHEAD_CACHED_FLAG) | MEMHEAD_TAGGED_FLAG)
 
 /* Uncomment this to have proper peak counter. */
 #define USE_ATOMIC_MAX
@@ -89,10 +98,40 @@ print_error(const char *str, ...)
   }
 }
 
+/* The tag is stored in front of the #MemHead or #MemHeadAligned. */
+MEM_INLINE MemHeadTag *memhead_tag(const void *vmemh)
+{
+  if (MEMHEAD_IS_ALIGNED(MEMHEAD_FROM_PTR(vmemh))) {
+    return ((MemHeadTag *)MEMHEAD_ALIGNED_FROM_PTR(vmemh)) - 1;
+  }
+  return ((MemHeadTag *)MEMHEAD_FROM_PTR(vmemh)) - 1;
+}
+
+/* Padding in front of #MemHeadAligned, which has to fit the tag when there is one. */
+MEM_INLINE size_t memhead_aligned_padding(const size_t alignment, const bool is_tagged)
+{
+  size_t padding = MEMHEAD_ALIGN_PADDING(alignment);
+  if (is_tagged) {
+    while (padding < sizeof(MemHeadTag)) {
+      padding += alignment;
+    }
+  }
+  return padding;
+}
+
+/* Name to use for a copy of the block, the original name when it's known. */
+MEM_INLINE const char *memhead_name(const void *vmemh, const char *str)
+{
+  if (MEMHEAD_IS_TAGGED(MEMHEAD_FROM_PTR(vmemh))) {
+    return mem_accounting_tag_name(memhead_tag(vmemh));
+  }
+  return str;
+}
+
 size_t MEM_lockfree_allocN_len(const void *vmemh)
 {
   if (vmemh) {
-    return MEMHEAD_FROM_PTR(vmemh)->len & ~((size_t)(MEMHEAD_ALIGN_FLAG));
+    return MEMHEAD_FROM_PTR(vmemh)->len & ~MEMHEAD_LEN_FLAGS;
   }
 
   return 0;
@@ -121,12 +160,24 @@ void MEM_lockfree_freeN(void *vmemh)
   if (UNLIKELY(malloc_debug_memset && len)) {
     memset(memh + 1, 255, len);
   }
+  const bool is_tagged = MEMHEAD_IS_TAGGED(memh);
+  if (UNLIKELY(is_tagged)) {
+    mem_accounting_free(memhead_tag(vmemh), vmemh, len);
+  }
   if (UNLIKELY(MEMHEAD_IS_ALIGNED(memh))) {
     MemHeadAligned *memh_aligned = MEMHEAD_ALIGNED_FROM_PTR(vmemh);
-    aligned_free(MEMHEAD_REAL_PTR(memh_aligned));
+    aligned_free((char *)memh_aligned -
+                 memhead_aligned_padding((size_t)memh_aligned->alignment, is_tagged));
   }
   else {
-    free(memh);
+    const size_t header_size = sizeof(MemHead) + (is_tagged ? sizeof(MemHeadTag) : 0);
+    void *mem = (char *)vmemh - header_size;
+    if (MEMHEAD_IS_CACHED(memh)) {
+      mem_thread_cache_free(mem, len + header_size);
+    }
+    else {
+      free(mem);
+    }
   }
 }
 
@@ -139,10 +190,10 @@ void *MEM_lockfree_dupallocN(const void *vmemh)
     if (UNLIKELY(MEMHEAD_IS_ALIGNED(memh))) {
       MemHeadAligned *memh_aligned = MEMHEAD_ALIGNED_FROM_PTR(vmemh);
       newp = MEM_lockfree_mallocN_aligned(
-          prev_size, (size_t)memh_aligned->alignment, "dupli_malloc");
+          prev_size, (size_t)memh_aligned->alignment, memhead_name(vmemh, "dupli_malloc"));
     }
     else {
-      newp = MEM_lockfree_mallocN(prev_size, "dupli_malloc");
+      newp = MEM_lockfree_mallocN(prev_size, memhead_name(vmemh, "dupli_malloc"));
     }
     memcpy(newp, vmemh, prev_size);
   }
@@ -158,11 +209,12 @@ void *MEM_lockfree_reallocN_id(void *vmemh, size_t len, const char *str)
     size_t old_len = MEM_lockfree_allocN_len(vmemh);
 
     if (LIKELY(!MEMHEAD_IS_ALIGNED(memh))) {
-      newp = MEM_lockfree_mallocN(len, "realloc");
+      newp = MEM_lockfree_mallocN(len, memhead_name(vmemh, "realloc"));
     }
     else {
       MemHeadAligned *memh_aligned = MEMHEAD_ALIGNED_FROM_PTR(vmemh);
-      newp = MEM_lockfree_mallocN_aligned(len, (size_t)memh_aligned->alignment, "realloc");
+      newp = MEM_lockfree_mallocN_aligned(
+          len, (size_t)memh_aligned->alignment, memhead_name(vmemh, "realloc"));
     }
 
     if (newp) {
@@ -194,11 +246,12 @@ void *MEM_lockfree_recallocN_id(void *vmemh, size_t len, const char *str)
     size_t old_len = MEM_lockfree_allocN_len(vmemh);
 
     if (LIKELY(!MEMHEAD_IS_ALIGNED(memh))) {
-      newp = MEM_lockfree_mallocN(len, "recalloc");
+      newp = MEM_lockfree_mallocN(len, memhead_name(vmemh, "recalloc"));
     }
     else {
       MemHeadAligned *memh_aligned = MEMHEAD_ALIGNED_FROM_PTR(vmemh);
-      newp = MEM_lockfree_mallocN_aligned(len, (size_t)memh_aligned->alignment, "recalloc");
+      newp = MEM_lockfree_mallocN_aligned(
+          len, (size_t)memh_aligned->alignment, memhead_name(vmemh, "recalloc"));
     }
 
     if (newp) {
@@ -226,16 +279,47 @@ void *MEM_lockfree_recallocN_id(void *vmemh, size_t len, const char *str)
   return newp;
 }
 
+/* Small blocks come from the thread cache when it's enabled, the flags are stored in the
+ * length. */
+MEM_INLINE MemHead *memhead_alloc(const size_t len, const bool clear, const char *str)
+{
+  const bool is_tagged = mem_accounting_enabled;
+  const size_t header_size = sizeof(MemHead) + (is_tagged ? sizeof(MemHeadTag) : 0);
+  const size_t size = len + header_size;
+  size_t flags = 0;
+  char *mem;
+  if (mem_thread_cache_enabled && size <= MEM_THREAD_CACHE_SIZE_MAX) {
+    mem = mem_thread_cache_alloc(size);
+    if (LIKELY(mem) && clear) {
+      memset(mem, 0, size);
+    }
+    flags |= (size_t)MEMHEAD_CACHED_FLAG;
+  }
+  else {
+    mem = clear ? calloc(1, size) : malloc(size);
+  }
+  if (UNLIKELY(mem == NULL)) {
+    return NULL;
+  }
+
+  MemHead *memh = (MemHead *)(mem + header_size) - 1;
+  memh->len = len | flags;
+  if (UNLIKELY(is_tagged)) {
+    memh->len |= MEMHEAD_TAGGED_FLAG;
+    mem_accounting_alloc((MemHeadTag *)mem, PTR_FROM_MEMHEAD(memh), len, str);
+  }
+  return memh;
+}
+
 void *MEM_lockfree_callocN(size_t len, const char *str)
 {
   MemHead *memh;
 
   len = SIZET_ALIGN_4(len);
 
-  memh = (MemHead *)calloc(1, len + sizeof(MemHead));
+  memh = memhead_alloc(len, true, str);
 
   if (LIKELY(memh)) {
-    memh->len = len;
     atomic_add_and_fetch_u(&totblock, 1);
     atomic_add_and_fetch_z(&mem_in_use, len);
     update_maximum(&peak_mem, mem_in_use);
@@ -273,14 +357,13 @@ void *MEM_lockfree_mallocN(size_t len, const char *str)
 
   len = SIZET_ALIGN_4(len);
 
-  memh = (MemHead *)malloc(len + sizeof(MemHead));
+  memh = memhead_alloc(len, false, str);
 
   if (LIKELY(memh)) {
     if (UNLIKELY(malloc_debug_memset && len)) {
       memset(memh + 1, 255, len);
     }
 
-    memh->len = len;
     atomic_add_and_fetch_u(&totblock, 1);
     atomic_add_and_fetch_z(&mem_in_use, len);
     update_maximum(&peak_mem, mem_in_use);
@@ -332,7 +415,8 @@ void *MEM_lockfree_mallocN_aligned(size_t len, size_t alignment, const char *str
    * We only support small alignments which fits into short in
    * order to save some bits in MemHead structure.
    */
-  size_t extra_padding = MEMHEAD_ALIGN_PADDING(alignment);
+  const bool is_tagged = mem_accounting_enabled;
+  size_t extra_padding = memhead_aligned_padding(alignment, is_tagged);
 
   len = SIZET_ALIGN_4(len);
 
@@ -352,6 +436,10 @@ void *MEM_lockfree_mallocN_aligned(size_t len, size_t alignment, const char *str
 
     memh->len = len | (size_t)MEMHEAD_ALIGN_FLAG;
     memh->alignment = (short)alignment;
+    if (UNLIKELY(is_tagged)) {
+      memh->len |= MEMHEAD_TAGGED_FLAG;
+      mem_accounting_alloc(((MemHeadTag *)memh) - 1, PTR_FROM_MEMHEAD(memh), len, str);
+    }
     atomic_add_and_fetch_u(&totblock, 1);
     atomic_add_and_fetch_z(&mem_in_use, len);
     update_maximum(&peak_mem, mem_in_use);
@@ -383,6 +471,11 @@ void MEM_lockfree_printmemlist_stats(void)
 {
   printf("\ntotal memory len: %.3f MB\n", (double)mem_in_use / (double)(1024 * 1024));
   printf("peak memory len: %.3f MB\n", (double)peak_mem / (double)(1024 * 1024));
+  if (mem_thread_cache_enabled) {
+    printf("thread cache reserved memory: %.3f MB\n",
+           (double)mem_thread_cache_reserved_memory() / (double)(1024 * 1024));
+  }
+  MEM_memory_accounting_print(stdout);
   printf(
       "\nFor more detailed per-block statistics run Blender with memory debugging command line "
       "argument.\n");
@@ -433,7 +526,7 @@ size_t MEM_lockfree_get_peak_memory(void)
 const char *MEM_lockfree_name_ptr(void *vmemh)
 {
   if (vmemh) {
-    return "unknown block name ptr";
+    return memhead_name(vmemh, "unknown block name ptr");
   }
 
   return "MEM_lockfree_name_ptr(NULL)";
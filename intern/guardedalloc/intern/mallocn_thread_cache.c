@@ -0,0 +1,277 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup MEM
+ *
+ * Size class allocator with per-thread caches, used by the lock-free allocator for small blocks.
+ *
+ * Every thread keeps lists of free blocks for each size class, so most allocations and frees
+ * don't need any synchronization. Blocks can be freed by another thread than the one that
+ * allocated them, they are then cached by the freeing thread. When a thread cache gets too large,
+ * a batch of blocks is moved to a shared depot (one per size class, protected by a mutex), from
+ * which the other threads refill their caches. New blocks are cut from large chunks allocated
+ * with the system allocator.
+ *
+ * The chunks are never returned to the system, the memory of freed blocks is only reused for new
+ * blocks of the same size class.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "MEM_guardedalloc.h"
+
+/* to ensure strict conversions */
+#include "../../source/blender/blenlib/BLI_strict_flags.h"
+
+#include "mallocn_intern.h"
+
+/* Classes in steps of 16 bytes up to 256 bytes, then in steps of 64 bytes up to
+ * #MEM_THREAD_CACHE_SIZE_MAX. The step has to be a multiple of the malloc alignment. */
+#define SIZE_CLASS_SMALL_STEP 16
+#define SIZE_CLASS_SMALL_MAX 256
+#define SIZE_CLASS_LARGE_STEP 64
+#define SIZE_CLASS_NUM \
+  (SIZE_CLASS_SMALL_MAX / SIZE_CLASS_SMALL_STEP + \
+   (MEM_THREAD_CACHE_SIZE_MAX - SIZE_CLASS_SMALL_MAX) / SIZE_CLASS_LARGE_STEP)
+
+/* Size of the chunks new blocks are cut from. */
+#define CHUNK_SIZE ((size_t)64 * 1024)
+/* Number of bytes moved between a thread cache and a depot at once. */
+#define BATCH_SIZE ((size_t)8 * 1024)
+
+typedef struct FreeBlock {
+  struct FreeBlock *next;
+  /* Only used for the first block of the batches in a depot. */
+  struct FreeBlock *next_batch;
+} FreeBlock;
+
+typedef struct ThreadCacheList {
+  FreeBlock *free;
+  size_t len;
+} ThreadCacheList;
+
+typedef struct ThreadCache {
+  ThreadCacheList lists[SIZE_CLASS_NUM];
+} ThreadCache;
+
+typedef struct Depot {
+  pthread_mutex_t mutex;
+  FreeBlock *batches;
+} Depot;
+
+typedef struct Chunk {
+  struct Chunk *next;
+} Chunk;
+
+bool mem_thread_cache_enabled = false;
+
+static MEM_THREAD_LOCAL ThreadCache *thread_cache = NULL;
+
+static pthread_once_t thread_cache_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_cache_key;
+
+static Depot depots[SIZE_CLASS_NUM];
+static pthread_once_t depots_once = PTHREAD_ONCE_INIT;
+
+/* All chunks, so that they stay reachable for leak checkers. */
+static Chunk *chunks = NULL;
+static pthread_mutex_t chunks_mutex = PTHREAD_MUTEX_INITIALIZER;
+static size_t chunks_size = 0;
+
+MEM_INLINE unsigned int size_class_from_size(const size_t size)
+{
+  if (size <= SIZE_CLASS_SMALL_MAX) {
+    return (unsigned int)((size + SIZE_CLASS_SMALL_STEP - 1) / SIZE_CLASS_SMALL_STEP) - 1;
+  }
+  return (unsigned int)(SIZE_CLASS_SMALL_MAX / SIZE_CLASS_SMALL_STEP +
+                        (size - SIZE_CLASS_SMALL_MAX + SIZE_CLASS_LARGE_STEP - 1) /
+                            SIZE_CLASS_LARGE_STEP) -
+         1;
+}
+
+MEM_INLINE size_t size_class_block_size(const unsigned int size_class)
+{
+  const unsigned int small_num = SIZE_CLASS_SMALL_MAX / SIZE_CLASS_SMALL_STEP;
+  if (size_class < small_num) {
+    return (size_t)(size_class + 1) * SIZE_CLASS_SMALL_STEP;
+  }
+  return SIZE_CLASS_SMALL_MAX + (size_t)(size_class + 1 - small_num) * SIZE_CLASS_LARGE_STEP;
+}
+
+MEM_INLINE size_t size_class_batch_len(const unsigned int size_class)
+{
+  return BATCH_SIZE / size_class_block_size(size_class);
+}
+
+static void depots_init(void)
+{
+  for (int i = 0; i < SIZE_CLASS_NUM; i++) {
+    pthread_mutex_init(&depots[i].mutex, NULL);
+    depots[i].batches = NULL;
+  }
+}
+
+static void depot_push(const unsigned int size_class, FreeBlock *batch)
+{
+  Depot *depot = &depots[size_class];
+  pthread_mutex_lock(&depot->mutex);
+  batch->next_batch = depot->batches;
+  depot->batches = batch;
+  pthread_mutex_unlock(&depot->mutex);
+}
+
+static FreeBlock *depot_pop(const unsigned int size_class)
+{
+  Depot *depot = &depots[size_class];
+  pthread_mutex_lock(&depot->mutex);
+  FreeBlock *batch = depot->batches;
+  if (batch) {
+    depot->batches = batch->next_batch;
+  }
+  pthread_mutex_unlock(&depot->mutex);
+  return batch;
+}
+
+/* Move the cached blocks of a thread that exits to the depots. */
+static void thread_cache_free(void *cache_v)
+{
+  ThreadCache *cache = cache_v;
+  for (unsigned int size_class = 0; size_class < SIZE_CLASS_NUM; size_class++) {
+    ThreadCacheList *list = &cache->lists[size_class];
+    if (list->free) {
+      depot_push(size_class, list->free);
+    }
+  }
+  free(cache);
+  /* Destructors of other thread data may still allocate, that creates a new cache. */
+  thread_cache = NULL;
+}
+
+static void thread_cache_key_init(void)
+{
+  pthread_once(&depots_once, depots_init);
+  pthread_key_create(&thread_cache_key, thread_cache_free);
+}
+
+static ThreadCache *thread_cache_ensure(void)
+{
+  if (UNLIKELY(thread_cache == NULL)) {
+    pthread_once(&thread_cache_key_once, thread_cache_key_init);
+    thread_cache = calloc(1, sizeof(ThreadCache));
+    if (thread_cache == NULL) {
+      return NULL;
+    }
+    pthread_setspecific(thread_cache_key, thread_cache);
+  }
+  return thread_cache;
+}
+
+/* Fill an empty list from the depot, or from a new chunk. */
+static bool thread_cache_list_refill(ThreadCacheList *list, const unsigned int size_class)
+{
+  FreeBlock *batch = depot_pop(size_class);
+  if (batch) {
+    size_t len = 0;
+    for (FreeBlock *block = batch; block; block = block->next) {
+      len++;
+    }
+    list->free = batch;
+    list->len = len;
+    return true;
+  }
+
+  Chunk *chunk = malloc(CHUNK_SIZE);
+  if (chunk == NULL) {
+    return false;
+  }
+  pthread_mutex_lock(&chunks_mutex);
+  chunk->next = chunks;
+  chunks = chunk;
+  chunks_size += CHUNK_SIZE;
+  pthread_mutex_unlock(&chunks_mutex);
+
+  /* The first block of the chunk holds the chunk header, it is not used. */
+  const size_t block_size = size_class_block_size(size_class);
+  const size_t blocks_num = CHUNK_SIZE / block_size - 1;
+  char *first = (char *)chunk + block_size;
+  for (size_t i = 0; i < blocks_num - 1; i++) {
+    ((FreeBlock *)(first + i * block_size))->next = (FreeBlock *)(first + (i + 1) * block_size);
+  }
+  ((FreeBlock *)(first + (blocks_num - 1) * block_size))->next = NULL;
+  list->free = (FreeBlock *)first;
+  list->len = blocks_num;
+  return true;
+}
+
+void *mem_thread_cache_alloc(size_t size)
+{
+  ThreadCache *cache = thread_cache_ensure();
+  if (UNLIKELY(cache == NULL)) {
+    return NULL;
+  }
+  const unsigned int size_class = size_class_from_size(size);
+  ThreadCacheList *list = &cache->lists[size_class];
+  if (UNLIKELY(list->free == NULL)) {
+    if (!thread_cache_list_refill(list, size_class)) {
+      return NULL;
+    }
+  }
+  FreeBlock *block = list->free;
+  list->free = block->next;
+  list->len--;
+  return block;
+}
+
+void mem_thread_cache_free(void *ptr, size_t size)
+{
+  ThreadCache *cache = thread_cache_ensure();
+  if (UNLIKELY(cache == NULL)) {
+    /* Can't cache it, but the depot doesn't need a thread cache. */
+    FreeBlock *block = ptr;
+    block->next = NULL;
+    depot_push(size_class_from_size(size), block);
+    return;
+  }
+  const unsigned int size_class = size_class_from_size(size);
+  ThreadCacheList *list = &cache->lists[size_class];
+  FreeBlock *block = ptr;
+  block->next = list->free;
+  list->free = block;
+  list->len++;
+
+  /* Keep up to two batches, so that alternating allocations and frees don't move a batch back
+   * and forth every time. */
+  const size_t batch_len = size_class_batch_len(size_class);
+  if (UNLIKELY(list->len >= batch_len * 2)) {
+    FreeBlock *batch = list->free;
+    FreeBlock *batch_last = batch;
+    for (size_t i = 1; i < batch_len; i++) {
+      batch_last = batch_last->next;
+    }
+    list->free = batch_last->next;
+    list->len -= batch_len;
+    batch_last->next = NULL;
+    depot_push(size_class, batch);
+  }
+}
+
+size_t mem_thread_cache_reserved_memory(void)
+{
+  return chunks_size;
+}
@@ -0,0 +1,170 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "MEM_guardedalloc.h"
+
+#include "../intern/mallocn_intern.h"
+
+/* Only the lock-free allocator tags its blocks, so it is called directly rather than through
+ * #MEM_mallocN which may point to the guarded allocator. Accounting can't be disabled again once
+ * enabled, the tests only look at the tags of the names they allocate with themselves. */
+
+namespace {
+
+struct TagResult {
+  const char *name;
+  MemAccountingTag tag = {};
+  int found = 0;
+};
+
+MemAccountingTag find_tag(const char *name)
+{
+  TagResult result;
+  result.name = name;
+  MEM_memory_accounting_foreach_tag(
+      [](const MemAccountingTag *tag, void *user_data) {
+        TagResult &result = *static_cast<TagResult *>(user_data);
+        if (strcmp(tag->name, result.name) == 0) {
+          result.tag = *tag;
+          result.found++;
+        }
+      },
+      &result);
+  EXPECT_LE(result.found, 1);
+  return result.tag;
+}
+
+struct SampleResult {
+  const char *name;
+  size_t len;
+  int found = 0;
+};
+
+int count_samples(const char *name, size_t len)
+{
+  SampleResult result;
+  result.name = name;
+  result.len = len;
+  MEM_memory_accounting_foreach_sample(
+      [](const MemAccountingSample *sample, void *user_data) {
+        SampleResult &result = *static_cast<SampleResult *>(user_data);
+        if (strcmp(sample->name, result.name) == 0 && sample->len == result.len) {
+          EXPECT_GT(sample->stack_len, 0);
+          result.found++;
+        }
+      },
+      &result);
+  return result.found;
+}
+
+}  // namespace
+
+TEST(guardedalloc, AccountingTags)
+{
+  MEM_enable_memory_accounting();
+  EXPECT_TRUE(MEM_memory_accounting_is_enabled());
+
+  std::vector<void *> blocks;
+  for (int i = 0; i < 10; i++) {
+    blocks.push_back(MEM_lockfree_mallocN(100, "AccountingTags"));
+  }
+  blocks.push_back(MEM_lockfree_callocN(200, "AccountingTags"));
+  blocks.push_back(MEM_lockfree_mallocN_aligned(300, 64, "AccountingTags"));
+  EXPECT_EQ((uintptr_t)blocks.back() % 64, 0);
+  EXPECT_EQ(MEM_lockfree_allocN_len(blocks.back()), 300);
+
+  MemAccountingTag tag = find_tag("AccountingTags");
+  EXPECT_EQ(tag.bytes, 1500);
+  EXPECT_EQ(tag.peak_bytes, 1500);
+  EXPECT_EQ(tag.blocks, 12);
+
+  for (void *mem : blocks) {
+    MEM_lockfree_freeN(mem);
+  }
+  tag = find_tag("AccountingTags");
+  EXPECT_EQ(tag.bytes, 0);
+  EXPECT_EQ(tag.peak_bytes, 1500);
+  EXPECT_EQ(tag.blocks, 0);
+}
+
+TEST(guardedalloc, AccountingCopiesKeepName)
+{
+  MEM_enable_memory_accounting();
+
+  void *mem = MEM_lockfree_mallocN(16, "AccountingCopies");
+  mem = MEM_lockfree_reallocN_id(mem, 32, "realloc");
+  void *mem_aligned = MEM_lockfree_mallocN_aligned(16, 32, "AccountingCopies");
+  mem_aligned = MEM_lockfree_recallocN_id(mem_aligned, 64, "recalloc");
+  void *mem_copy = MEM_lockfree_dupallocN(mem);
+
+  const MemAccountingTag tag = find_tag("AccountingCopies");
+  EXPECT_EQ(tag.bytes, 32 + 64 + 32);
+  EXPECT_EQ(tag.blocks, 3);
+
+  MEM_lockfree_freeN(mem);
+  MEM_lockfree_freeN(mem_aligned);
+  MEM_lockfree_freeN(mem_copy);
+  EXPECT_EQ(find_tag("AccountingCopies").bytes, 0);
+}
+
+TEST(guardedalloc, AccountingSampling)
+{
+  MEM_set_memory_sampling_interval(1);
+  EXPECT_TRUE(MEM_memory_accounting_is_enabled());
+
+  /* The first allocation of a thread can be skipped. */
+  MEM_lockfree_freeN(MEM_lockfree_mallocN(4, "AccountingSampling"));
+
+  void *mem = MEM_lockfree_mallocN(1000, "AccountingSampling");
+  void *mem_aligned = MEM_lockfree_mallocN_aligned(2000, 16, "AccountingSampling");
+  EXPECT_EQ(count_samples("AccountingSampling", 1000), 1);
+  EXPECT_EQ(count_samples("AccountingSampling", 2000), 1);
+  MEM_lockfree_freeN(mem);
+  MEM_lockfree_freeN(mem_aligned);
+  EXPECT_EQ(count_samples("AccountingSampling", 1000), 0);
+  EXPECT_EQ(count_samples("AccountingSampling", 2000), 0);
+
+  MEM_set_memory_sampling_interval(0);
+  mem = MEM_lockfree_mallocN(1000, "AccountingSampling");
+  EXPECT_EQ(count_samples("AccountingSampling", 1000), 0);
+  MEM_lockfree_freeN(mem);
+}
+
+TEST(guardedalloc, AccountingThreads)
+{
+  MEM_enable_memory_accounting();
+  MEM_set_memory_sampling_interval(10);
+  /* Blocks of the thread cache are tagged as well, restored below for the other tests. */
+  const bool thread_cache_enabled = mem_thread_cache_enabled;
+  mem_thread_cache_enabled = true;
+  const size_t mem_in_use = MEM_lockfree_get_memory_in_use();
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; t++) {
+    threads.emplace_back([]() {
+      std::vector<void *> blocks;
+      for (int i = 0; i < 10000; i++) {
+        blocks.push_back(MEM_lockfree_mallocN((size_t)(i % 100) * 4 + 4, "AccountingThreads"));
+      }
+      for (void *mem : blocks) {
+        MEM_lockfree_freeN(mem);
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  MEM_set_memory_sampling_interval(0);
+  mem_thread_cache_enabled = thread_cache_enabled;
+
+  const MemAccountingTag tag = find_tag("AccountingThreads");
+  EXPECT_EQ(tag.bytes, 0);
+  EXPECT_EQ(tag.blocks, 0);
+  EXPECT_GE(tag.peak_bytes, 10000 * 200);
+  EXPECT_EQ(MEM_lockfree_get_memory_in_use(), mem_in_use);
+}
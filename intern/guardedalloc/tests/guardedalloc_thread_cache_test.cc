@@ -0,0 +1,158 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "MEM_guardedalloc.h"
+
+#include "../intern/mallocn_intern.h"
+
+/* The lock-free functions are called directly, other tests may have switched to the guarded
+ * allocator already. The thread cache is a global switch, every test restores it when done so
+ * the other tests keep running on the allocator they expect. */
+
+namespace {
+
+/* Blocks remember whether they are cached, so the switch can be turned off with blocks alive. */
+class ThreadCacheEnabled {
+  bool enabled_prev_;
+
+ public:
+  ThreadCacheEnabled() : enabled_prev_(mem_thread_cache_enabled)
+  {
+    mem_thread_cache_enabled = true;
+  }
+
+  ~ThreadCacheEnabled()
+  {
+    mem_thread_cache_enabled = enabled_prev_;
+  }
+};
+
+}  // namespace
+
+TEST(guardedalloc, ThreadCacheUse)
+{
+  const bool enabled_prev = mem_thread_cache_enabled;
+  MEM_use_thread_cached_allocator();
+  EXPECT_TRUE(mem_thread_cache_enabled);
+
+  void *mem = MEM_lockfree_mallocN(16, __func__);
+  mem_thread_cache_enabled = enabled_prev;
+  /* Freeing after the switch changed goes back to the allocator the block came from. */
+  MEM_lockfree_freeN(mem);
+}
+
+TEST(guardedalloc, ThreadCacheCallocIsCleared)
+{
+  ThreadCacheEnabled thread_cache;
+
+  /* Reuse a block that has been written to. */
+  char *mem = (char *)MEM_lockfree_mallocN(100, __func__);
+  memset(mem, 255, 100);
+  MEM_lockfree_freeN(mem);
+
+  mem = (char *)MEM_lockfree_callocN(100, __func__);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(mem[i], 0);
+  }
+  MEM_lockfree_freeN(mem);
+}
+
+TEST(guardedalloc, ThreadCacheLen)
+{
+  ThreadCacheEnabled thread_cache;
+
+  for (const size_t len : {1, 4, 16, 100, 500, 1000, 2000}) {
+    void *mem = MEM_lockfree_mallocN(len, __func__);
+    EXPECT_EQ(MEM_lockfree_allocN_len(mem), (len + 3) & ~(size_t)3);
+    MEM_lockfree_freeN(mem);
+  }
+}
+
+TEST(guardedalloc, ThreadCacheRealloc)
+{
+  ThreadCacheEnabled thread_cache;
+
+  int *mem = (int *)MEM_lockfree_mallocN(sizeof(int) * 10, __func__);
+  for (int i = 0; i < 10; i++) {
+    mem[i] = i;
+  }
+  /* Grow to another size class, then beyond the cached sizes. */
+  mem = (int *)MEM_lockfree_reallocN_id(mem, sizeof(int) * 100, __func__);
+  mem = (int *)MEM_lockfree_reallocN_id(mem, sizeof(int) * 1000, __func__);
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(mem[i], i);
+  }
+  MEM_lockfree_freeN(mem);
+}
+
+TEST(guardedalloc, ThreadCacheMemoryInUse)
+{
+  ThreadCacheEnabled thread_cache;
+
+  const size_t mem_in_use = MEM_lockfree_get_memory_in_use();
+  const unsigned int blocks_in_use = MEM_lockfree_get_memory_blocks_in_use();
+
+  std::vector<void *> blocks;
+  for (int i = 0; i < 1000; i++) {
+    blocks.push_back(MEM_lockfree_mallocN((size_t)(i % 50) * 8 + 8, __func__));
+  }
+  EXPECT_EQ(MEM_lockfree_get_memory_blocks_in_use(), blocks_in_use + 1000);
+  for (void *mem : blocks) {
+    MEM_lockfree_freeN(mem);
+  }
+  EXPECT_EQ(MEM_lockfree_get_memory_in_use(), mem_in_use);
+  EXPECT_EQ(MEM_lockfree_get_memory_blocks_in_use(), blocks_in_use);
+}
+
+TEST(guardedalloc, ThreadCacheThreads)
+{
+  ThreadCacheEnabled thread_cache;
+
+  const size_t mem_in_use = MEM_lockfree_get_memory_in_use();
+
+  /* Every thread frees the blocks allocated by the next thread, so that blocks move between
+   * thread caches and through the depots. */
+  const int threads_num = 8;
+  const int blocks_num = 20000;
+  std::vector<std::vector<int *>> blocks(threads_num);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threads_num; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < blocks_num; i++) {
+        const int len = 2 + (i % 60);
+        int *mem = (int *)MEM_lockfree_mallocN(sizeof(int) * (size_t)len, __func__);
+        mem[0] = t;
+        mem[len - 1] = i;
+        blocks[t].push_back(mem);
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+  for (int t = 0; t < threads_num; t++) {
+    threads.emplace_back([&, t]() {
+      const int other = (t + 1) % threads_num;
+      for (int i = 0; i < blocks_num; i++) {
+        int *mem = blocks[other][i];
+        EXPECT_EQ(mem[0], other);
+        EXPECT_EQ(mem[1 + i % 60], i);
+        MEM_lockfree_freeN(mem);
+        /* Reuse some of the freed blocks. */
+        if (i % 4 == 0) {
+          MEM_lockfree_freeN(MEM_lockfree_callocN(sizeof(int) * 8, __func__));
+        }
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(MEM_lockfree_get_memory_in_use(), mem_in_use);
+}
@@ -231,6 +231,10 @@ void *CustomData_duplicate_referenced_layer_named(struct CustomData *data,
                                                   const int type,
                                                   const char *name,
                                                   const int totelem);
+void CustomData_duplicate_referenced_layers_reuse(struct CustomData *data,
+                                                  const int totelem,
+                                                  struct CustomData *data_reuse,
+                                                  const int totelem_reuse);
 bool CustomData_is_referenced_layer(struct CustomData *data, int type);
 
 /* set the CD_FLAG_NOCOPY flag in custom data layers where the mask is
@@ -0,0 +1,85 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup bke
+ *
+ * Results of the mesh modifier stack kept at modifiers with #eModifierFlag_CacheResult, so that
+ * the evaluation can resume from there when only the following modifiers changed.
+ */
+
+#include "BLI_sys_types.h"
+
+#include "DNA_customdata_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct CDMaskLink;
+struct Mesh;
+struct ModifierData;
+struct Object;
+struct Scene;
+
+/* State of the modifier stack evaluation after a constructive modifier. */
+typedef struct ModifierStackCheckpoint {
+  struct Mesh *mesh_final;
+  struct Mesh *mesh_orco;
+  struct Mesh *mesh_orco_cloth;
+  CustomData_MeshMasks append_mask;
+} ModifierStackCheckpoint;
+
+/**
+ * Identifies the result of the stack up to a modifier. Next to the hash, the sizes of the input
+ * mesh are compared before a result is reused.
+ */
+typedef struct ModifierStackCacheKey {
+  uint64_t hash;
+  int totvert;
+  int totedge;
+  int totpoly;
+} ModifierStackCacheKey;
+
+bool BKE_modifier_stack_cache_used(const struct Object *ob);
+
+int BKE_modifier_stack_cache_keys(struct Scene *scene,
+                                  struct Object *ob,
+                                  struct ModifierData *firstmd,
+                                  const struct CDMaskLink *datamasks,
+                                  const CustomData_MeshMasks *final_datamask,
+                                  int eval_flag,
+                                  ModifierStackCacheKey *r_keys);
+
+const ModifierStackCheckpoint *BKE_modifier_stack_cache_find(struct Object *ob,
+                                                             const struct ModifierData *md,
+                                                             const ModifierStackCacheKey *key);
+void BKE_modifier_stack_cache_store(struct Object *ob,
+                                    const struct ModifierData *md,
+                                    const ModifierStackCacheKey *key,
+                                    const ModifierStackCheckpoint *checkpoint);
+
+void BKE_modifier_stack_checkpoint_copy(const ModifierStackCheckpoint *checkpoint,
+                                        ModifierStackCheckpoint *r_checkpoint);
+
+void BKE_modifier_stack_cache_remove_unused(struct Object *ob);
+void BKE_modifier_stack_cache_free(struct Object *ob);
+
+#ifdef __cplusplus
+}
+#endif
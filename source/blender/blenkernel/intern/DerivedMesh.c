@@ -59,6 +59,7 @@
 #include "BKE_mesh_tangent.h"
 #include "BKE_mesh_wrapper.h"
 #include "BKE_modifier.h"
+#include "BKE_modifier_stack_cache.h"
 #include "BKE_multires.h"
 #include "BKE_object.h"
 #include "BKE_object_deform.h"
@@ -869,6 +870,19 @@ void BKE_mesh_wrapper_deferred_finalize(Mesh *me_eval,
   BLI_assert(me_eval->runtime.wrapper_type_finalize == 0);
 }
 
+static bool modifier_stack_has_error(ModifierData *firstmd, ModifierData *lastmd)
+{
+  for (ModifierData *md = firstmd; md; md = md->next) {
+    if (md->error) {
+      return true;
+    }
+    if (md == lastmd) {
+      break;
+    }
+  }
+  return false;
+}
+
 static void mesh_calc_modifiers(struct Depsgraph *depsgraph,
                                 Scene *scene,
                                 Object *ob,
@@ -954,9 +968,52 @@ static void mesh_calc_modifiers(struct Depsgraph *depsgraph,
   /* Clear errors before evaluation. */
   BKE_modifiers_clear_errors(ob);
 
-  /* Apply all leading deform modifiers. */
-  if (useDeform) {
-    for (; md; md = md->next, md_datamask = md_datamask->next) {
+  /* Find the last cached result of the stack which is still valid, to continue the evaluation
+   * from there. Keys are computed for the leading modifiers which can be cached. */
+  ModifierStackCacheKey *cache_keys = NULL;
+  int cache_keys_len = 0;
+  ModifierData *cache_resume_md = NULL;
+  CDMaskLink *cache_resume_datamask = NULL;
+  int cache_resume_index = -1;
+  ModifierStackCheckpoint cache_resume = {NULL};
+  if (!BKE_modifier_stack_cache_used(ob)) {
+    BKE_modifier_stack_cache_free(ob);
+  }
+  else if (index == -1 && !sculpt_mode && DEG_is_evaluated_object(ob)) {
+    const int eval_flag = (useDeform + 1) | (need_mapping << 2) | (use_render << 3) |
+                          (use_cache << 4);
+    cache_keys = MEM_malloc_arrayN(
+        (size_t)BLI_listbase_count(&ob->modifiers), sizeof(*cache_keys), __func__);
+    cache_keys_len = BKE_modifier_stack_cache_keys(
+        scene, ob, firstmd, datamasks, &final_datamask, eval_flag, cache_keys);
+    BKE_modifier_stack_cache_remove_unused(ob);
+
+    const ModifierStackCheckpoint *checkpoint = NULL;
+    ModifierData *cache_md = firstmd;
+    CDMaskLink *cache_datamask = datamasks;
+    for (int i = 0; i < cache_keys_len;
+         i++, cache_md = cache_md->next, cache_datamask = cache_datamask->next) {
+      if (cache_md->flag & eModifierFlag_CacheResult) {
+        const ModifierStackCheckpoint *found = BKE_modifier_stack_cache_find(
+            ob, cache_md, &cache_keys[i]);
+        if (found) {
+          checkpoint = found;
+          cache_resume_md = cache_md;
+          cache_resume_datamask = cache_datamask;
+          cache_resume_index = i;
+        }
+      }
+    }
+    if (checkpoint) {
+      BKE_modifier_stack_checkpoint_copy(checkpoint, &cache_resume);
+    }
+  }
+  int md_index = 0;
+
+  /* Apply all leading deform modifiers. The result is replaced by the cached one, only evaluate
+   * them if the deformed mesh is needed. */
+  if (useDeform && (cache_resume_md == NULL || r_deform != NULL)) {
+    for (; md; md = md->next, md_datamask = md_datamask->next, md_index++) {
       const ModifierTypeInfo *mti = BKE_modifier_get_info(md->type);
 
       if (!BKE_modifier_is_enabled(scene, md, required_mode)) {
@@ -1006,9 +1063,27 @@ static void mesh_calc_modifiers(struct Depsgraph *depsgraph,
     }
   }
 
+  /* Continue after the cached result. */
+  if (cache_resume_md != NULL) {
+    MEM_SAFE_FREE(deformed_verts);
+    if (mesh_final) {
+      BKE_id_free(NULL, mesh_final);
+    }
+    mesh_final = cache_resume.mesh_final;
+    mesh_final->runtime.deformed_only = false;
+    mesh_orco = cache_resume.mesh_orco;
+    mesh_orco_cloth = cache_resume.mesh_orco_cloth;
+    append_mask = cache_resume.append_mask;
+    isPrevDeform = false;
+
+    md = cache_resume_md->next;
+    md_datamask = cache_resume_datamask->next;
+    md_index = cache_resume_index + 1;
+  }
+
   /* Apply all remaining constructive and deforming modifiers. */
-  bool have_non_onlydeform_modifiers_appled = false;
-  for (; md; md = md->next, md_datamask = md_datamask->next) {
+  bool have_non_onlydeform_modifiers_appled = (cache_resume_md != NULL);
+  for (; md; md = md->next, md_datamask = md_datamask->next, md_index++) {
     const ModifierTypeInfo *mti = BKE_modifier_get_info(md->type);
 
     if (!BKE_modifier_is_enabled(scene, md, required_mode)) {
@@ -1264,6 +1339,18 @@ static void mesh_calc_modifiers(struct Depsgraph *depsgraph,
       }
 
       mesh_final->runtime.deformed_only = false;
+
+      /* Keep a copy of the result, unless the stack failed up to here. */
+      if ((md->flag & eModifierFlag_CacheResult) && md_index < cache_keys_len &&
+          deformed_verts == NULL && !modifier_stack_has_error(firstmd, md)) {
+        const ModifierStackCheckpoint checkpoint = {
+            .mesh_final = mesh_final,
+            .mesh_orco = mesh_orco,
+            .mesh_orco_cloth = mesh_orco_cloth,
+            .append_mask = append_mask,
+        };
+        BKE_modifier_stack_cache_store(ob, md, &cache_keys[md_index], &checkpoint);
+      }
     }
 
     isPrevDeform = (mti->type == eModifierTypeType_OnlyDeform);
@@ -1279,6 +1366,7 @@ static void mesh_calc_modifiers(struct Depsgraph *depsgraph,
   }
 
   BLI_linklist_free((LinkNode *)datamasks, NULL);
+  MEM_SAFE_FREE(cache_keys);
 
   for (md = firstmd; md; md = md->next) {
     BKE_modifier_free_temporary_data(md);
@@ -1173,7 +1173,9 @@ static BVHTree *bvhtree_from_mesh_looptri_create_tree(float epsilon,
         }
       }
       BLI_assert(BLI_bvhtree_get_len(tree) == looptri_num_active);
-      BLI_bvhtree_balance(tree);
+      /* Triangle sizes vary a lot on scans and sculpts, the SAH tree pays off quickly
+       * for the many queries of shrink-wrap, data transfer and collisions. */
+      BLI_bvhtree_balance_ex(tree, BVH_BALANCE_USE_SAH);
     }
   }
 
@@ -80,6 +80,23 @@ void BKE_callback_add(bCallbackFuncStore *funcstore, eCbEvent evt)
   BLI_addtail(lb, funcstore);
 }
 
+/**
+ * Check whether executing the event runs any callbacks, to skip work only needed for them.
+ *
+ * \note Only call this from the main thread: the Python handler lists are read without
+ * holding the GIL, which is only safe where they are modified.
+ */
+bool BKE_callback_is_used(eCbEvent evt)
+{
+  ListBase *lb = &callback_slots[evt];
+  LISTBASE_FOREACH (bCallbackFuncStore *, funcstore, lb) {
+    if (funcstore->is_used == NULL || funcstore->is_used(funcstore->arg)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void BKE_callback_global_init(void)
 {
   /* do nothing */
@@ -2860,6 +2860,43 @@ void *CustomData_duplicate_referenced_layer_named(CustomData *data,
   return customData_duplicate_referenced_layer_index(data, layer_index, totelem);
 }
 
+/**
+ * Duplicate the data of all layers with flag NOFREE, like
+ * #CustomData_duplicate_referenced_layer. Layers which are equal to the same layer in
+ * \a data_reuse take over its data instead of duplicating it, the layer in \a data_reuse is then
+ * flagged NOFREE. This avoids allocating and copying large arrays again when updating a copy of
+ * data which mostly did not change.
+ */
+void CustomData_duplicate_referenced_layers_reuse(CustomData *data,
+                                                  const int totelem,
+                                                  CustomData *data_reuse,
+                                                  const int totelem_reuse)
+{
+  for (int i = 0; i < data->totlayer; i++) {
+    CustomDataLayer *layer = &data->layers[i];
+    if ((layer->flag & CD_FLAG_NOFREE) == 0 || layer->data == NULL) {
+      continue;
+    }
+    const LayerTypeInfo *typeInfo = layerType_getInfo(layer->type);
+    /* Layers with pointers to other allocations are always duplicated. */
+    if (totelem == totelem_reuse && typeInfo->copy == NULL) {
+      const int n = i - data->typemap[layer->type];
+      const int reuse_index = CustomData_get_layer_index_n(data_reuse, layer->type, n);
+      CustomDataLayer *layer_reuse = (reuse_index != -1) ? &data_reuse->layers[reuse_index] :
+                                                           NULL;
+      if (layer_reuse && (layer_reuse->flag & CD_FLAG_NOFREE) == 0 && layer_reuse->data &&
+          STREQ(layer->name, layer_reuse->name) &&
+          memcmp(layer->data, layer_reuse->data, (size_t)totelem * typeInfo->size) == 0) {
+        layer->data = layer_reuse->data;
+        layer->flag &= ~CD_FLAG_NOFREE;
+        layer_reuse->flag |= CD_FLAG_NOFREE;
+        continue;
+      }
+    }
+    customData_duplicate_referenced_layer_index(data, i, totelem);
+  }
+}
+
 bool CustomData_is_referenced_layer(struct CustomData *data, int type)
 {
   /* get the layer index of the first layer of type */
@@ -0,0 +1,180 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2020 Blender Foundation
+ * All rights reserved.
+ */
+
+#include "BKE_customdata.h"
+
+#include "BLI_timeit.hh"
+
+#include "DNA_customdata_types.h"
+#include "DNA_meshdata_types.h"
+
+#include "testing/testing.h"
+
+namespace blender::bke::tests {
+
+/* The copy-on-write update of a mesh: `data_orig` is the original, `data_backup` the geometry of
+ * the previous copy which was taken over before freeing it. Normal and original index layers are
+ * used since they have no copy callback, layers with one are always duplicated. */
+class CustomDataReuseTest : public testing::Test {
+ protected:
+  CustomData data_orig;
+  CustomData data_backup;
+  CustomData data_copy;
+  int orig_len = 0;
+  int backup_len = 0;
+  int copy_len = 0;
+
+  void SetUp() override
+  {
+    CustomData_reset(&data_orig);
+    CustomData_reset(&data_backup);
+    CustomData_reset(&data_copy);
+  }
+
+  void TearDown() override
+  {
+    CustomData_free(&data_copy, copy_len);
+    CustomData_free(&data_backup, backup_len);
+    CustomData_free(&data_orig, orig_len);
+  }
+
+  void add_layers(const int len)
+  {
+    orig_len = len;
+    float(*normals)[3] = (float(*)[3])CustomData_add_layer_named(
+        &data_orig, CD_NORMAL, CD_CALLOC, nullptr, len, "normal");
+    int *indices = (int *)CustomData_add_layer(&data_orig, CD_ORIGINDEX, CD_CALLOC, nullptr, len);
+    for (int i = 0; i < len; i++) {
+      normals[i][0] = (float)i;
+      indices[i] = i;
+    }
+  }
+
+  void backup()
+  {
+    backup_len = orig_len;
+    CustomData_copy(&data_orig, &data_backup, CD_MASK_ALL, CD_DUPLICATE, backup_len);
+  }
+
+  void copy_reuse()
+  {
+    copy_len = orig_len;
+    CustomData_copy(&data_orig, &data_copy, CD_MASK_ALL, CD_REFERENCE, copy_len);
+    CustomData_duplicate_referenced_layers_reuse(&data_copy, copy_len, &data_backup, backup_len);
+  }
+};
+
+static const CustomDataLayer *get_layer(const CustomData *data, const int type)
+{
+  const int index = CustomData_get_layer_index(data, type);
+  EXPECT_NE(index, -1);
+  return &data->layers[index];
+}
+
+TEST_F(CustomDataReuseTest, EqualLayersAreReused)
+{
+  add_layers(100);
+  backup();
+  const void *backup_normals = get_layer(&data_backup, CD_NORMAL)->data;
+  const void *backup_indices = get_layer(&data_backup, CD_ORIGINDEX)->data;
+
+  /* Only the indices change in the original. */
+  ((int *)get_layer(&data_orig, CD_ORIGINDEX)->data)[99] = -1;
+  copy_reuse();
+
+  const CustomDataLayer *copy_normals = get_layer(&data_copy, CD_NORMAL);
+  EXPECT_EQ(copy_normals->data, backup_normals);
+  EXPECT_EQ(copy_normals->flag & CD_FLAG_NOFREE, 0);
+  EXPECT_NE(get_layer(&data_backup, CD_NORMAL)->flag & CD_FLAG_NOFREE, 0);
+
+  const CustomDataLayer *copy_indices = get_layer(&data_copy, CD_ORIGINDEX);
+  EXPECT_NE(copy_indices->data, backup_indices);
+  EXPECT_NE(copy_indices->data, get_layer(&data_orig, CD_ORIGINDEX)->data);
+  EXPECT_EQ(copy_indices->flag & CD_FLAG_NOFREE, 0);
+  EXPECT_EQ(((int *)copy_indices->data)[99], -1);
+  EXPECT_EQ(get_layer(&data_backup, CD_ORIGINDEX)->flag & CD_FLAG_NOFREE, 0);
+}
+
+TEST_F(CustomDataReuseTest, ResizedLayersAreCopied)
+{
+  add_layers(100);
+  backup();
+  const void *backup_normals = get_layer(&data_backup, CD_NORMAL)->data;
+
+  /* The original got more elements, the beginning of the arrays is still equal. */
+  CustomData_free(&data_orig, orig_len);
+  add_layers(200);
+  copy_reuse();
+
+  const CustomDataLayer *copy_normals = get_layer(&data_copy, CD_NORMAL);
+  EXPECT_NE(copy_normals->data, backup_normals);
+  EXPECT_EQ(copy_normals->flag & CD_FLAG_NOFREE, 0);
+  EXPECT_EQ(((float(*)[3])copy_normals->data)[199][0], 199.0f);
+}
+
+TEST_F(CustomDataReuseTest, RenamedLayersAreCopied)
+{
+  add_layers(100);
+  backup();
+  const void *backup_normals = get_layer(&data_backup, CD_NORMAL)->data;
+
+  CustomData_set_layer_name(&data_orig, CD_NORMAL, 0, "renamed");
+  copy_reuse();
+
+  const CustomDataLayer *copy_normals = get_layer(&data_copy, CD_NORMAL);
+  EXPECT_NE(copy_normals->data, backup_normals);
+  EXPECT_EQ(copy_normals->flag & CD_FLAG_NOFREE, 0);
+}
+
+/* Compares updating a copy of mesh sized vertex data by duplicating all of it, as copy-on-write
+ * did before reusing layers, with reusing the layers when nothing or only the last element
+ * changed, which is the worst case for the comparison.
+ *
+ * Disabled by default since it only prints timings, run it with:
+ * `blender_test --gtest_also_run_disabled_tests --gtest_filter='*CustomDataReuse*'` */
+TEST_F(CustomDataReuseTest, DISABLED_LargeMeshTiming)
+{
+  const int len = 4 * 1000 * 1000;
+  CustomData_add_layer(&data_orig, CD_MVERT, CD_CALLOC, nullptr, len);
+  add_layers(len);
+  backup();
+
+  {
+    SCOPED_TIMER("duplicate");
+    CustomData_copy(&data_orig, &data_copy, CD_MASK_ALL, CD_DUPLICATE, len);
+  }
+  CustomData_free(&data_copy, len);
+
+  {
+    SCOPED_TIMER("reuse unchanged");
+    copy_reuse();
+  }
+  CustomData_free(&data_copy, copy_len);
+  CustomData_free(&data_backup, backup_len);
+  backup();
+
+  ((MVert *)CustomData_get_layer(&data_orig, CD_MVERT))[len - 1].co[0] = 1.0f;
+  ((int *)CustomData_get_layer(&data_orig, CD_ORIGINDEX))[len - 1] = -1;
+  {
+    SCOPED_TIMER("reuse changed last element");
+    copy_reuse();
+  }
+}
+
+}  // namespace blender::bke::tests
@@ -110,6 +110,105 @@ static bool mesh_remap_bvhtree_query_raycast(BVHTreeFromMesh *treedata,
   return false;
 }
 
+/* Batched versions of the queries above, misses get a -1 index. */
+
+static void mesh_remap_bvhtree_query_nearest_batch(BVHTreeFromMesh *treedata,
+                                                   BVHTreeNearest *r_nearest,
+                                                   const float (*cos)[3],
+                                                   const int cos_num,
+                                                   const float max_dist_sq)
+{
+  int i;
+
+  for (i = 0; i < cos_num; i++) {
+    r_nearest[i].index = -1;
+    r_nearest[i].dist_sq = max_dist_sq;
+  }
+
+  BLI_bvhtree_find_nearest_batch(
+      treedata->tree, cos, cos_num, r_nearest, treedata->nearest_callback, treedata, 0);
+
+  for (i = 0; i < cos_num; i++) {
+    if (r_nearest[i].dist_sq > max_dist_sq) {
+      r_nearest[i].index = -1;
+    }
+  }
+}
+
+static void mesh_remap_bvhtree_query_raycast_batch(BVHTreeFromMesh *treedata,
+                                                   BVHTreeRayHit *r_rayhit,
+                                                   const float (*cos)[3],
+                                                   const float (*nos)[3],
+                                                   const int cos_num,
+                                                   const float radius,
+                                                   const float max_dist)
+{
+  BVHTreeRayHit *rayhit_inv = MEM_mallocN(sizeof(*rayhit_inv) * (size_t)cos_num, __func__);
+  float(*nos_inv)[3] = MEM_mallocN(sizeof(*nos_inv) * (size_t)cos_num, __func__);
+  int i;
+
+  for (i = 0; i < cos_num; i++) {
+    r_rayhit[i].index = -1;
+    r_rayhit[i].dist = max_dist;
+    rayhit_inv[i] = r_rayhit[i];
+    negate_v3_v3(nos_inv[i], nos[i]);
+  }
+
+  BLI_bvhtree_ray_cast_batch(treedata->tree,
+                             cos,
+                             nos,
+                             cos_num,
+                             radius,
+                             r_rayhit,
+                             treedata->raycast_callback,
+                             treedata,
+                             BVH_RAYCAST_DEFAULT);
+  /* Also cast in the other direction! */
+  BLI_bvhtree_ray_cast_batch(treedata->tree,
+                             cos,
+                             (const float(*)[3])nos_inv,
+                             cos_num,
+                             radius,
+                             rayhit_inv,
+                             treedata->raycast_callback,
+                             treedata,
+                             BVH_RAYCAST_DEFAULT);
+
+  for (i = 0; i < cos_num; i++) {
+    if (rayhit_inv[i].dist < r_rayhit[i].dist) {
+      r_rayhit[i] = rayhit_inv[i];
+    }
+    if (r_rayhit[i].dist > max_dist) {
+      r_rayhit[i].index = -1;
+    }
+  }
+
+  MEM_freeN(rayhit_inv);
+  MEM_freeN(nos_inv);
+}
+
+/* Destination vertex coordinates (and optionally normals) in tree space. */
+static void mesh_remap_verts_dst_to_tree_space(const MVert *verts_dst,
+                                               const int numverts_dst,
+                                               const SpaceTransform *space_transform,
+                                               float (*r_cos)[3],
+                                               float (*r_nos)[3])
+{
+  for (int i = 0; i < numverts_dst; i++) {
+    copy_v3_v3(r_cos[i], verts_dst[i].co);
+    if (r_nos) {
+      normal_short_to_float_v3(r_nos[i], verts_dst[i].no);
+    }
+
+    if (space_transform) {
+      BLI_space_transform_apply(space_transform, r_cos[i]);
+      if (r_nos) {
+        BLI_space_transform_apply_normal(space_transform, r_nos[i]);
+      }
+    }
+  }
+}
+
 /** \} */
 
 /**
@@ -517,26 +616,26 @@ void BKE_mesh_remap_calc_verts_from_mesh(const int mode,
   }
   else {
     BVHTreeFromMesh treedata = {NULL};
-    BVHTreeNearest nearest = {0};
-    BVHTreeRayHit rayhit = {0};
+    BVHTreeNearest *nearest_dst = NULL;
     float hit_dist;
-    float tmp_co[3], tmp_no[3];
+
+    /* All destination vertices are queried at once, in tree coordinates. */
+    float(*vcos_dst)[3] = MEM_mallocN(sizeof(*vcos_dst) * (size_t)numverts_dst, __func__);
 
     if (mode == MREMAP_MODE_VERT_NEAREST) {
       BKE_bvhtree_from_mesh_get(&treedata, me_src, BVHTREE_FROM_VERTS, 2);
-      nearest.index = -1;
+
+      mesh_remap_verts_dst_to_tree_space(verts_dst, numverts_dst, space_transform, vcos_dst, NULL);
+      nearest_dst = MEM_mallocN(sizeof(*nearest_dst) * (size_t)numverts_dst, __func__);
+      mesh_remap_bvhtree_query_nearest_batch(
+          &treedata, nearest_dst, (const float(*)[3])vcos_dst, numverts_dst, max_dist_sq);
 
       for (i = 0; i < numverts_dst; i++) {
-        copy_v3_v3(tmp_co, verts_dst[i].co);
+        const BVHTreeNearest *nearest = &nearest_dst[i];
 
-        /* Convert the vertex to tree coordinates, if needed. */
-        if (space_transform) {
-          BLI_space_transform_apply(space_transform, tmp_co);
-        }
-
-        if (mesh_remap_bvhtree_query_nearest(
-                &treedata, &nearest, tmp_co, max_dist_sq, &hit_dist)) {
-          mesh_remap_item_define(r_map, i, hit_dist, 0, 1, &nearest.index, &full_weight);
+        if (nearest->index != -1) {
+          hit_dist = sqrtf(nearest->dist_sq);
+          mesh_remap_item_define(r_map, i, hit_dist, 0, 1, &nearest->index, &full_weight);
         }
         else {
           /* No source for this dest vertex! */
@@ -549,22 +648,23 @@ void BKE_mesh_remap_calc_verts_from_mesh(const int mode,
       float(*vcos_src)[3] = BKE_mesh_vert_coords_alloc(me_src, NULL);
 
       BKE_bvhtree_from_mesh_get(&treedata, me_src, BVHTREE_FROM_EDGES, 2);
-      nearest.index = -1;
 
-      for (i = 0; i < numverts_dst; i++) {
-        copy_v3_v3(tmp_co, verts_dst[i].co);
+      mesh_remap_verts_dst_to_tree_space(verts_dst, numverts_dst, space_transform, vcos_dst, NULL);
+      nearest_dst = MEM_mallocN(sizeof(*nearest_dst) * (size_t)numverts_dst, __func__);
+      mesh_remap_bvhtree_query_nearest_batch(
+          &treedata, nearest_dst, (const float(*)[3])vcos_dst, numverts_dst, max_dist_sq);
 
-        /* Convert the vertex to tree coordinates, if needed. */
-        if (space_transform) {
-          BLI_space_transform_apply(space_transform, tmp_co);
-        }
+      for (i = 0; i < numverts_dst; i++) {
+        const BVHTreeNearest *nearest = &nearest_dst[i];
+        const float *tmp_co = vcos_dst[i];
 
-        if (mesh_remap_bvhtree_query_nearest(
-                &treedata, &nearest, tmp_co, max_dist_sq, &hit_dist)) {
-          MEdge *me = &edges_src[nearest.index];
+        if (nearest->index != -1) {
+          MEdge *me = &edges_src[nearest->index];
           const float *v1cos = vcos_src[me->v1];
           const float *v2cos = vcos_src[me->v2];
 
+          hit_dist = sqrtf(nearest->dist_sq);
+
           if (mode == MREMAP_MODE_VERT_EDGE_NEAREST) {
             const float dist_v1 = len_squared_v3v3(tmp_co, v1cos);
             const float dist_v2 = len_squared_v3v3(tmp_co, v2cos);
@@ -610,24 +710,30 @@ void BKE_mesh_remap_calc_verts_from_mesh(const int mode,
       BKE_bvhtree_from_mesh_get(&treedata, me_src, BVHTREE_FROM_LOOPTRI, 2);
 
       if (mode == MREMAP_MODE_VERT_POLYINTERP_VNORPROJ) {
-        for (i = 0; i < numverts_dst; i++) {
-          copy_v3_v3(tmp_co, verts_dst[i].co);
-          normal_short_to_float_v3(tmp_no, verts_dst[i].no);
+        float(*vnos_dst)[3] = MEM_mallocN(sizeof(*vnos_dst) * (size_t)numverts_dst, __func__);
+        BVHTreeRayHit *rayhit_dst = MEM_mallocN(sizeof(*rayhit_dst) * (size_t)numverts_dst,
+                                                __func__);
+
+        mesh_remap_verts_dst_to_tree_space(
+            verts_dst, numverts_dst, space_transform, vcos_dst, vnos_dst);
+        mesh_remap_bvhtree_query_raycast_batch(&treedata,
+                                               rayhit_dst,
+                                               (const float(*)[3])vcos_dst,
+                                               (const float(*)[3])vnos_dst,
+                                               numverts_dst,
+                                               ray_radius,
+                                               max_dist);
 
-          /* Convert the vertex to tree coordinates, if needed. */
-          if (space_transform) {
-            BLI_space_transform_apply(space_transform, tmp_co);
-            BLI_space_transform_apply_normal(space_transform, tmp_no);
-          }
+        for (i = 0; i < numverts_dst; i++) {
+          const BVHTreeRayHit *rayhit = &rayhit_dst[i];
 
-          if (mesh_remap_bvhtree_query_raycast(
-                  &treedata, &rayhit, tmp_co, tmp_no, ray_radius, max_dist, &hit_dist)) {
-            const MLoopTri *lt = &treedata.looptri[rayhit.index];
+          if (rayhit->index != -1) {
+            const MLoopTri *lt = &treedata.looptri[rayhit->index];
             MPoly *mp_src = &polys_src[lt->poly];
             const int sources_num = mesh_remap_interp_poly_data_get(mp_src,
                                                                     loops_src,
                                                                     (const float(*)[3])vcos_src,
-                                                                    rayhit.co,
+                                                                    rayhit->co,
                                                                     &tmp_buff_size,
                                                                     &vcos,
                                                                     false,
@@ -636,6 +742,7 @@ void BKE_mesh_remap_calc_verts_from_mesh(const int mode,
                                                                     true,
                                                                     NULL);
 
+            hit_dist = rayhit->dist;
             mesh_remap_item_define(r_map, i, hit_dist, 0, sources_num, indices, weights);
           }
           else {
@@ -643,29 +750,32 @@ void BKE_mesh_remap_calc_verts_from_mesh(const int mode,
             BKE_mesh_remap_item_define_invalid(r_map, i);
           }
         }
+
+        MEM_freeN(vnos_dst);
+        MEM_freeN(rayhit_dst);
       }
       else {
-        nearest.index = -1;
+        mesh_remap_verts_dst_to_tree_space(
+            verts_dst, numverts_dst, space_transform, vcos_dst, NULL);
+        nearest_dst = MEM_mallocN(sizeof(*nearest_dst) * (size_t)numverts_dst, __func__);
+        mesh_remap_bvhtree_query_nearest_batch(
+            &treedata, nearest_dst, (const float(*)[3])vcos_dst, numverts_dst, max_dist_sq);
 
         for (i = 0; i < numverts_dst; i++) {
-          copy_v3_v3(tmp_co, verts_dst[i].co);
-
-          /* Convert the vertex to tree coordinates, if needed. */
-          if (space_transform) {
-            BLI_space_transform_apply(space_transform, tmp_co);
-          }
+          const BVHTreeNearest *nearest = &nearest_dst[i];
 
-          if (mesh_remap_bvhtree_query_nearest(
-                  &treedata, &nearest, tmp_co, max_dist_sq, &hit_dist)) {
-            const MLoopTri *lt = &treedata.looptri[nearest.index];
+          if (nearest->index != -1) {
+            const MLoopTri *lt = &treedata.looptri[nearest->index];
             MPoly *mp = &polys_src[lt->poly];
 
+            hit_dist = sqrtf(nearest->dist_sq);
+
             if (mode == MREMAP_MODE_VERT_POLY_NEAREST) {
               int index;
               mesh_remap_interp_poly_data_get(mp,
                                               loops_src,
                                               (const float(*)[3])vcos_src,
-                                              nearest.co,
+                                              nearest->co,
                                               &tmp_buff_size,
                                               &vcos,
                                               false,
@@ -680,7 +790,7 @@ void BKE_mesh_remap_calc_verts_from_mesh(const int mode,
               const int sources_num = mesh_remap_interp_poly_data_get(mp,
                                                                       loops_src,
                                                                       (const float(*)[3])vcos_src,
-                                                                      nearest.co,
+                                                                      nearest->co,
                                                                       &tmp_buff_size,
                                                                       &vcos,
                                                                       false,
@@ -709,6 +819,9 @@ void BKE_mesh_remap_calc_verts_from_mesh(const int mode,
       memset(r_map->items, 0, sizeof(*r_map->items) * (size_t)numverts_dst);
     }
 
+    MEM_freeN(vcos_dst);
+    MEM_SAFE_FREE(nearest_dst);
+
     free_bvhtree_from_mesh(&treedata);
   }
 }
@@ -45,6 +45,7 @@
 #include "BLI_session_uuid.h"
 #include "BLI_string.h"
 #include "BLI_string_utils.h"
+#include "BLI_trace.h"
 #include "BLI_utildefines.h"
 
 #include "BLT_translation.h"
@@ -1028,7 +1029,10 @@ struct Mesh *BKE_modifier_modify_mesh(ModifierData *md,
   if (mti->dependsOnNormals && mti->dependsOnNormals(md)) {
     modwrap_dependsOnNormals(me);
   }
-  return mti->modifyMesh(md, ctx, me);
+  TRACE_ZONE_BEGIN("modifier", md->name);
+  Mesh *result = mti->modifyMesh(md, ctx, me);
+  TRACE_ZONE_END();
+  return result;
 }
 
 void BKE_modifier_deform_verts(ModifierData *md,
@@ -1043,7 +1047,9 @@ void BKE_modifier_deform_verts(ModifierData *md,
   if (me && mti->dependsOnNormals && mti->dependsOnNormals(md)) {
     modwrap_dependsOnNormals(me);
   }
+  TRACE_ZONE_BEGIN("modifier", md->name);
   mti->deformVerts(md, ctx, me, vertexCos, numVerts);
+  TRACE_ZONE_END();
 }
 
 void BKE_modifier_deform_vertsEM(ModifierData *md,
@@ -1059,7 +1065,9 @@ void BKE_modifier_deform_vertsEM(ModifierData *md,
   if (me && mti->dependsOnNormals && mti->dependsOnNormals(md)) {
     BKE_mesh_calc_normals(me);
   }
+  TRACE_ZONE_BEGIN("modifier", md->name);
   mti->deformVertsEM(md, ctx, em, me, vertexCos, numVerts);
+  TRACE_ZONE_END();
 }
 
 /* end modifier callback wrappers */
@@ -0,0 +1,581 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup bke
+ *
+ * Results of the mesh modifier stack at modifiers with #eModifierFlag_CacheResult.
+ *
+ * A result is stored with a key, which is a 64 bit hash of everything the stack up to the
+ * modifier depends on: the input mesh, the settings of the modifiers, the objects they use and
+ * the evaluation settings. Only the leading modifiers which don't change over time, are fully
+ * described by their DNA struct and use either no data-blocks or objects which can be hashed
+ * (see #hash_modifier_operands) can be part of a key, see #BKE_modifier_stack_cache_keys.
+ *
+ * Next to the hash, the key contains the sizes of the input mesh. They are compared together
+ * with the session UUID of the modifier before a result is reused, so that a hash collision
+ * can't give the result of another mesh.
+ *
+ * The results are kept in the runtime data of the evaluated object, which survives copy-on-write
+ * updates. The memory used by the results of all objects is limited by
+ * #UserDef.modifier_cache_limit, results which don't fit are not stored.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "atomic_ops.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_modifier_types.h"
+#include "DNA_object_types.h"
+#include "DNA_scene_types.h"
+#include "DNA_userdef_types.h"
+
+#include "BLI_hash_mm2a.h"
+#include "BLI_listbase.h"
+#include "BLI_session_uuid.h"
+#include "BLI_utildefines.h"
+
+#include "BKE_customdata.h"
+#include "BKE_lib_id.h"
+#include "BKE_mesh.h"
+#include "BKE_modifier.h"
+#include "BKE_modifier_stack_cache.h"
+
+typedef struct CachedResult {
+  struct CachedResult *next, *prev;
+
+  /* Modifier after which the stack was evaluated. */
+  SessionUUID session_uuid;
+  ModifierStackCacheKey key;
+
+  ModifierStackCheckpoint checkpoint;
+  size_t memory_size;
+} CachedResult;
+
+typedef struct ModifierStackCache {
+  ListBase results;
+} ModifierStackCache;
+
+/* Memory used by the cached results of all objects. */
+static size_t cache_memory_used = 0;
+
+/* -------------------------------------------------------------------- */
+/** \name Keys
+ * \{ */
+
+/* Two MurmurHash2A states with different seeds, which together give a 64 bit hash. */
+typedef struct KeyHash {
+  BLI_HashMurmur2A low;
+  BLI_HashMurmur2A high;
+} KeyHash;
+
+static void key_hash_init(KeyHash *hash)
+{
+  BLI_hash_mm2a_init(&hash->low, 0);
+  BLI_hash_mm2a_init(&hash->high, 0x9747b28c);
+}
+
+static void key_hash_add(KeyHash *hash, const uchar *data, size_t len)
+{
+  BLI_hash_mm2a_add(&hash->low, data, len);
+  BLI_hash_mm2a_add(&hash->high, data, len);
+}
+
+static void key_hash_add_int(KeyHash *hash, int data)
+{
+  BLI_hash_mm2a_add_int(&hash->low, data);
+  BLI_hash_mm2a_add_int(&hash->high, data);
+}
+
+static uint64_t key_hash_end(KeyHash *hash)
+{
+  return ((uint64_t)BLI_hash_mm2a_end(&hash->high) << 32) | BLI_hash_mm2a_end(&hash->low);
+}
+
+static void hash_customdata(KeyHash *hash, const CustomData *data, const int totelem)
+{
+  key_hash_add_int(hash, totelem);
+  key_hash_add_int(hash, data->totlayer);
+
+  for (int i = 0; i < data->totlayer; i++) {
+    const CustomDataLayer *layer = &data->layers[i];
+    key_hash_add_int(hash, layer->type);
+    key_hash_add_int(hash, layer->flag);
+    key_hash_add(hash, (const uchar *)layer->name, strlen(layer->name));
+
+    if (layer->data == NULL) {
+      continue;
+    }
+
+    /* Layers which point to more data. */
+    switch (layer->type) {
+      case CD_MDEFORMVERT: {
+        const MDeformVert *dvert = layer->data;
+        for (int j = 0; j < totelem; j++) {
+          key_hash_add_int(hash, dvert[j].totweight);
+          if (dvert[j].dw) {
+            key_hash_add(hash,
+                         (const uchar *)dvert[j].dw,
+                         sizeof(*dvert[j].dw) * (size_t)dvert[j].totweight);
+          }
+        }
+        break;
+      }
+      case CD_MDISPS: {
+        const MDisps *mdisps = layer->data;
+        for (int j = 0; j < totelem; j++) {
+          key_hash_add_int(hash, mdisps[j].totdisp);
+          key_hash_add_int(hash, mdisps[j].level);
+          if (mdisps[j].disps) {
+            key_hash_add(hash,
+                         (const uchar *)mdisps[j].disps,
+                         sizeof(*mdisps[j].disps) * (size_t)mdisps[j].totdisp);
+          }
+          if (mdisps[j].hidden) {
+            key_hash_add(hash, (const uchar *)mdisps[j].hidden, MEM_allocN_len(mdisps[j].hidden));
+          }
+        }
+        break;
+      }
+      case CD_GRID_PAINT_MASK: {
+        const GridPaintMask *gpm = layer->data;
+        for (int j = 0; j < totelem; j++) {
+          key_hash_add_int(hash, gpm[j].level);
+          if (gpm[j].data) {
+            key_hash_add(hash, (const uchar *)gpm[j].data, MEM_allocN_len(gpm[j].data));
+          }
+        }
+        break;
+      }
+      default:
+        key_hash_add(hash, layer->data, (size_t)CustomData_sizeof(layer->type) * (size_t)totelem);
+        break;
+    }
+  }
+}
+
+static void hash_mesh(KeyHash *hash, const Mesh *mesh)
+{
+  hash_customdata(hash, &mesh->vdata, mesh->totvert);
+  hash_customdata(hash, &mesh->edata, mesh->totedge);
+  hash_customdata(hash, &mesh->ldata, mesh->totloop);
+  hash_customdata(hash, &mesh->pdata, mesh->totpoly);
+
+  /* Settings used by modifiers, like auto-smooth and the texture space for orco. */
+  key_hash_add(hash, (const uchar *)mesh->loc, sizeof(mesh->loc));
+  key_hash_add(hash, (const uchar *)mesh->size, sizeof(mesh->size));
+  key_hash_add_int(hash, mesh->texflag);
+  key_hash_add_int(hash, mesh->flag);
+  key_hash_add(hash, (const uchar *)&mesh->smoothresh, sizeof(mesh->smoothresh));
+  key_hash_add_int(hash, mesh->cd_flag);
+  key_hash_add_int(hash, mesh->totcol);
+}
+
+static void modifier_id_used_cb(void *user_data,
+                                Object *UNUSED(ob),
+                                ID **idpoin,
+                                int UNUSED(cb_flag))
+{
+  if (*idpoin != NULL) {
+    *(bool *)user_data = true;
+  }
+}
+
+static void modifier_object_used_cb(void *user_data,
+                                    Object *UNUSED(ob),
+                                    Object **obpoin,
+                                    int UNUSED(cb_flag))
+{
+  if (*obpoin != NULL) {
+    *(bool *)user_data = true;
+  }
+}
+
+/* The result of the modifier only depends on its DNA struct, on its input mesh and on the
+ * objects hashed by #hash_modifier_operands. */
+static bool modifier_is_keyable(ModifierData *md)
+{
+  const ModifierTypeInfo *mti = BKE_modifier_get_info(md->type);
+
+  if (BKE_modifier_depends_ontime(md)) {
+    return false;
+  }
+
+  /* Other modifiers own data which isn't in their struct, Subdivision Surface and Multires only
+   * own caches of their result. */
+  if (mti->copyData != BKE_modifier_copydata_generic &&
+      !ELEM(md->type, eModifierType_Subsurf, eModifierType_Multires)) {
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * Hash the parts of an evaluated object used by a modifier, the modifier has depsgraph relations
+ * to these parts, so they are evaluated already.
+ */
+static bool hash_operand_object(KeyHash *hash,
+                                Object *ob,
+                                const bool use_transform,
+                                const bool use_geometry)
+{
+  if (ob == NULL) {
+    key_hash_add_int(hash, 0);
+    return true;
+  }
+
+  key_hash_add(hash, (const uchar *)ob->id.name, strlen(ob->id.name));
+  if (use_transform) {
+    key_hash_add(hash, (const uchar *)ob->obmat, sizeof(ob->obmat));
+  }
+
+  if (use_geometry) {
+    if (ob->type != OB_MESH) {
+      return false;
+    }
+    const Mesh *mesh = BKE_modifier_get_evaluated_mesh_from_evaluated_object(ob, false);
+    if (mesh == NULL) {
+      return false;
+    }
+    key_hash_add_int(hash, ob->totcol);
+    hash_mesh(hash, mesh);
+  }
+  return true;
+}
+
+/**
+ * Add the objects a modifier uses to the key. Only done for modifier types for which it is known
+ * how the objects are used, the others can't be part of a key when they use any data-block.
+ */
+static bool hash_modifier_operands(KeyHash *hash, ModifierData *md, Object *ob)
+{
+  switch (md->type) {
+    case eModifierType_Boolean: {
+      BooleanModifierData *bmd = (BooleanModifierData *)md;
+      return hash_operand_object(hash, bmd->object, true, true);
+    }
+    case eModifierType_Array: {
+      ArrayModifierData *amd = (ArrayModifierData *)md;
+      /* The length of a curve isn't hashed. */
+      if (amd->fit_type == MOD_ARR_FITCURVE && amd->curve_ob != NULL) {
+        return false;
+      }
+      return hash_operand_object(hash, amd->start_cap, false, true) &&
+             hash_operand_object(hash, amd->end_cap, false, true) &&
+             hash_operand_object(hash, amd->offset_ob, true, false);
+    }
+    case eModifierType_Mirror: {
+      MirrorModifierData *mmd = (MirrorModifierData *)md;
+      return hash_operand_object(hash, mmd->mirror_ob, true, false);
+    }
+  }
+
+  const ModifierTypeInfo *mti = BKE_modifier_get_info(md->type);
+  bool uses_id = false;
+  if (mti->foreachIDLink) {
+    mti->foreachIDLink(md, ob, modifier_id_used_cb, &uses_id);
+  }
+  else if (mti->foreachObjectLink) {
+    mti->foreachObjectLink(md, ob, modifier_object_used_cb, &uses_id);
+  }
+  return !uses_id;
+}
+
+static void hash_modifier(KeyHash *hash, const ModifierData *md)
+{
+  const ModifierTypeInfo *mti = BKE_modifier_get_info(md->type);
+
+  key_hash_add(hash, (const uchar *)&md->session_uuid, sizeof(md->session_uuid));
+  key_hash_add_int(hash, md->type);
+  key_hash_add_int(hash, md->mode);
+  key_hash_add_int(hash, md->flag & ~eModifierFlag_CacheResult);
+
+  /* Settings of the modifier type, without the pointers to caches of Subdivision Surface. */
+  size_t settings_end = (size_t)mti->structSize;
+  if (md->type == eModifierType_Subsurf) {
+    settings_end = offsetof(SubsurfModifierData, emCache);
+  }
+  key_hash_add(
+      hash, (const uchar *)md + sizeof(ModifierData), settings_end - sizeof(ModifierData));
+}
+
+bool BKE_modifier_stack_cache_used(const Object *ob)
+{
+  LISTBASE_FOREACH (const ModifierData *, md, &ob->modifiers) {
+    if (md->flag & eModifierFlag_CacheResult) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Compute the keys of the results of the modifiers from \a firstmd, in \a r_keys which has an
+ * item for every modifier. \a eval_flag combines the evaluation settings of the caller which
+ * change the result.
+ *
+ * \return The number of leading modifiers which have a key, the results of the following
+ * modifiers can't be cached.
+ */
+int BKE_modifier_stack_cache_keys(Scene *scene,
+                                  Object *ob,
+                                  ModifierData *firstmd,
+                                  const CDMaskLink *datamasks,
+                                  const CustomData_MeshMasks *final_datamask,
+                                  const int eval_flag,
+                                  ModifierStackCacheKey *r_keys)
+{
+  /* Virtual modifiers for shape keys and armature parents use other data than the mesh. */
+  if (firstmd != ob->modifiers.first) {
+    return 0;
+  }
+
+  const Mesh *mesh = ob->data;
+
+  KeyHash hash;
+  key_hash_init(&hash);
+
+  key_hash_add_int(&hash, eval_flag);
+  key_hash_add_int(&hash, ob->mode);
+  key_hash_add_int(&hash, ob->totcol);
+  key_hash_add(&hash, (const uchar *)ob->obmat, sizeof(ob->obmat));
+  LISTBASE_FOREACH (const bDeformGroup *, dg, &ob->defbase) {
+    key_hash_add(&hash, (const uchar *)dg->name, strlen(dg->name));
+  }
+
+  /* Simplify limits the subdivision levels. */
+  key_hash_add_int(&hash, scene->r.mode & R_SIMPLIFY);
+  key_hash_add_int(&hash, scene->r.simplify_subsurf);
+  key_hash_add_int(&hash, scene->r.simplify_subsurf_render);
+
+  hash_mesh(&hash, mesh);
+
+  int keys_len = 0;
+  const CDMaskLink *md_datamask = datamasks;
+  for (ModifierData *md = firstmd; md; md = md->next, md_datamask = md_datamask->next) {
+    if (!modifier_is_keyable(md)) {
+      break;
+    }
+
+    /* The layers kept by a modifier depend on what the following modifiers need. */
+    hash_modifier(&hash, md);
+    if (!hash_modifier_operands(&hash, md, ob)) {
+      break;
+    }
+    key_hash_add(&hash, (const uchar *)&md_datamask->mask, sizeof(md_datamask->mask));
+
+    const CustomData_MeshMasks *nextmask = md_datamask->next ? &md_datamask->next->mask :
+                                                               final_datamask;
+    KeyHash hash_result = hash;
+    key_hash_add(&hash_result, (const uchar *)nextmask, sizeof(*nextmask));
+    ModifierStackCacheKey *key = &r_keys[keys_len++];
+    key->hash = key_hash_end(&hash_result);
+    key->totvert = mesh->totvert;
+    key->totedge = mesh->totedge;
+    key->totpoly = mesh->totpoly;
+  }
+
+  return keys_len;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Results
+ * \{ */
+
+static size_t customdata_memory_size(const CustomData *data, const int totelem)
+{
+  size_t size = 0;
+  for (int i = 0; i < data->totlayer; i++) {
+    size += (size_t)CustomData_sizeof(data->layers[i].type) * (size_t)totelem;
+  }
+  return size;
+}
+
+static size_t mesh_memory_size(const Mesh *mesh)
+{
+  if (mesh == NULL) {
+    return 0;
+  }
+  return customdata_memory_size(&mesh->vdata, mesh->totvert) +
+         customdata_memory_size(&mesh->edata, mesh->totedge) +
+         customdata_memory_size(&mesh->ldata, mesh->totloop) +
+         customdata_memory_size(&mesh->pdata, mesh->totpoly);
+}
+
+static Mesh *mesh_copy_or_null(Mesh *mesh)
+{
+  return mesh ? BKE_mesh_copy_for_eval(mesh, false) : NULL;
+}
+
+/**
+ * Copy the meshes of the checkpoint, the copies are owned by the modifier stack evaluation.
+ */
+void BKE_modifier_stack_checkpoint_copy(const ModifierStackCheckpoint *checkpoint,
+                                        ModifierStackCheckpoint *r_checkpoint)
+{
+  r_checkpoint->mesh_final = mesh_copy_or_null(checkpoint->mesh_final);
+  r_checkpoint->mesh_orco = mesh_copy_or_null(checkpoint->mesh_orco);
+  r_checkpoint->mesh_orco_cloth = mesh_copy_or_null(checkpoint->mesh_orco_cloth);
+  r_checkpoint->append_mask = checkpoint->append_mask;
+}
+
+static void cached_result_free(ModifierStackCache *cache, CachedResult *result)
+{
+  ModifierStackCheckpoint *checkpoint = &result->checkpoint;
+  BKE_id_free(NULL, checkpoint->mesh_final);
+  if (checkpoint->mesh_orco) {
+    BKE_id_free(NULL, checkpoint->mesh_orco);
+  }
+  if (checkpoint->mesh_orco_cloth) {
+    BKE_id_free(NULL, checkpoint->mesh_orco_cloth);
+  }
+  atomic_sub_and_fetch_z(&cache_memory_used, result->memory_size);
+
+  BLI_freelinkN(&cache->results, result);
+}
+
+static bool cached_result_key_matches(const CachedResult *result,
+                                      const ModifierData *md,
+                                      const ModifierStackCacheKey *key)
+{
+  return BLI_session_uuid_is_equal(&result->session_uuid, &md->session_uuid) &&
+         result->key.hash == key->hash && result->key.totvert == key->totvert &&
+         result->key.totedge == key->totedge && result->key.totpoly == key->totpoly;
+}
+
+static CachedResult *cached_result_find(ModifierStackCache *cache, const ModifierData *md)
+{
+  LISTBASE_FOREACH (CachedResult *, result, &cache->results) {
+    if (BLI_session_uuid_is_equal(&result->session_uuid, &md->session_uuid)) {
+      return result;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Get the result of the stack up to \a md, a result with another key is outdated and freed.
+ */
+const ModifierStackCheckpoint *BKE_modifier_stack_cache_find(Object *ob,
+                                                             const ModifierData *md,
+                                                             const ModifierStackCacheKey *key)
+{
+  ModifierStackCache *cache = ob->runtime.modifier_stack_cache;
+  if (cache == NULL) {
+    return NULL;
+  }
+
+  CachedResult *result = cached_result_find(cache, md);
+  if (result == NULL) {
+    return NULL;
+  }
+  if (!cached_result_key_matches(result, md, key)) {
+    cached_result_free(cache, result);
+    return NULL;
+  }
+  return &result->checkpoint;
+}
+
+/**
+ * Store a copy of the result of the stack up to \a md, unless it's already stored or doesn't
+ * fit in the memory limit.
+ */
+void BKE_modifier_stack_cache_store(Object *ob,
+                                    const ModifierData *md,
+                                    const ModifierStackCacheKey *key,
+                                    const ModifierStackCheckpoint *checkpoint)
+{
+  ModifierStackCache *cache = ob->runtime.modifier_stack_cache;
+  if (cache != NULL) {
+    CachedResult *result = cached_result_find(cache, md);
+    if (result != NULL) {
+      if (cached_result_key_matches(result, md, key)) {
+        return;
+      }
+      cached_result_free(cache, result);
+    }
+  }
+
+  const size_t memory_size = mesh_memory_size(checkpoint->mesh_final) +
+                             mesh_memory_size(checkpoint->mesh_orco) +
+                             mesh_memory_size(checkpoint->mesh_orco_cloth);
+  const size_t memory_limit = (size_t)U.modifier_cache_limit * 1024 * 1024;
+  if (atomic_add_and_fetch_z(&cache_memory_used, memory_size) > memory_limit) {
+    atomic_sub_and_fetch_z(&cache_memory_used, memory_size);
+    return;
+  }
+
+  if (cache == NULL) {
+    cache = MEM_callocN(sizeof(*cache), "ModifierStackCache");
+    ob->runtime.modifier_stack_cache = cache;
+  }
+
+  CachedResult *result = MEM_callocN(sizeof(*result), "ModifierStackCache result");
+  result->session_uuid = md->session_uuid;
+  result->key = *key;
+  result->memory_size = memory_size;
+  BKE_modifier_stack_checkpoint_copy(checkpoint, &result->checkpoint);
+  BLI_addtail(&cache->results, result);
+}
+
+/**
+ * Free the results of modifiers which were removed or don't use #eModifierFlag_CacheResult.
+ */
+void BKE_modifier_stack_cache_remove_unused(Object *ob)
+{
+  ModifierStackCache *cache = ob->runtime.modifier_stack_cache;
+  if (cache == NULL) {
+    return;
+  }
+
+  LISTBASE_FOREACH_MUTABLE (CachedResult *, result, &cache->results) {
+    bool used = false;
+    LISTBASE_FOREACH (const ModifierData *, md, &ob->modifiers) {
+      if ((md->flag & eModifierFlag_CacheResult) &&
+          BLI_session_uuid_is_equal(&result->session_uuid, &md->session_uuid)) {
+        used = true;
+        break;
+      }
+    }
+    if (!used) {
+      cached_result_free(cache, result);
+    }
+  }
+}
+
+void BKE_modifier_stack_cache_free(Object *ob)
+{
+  ModifierStackCache *cache = ob->runtime.modifier_stack_cache;
+  if (cache == NULL) {
+    return;
+  }
+
+  LISTBASE_FOREACH_MUTABLE (CachedResult *, result, &cache->results) {
+    cached_result_free(cache, result);
+  }
+  MEM_freeN(cache);
+  ob->runtime.modifier_stack_cache = NULL;
+}
+
+/** \} */
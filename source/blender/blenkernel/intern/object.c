@@ -110,6 +110,7 @@
 #include "BKE_mesh.h"
 #include "BKE_mesh_wrapper.h"
 #include "BKE_modifier.h"
+#include "BKE_modifier_stack_cache.h"
 #include "BKE_multires.h"
 #include "BKE_node.h"
 #include "BKE_object.h"
@@ -322,6 +323,8 @@ static void object_free_data(ID *id)
     ob->runtime.curve_cache = NULL;
   }
 
+  BKE_modifier_stack_cache_free(ob);
+
   BKE_previewimg_free(&ob->preview);
 }
 
@@ -955,6 +958,7 @@ void BKE_object_free_caches(Object *object)
    */
   if ((object->base_flag & BASE_FROM_DUPLI) == 0) {
     BKE_object_free_derived_caches(object);
+    BKE_modifier_stack_cache_free(object);
     update_flag |= ID_RECALC_GEOMETRY;
   }
 
@@ -4231,6 +4235,7 @@ void BKE_object_runtime_reset_on_copy(Object *object, const int UNUSED(flag))
   runtime->data_eval = NULL;
   runtime->mesh_deform_eval = NULL;
   runtime->curve_cache = NULL;
+  runtime->modifier_stack_cache = NULL;
 }
 
 /**
@@ -100,6 +100,10 @@ typedef struct ShrinkwrapCalcCBData {
 
   float *proj_axis;
   SpaceTransform *local2aux;
+
+  /* Nearest vertex results and vertex group weights, per vertex. */
+  const BVHTreeNearest *nearest;
+  const float *weights;
 } ShrinkwrapCalcCBData;
 
 /* Checks if the modifier needs target normals with these settings. */
@@ -354,48 +358,16 @@ void BKE_shrinkwrap_compute_boundary_data(struct Mesh *mesh)
  */
 static void shrinkwrap_calc_nearest_vertex_cb_ex(void *__restrict userdata,
                                                  const int i,
-                                                 const TaskParallelTLS *__restrict tls)
+                                                 const TaskParallelTLS *__restrict UNUSED(tls))
 {
   ShrinkwrapCalcCBData *data = userdata;
 
   ShrinkwrapCalcData *calc = data->calc;
-  BVHTreeFromMesh *treeData = &data->tree->treeData;
-  BVHTreeNearest *nearest = tls->userdata_chunk;
+  const BVHTreeNearest *nearest = &data->nearest[i];
 
   float *co = calc->vertexCos[i];
   float tmp_co[3];
-  float weight = BKE_defvert_array_find_weight_safe(calc->dvert, i, calc->vgroup);
-
-  if (calc->invert_vgroup) {
-    weight = 1.0f - weight;
-  }
-
-  if (weight == 0.0f) {
-    return;
-  }
-
-  /* Convert the vertex to tree coordinates */
-  if (calc->vert) {
-    copy_v3_v3(tmp_co, calc->vert[i].co);
-  }
-  else {
-    copy_v3_v3(tmp_co, co);
-  }
-  BLI_space_transform_apply(&calc->local2target, tmp_co);
-
-  /* Use local proximity heuristics (to reduce the nearest search)
-   *
-   * If we already had an hit before.. we assume this vertex is going to have a close hit to that
-   * other vertex so we can initiate the "nearest.dist" with the expected value to that last hit.
-   * This will lead in pruning of the search tree. */
-  if (nearest->index != -1) {
-    nearest->dist_sq = len_squared_v3v3(tmp_co, nearest->co);
-  }
-  else {
-    nearest->dist_sq = FLT_MAX;
-  }
-
-  BLI_bvhtree_find_nearest(treeData->tree, tmp_co, nearest, treeData->nearest_callback, treeData);
+  float weight = data->weights[i];
 
   /* Found the nearest vertex */
   if (nearest->index != -1) {
@@ -416,23 +388,60 @@ static void shrinkwrap_calc_nearest_vertex_cb_ex(void *__restrict userdata,
 
 static void shrinkwrap_calc_nearest_vertex(ShrinkwrapCalcData *calc)
 {
-  BVHTreeNearest nearest = NULL_BVHTreeNearest;
+  BVHTreeFromMesh *treeData = &calc->tree->treeData;
+  const size_t verts_num = (size_t)calc->numVerts;
 
-  /* Setup nearest */
-  nearest.index = -1;
-  nearest.dist_sq = FLT_MAX;
+  BVHTreeNearest *nearest = MEM_malloc_arrayN(verts_num, sizeof(*nearest), __func__);
+  float *weights = MEM_malloc_arrayN(verts_num, sizeof(*weights), __func__);
+  float(*tmp_cos)[3] = MEM_malloc_arrayN(verts_num, sizeof(*tmp_cos), __func__);
+
+  for (int i = 0; i < calc->numVerts; i++) {
+    float weight = BKE_defvert_array_find_weight_safe(calc->dvert, i, calc->vgroup);
+
+    if (calc->invert_vgroup) {
+      weight = 1.0f - weight;
+    }
+    weights[i] = weight;
+
+    /* Convert the vertex to tree coordinates */
+    if (calc->vert) {
+      copy_v3_v3(tmp_cos[i], calc->vert[i].co);
+    }
+    else {
+      copy_v3_v3(tmp_cos[i], calc->vertexCos[i]);
+    }
+    BLI_space_transform_apply(&calc->local2target, tmp_cos[i]);
+
+    /* A zero search distance skips unaffected vertices. */
+    nearest[i].index = -1;
+    nearest[i].dist_sq = (weight == 0.0f) ? 0.0f : FLT_MAX;
+  }
+
+  /* The batched query sorts the vertices by position and seeds each search with the previous
+   * result, which replaces the local proximity heuristic of the per vertex search. */
+  BLI_bvhtree_find_nearest_batch(treeData->tree,
+                                 (const float(*)[3])tmp_cos,
+                                 calc->numVerts,
+                                 nearest,
+                                 treeData->nearest_callback,
+                                 treeData,
+                                 0);
 
   ShrinkwrapCalcCBData data = {
       .calc = calc,
       .tree = calc->tree,
+      .nearest = nearest,
+      .weights = weights,
   };
   TaskParallelSettings settings;
   BLI_parallel_range_settings_defaults(&settings);
   settings.use_threading = (calc->numVerts > BKE_MESH_OMP_LIMIT);
-  settings.userdata_chunk = &nearest;
-  settings.userdata_chunk_size = sizeof(nearest);
   BLI_task_parallel_range(
       0, calc->numVerts, &data, shrinkwrap_calc_nearest_vertex_cb_ex, &settings);
+
+  MEM_freeN(nearest);
+  MEM_freeN(weights);
+  MEM_freeN(tmp_cos);
 }
 
 /*
@@ -0,0 +1,596 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * A `blender::ConcurrentMap<Key, Value>` is an unordered associative container that can be filled
+ * from many threads at the same time, without a lock around every access. It is meant for
+ * parallel algorithms that produce key-value-pairs which have to be deduplicated, instead of
+ * building a map per thread and merging them afterwards, or protecting a `blender::Map` with a
+ * global lock.
+ *
+ * Like blender::Map, it is implemented using open addressing in a slot array with a power-of-two
+ * size, using the probing strategies from BLI_probing_strategies.hh. Every slot has an atomic
+ * state, which is either empty, constructing, occupied or migrated.
+ * - Adding a key claims an empty slot with a compare-and-swap and then constructs key and value in
+ *   it. Threads probing past a slot that is still being constructed wait until it is done, so that
+ *   every key is only added once.
+ * - When the map becomes too full, a slot array with twice the size is allocated. All threads
+ *   accessing the map help moving the slots into it, one chunk of slots at a time, so the map also
+ *   grows in parallel. Operations that run into a migrated slot retry in the new slot array.
+ *
+ * Some noteworthy differences to blender::Map:
+ * - Keys cannot be removed and values cannot be changed once they are added. Lookups return
+ *   copies of the values, so Key and Value have to be copyable (and should be cheap to copy).
+ * - Slot arrays the map has grown out of are only freed when the map is cleared or destructed,
+ *   because other threads might still be reading from them. Since the size doubles every time,
+ *   this at most doubles the memory used by the map.
+ * - Only the add, lookup and contains methods are thread-safe. All other methods must not be
+ *   called while other threads use the map.
+ */
+
+#include <atomic>
+#include <optional>
+#include <thread>
+
+#include "BLI_allocator.hh"
+#include "BLI_hash.hh"
+#include "BLI_hash_tables.hh"
+#include "BLI_memory_utils.hh"
+#include "BLI_probing_strategies.hh"
+#include "BLI_utility_mixins.hh"
+
+namespace blender {
+
+template<
+    /**
+     * Type of the keys stored in the map. Keys have to be copyable. Furthermore, the hash and
+     * is-equal functions have to support it.
+     */
+    typename Key,
+    /**
+     * Type of the value that is stored per key. It has to be copyable as well.
+     */
+    typename Value,
+    /**
+     * The strategy used to deal with collisions. They are defined in BLI_probing_strategies.hh.
+     */
+    typename ProbingStrategy = DefaultProbingStrategy,
+    /**
+     * The hash function used to hash the keys. There is a default for many types. See BLI_hash.hh
+     * for examples on how to define a custom hash function.
+     */
+    typename Hash = DefaultHash<Key>,
+    /**
+     * The equality operator used to compare keys. By default it will simply compare keys using the
+     * `==` operator.
+     */
+    typename IsEqual = DefaultEquality,
+    /**
+     * The allocator used by this map. Should rarely be changed, except when you don't want that
+     * MEM_* is used internally.
+     */
+    typename Allocator = GuardedAllocator>
+class ConcurrentMap : NonCopyable, NonMovable {
+ private:
+  enum SlotState : uint8_t {
+    Empty = 0,
+    /** A thread claimed the slot and is constructing the key and value. */
+    Constructing = 1,
+    Occupied = 2,
+    /** The slot has been moved to the grown slot array, it was empty before. */
+    MigratedEmpty = 3,
+    /** The slot has been copied to the grown slot array, key and value are still valid. */
+    MigratedOccupied = 4,
+  };
+
+  struct Slot {
+    std::atomic<uint8_t> state;
+    TypedBuffer<Key> key;
+    TypedBuffer<Value> value;
+  };
+
+  struct SlotArray {
+    Slot *slots;
+    int64_t total_slots;
+    uint64_t slot_mask;
+    int64_t usable_slots;
+
+    /** Number of occupied slots, including the slots threads are about to occupy. */
+    std::atomic<int64_t> reserved_slots;
+
+    /** The slot array this one grows into, set when the migration starts. */
+    std::atomic<SlotArray *> next;
+    std::atomic<int64_t> migrate_chunks_started;
+    std::atomic<int64_t> migrate_chunks_finished;
+
+    /** The slot array this one has grown out of, freed together with this one. */
+    SlotArray *prev;
+  };
+
+  enum class ProbeResult {
+    Added,
+    Found,
+    NotFound,
+    /** The slot array is being grown, the operation has to be done in the grown array. */
+    Migrating,
+  };
+
+  /** Number of slots that a thread moves to the grown slot array at once. */
+  static constexpr int64_t migrate_chunk_size = 1024;
+
+  /** The max load factor is 1/2 = 50%, like blender::Map. */
+  static constexpr int64_t max_load_factor_numerator = 1;
+  static constexpr int64_t max_load_factor_denominator = 2;
+
+  /** Size of the slot array that is allocated on construction. */
+  static constexpr int64_t min_total_slots = 16;
+
+  /**
+   * The slot array new keys are added to. Changes when the map grows, which can happen from const
+   * methods as well, since all threads help growing the map.
+   */
+  mutable std::atomic<SlotArray *> array_;
+
+  /** This is called to hash incoming keys. */
+  Hash hash_;
+
+  /** This is called to check equality of two keys. */
+  IsEqual is_equal_;
+
+  mutable Allocator allocator_;
+
+ public:
+  ConcurrentMap(Allocator allocator = {}) : hash_(), is_equal_(), allocator_(allocator)
+  {
+    array_.store(this->slot_array_new(min_total_slots, nullptr), std::memory_order_relaxed);
+  }
+
+  ~ConcurrentMap()
+  {
+    this->slot_arrays_free(array_.load(std::memory_order_relaxed));
+  }
+
+  /**
+   * Add a key-value-pair to the map. If the map contains the key already, nothing is changed.
+   * Returns true when the key has been newly added.
+   *
+   * This is thread-safe.
+   */
+  bool add(const Key &key, const Value &value)
+  {
+    return this->add_as(key, value);
+  }
+  bool add(const Key &key, Value &&value)
+  {
+    return this->add_as(key, std::move(value));
+  }
+  bool add(Key &&key, const Value &value)
+  {
+    return this->add_as(std::move(key), value);
+  }
+  bool add(Key &&key, Value &&value)
+  {
+    return this->add_as(std::move(key), std::move(value));
+  }
+  template<typename ForwardKey, typename ForwardValue>
+  bool add_as(ForwardKey &&key, ForwardValue &&value)
+  {
+    return this->add__impl(std::forward<ForwardKey>(key),
+                           std::forward<ForwardValue>(value),
+                           hash_(key),
+                           nullptr) == ProbeResult::Added;
+  }
+
+  /**
+   * Returns the value that is stored for the given key. When the key is not in the map yet, it is
+   * added with the given value first. When multiple threads add the same key at the same time,
+   * all of them get the value of the thread that added it first.
+   *
+   * This is thread-safe.
+   */
+  Value lookup_or_add(const Key &key, const Value &value)
+  {
+    return this->lookup_or_add_as(key, value);
+  }
+  template<typename ForwardKey, typename ForwardValue>
+  Value lookup_or_add_as(ForwardKey &&key, ForwardValue &&value)
+  {
+    const Value *r_value;
+    this->add__impl(
+        std::forward<ForwardKey>(key), std::forward<ForwardValue>(value), hash_(key), &r_value);
+    return *r_value;
+  }
+
+  /**
+   * Returns a copy of the value corresponding to the key, or std::nullopt when the key is not
+   * in the map.
+   *
+   * This is thread-safe.
+   */
+  std::optional<Value> lookup_try(const Key &key) const
+  {
+    return this->lookup_try_as(key);
+  }
+  template<typename ForwardKey> std::optional<Value> lookup_try_as(const ForwardKey &key) const
+  {
+    const Value *value = this->lookup__impl(key, hash_(key));
+    if (value == nullptr) {
+      return {};
+    }
+    return *value;
+  }
+
+  /**
+   * Returns a copy of the value corresponding to the key, or the given default value when the key
+   * is not in the map.
+   *
+   * This is thread-safe.
+   */
+  Value lookup_default(const Key &key, const Value &default_value) const
+  {
+    return this->lookup_default_as(key, default_value);
+  }
+  template<typename ForwardKey>
+  Value lookup_default_as(const ForwardKey &key, const Value &default_value) const
+  {
+    const Value *value = this->lookup__impl(key, hash_(key));
+    return (value != nullptr) ? *value : default_value;
+  }
+
+  /**
+   * Returns true if there is a key in the map that compares equal to the given key.
+   *
+   * This is thread-safe.
+   */
+  bool contains(const Key &key) const
+  {
+    return this->contains_as(key);
+  }
+  template<typename ForwardKey> bool contains_as(const ForwardKey &key) const
+  {
+    return this->lookup__impl(key, hash_(key)) != nullptr;
+  }
+
+  /**
+   * Return the number of key-value-pairs that are stored in the map. Only exact when no other
+   * threads are adding keys.
+   */
+  int64_t size() const
+  {
+    return array_.load(std::memory_order_acquire)->reserved_slots.load(std::memory_order_relaxed);
+  }
+
+  bool is_empty() const
+  {
+    return this->size() == 0;
+  }
+
+  /**
+   * Call the given function for every key-value-pair, in no particular order. This must not be
+   * called while other threads are adding keys.
+   */
+  template<typename FuncT> void foreach_item(const FuncT &func) const
+  {
+    const SlotArray *array = array_.load(std::memory_order_acquire);
+    BLI_assert(array->next.load(std::memory_order_relaxed) == nullptr);
+    for (int64_t i = 0; i < array->total_slots; i++) {
+      const Slot &slot = array->slots[i];
+      if (slot.state.load(std::memory_order_relaxed) == SlotState::Occupied) {
+        func(*slot.key, *slot.value);
+      }
+    }
+  }
+
+  /**
+   * Potentially resize the map such that the specified number of elements can be added without
+   * another grow operation. This must not be called while other threads use the map.
+   */
+  void reserve(const int64_t n)
+  {
+    SlotArray *array = array_.load(std::memory_order_relaxed);
+    if (n > array->usable_slots) {
+      this->grow_start(array,
+                       total_slot_amount_for_usable_slots(
+                           n, max_load_factor_numerator, max_load_factor_denominator));
+      this->grow_help(array);
+    }
+  }
+
+  /**
+   * Removes all key-value-pairs from the map and frees all slot arrays. This must not be called
+   * while other threads use the map.
+   */
+  void clear()
+  {
+    this->slot_arrays_free(array_.load(std::memory_order_relaxed));
+    array_.store(this->slot_array_new(min_total_slots, nullptr), std::memory_order_relaxed);
+  }
+
+  /** Get the number of slots of the slot array new keys are added to. */
+  int64_t capacity() const
+  {
+    return array_.load(std::memory_order_acquire)->total_slots;
+  }
+
+ private:
+  SlotArray *slot_array_new(const int64_t total_slots, SlotArray *prev) const
+  {
+    BLI_assert((total_slots & (total_slots - 1)) == 0);
+    SlotArray *array = new (allocator_.allocate(sizeof(SlotArray), alignof(SlotArray), AT))
+        SlotArray();
+    array->slots = static_cast<Slot *>(
+        allocator_.allocate(sizeof(Slot) * static_cast<size_t>(total_slots), alignof(Slot), AT));
+    for (int64_t i = 0; i < total_slots; i++) {
+      new (&array->slots[i].state) std::atomic<uint8_t>(SlotState::Empty);
+    }
+    array->total_slots = total_slots;
+    array->slot_mask = static_cast<uint64_t>(total_slots) - 1;
+    array->usable_slots = floor_multiplication_with_fraction(
+        total_slots, max_load_factor_numerator, max_load_factor_denominator);
+    array->reserved_slots.store(0, std::memory_order_relaxed);
+    array->next.store(nullptr, std::memory_order_relaxed);
+    array->migrate_chunks_started.store(0, std::memory_order_relaxed);
+    array->migrate_chunks_finished.store(0, std::memory_order_relaxed);
+    array->prev = prev;
+    return array;
+  }
+
+  /** Frees the slot array and all slot arrays it has grown out of. */
+  void slot_arrays_free(SlotArray *array) const
+  {
+    while (array != nullptr) {
+      SlotArray *prev = array->prev;
+      for (int64_t i = 0; i < array->total_slots; i++) {
+        Slot &slot = array->slots[i];
+        const uint8_t state = slot.state.load(std::memory_order_relaxed);
+        if (ELEM(state, SlotState::Occupied, SlotState::MigratedOccupied)) {
+          slot.key.ptr()->~Key();
+          slot.value.ptr()->~Value();
+        }
+      }
+      allocator_.deallocate(array->slots);
+      array->~SlotArray();
+      allocator_.deallocate(array);
+      array = prev;
+    }
+  }
+
+  /** Returns the new state of a slot once it is not being constructed anymore. */
+  static uint8_t slot_state_wait(const Slot &slot, uint8_t state)
+  {
+    while (state == SlotState::Constructing) {
+      std::this_thread::yield();
+      state = slot.state.load(std::memory_order_acquire);
+    }
+    return state;
+  }
+
+  template<typename ForwardKey, typename ForwardValue>
+  ProbeResult add__impl(ForwardKey &&key,
+                        ForwardValue &&value,
+                        const uint64_t hash,
+                        const Value **r_value)
+  {
+    while (true) {
+      SlotArray *array = array_.load(std::memory_order_acquire);
+      if (array->next.load(std::memory_order_acquire) != nullptr) {
+        this->grow_help(array);
+        continue;
+      }
+      /* Reserve a slot first, so that there is always an empty slot to find while probing,
+       * even when many threads add keys at the same time. */
+      if (array->reserved_slots.fetch_add(1, std::memory_order_relaxed) >= array->usable_slots) {
+        array->reserved_slots.fetch_sub(1, std::memory_order_relaxed);
+        this->grow_start(array, array->total_slots * 2);
+        this->grow_help(array);
+        continue;
+      }
+
+      const ProbeResult result = this->add_in_array(*array,
+                                                    std::forward<ForwardKey>(key),
+                                                    std::forward<ForwardValue>(value),
+                                                    hash,
+                                                    r_value);
+      if (result == ProbeResult::Added) {
+        return result;
+      }
+      array->reserved_slots.fetch_sub(1, std::memory_order_relaxed);
+      if (result == ProbeResult::Found) {
+        return result;
+      }
+      this->grow_help(array);
+    }
+  }
+
+  template<typename ForwardKey, typename ForwardValue>
+  ProbeResult add_in_array(SlotArray &array,
+                           ForwardKey &&key,
+                           ForwardValue &&value,
+                           const uint64_t hash,
+                           const Value **r_value)
+  {
+    SLOT_PROBING_BEGIN (ProbingStrategy, hash, array.slot_mask, slot_index) {
+      Slot &slot = array.slots[slot_index];
+      uint8_t state = slot.state.load(std::memory_order_acquire);
+      if (state == SlotState::Empty) {
+        if (slot.state.compare_exchange_strong(state, SlotState::Constructing)) {
+          /* Key and value are only moved when the pair is actually added. */
+          new (slot.key) Key(std::forward<ForwardKey>(key));
+          new (slot.value) Value(std::forward<ForwardValue>(value));
+          slot.state.store(SlotState::Occupied, std::memory_order_release);
+          if (r_value != nullptr) {
+            *r_value = slot.value;
+          }
+          return ProbeResult::Added;
+        }
+        /* Another thread claimed the slot first, `state` has been updated. */
+      }
+      state = slot_state_wait(slot, state);
+      if (state == SlotState::Occupied) {
+        if (is_equal_(key, *slot.key)) {
+          if (r_value != nullptr) {
+            *r_value = slot.value;
+          }
+          return ProbeResult::Found;
+        }
+      }
+      else if (state != SlotState::Empty) {
+        return ProbeResult::Migrating;
+      }
+    }
+    SLOT_PROBING_END();
+  }
+
+  template<typename ForwardKey>
+  const Value *lookup__impl(const ForwardKey &key, const uint64_t hash) const
+  {
+    while (true) {
+      SlotArray *array = array_.load(std::memory_order_acquire);
+      const Value *value;
+      const ProbeResult result = this->lookup_in_array(*array, key, hash, &value);
+      if (result == ProbeResult::Found) {
+        return value;
+      }
+      if (result == ProbeResult::NotFound) {
+        return nullptr;
+      }
+      this->grow_help(array);
+    }
+  }
+
+  template<typename ForwardKey>
+  ProbeResult lookup_in_array(const SlotArray &array,
+                              const ForwardKey &key,
+                              const uint64_t hash,
+                              const Value **r_value) const
+  {
+    SLOT_PROBING_BEGIN (ProbingStrategy, hash, array.slot_mask, slot_index) {
+      const Slot &slot = array.slots[slot_index];
+      const uint8_t state = slot_state_wait(slot, slot.state.load(std::memory_order_acquire));
+      if (state == SlotState::Empty) {
+        return ProbeResult::NotFound;
+      }
+      if (state == SlotState::Occupied) {
+        if (is_equal_(key, *slot.key)) {
+          *r_value = slot.value;
+          return ProbeResult::Found;
+        }
+      }
+      else {
+        return ProbeResult::Migrating;
+      }
+    }
+    SLOT_PROBING_END();
+  }
+
+  /** Allocate the slot array to grow into, unless another thread did that already. */
+  void grow_start(SlotArray *array, const int64_t total_slots) const
+  {
+    if (array->next.load(std::memory_order_acquire) != nullptr) {
+      return;
+    }
+    SlotArray *new_array = this->slot_array_new(total_slots, array);
+    SlotArray *expected = nullptr;
+    if (!array->next.compare_exchange_strong(expected, new_array)) {
+      new_array->prev = nullptr;
+      this->slot_arrays_free(new_array);
+    }
+  }
+
+  /**
+   * Move slots to the grown slot array, until all slots have been moved. This is done by all
+   * threads which access the map while it is growing.
+   */
+  void grow_help(SlotArray *array) const
+  {
+    SlotArray *new_array = array->next.load(std::memory_order_acquire);
+    BLI_assert(new_array != nullptr);
+    const int64_t chunks_len = ceil_division(array->total_slots, migrate_chunk_size);
+
+    while (true) {
+      const int64_t chunk = array->migrate_chunks_started.fetch_add(1);
+      if (chunk >= chunks_len) {
+        break;
+      }
+      const int64_t slot_end = std::min((chunk + 1) * migrate_chunk_size, array->total_slots);
+      int64_t migrated_len = 0;
+      for (int64_t i = chunk * migrate_chunk_size; i < slot_end; i++) {
+        migrated_len += this->slot_migrate(array->slots[i], *new_array);
+      }
+      new_array->reserved_slots.fetch_add(migrated_len);
+      array->migrate_chunks_finished.fetch_add(1, std::memory_order_release);
+    }
+
+    /* Wait for the chunks other threads are still moving. */
+    while (array->migrate_chunks_finished.load(std::memory_order_acquire) < chunks_len) {
+      std::this_thread::yield();
+    }
+
+    /* Only the first thread actually changes it. */
+    SlotArray *expected = array;
+    array_.compare_exchange_strong(expected, new_array);
+  }
+
+  /** Returns the number of key-value-pairs copied to the new slot array. */
+  int64_t slot_migrate(Slot &slot, SlotArray &new_array) const
+  {
+    uint8_t state = slot.state.load(std::memory_order_acquire);
+    while (true) {
+      if (state == SlotState::Empty) {
+        if (slot.state.compare_exchange_strong(state, SlotState::MigratedEmpty)) {
+          return 0;
+        }
+        /* Another thread is adding a key to the slot. */
+      }
+      state = slot_state_wait(slot, state);
+      if (state == SlotState::Occupied) {
+        /* Copy instead of move, other threads might still be reading the old slot. */
+        this->add_new_in_array(new_array, *slot.key, *slot.value, hash_(*slot.key));
+        slot.state.store(SlotState::MigratedOccupied, std::memory_order_release);
+        return 1;
+      }
+      if (state != SlotState::Empty) {
+        BLI_assert(false);
+        return 0;
+      }
+    }
+  }
+
+  /** Add a key that is known not to be in the slot array, used when growing. */
+  void add_new_in_array(SlotArray &array,
+                        const Key &key,
+                        const Value &value,
+                        const uint64_t hash) const
+  {
+    SLOT_PROBING_BEGIN (ProbingStrategy, hash, array.slot_mask, slot_index) {
+      Slot &slot = array.slots[slot_index];
+      uint8_t state = SlotState::Empty;
+      if (slot.state.compare_exchange_strong(state, SlotState::Constructing)) {
+        new (slot.key) Key(key);
+        new (slot.value) Value(value);
+        slot.state.store(SlotState::Occupied, std::memory_order_release);
+        return;
+      }
+    }
+    SLOT_PROBING_END();
+  }
+};
+
+}  // namespace blender
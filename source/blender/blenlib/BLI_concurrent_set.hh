@@ -0,0 +1,121 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * A `blender::ConcurrentSet<Key>` is an unordered container for unique keys that can be filled
+ * from many threads at the same time. It is a thin wrapper around blender::ConcurrentMap, see
+ * BLI_concurrent_map.hh for details about the implementation and the thread-safety guarantees.
+ */
+
+#include "BLI_concurrent_map.hh"
+
+namespace blender {
+
+template<typename Key,
+         typename ProbingStrategy = DefaultProbingStrategy,
+         typename Hash = DefaultHash<Key>,
+         typename IsEqual = DefaultEquality,
+         typename Allocator = GuardedAllocator>
+class ConcurrentSet {
+ private:
+  struct Dummy {
+  };
+
+  ConcurrentMap<Key, Dummy, ProbingStrategy, Hash, IsEqual, Allocator> map_;
+
+ public:
+  ConcurrentSet(Allocator allocator = {}) : map_(allocator)
+  {
+  }
+
+  /**
+   * Add a key to the set. Returns true when the key has been newly added, false when it was in
+   * the set already.
+   *
+   * This is thread-safe.
+   */
+  bool add(const Key &key)
+  {
+    return map_.add(key, Dummy());
+  }
+  bool add(Key &&key)
+  {
+    return map_.add(std::move(key), Dummy());
+  }
+  template<typename ForwardKey> bool add_as(ForwardKey &&key)
+  {
+    return map_.add_as(std::forward<ForwardKey>(key), Dummy());
+  }
+
+  /**
+   * Returns true if the key is in the set.
+   *
+   * This is thread-safe.
+   */
+  bool contains(const Key &key) const
+  {
+    return map_.contains(key);
+  }
+  template<typename ForwardKey> bool contains_as(const ForwardKey &key) const
+  {
+    return map_.contains_as(key);
+  }
+
+  /**
+   * Returns the number of keys in the set. Only exact when no other threads are adding keys.
+   */
+  int64_t size() const
+  {
+    return map_.size();
+  }
+
+  bool is_empty() const
+  {
+    return map_.is_empty();
+  }
+
+  /**
+   * Call the given function for every key, in no particular order. This must not be called while
+   * other threads are adding keys.
+   */
+  template<typename FuncT> void foreach_key(const FuncT &func) const
+  {
+    map_.foreach_item([&](const Key &key, const Dummy &UNUSED(dummy)) { func(key); });
+  }
+
+  /**
+   * Potentially resize the set such that the specified number of keys can be added without
+   * another grow operation. This must not be called while other threads use the set.
+   */
+  void reserve(const int64_t n)
+  {
+    map_.reserve(n);
+  }
+
+  /**
+   * Removes all keys from the set. This must not be called while other threads use the set.
+   */
+  void clear()
+  {
+    map_.clear();
+  }
+};
+
+}  // namespace blender
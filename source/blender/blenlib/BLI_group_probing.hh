@@ -0,0 +1,133 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * Control bytes and group probing, shared by `blender::GroupProbingMap` and
+ * `blender::GroupProbingSet`.
+ *
+ * Next to the slots, these hash tables store one control byte per slot in a separate array. The
+ * byte tells whether the slot is empty, removed, or occupied, and for occupied slots it contains
+ * 7 bits of the hash. Lookups compare the control bytes of a group of 16 slots at once (with SSE2
+ * when available), and only compare keys of slots whose hash bits match. Since the control bytes
+ * of a group fill a quarter of a cache line, a lookup usually touches one cache line of control
+ * bytes and one of slots, even in tables with millions of keys.
+ */
+
+#include "BLI_math_bits.h"
+#include "BLI_sys_types.h"
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+namespace blender::group_probing {
+
+/** Number of slots whose control bytes are compared at once. */
+constexpr int64_t GroupSize = 16;
+
+/**
+ * Control bytes of slots that are not occupied have the sign bit set. Occupied slots store the
+ * lower 7 bits of the mixed hash.
+ */
+constexpr int8_t ControlEmpty = -128;
+constexpr int8_t ControlRemoved = -2;
+
+/**
+ * Keys with sequential hashes (like indices with the default hash) would otherwise fill
+ * consecutive slots of the same group and share the hash bits of the control byte.
+ */
+inline uint64_t mix_hash(const uint64_t hash)
+{
+  const uint64_t mixed = hash * 0x9E3779B97F4A7C15ull;
+  return mixed ^ (mixed >> 32);
+}
+
+inline int8_t control_from_hash(const uint64_t mixed_hash)
+{
+  return (int8_t)(mixed_hash & 0x7F);
+}
+
+/** Bit i of the result is set when the control byte of slot i in the group equals the byte. */
+inline uint32_t group_match(const int8_t *group, const int8_t control)
+{
+#ifdef __SSE2__
+  const __m128i controls = _mm_loadu_si128((const __m128i *)group);
+  return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(controls, _mm_set1_epi8(control)));
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < GroupSize; i++) {
+    mask |= (uint32_t)(group[i] == control) << i;
+  }
+  return mask;
+#endif
+}
+
+/** Bit i of the result is set when slot i in the group is empty or removed. */
+inline uint32_t group_match_not_occupied(const int8_t *group)
+{
+#ifdef __SSE2__
+  return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < GroupSize; i++) {
+    mask |= (uint32_t)(group[i] < 0) << i;
+  }
+  return mask;
+#endif
+}
+
+/**
+ * The maximum number of slots that can be used (either occupied or removed) until the table has
+ * to grow. This is 7/8 of the slots, so there is always an empty slot to end the lookups.
+ */
+inline int64_t usable_slots_for(const int64_t total_slots)
+{
+  return total_slots - total_slots / 8;
+}
+
+/** The smallest power-of-two number of slots that has at least the given usable slots. */
+inline int64_t total_slots_for(const int64_t min_usable_slots)
+{
+  int64_t total_slots = GroupSize;
+  while (usable_slots_for(total_slots) < min_usable_slots) {
+    total_slots *= 2;
+  }
+  return total_slots;
+}
+
+}  // namespace blender::group_probing
+
+/**
+ * Both macros together form a loop over the groups for a mixed hash. The steps grow
+ * triangularly, which visits every group once the number of steps reaches the number of groups.
+ *
+ * Like with SLOT_PROBING_BEGIN, you must not `break` out of this loop, only `return` is
+ * permitted.
+ *
+ * MIXED_HASH: The hash after #blender::group_probing::mix_hash.
+ * GROUP_MASK: The number of groups minus one.
+ * R_GROUP_START: Name of the variable that will contain the index of the first slot in the group.
+ */
+#define GROUP_PROBING_BEGIN(MIXED_HASH, GROUP_MASK, R_GROUP_START) \
+  for (uint64_t group_index_ = ((MIXED_HASH) >> 7) & (GROUP_MASK), step_ = 1;; \
+       group_index_ = (group_index_ + step_++) & (GROUP_MASK)) { \
+    const int64_t R_GROUP_START = (int64_t)group_index_ * ::blender::group_probing::GroupSize;
+
+#define GROUP_PROBING_END() }
@@ -0,0 +1,472 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * A `blender::GroupProbingMap<Key, Value>` is a hash map with the layout of "Swiss table" hash
+ * tables: control bytes of groups of 16 slots are compared at once, see `BLI_group_probing.hh`.
+ *
+ * Use it for large maps with many lookups that are mostly cache misses, especially when many of
+ * the looked up keys are not in the map. For small maps, and for finding keys with sequential
+ * hashes in the order they were added, `blender::Map` can be faster. See
+ * `BLI_map_performance_test.cc`.
+ *
+ * The interface is a subset of the one of `blender::Map`, the methods behave the same way.
+ * - Key and Value must be movable types.
+ * - Pointers to keys and values might be invalidated when the map is changed or moved.
+ * - The default constructor does not allocate.
+ */
+
+#include "BLI_array.hh"
+#include "BLI_group_probing.hh"
+#include "BLI_hash.hh"
+#include "BLI_hash_tables.hh"
+#include "BLI_memory_utils.hh"
+
+namespace blender {
+
+template<typename Key,
+         typename Value,
+         typename Hash = DefaultHash<Key>,
+         typename IsEqual = DefaultEquality,
+         typename Allocator = GuardedAllocator>
+class GroupProbingMap {
+ private:
+  static constexpr int64_t GroupSize = group_probing::GroupSize;
+  static constexpr int8_t ControlEmpty = group_probing::ControlEmpty;
+  static constexpr int8_t ControlRemoved = group_probing::ControlRemoved;
+
+  struct Slot {
+    TypedBuffer<Key> key;
+    TypedBuffer<Value> value;
+  };
+
+  int64_t occupied_slots_;
+  int64_t removed_slots_;
+
+  /** See #group_probing::usable_slots_for. */
+  int64_t usable_slots_;
+
+  /** The number of groups minus one. The number of groups is a power of two. */
+  uint64_t group_mask_;
+
+  /**
+   * One control byte per slot. A map that was never added to has one group of empty control
+   * bytes and no slots.
+   */
+  Array<int8_t, GroupSize, Allocator> controls_;
+  Array<Slot, 0, Allocator> slots_;
+
+  Hash hash_;
+  IsEqual is_equal_;
+
+ public:
+  GroupProbingMap(Allocator allocator = {}) noexcept
+      : occupied_slots_(0),
+        removed_slots_(0),
+        usable_slots_(0),
+        group_mask_(0),
+        controls_(GroupSize, ControlEmpty, allocator),
+        slots_(allocator)
+  {
+  }
+
+  GroupProbingMap(NoExceptConstructor, Allocator allocator = {}) noexcept
+      : GroupProbingMap(allocator)
+  {
+  }
+
+  ~GroupProbingMap()
+  {
+    this->destruct_slots();
+  }
+
+  GroupProbingMap(const GroupProbingMap &other)
+      : occupied_slots_(other.occupied_slots_),
+        removed_slots_(other.removed_slots_),
+        usable_slots_(other.usable_slots_),
+        group_mask_(other.group_mask_),
+        controls_(other.controls_),
+        slots_(other.slots_.size(), other.slots_.allocator()),
+        hash_(other.hash_),
+        is_equal_(other.is_equal_)
+  {
+    for (int64_t i = 0; i < slots_.size(); i++) {
+      if (controls_[i] >= 0) {
+        new (slots_[i].key.ptr()) Key(other.slots_[i].key.ref());
+        new (slots_[i].value.ptr()) Value(other.slots_[i].value.ref());
+      }
+    }
+  }
+
+  GroupProbingMap(GroupProbingMap &&other) noexcept
+      : occupied_slots_(other.occupied_slots_),
+        removed_slots_(other.removed_slots_),
+        usable_slots_(other.usable_slots_),
+        group_mask_(other.group_mask_),
+        controls_(std::move(other.controls_)),
+        slots_(std::move(other.slots_)),
+        hash_(std::move(other.hash_)),
+        is_equal_(std::move(other.is_equal_))
+  {
+    /* The slots are owned by this map now. */
+    other.occupied_slots_ = 0;
+    other.removed_slots_ = 0;
+    other.usable_slots_ = 0;
+    other.group_mask_ = 0;
+    other.controls_ = Array<int8_t, GroupSize, Allocator>(
+        GroupSize, ControlEmpty, other.controls_.allocator());
+  }
+
+  GroupProbingMap &operator=(const GroupProbingMap &other)
+  {
+    return copy_assign_container(*this, other);
+  }
+
+  GroupProbingMap &operator=(GroupProbingMap &&other)
+  {
+    return move_assign_container(*this, std::move(other));
+  }
+
+  /**
+   * Insert a new key-value-pair into the map. This invokes undefined behavior when the key is in
+   * the map already.
+   */
+  void add_new(const Key &key, const Value &value)
+  {
+    this->add_new__impl(key, value, hash_(key));
+  }
+  void add_new(Key &&key, Value &&value)
+  {
+    this->add_new__impl(std::move(key), std::move(value), hash_(key));
+  }
+
+  /**
+   * Add a key-value-pair to the map. If the map contains the key already, nothing is changed.
+   * Returns true when the key has been newly added.
+   */
+  bool add(const Key &key, const Value &value)
+  {
+    return this->add__impl(key, value, hash_(key));
+  }
+  bool add(Key &&key, Value &&value)
+  {
+    return this->add__impl(std::move(key), std::move(value), hash_(key));
+  }
+
+  /**
+   * Adds a key-value-pair to the map. If the map contained the key already, the corresponding
+   * value will be replaced. Returns true when the key has been newly added.
+   */
+  bool add_overwrite(const Key &key, const Value &value)
+  {
+    const uint64_t hash = hash_(key);
+    Slot *slot = this->lookup_slot_ptr(key, hash);
+    if (slot != nullptr) {
+      slot->value.ref() = value;
+      return false;
+    }
+    this->add_new__impl(key, value, hash);
+    return true;
+  }
+
+  /**
+   * Returns true if there is a key in the map that compares equal to the given key.
+   */
+  bool contains(const Key &key) const
+  {
+    return this->contains_as(key);
+  }
+  template<typename ForwardKey> bool contains_as(const ForwardKey &key) const
+  {
+    return this->lookup_slot_ptr(key, hash_(key)) != nullptr;
+  }
+
+  /**
+   * Deletes the key-value-pair with the given key. Returns true when the key was contained and is
+   * now removed, otherwise false.
+   */
+  bool remove(const Key &key)
+  {
+    return this->remove_as(key);
+  }
+  template<typename ForwardKey> bool remove_as(const ForwardKey &key)
+  {
+    Slot *slot = this->lookup_slot_ptr(key, hash_(key));
+    if (slot == nullptr) {
+      return false;
+    }
+    this->remove_slot(slot - slots_.data());
+    return true;
+  }
+
+  /**
+   * Deletes the key-value-pair with the given key. This invokes undefined behavior when the key is
+   * not in the map.
+   */
+  void remove_contained(const Key &key)
+  {
+    Slot *slot = this->lookup_slot_ptr(key, hash_(key));
+    BLI_assert(slot != nullptr);
+    this->remove_slot(slot - slots_.data());
+  }
+
+  /**
+   * Returns a pointer to the value that corresponds to the given key. If the key is not in the
+   * map, nullptr is returned.
+   */
+  const Value *lookup_ptr(const Key &key) const
+  {
+    return this->lookup_ptr_as(key);
+  }
+  Value *lookup_ptr(const Key &key)
+  {
+    return this->lookup_ptr_as(key);
+  }
+  template<typename ForwardKey> const Value *lookup_ptr_as(const ForwardKey &key) const
+  {
+    const Slot *slot = this->lookup_slot_ptr(key, hash_(key));
+    return (slot != nullptr) ? slot->value.ptr() : nullptr;
+  }
+  template<typename ForwardKey> Value *lookup_ptr_as(const ForwardKey &key)
+  {
+    return const_cast<Value *>(const_cast<const GroupProbingMap *>(this)->lookup_ptr_as(key));
+  }
+
+  /**
+   * Returns a reference to the value that corresponds to the given key. This invokes undefined
+   * behavior when the key is not in the map.
+   */
+  const Value &lookup(const Key &key) const
+  {
+    const Value *ptr = this->lookup_ptr(key);
+    BLI_assert(ptr != nullptr);
+    return *ptr;
+  }
+  Value &lookup(const Key &key)
+  {
+    Value *ptr = this->lookup_ptr(key);
+    BLI_assert(ptr != nullptr);
+    return *ptr;
+  }
+
+  /**
+   * Returns a copy of the value that corresponds to the given key. If the key is not in the
+   * map, the provided default_value is returned.
+   */
+  Value lookup_default(const Key &key, const Value &default_value) const
+  {
+    const Value *ptr = this->lookup_ptr(key);
+    return (ptr != nullptr) ? *ptr : default_value;
+  }
+
+  /**
+   * Calls the provided callback for every key-value-pair in the map. The callback is expected
+   * to take a `const Key &` as first and a `const Value &` as second parameter.
+   */
+  template<typename FuncT> void foreach_item(const FuncT &func) const
+  {
+    for (int64_t i = 0; i < slots_.size(); i++) {
+      if (controls_[i] >= 0) {
+        func(slots_[i].key.ref(), slots_[i].value.ref());
+      }
+    }
+  }
+
+  /**
+   * Return the number of key-value-pairs that are stored in the map.
+   */
+  int64_t size() const
+  {
+    return occupied_slots_;
+  }
+
+  /**
+   * Returns true if there are no elements in the map.
+   */
+  bool is_empty() const
+  {
+    return occupied_slots_ == 0;
+  }
+
+  /**
+   * Returns the number of available slots. This is mostly for debugging purposes.
+   */
+  int64_t capacity() const
+  {
+    return slots_.size();
+  }
+
+  /**
+   * Potentially resize the map such that the specified number of elements can be added without
+   * another grow operation.
+   */
+  void reserve(int64_t n)
+  {
+    if (usable_slots_ < n) {
+      this->realloc_and_reinsert(n);
+    }
+  }
+
+  /**
+   * Removes all key-value-pairs from the map.
+   */
+  void clear()
+  {
+    this->~GroupProbingMap();
+    new (this) GroupProbingMap(NoExceptConstructor());
+  }
+
+ private:
+  template<typename ForwardKey>
+  const Slot *lookup_slot_ptr(const ForwardKey &key, const uint64_t hash) const
+  {
+    const uint64_t mixed_hash = group_probing::mix_hash(hash);
+    const int8_t control = group_probing::control_from_hash(mixed_hash);
+    GROUP_PROBING_BEGIN (mixed_hash, group_mask_, group_start) {
+      const int8_t *group = &controls_[group_start];
+      const uint32_t matches = group_probing::group_match(group, control);
+      for (uint32_t match = matches; match != 0; match &= match - 1) {
+        const int64_t slot_index = group_start + bitscan_forward_uint(match);
+        if (is_equal_(key, slots_[slot_index].key.ref())) {
+          return &slots_[slot_index];
+        }
+      }
+      if (group_probing::group_match(group, ControlEmpty) != 0) {
+        return nullptr;
+      }
+    }
+    GROUP_PROBING_END();
+  }
+
+  template<typename ForwardKey> Slot *lookup_slot_ptr(const ForwardKey &key, const uint64_t hash)
+  {
+    return const_cast<Slot *>(
+        const_cast<const GroupProbingMap *>(this)->lookup_slot_ptr(key, hash));
+  }
+
+  /** Find the first slot that is not occupied in the probe sequence of the hash. */
+  static int64_t find_free_slot_index(const int8_t *controls,
+                                      const uint64_t group_mask,
+                                      const uint64_t mixed_hash)
+  {
+    GROUP_PROBING_BEGIN (mixed_hash, group_mask, group_start) {
+      const uint32_t match = group_probing::group_match_not_occupied(&controls[group_start]);
+      if (match != 0) {
+        return group_start + bitscan_forward_uint(match);
+      }
+    }
+    GROUP_PROBING_END();
+  }
+
+  template<typename ForwardKey, typename ForwardValue>
+  void add_new__impl(ForwardKey &&key, ForwardValue &&value, const uint64_t hash)
+  {
+    BLI_assert(!this->contains_as(key));
+
+    if (occupied_slots_ + removed_slots_ >= usable_slots_) {
+      this->realloc_and_reinsert(occupied_slots_ + 1);
+    }
+
+    const uint64_t mixed_hash = group_probing::mix_hash(hash);
+    const int64_t slot_index = find_free_slot_index(controls_.data(), group_mask_, mixed_hash);
+    Slot &slot = slots_[slot_index];
+    new (slot.key.ptr()) Key(std::forward<ForwardKey>(key));
+    new (slot.value.ptr()) Value(std::forward<ForwardValue>(value));
+    if (controls_[slot_index] == ControlRemoved) {
+      removed_slots_--;
+    }
+    controls_[slot_index] = group_probing::control_from_hash(mixed_hash);
+    occupied_slots_++;
+  }
+
+  template<typename ForwardKey, typename ForwardValue>
+  bool add__impl(ForwardKey &&key, ForwardValue &&value, const uint64_t hash)
+  {
+    if (this->lookup_slot_ptr(key, hash) != nullptr) {
+      return false;
+    }
+    this->add_new__impl(std::forward<ForwardKey>(key), std::forward<ForwardValue>(value), hash);
+    return true;
+  }
+
+  void remove_slot(const int64_t slot_index)
+  {
+    Slot &slot = slots_[slot_index];
+    slot.key.ref().~Key();
+    slot.value.ref().~Value();
+    occupied_slots_--;
+
+    /* Lookups stop at a group with an empty slot anyway, so the slot can become empty again
+     * instead of being marked as removed. */
+    const int64_t group_start = slot_index - slot_index % GroupSize;
+    if (group_probing::group_match(&controls_[group_start], ControlEmpty) != 0) {
+      controls_[slot_index] = ControlEmpty;
+    }
+    else {
+      controls_[slot_index] = ControlRemoved;
+      removed_slots_++;
+    }
+  }
+
+  BLI_NOINLINE void realloc_and_reinsert(const int64_t min_usable_slots)
+  {
+    const int64_t total_slots = group_probing::total_slots_for(min_usable_slots);
+    const uint64_t new_group_mask = (uint64_t)(total_slots / GroupSize) - 1;
+
+    Array<int8_t, GroupSize, Allocator> new_controls(
+        total_slots, ControlEmpty, controls_.allocator());
+    Array<Slot, 0, Allocator> new_slots(total_slots, slots_.allocator());
+
+    /* Keys are unique already, so they are inserted without comparing them. */
+    for (int64_t i = 0; i < slots_.size(); i++) {
+      if (controls_[i] < 0) {
+        continue;
+      }
+      Slot &old_slot = slots_[i];
+      const uint64_t mixed_hash = group_probing::mix_hash(hash_(old_slot.key.ref()));
+      const int64_t slot_index = find_free_slot_index(
+          new_controls.data(), new_group_mask, mixed_hash);
+      new (new_slots[slot_index].key.ptr()) Key(std::move(old_slot.key.ref()));
+      new (new_slots[slot_index].value.ptr()) Value(std::move(old_slot.value.ref()));
+      new_controls[slot_index] = group_probing::control_from_hash(mixed_hash);
+      old_slot.key.ref().~Key();
+      old_slot.value.ref().~Value();
+    }
+
+    controls_ = std::move(new_controls);
+    slots_ = std::move(new_slots);
+    group_mask_ = new_group_mask;
+    usable_slots_ = group_probing::usable_slots_for(total_slots);
+    removed_slots_ = 0;
+  }
+
+  void destruct_slots()
+  {
+    for (int64_t i = 0; i < slots_.size(); i++) {
+      if (controls_[i] >= 0) {
+        slots_[i].key.ref().~Key();
+        slots_[i].value.ref().~Value();
+        controls_[i] = ControlEmpty;
+      }
+    }
+  }
+};
+
+}  // namespace blender
@@ -0,0 +1,428 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * A `blender::GroupProbingSet<Key>` is the set counterpart of `blender::GroupProbingMap`. It
+ * compares control bytes of groups of 16 slots at once, see `BLI_group_probing.hh`.
+ *
+ * Use it for large sets with many lookups that are mostly cache misses, especially when many of
+ * the looked up keys are not in the set. For small sets, `blender::Set` can be faster. See
+ * `BLI_map_performance_test.cc`.
+ *
+ * The interface is a subset of the one of `blender::Set`, the methods behave the same way.
+ * - Key must be a movable type.
+ * - Pointers to keys might be invalidated when the set is changed or moved.
+ * - The default constructor does not allocate.
+ */
+
+#include "BLI_array.hh"
+#include "BLI_group_probing.hh"
+#include "BLI_hash.hh"
+#include "BLI_hash_tables.hh"
+#include "BLI_memory_utils.hh"
+
+namespace blender {
+
+template<typename Key,
+         typename Hash = DefaultHash<Key>,
+         typename IsEqual = DefaultEquality,
+         typename Allocator = GuardedAllocator>
+class GroupProbingSet {
+ private:
+  static constexpr int64_t GroupSize = group_probing::GroupSize;
+  static constexpr int8_t ControlEmpty = group_probing::ControlEmpty;
+  static constexpr int8_t ControlRemoved = group_probing::ControlRemoved;
+
+  int64_t occupied_slots_;
+  int64_t removed_slots_;
+
+  /** See #group_probing::usable_slots_for. */
+  int64_t usable_slots_;
+
+  /** The number of groups minus one. The number of groups is a power of two. */
+  uint64_t group_mask_;
+
+  /**
+   * One control byte per slot. A set that was never added to has one group of empty control
+   * bytes and no slots.
+   */
+  Array<int8_t, GroupSize, Allocator> controls_;
+  Array<TypedBuffer<Key>, 0, Allocator> slots_;
+
+  Hash hash_;
+  IsEqual is_equal_;
+
+ public:
+  GroupProbingSet(Allocator allocator = {}) noexcept
+      : occupied_slots_(0),
+        removed_slots_(0),
+        usable_slots_(0),
+        group_mask_(0),
+        controls_(GroupSize, ControlEmpty, allocator),
+        slots_(allocator)
+  {
+  }
+
+  GroupProbingSet(NoExceptConstructor, Allocator allocator = {}) noexcept
+      : GroupProbingSet(allocator)
+  {
+  }
+
+  ~GroupProbingSet()
+  {
+    this->destruct_slots();
+  }
+
+  GroupProbingSet(const GroupProbingSet &other)
+      : occupied_slots_(other.occupied_slots_),
+        removed_slots_(other.removed_slots_),
+        usable_slots_(other.usable_slots_),
+        group_mask_(other.group_mask_),
+        controls_(other.controls_),
+        slots_(other.slots_.size(), other.slots_.allocator()),
+        hash_(other.hash_),
+        is_equal_(other.is_equal_)
+  {
+    for (int64_t i = 0; i < slots_.size(); i++) {
+      if (controls_[i] >= 0) {
+        new (slots_[i].ptr()) Key(other.slots_[i].ref());
+      }
+    }
+  }
+
+  GroupProbingSet(GroupProbingSet &&other) noexcept
+      : occupied_slots_(other.occupied_slots_),
+        removed_slots_(other.removed_slots_),
+        usable_slots_(other.usable_slots_),
+        group_mask_(other.group_mask_),
+        controls_(std::move(other.controls_)),
+        slots_(std::move(other.slots_)),
+        hash_(std::move(other.hash_)),
+        is_equal_(std::move(other.is_equal_))
+  {
+    /* The slots are owned by this set now. */
+    other.occupied_slots_ = 0;
+    other.removed_slots_ = 0;
+    other.usable_slots_ = 0;
+    other.group_mask_ = 0;
+    other.controls_ = Array<int8_t, GroupSize, Allocator>(
+        GroupSize, ControlEmpty, other.controls_.allocator());
+  }
+
+  GroupProbingSet &operator=(const GroupProbingSet &other)
+  {
+    return copy_assign_container(*this, other);
+  }
+
+  GroupProbingSet &operator=(GroupProbingSet &&other)
+  {
+    return move_assign_container(*this, std::move(other));
+  }
+
+  /**
+   * Add a new key to the set. This invokes undefined behavior when the key is in the set already.
+   */
+  void add_new(const Key &key)
+  {
+    this->add_new__impl(key, hash_(key));
+  }
+  void add_new(Key &&key)
+  {
+    this->add_new__impl(std::move(key), hash_(key));
+  }
+
+  /**
+   * Add a key to the set. If the key exists in the set already, nothing is done. Returns true
+   * when the key has been newly added.
+   */
+  bool add(const Key &key)
+  {
+    return this->add__impl(key, hash_(key));
+  }
+  bool add(Key &&key)
+  {
+    return this->add__impl(std::move(key), hash_(key));
+  }
+
+  /**
+   * Returns true if the key is in the set.
+   */
+  bool contains(const Key &key) const
+  {
+    return this->contains_as(key);
+  }
+  template<typename ForwardKey> bool contains_as(const ForwardKey &key) const
+  {
+    return this->lookup_slot_index(key, hash_(key)) != -1;
+  }
+
+  /**
+   * Deletes the key from the set. Returns true when the key was contained and is now removed,
+   * otherwise false.
+   */
+  bool remove(const Key &key)
+  {
+    return this->remove_as(key);
+  }
+  template<typename ForwardKey> bool remove_as(const ForwardKey &key)
+  {
+    const int64_t slot_index = this->lookup_slot_index(key, hash_(key));
+    if (slot_index == -1) {
+      return false;
+    }
+    this->remove_slot(slot_index);
+    return true;
+  }
+
+  /**
+   * Deletes the key from the set. This invokes undefined behavior when the key is not in the set.
+   */
+  void remove_contained(const Key &key)
+  {
+    const int64_t slot_index = this->lookup_slot_index(key, hash_(key));
+    BLI_assert(slot_index != -1);
+    this->remove_slot(slot_index);
+  }
+
+  /**
+   * Iterates over the keys in the set, in no particular order.
+   */
+  class Iterator {
+   private:
+    const int8_t *controls_;
+    const TypedBuffer<Key> *slots_;
+    int64_t total_slots_;
+    int64_t current_slot_;
+
+   public:
+    Iterator(const int8_t *controls,
+             const TypedBuffer<Key> *slots,
+             const int64_t total_slots,
+             const int64_t current_slot)
+        : controls_(controls),
+          slots_(slots),
+          total_slots_(total_slots),
+          current_slot_(current_slot)
+    {
+    }
+
+    Iterator &operator++()
+    {
+      while (++current_slot_ < total_slots_) {
+        if (controls_[current_slot_] >= 0) {
+          break;
+        }
+      }
+      return *this;
+    }
+
+    const Key &operator*() const
+    {
+      return slots_[current_slot_].ref();
+    }
+
+    friend bool operator!=(const Iterator &a, const Iterator &b)
+    {
+      BLI_assert(a.slots_ == b.slots_);
+      return a.current_slot_ != b.current_slot_;
+    }
+  };
+
+  Iterator begin() const
+  {
+    for (int64_t i = 0; i < slots_.size(); i++) {
+      if (controls_[i] >= 0) {
+        return Iterator(controls_.data(), slots_.data(), slots_.size(), i);
+      }
+    }
+    return this->end();
+  }
+
+  Iterator end() const
+  {
+    return Iterator(controls_.data(), slots_.data(), slots_.size(), slots_.size());
+  }
+
+  /**
+   * Returns the number of keys stored in the set.
+   */
+  int64_t size() const
+  {
+    return occupied_slots_;
+  }
+
+  /**
+   * Returns true if no keys are stored.
+   */
+  bool is_empty() const
+  {
+    return occupied_slots_ == 0;
+  }
+
+  /**
+   * Returns the number of available slots. This is mostly for debugging purposes.
+   */
+  int64_t capacity() const
+  {
+    return slots_.size();
+  }
+
+  /**
+   * Potentially resize the set such that the specified number of keys can be added without
+   * another grow operation.
+   */
+  void reserve(int64_t n)
+  {
+    if (usable_slots_ < n) {
+      this->realloc_and_reinsert(n);
+    }
+  }
+
+  /**
+   * Removes all keys from the set.
+   */
+  void clear()
+  {
+    this->~GroupProbingSet();
+    new (this) GroupProbingSet(NoExceptConstructor());
+  }
+
+ private:
+  template<typename ForwardKey>
+  int64_t lookup_slot_index(const ForwardKey &key, const uint64_t hash) const
+  {
+    const uint64_t mixed_hash = group_probing::mix_hash(hash);
+    const int8_t control = group_probing::control_from_hash(mixed_hash);
+    GROUP_PROBING_BEGIN (mixed_hash, group_mask_, group_start) {
+      const int8_t *group = &controls_[group_start];
+      const uint32_t matches = group_probing::group_match(group, control);
+      for (uint32_t match = matches; match != 0; match &= match - 1) {
+        const int64_t slot_index = group_start + bitscan_forward_uint(match);
+        if (is_equal_(key, slots_[slot_index].ref())) {
+          return slot_index;
+        }
+      }
+      if (group_probing::group_match(group, ControlEmpty) != 0) {
+        return -1;
+      }
+    }
+    GROUP_PROBING_END();
+  }
+
+  /** Find the first slot that is not occupied in the probe sequence of the hash. */
+  static int64_t find_free_slot_index(const int8_t *controls,
+                                      const uint64_t group_mask,
+                                      const uint64_t mixed_hash)
+  {
+    GROUP_PROBING_BEGIN (mixed_hash, group_mask, group_start) {
+      const uint32_t match = group_probing::group_match_not_occupied(&controls[group_start]);
+      if (match != 0) {
+        return group_start + bitscan_forward_uint(match);
+      }
+    }
+    GROUP_PROBING_END();
+  }
+
+  template<typename ForwardKey> void add_new__impl(ForwardKey &&key, const uint64_t hash)
+  {
+    BLI_assert(!this->contains_as(key));
+
+    if (occupied_slots_ + removed_slots_ >= usable_slots_) {
+      this->realloc_and_reinsert(occupied_slots_ + 1);
+    }
+
+    const uint64_t mixed_hash = group_probing::mix_hash(hash);
+    const int64_t slot_index = find_free_slot_index(controls_.data(), group_mask_, mixed_hash);
+    new (slots_[slot_index].ptr()) Key(std::forward<ForwardKey>(key));
+    if (controls_[slot_index] == ControlRemoved) {
+      removed_slots_--;
+    }
+    controls_[slot_index] = group_probing::control_from_hash(mixed_hash);
+    occupied_slots_++;
+  }
+
+  template<typename ForwardKey> bool add__impl(ForwardKey &&key, const uint64_t hash)
+  {
+    if (this->lookup_slot_index(key, hash) != -1) {
+      return false;
+    }
+    this->add_new__impl(std::forward<ForwardKey>(key), hash);
+    return true;
+  }
+
+  void remove_slot(const int64_t slot_index)
+  {
+    slots_[slot_index].ref().~Key();
+    occupied_slots_--;
+
+    /* Lookups stop at a group with an empty slot anyway, so the slot can become empty again
+     * instead of being marked as removed. */
+    const int64_t group_start = slot_index - slot_index % GroupSize;
+    if (group_probing::group_match(&controls_[group_start], ControlEmpty) != 0) {
+      controls_[slot_index] = ControlEmpty;
+    }
+    else {
+      controls_[slot_index] = ControlRemoved;
+      removed_slots_++;
+    }
+  }
+
+  BLI_NOINLINE void realloc_and_reinsert(const int64_t min_usable_slots)
+  {
+    const int64_t total_slots = group_probing::total_slots_for(min_usable_slots);
+    const uint64_t new_group_mask = (uint64_t)(total_slots / GroupSize) - 1;
+
+    Array<int8_t, GroupSize, Allocator> new_controls(
+        total_slots, ControlEmpty, controls_.allocator());
+    Array<TypedBuffer<Key>, 0, Allocator> new_slots(total_slots, slots_.allocator());
+
+    /* Keys are unique already, so they are inserted without comparing them. */
+    for (int64_t i = 0; i < slots_.size(); i++) {
+      if (controls_[i] < 0) {
+        continue;
+      }
+      Key &old_key = slots_[i].ref();
+      const uint64_t mixed_hash = group_probing::mix_hash(hash_(old_key));
+      const int64_t slot_index = find_free_slot_index(
+          new_controls.data(), new_group_mask, mixed_hash);
+      new (new_slots[slot_index].ptr()) Key(std::move(old_key));
+      new_controls[slot_index] = group_probing::control_from_hash(mixed_hash);
+      old_key.~Key();
+    }
+
+    controls_ = std::move(new_controls);
+    slots_ = std::move(new_slots);
+    group_mask_ = new_group_mask;
+    usable_slots_ = group_probing::usable_slots_for(total_slots);
+    removed_slots_ = 0;
+  }
+
+  void destruct_slots()
+  {
+    for (int64_t i = 0; i < slots_.size(); i++) {
+      if (controls_[i] >= 0) {
+        slots_[i].ref().~Key();
+        controls_[i] = ControlEmpty;
+      }
+    }
+  }
+};
+
+}  // namespace blender
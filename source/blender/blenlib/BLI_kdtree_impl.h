@@ -67,6 +67,26 @@ void BLI_kdtree_nd_(range_search_cb)(
     bool (*search_cb)(void *user_data, int index, const float co[KD_DIMS], float dist_sq),
     void *user_data);
 
+/* Batched queries writing into flat buffers, see the implementation for details. */
+uint BLI_kdtree_nd_(range_search_batch_count)(const KDTree *tree,
+                                              const float (*co)[KD_DIMS],
+                                              const uint co_len,
+                                              const float range,
+                                              uint *r_offsets) ATTR_NONNULL(1, 5);
+void BLI_kdtree_nd_(range_search_batch)(const KDTree *tree,
+                                        const float (*co)[KD_DIMS],
+                                        const uint co_len,
+                                        const float range,
+                                        const uint *offsets,
+                                        int *r_neighbors,
+                                        float *r_dist_sq) ATTR_NONNULL(1, 5, 6);
+void BLI_kdtree_nd_(find_nearest_n_batch)(const KDTree *tree,
+                                          const float (*co)[KD_DIMS],
+                                          const uint co_len,
+                                          KDTreeNearest *r_nearest,
+                                          const uint nearest_len_capacity,
+                                          int *r_nearest_len) ATTR_NONNULL(1);
+
 int BLI_kdtree_nd_(calc_duplicates_fast)(const KDTree *tree,
                                          const float range,
                                          bool use_index_order,
@@ -0,0 +1,64 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * Math operations on arrays of vectors. Use these instead of calling e.g. `mul_m4_v3` in a loop
+ * when many vectors are processed at once, like in deform modifiers.
+ *
+ * The functions have scalar, SSE2 and AVX2 implementations. The best one supported by the CPU
+ * is chosen at runtime. Results can differ in the last bits from the corresponding single
+ * vector functions, because the AVX2 implementation uses fused multiply-add.
+ *
+ * Input and output spans have to be the same size. They can be the same span, but must not
+ * overlap otherwise.
+ */
+
+#include "BLI_float3.hh"
+#include "BLI_float4x4.hh"
+#include "BLI_span.hh"
+
+namespace blender::math {
+
+/**
+ * `dst[i] = matrix * src[i]`, including the translation, like #mul_v3_m4v3.
+ */
+void transform_points(const float4x4 &matrix, Span<float3> src, MutableSpan<float3> dst);
+void transform_points(const float4x4 &matrix, MutableSpan<float3> points);
+
+/**
+ * `dst[i] = matrices[i] * src[i]`, including the translation.
+ */
+void transform_points(Span<float4x4> matrices, Span<float3> src, MutableSpan<float3> dst);
+void transform_points(Span<float4x4> matrices, MutableSpan<float3> points);
+
+/**
+ * `dst[i] = matrix.ref_3x3() * src[i]`, ignoring the translation, like #mul_v3_mat3_m4v3.
+ */
+void transform_directions(const float4x4 &matrix, Span<float3> src, MutableSpan<float3> dst);
+void transform_directions(const float4x4 &matrix, MutableSpan<float3> directions);
+
+/**
+ * `dst[i] = src[i].normalized()`. Vectors that are too short become zero, like with
+ * #normalize_v3.
+ */
+void normalize(Span<float3> src, MutableSpan<float3> dst);
+void normalize(MutableSpan<float3> vectors);
+
+}  // namespace blender::math
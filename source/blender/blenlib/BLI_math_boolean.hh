@@ -54,6 +54,15 @@ int insphere(
 int insphere_fast(
     const double3 &a, const double3 &b, const double3 &c, const double3 &d, const double3 &e);
 
+/* #filter_orient2d, #filter_incircle and #filter_orient3d return the sign the exact predicates
+ * would give for the exact points the arguments approximate, when the inputs are within one
+ * rounding of the exact coordinates. They only use double arithmetic and a bound on its error,
+ * and return 0 when the sign can't be known that way, in which case the exact test must be used.
+ */
+int filter_orient2d(const double2 &a, const double2 &b, const double2 &c);
+int filter_incircle(const double2 &a, const double2 &b, const double2 &c, const double2 &d);
+int filter_orient3d(const double3 &a, const double3 &b, const double3 &c, const double3 &d);
+
 #ifdef WITH_GMP
 int orient2d(const mpq2 &a, const mpq2 &b, const mpq2 &c);
 int incircle(const mpq2 &a, const mpq2 &b, const mpq2 &c, const mpq2 &d);
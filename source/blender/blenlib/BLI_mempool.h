@@ -83,6 +83,15 @@ enum {
    * order of allocation when no chunks have been freed.
    */
   BLI_MEMPOOL_ALLOW_ITER = (1 << 0),
+  /** Allow allocating and freeing from multiple threads at once.
+   *
+   * Each thread allocates from its own cache of free elements, which is refilled (and flushed
+   * back) in batches under a lock, so threads rarely contend.
+   * \note clearing, destroying, iterating and converting the pool to a table or array
+   * still must not run concurrently with other operations on the pool.
+   * \note freeing the last used element doesn't free the chunks, use #BLI_mempool_clear.
+   */
+  BLI_MEMPOOL_THREADSAFE = (1 << 1),
 };
 
 void BLI_mempool_iternew(BLI_mempool *pool, BLI_mempool_iter *iter) ATTR_NONNULL();
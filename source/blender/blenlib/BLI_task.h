@@ -98,6 +98,12 @@ void BLI_task_pool_push(TaskPool *pool,
                         void *taskdata,
                         bool free_taskdata,
                         TaskFreeFunction freedata);
+void BLI_task_pool_push_affinity(TaskPool *pool,
+                                 TaskRunFunction run,
+                                 void *taskdata,
+                                 bool free_taskdata,
+                                 TaskFreeFunction freedata,
+                                 const void *affinity);
 
 /* work and wait until all tasks are done */
 void BLI_task_pool_work_and_wait(TaskPool *pool);
@@ -113,6 +119,21 @@ void *BLI_task_pool_user_data(TaskPool *pool);
 /* optional mutex to use from run function */
 ThreadMutex *BLI_task_pool_user_mutex(TaskPool *pool);
 
+/* Statistics for debugging and tuning the granularity of tasks. */
+typedef struct TaskPoolStats {
+  /* Number of tasks pushed to the pool. */
+  int num_tasks;
+  /* Number of tasks pushed with an affinity hint. */
+  int num_affinity_tasks;
+  /* Number of affinity tasks started by the scheduler, the other affinity tasks ran right
+   * after the related task which pushed them, on the same thread. */
+  int num_affinity_runs;
+  /* Largest number of related tasks one thread ran in a row. */
+  int max_affinity_run_len;
+} TaskPoolStats;
+
+void BLI_task_pool_stats_get(TaskPool *pool, TaskPoolStats *r_stats);
+
 /* Parallel for routines */
 
 /* Per-thread specific data passed to the callback. */
@@ -52,6 +52,9 @@ void BLI_threadpool_remove_index(struct ListBase *threadbase, int index);
 void BLI_threadpool_clear(struct ListBase *threadbase);
 void BLI_threadpool_end(struct ListBase *threadbase);
 int BLI_thread_is_main(void);
+/* Small number unique to the calling thread, assigned on first use. Unlike the task scheduler
+ * thread id this works from any thread, to index per-thread caches (modulo their size). */
+int BLI_thread_index_get(void);
 
 /* System Information */
 
@@ -0,0 +1,112 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * Tracing of named zones (scopes of code), for profiling where time goes in production scenes.
+ *
+ * Zones are recorded in per-thread ring buffers while a trace session is active (see the
+ * `--debug-trace` command line argument), so only the most recent zones of every thread are
+ * kept. When the session ends they are written in the Chrome trace event format, which can be
+ * opened in `chrome://tracing` or https://ui.perfetto.dev.
+ *
+ * Use the `TRACE_` macros rather than the functions: they are removed when building without
+ * `WITH_TRACE`, and cost a single check when no session is active.
+ */
+
+#include "BLI_sys_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Start recording zones, they are written to \a filepath when the session ends. */
+void BLI_trace_session_begin(const char *filepath);
+/* Write the recorded zones and stop recording. Must not be called while other threads are
+ * recording zones. Returns false when the file could not be written. */
+bool BLI_trace_session_end(void);
+bool BLI_trace_is_active(void);
+
+/* \a category must be a static string, \a name is copied (and truncated if too long).
+ * Zones must be ended on the thread that began them, in reverse order. */
+void BLI_trace_zone_begin(const char *category, const char *name);
+void BLI_trace_zone_end(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef WITH_TRACE
+#  define TRACE_ZONE_BEGIN(category, name) \
+    { \
+      if (BLI_trace_is_active()) { \
+        BLI_trace_zone_begin(category, name); \
+      } \
+    } \
+    ((void)0)
+#  define TRACE_ZONE_END() \
+    { \
+      if (BLI_trace_is_active()) { \
+        BLI_trace_zone_end(); \
+      } \
+    } \
+    ((void)0)
+#else
+#  define TRACE_ZONE_BEGIN(category, name) ((void)0)
+#  define TRACE_ZONE_END() ((void)0)
+#endif
+
+#ifdef __cplusplus
+
+namespace blender::trace {
+
+/* Zone lasting until the end of the scope. */
+class ScopedZone {
+ private:
+  bool active_;
+
+ public:
+  ScopedZone(const char *category, const char *name) : active_(BLI_trace_is_active())
+  {
+    if (active_) {
+      BLI_trace_zone_begin(category, name);
+    }
+  }
+
+  ~ScopedZone()
+  {
+    if (active_) {
+      BLI_trace_zone_end();
+    }
+  }
+
+  ScopedZone(const ScopedZone &other) = delete;
+  ScopedZone &operator=(const ScopedZone &other) = delete;
+};
+
+}  // namespace blender::trace
+
+#  ifdef WITH_TRACE
+#    define TRACE_SCOPE(category, name) \
+      blender::trace::ScopedZone trace_scoped_zone(category, name)
+#  else
+#    define TRACE_SCOPE(category, name) ((void)0)
+#  endif
+
+#endif /* __cplusplus */
@@ -42,6 +42,8 @@
 
 #include "MEM_guardedalloc.h"
 
+#include "atomic_ops.h"
+
 #include "BLI_alloca.h"
 #include "BLI_heap_simple.h"
 #include "BLI_kdopbvh.h"
@@ -865,6 +867,478 @@ static void non_recursive_bvh_div_nodes(const BVHTree *tree,
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Binned SAH Tree Build
+ *
+ * Alternative to the implicit tree build above, used with #BVH_BALANCE_USE_SAH.
+ * Leafs are split where the surface area heuristic predicts the lowest query cost,
+ * using a fixed number of bins per axis instead of sorting. Branches get `tree_type` children
+ * by splitting the child with the most leafs until all slots are used.
+ *
+ * Sub-trees are built in parallel, and the bins of large ranges are filled in parallel as well.
+ * Branches are allocated from a counter as they are created, so children are still stored after
+ * their parent as #BLI_bvhtree_update_tree expects. Since branches aren't necessarily full,
+ * there can be up to `totleaf - 1` of them, more than the implicit tree needs.
+ * \{ */
+
+#define BVH_SAH_BINS 16
+
+/* Sub-trees with more leafs are built in their own task. */
+#define BVH_SAH_TASK_LEAF_THRESHOLD 4096
+
+/* Ranges with more leafs fill their bins in parallel. */
+#define BVH_SAH_PARALLEL_LEAF_THRESHOLD 65536
+
+typedef struct BVHSAHBin {
+  /** Bounds of the leafs in this bin, along the first three k-DOP axes (like #get_largest_axis).
+   */
+  float min[3], max[3];
+  int count;
+} BVHSAHBin;
+
+typedef struct BVHSAHBins {
+  BVHSAHBin bins[3][BVH_SAH_BINS];
+} BVHSAHBins;
+
+typedef struct BVHSAHBounds {
+  float min[3], max[3];
+} BVHSAHBounds;
+
+typedef struct BVHSAHBuildData {
+  BVHTree *tree;
+  /** Number of branches used so far, incremented atomically. */
+  int branches_num;
+} BVHSAHBuildData;
+
+typedef struct BVHSAHBuildTask {
+  BVHNode *node;
+  int begin, end;
+} BVHSAHBuildTask;
+
+typedef struct BVHSAHRangeData {
+  BVHNode **leafs;
+  /** Centroid bounds of the range, only used when binning. */
+  const BVHSAHBounds *centroid_bounds;
+  float bin_scale[3];
+} BVHSAHRangeData;
+
+BLI_INLINE float bvh_sah_centroid(const BVHNode *node, const int axis)
+{
+  return (node->bv[2 * axis] + node->bv[2 * axis + 1]) * 0.5f;
+}
+
+BLI_INLINE float bvh_sah_half_area(const float min[3], const float max[3])
+{
+  const float x = max[0] - min[0], y = max[1] - min[1], z = max[2] - min[2];
+  return x * y + y * z + z * x;
+}
+
+static void bvh_sah_bounds_init(BVHSAHBounds *bounds)
+{
+  copy_v3_fl(bounds->min, FLT_MAX);
+  copy_v3_fl(bounds->max, -FLT_MAX);
+}
+
+static void bvh_sah_bins_init(BVHSAHBins *bins)
+{
+  for (int axis = 0; axis < 3; axis++) {
+    for (int i = 0; i < BVH_SAH_BINS; i++) {
+      BVHSAHBin *bin = &bins->bins[axis][i];
+      copy_v3_fl(bin->min, FLT_MAX);
+      copy_v3_fl(bin->max, -FLT_MAX);
+      bin->count = 0;
+    }
+  }
+}
+
+BLI_INLINE int bvh_sah_bin_index(const BVHSAHRangeData *data, const BVHNode *node, const int axis)
+{
+  const int i = (int)((bvh_sah_centroid(node, axis) - data->centroid_bounds->min[axis]) *
+                      data->bin_scale[axis]);
+  return CLAMPIS(i, 0, BVH_SAH_BINS - 1);
+}
+
+static void bvh_sah_centroid_bounds_cb(void *__restrict userdata,
+                                       const int i,
+                                       const TaskParallelTLS *__restrict tls)
+{
+  const BVHSAHRangeData *data = userdata;
+  BVHSAHBounds *bounds = tls->userdata_chunk;
+  for (int axis = 0; axis < 3; axis++) {
+    const float c = bvh_sah_centroid(data->leafs[i], axis);
+    bounds->min[axis] = min_ff(bounds->min[axis], c);
+    bounds->max[axis] = max_ff(bounds->max[axis], c);
+  }
+}
+
+static void bvh_sah_centroid_bounds_reduce(const void *__restrict UNUSED(userdata),
+                                           void *__restrict chunk_join,
+                                           void *__restrict chunk)
+{
+  BVHSAHBounds *join = chunk_join;
+  const BVHSAHBounds *bounds = chunk;
+  minmax_v3v3_v3(join->min, join->max, bounds->min);
+  minmax_v3v3_v3(join->min, join->max, bounds->max);
+}
+
+static void bvh_sah_bins_fill_cb(void *__restrict userdata,
+                                 const int i,
+                                 const TaskParallelTLS *__restrict tls)
+{
+  const BVHSAHRangeData *data = userdata;
+  BVHSAHBins *bins = tls->userdata_chunk;
+  const BVHNode *node = data->leafs[i];
+  for (int axis = 0; axis < 3; axis++) {
+    if (data->bin_scale[axis] == 0.0f) {
+      continue;
+    }
+    BVHSAHBin *bin = &bins->bins[axis][bvh_sah_bin_index(data, node, axis)];
+    for (int k = 0; k < 3; k++) {
+      bin->min[k] = min_ff(bin->min[k], node->bv[2 * k]);
+      bin->max[k] = max_ff(bin->max[k], node->bv[2 * k + 1]);
+    }
+    bin->count++;
+  }
+}
+
+static void bvh_sah_bins_reduce(const void *__restrict UNUSED(userdata),
+                                void *__restrict chunk_join,
+                                void *__restrict chunk)
+{
+  BVHSAHBins *join = chunk_join;
+  const BVHSAHBins *bins = chunk;
+  for (int axis = 0; axis < 3; axis++) {
+    for (int i = 0; i < BVH_SAH_BINS; i++) {
+      BVHSAHBin *bin_join = &join->bins[axis][i];
+      const BVHSAHBin *bin = &bins->bins[axis][i];
+      minmax_v3v3_v3(bin_join->min, bin_join->max, bin->min);
+      minmax_v3v3_v3(bin_join->min, bin_join->max, bin->max);
+      bin_join->count += bin->count;
+    }
+  }
+}
+
+/**
+ * Run `func` for the leafs in the range, in parallel when the range is large.
+ * The result is reduced into `chunk`.
+ */
+static void bvh_sah_range_reduce(BVHSAHRangeData *data,
+                                 const int begin,
+                                 const int end,
+                                 TaskParallelRangeFunc func,
+                                 TaskParallelReduceFunc func_reduce,
+                                 void *chunk,
+                                 const size_t chunk_size)
+{
+  if (end - begin > BVH_SAH_PARALLEL_LEAF_THRESHOLD) {
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.userdata_chunk = chunk;
+    settings.userdata_chunk_size = chunk_size;
+    settings.func_reduce = func_reduce;
+    settings.min_iter_per_thread = 4096;
+    BLI_task_parallel_range(begin, end, data, func, &settings);
+  }
+  else {
+    TaskParallelTLS tls = {.userdata_chunk = chunk};
+    for (int i = begin; i < end; i++) {
+      func(data, i, &tls);
+    }
+  }
+}
+
+/**
+ * Split the leafs in the range in two, ordered along the returned axis.
+ * \return The first leaf of the second part, always in `(begin, end)`.
+ */
+static int bvh_sah_split(BVHNode **leafs, const int begin, const int end, int *r_axis)
+{
+  BVHSAHBounds centroid_bounds;
+  BVHSAHRangeData data = {.leafs = leafs, .centroid_bounds = &centroid_bounds};
+
+  bvh_sah_bounds_init(&centroid_bounds);
+  bvh_sah_range_reduce(&data,
+                       begin,
+                       end,
+                       bvh_sah_centroid_bounds_cb,
+                       bvh_sah_centroid_bounds_reduce,
+                       &centroid_bounds,
+                       sizeof(centroid_bounds));
+
+  int largest_axis = 0;
+  for (int axis = 0; axis < 3; axis++) {
+    const float extent = centroid_bounds.max[axis] - centroid_bounds.min[axis];
+    /* Slightly less than the number of bins, so the largest centroid is still in the last bin. */
+    data.bin_scale[axis] = (extent > FLT_EPSILON) ? ((float)BVH_SAH_BINS * 0.9999f) / extent :
+                                                    0.0f;
+    if (extent > centroid_bounds.max[largest_axis] - centroid_bounds.min[largest_axis]) {
+      largest_axis = axis;
+    }
+  }
+
+  BVHSAHBins bins;
+  bvh_sah_bins_init(&bins);
+  bvh_sah_range_reduce(
+      &data, begin, end, bvh_sah_bins_fill_cb, bvh_sah_bins_reduce, &bins, sizeof(bins));
+
+  /* Find the cheapest split, the cost is relative to the area of the parent. */
+  float best_cost = FLT_MAX;
+  int best_axis = -1, best_bin = 0;
+  for (int axis = 0; axis < 3; axis++) {
+    if (data.bin_scale[axis] == 0.0f) {
+      continue;
+    }
+    const BVHSAHBin *axis_bins = bins.bins[axis];
+
+    /* Cost of everything right of the split, for every split position. */
+    float cost_right[BVH_SAH_BINS];
+    float min[3], max[3];
+    int count = 0;
+    copy_v3_fl(min, FLT_MAX);
+    copy_v3_fl(max, -FLT_MAX);
+    for (int i = BVH_SAH_BINS - 1; i > 0; i--) {
+      if (axis_bins[i].count) {
+        minmax_v3v3_v3(min, max, axis_bins[i].min);
+        minmax_v3v3_v3(min, max, axis_bins[i].max);
+        count += axis_bins[i].count;
+      }
+      cost_right[i] = count ? bvh_sah_half_area(min, max) * (float)count : FLT_MAX;
+    }
+
+    copy_v3_fl(min, FLT_MAX);
+    copy_v3_fl(max, -FLT_MAX);
+    count = 0;
+    for (int i = 0; i < BVH_SAH_BINS - 1; i++) {
+      if (axis_bins[i].count) {
+        minmax_v3v3_v3(min, max, axis_bins[i].min);
+        minmax_v3v3_v3(min, max, axis_bins[i].max);
+        count += axis_bins[i].count;
+      }
+      if (count == 0 || cost_right[i + 1] == FLT_MAX) {
+        continue;
+      }
+      const float cost = bvh_sah_half_area(min, max) * (float)count + cost_right[i + 1];
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_axis = axis;
+        best_bin = i;
+      }
+    }
+  }
+
+  if (best_axis == -1) {
+    /* All centroids are (nearly) at the same position, any split is as good as another. */
+    *r_axis = largest_axis;
+    return (begin + end) / 2;
+  }
+
+  /* Move the leafs left of the split to the front. */
+  int i = begin, j = end - 1;
+  while (i <= j) {
+    if (bvh_sah_bin_index(&data, leafs[i], best_axis) <= best_bin) {
+      i++;
+    }
+    else {
+      SWAP(BVHNode *, leafs[i], leafs[j]);
+      j--;
+    }
+  }
+  BLI_assert(i > begin && i < end);
+
+  *r_axis = best_axis;
+  return i;
+}
+
+static void bvh_sah_build_task(TaskPool *__restrict pool, void *taskdata);
+
+static void bvh_sah_build_branch(TaskPool *pool,
+                                 BVHSAHBuildData *data,
+                                 BVHNode *node,
+                                 const int begin,
+                                 const int end)
+{
+  BVHTree *tree = data->tree;
+  BVHNode **leafs = tree->nodes;
+
+  refit_kdop_hull(tree, node, begin, end);
+
+  /* Boundaries of the child ranges, split the largest one until all children are used. */
+  int bounds[MAX_TREETYPE + 1] = {begin, end};
+  int children_num = 1;
+  int main_axis = -1;
+  while (children_num < tree->tree_type) {
+    int split_child = -1, split_child_len = 1;
+    for (int k = 0; k < children_num; k++) {
+      if (bounds[k + 1] - bounds[k] > split_child_len) {
+        split_child = k;
+        split_child_len = bounds[k + 1] - bounds[k];
+      }
+    }
+    if (split_child == -1) {
+      break;
+    }
+
+    int axis;
+    const int mid = bvh_sah_split(leafs, bounds[split_child], bounds[split_child + 1], &axis);
+    if (main_axis == -1) {
+      /* Children are ordered along the axis of the first split. */
+      main_axis = axis;
+    }
+    memmove(&bounds[split_child + 2],
+            &bounds[split_child + 1],
+            sizeof(*bounds) * (size_t)(children_num - split_child));
+    bounds[split_child + 1] = mid;
+    children_num++;
+  }
+
+  node->main_axis = (char)main_axis;
+  node->totnode = (char)children_num;
+
+  for (int k = 0; k < tree->tree_type; k++) {
+    if (k >= children_num) {
+      node->children[k] = NULL;
+      continue;
+    }
+    BVHNode *child;
+    if (bounds[k + 1] - bounds[k] == 1) {
+      child = leafs[bounds[k]];
+    }
+    else {
+      const int branch_index = tree->totleaf + atomic_fetch_and_add_int32(&data->branches_num, 1);
+      child = &tree->nodearray[branch_index];
+      tree->nodes[branch_index] = child;
+    }
+    child->parent = node;
+    node->children[k] = child;
+  }
+
+  for (int k = 0; k < children_num; k++) {
+    const int child_len = bounds[k + 1] - bounds[k];
+    if (child_len == 1) {
+      continue;
+    }
+    if (pool && child_len > BVH_SAH_TASK_LEAF_THRESHOLD) {
+      BVHSAHBuildTask *task = MEM_mallocN(sizeof(*task), __func__);
+      task->node = node->children[k];
+      task->begin = bounds[k];
+      task->end = bounds[k + 1];
+      BLI_task_pool_push(pool, bvh_sah_build_task, task, true, NULL);
+    }
+    else {
+      bvh_sah_build_branch(pool, data, node->children[k], bounds[k], bounds[k + 1]);
+    }
+  }
+}
+
+static void bvh_sah_build_task(TaskPool *__restrict pool, void *taskdata)
+{
+  BVHSAHBuildData *data = BLI_task_pool_user_data(pool);
+  BVHSAHBuildTask *task = taskdata;
+  bvh_sah_build_branch(pool, data, task->node, task->begin, task->end);
+}
+
+/**
+ * Make room for `nodes_num` nodes, the leafs have to be inserted already
+ * but the tree must not be balanced yet.
+ */
+static void bvhtree_ensure_nodes_num(BVHTree *tree, const int nodes_num)
+{
+  const int nodes_num_prev = (int)(MEM_allocN_len(tree->nodearray) / sizeof(*tree->nodearray));
+  if (nodes_num <= nodes_num_prev) {
+    return;
+  }
+  BLI_assert(tree->totbranch == 0);
+
+  tree->nodes = MEM_recallocN(tree->nodes, sizeof(*tree->nodes) * (size_t)nodes_num);
+  tree->nodebv = MEM_recallocN(tree->nodebv, sizeof(float) * (size_t)(tree->axis * nodes_num));
+  tree->nodechild = MEM_recallocN(tree->nodechild,
+                                  sizeof(BVHNode *) * (size_t)(tree->tree_type * nodes_num));
+  tree->nodearray = MEM_recallocN(tree->nodearray, sizeof(BVHNode) * (size_t)nodes_num);
+
+  for (int i = 0; i < nodes_num; i++) {
+    tree->nodearray[i].bv = &tree->nodebv[i * tree->axis];
+    tree->nodearray[i].children = &tree->nodechild[i * tree->tree_type];
+  }
+  /* Before balancing, leaf nodes are stored in insertion order. */
+  for (int i = 0; i < tree->totleaf; i++) {
+    tree->nodes[i] = &tree->nodearray[i];
+  }
+}
+
+/**
+ * Shrink the node arrays to the first `nodes_num` nodes once the tree is built,
+ * re-basing all pointers between nodes since the arrays are reallocated.
+ */
+static void bvhtree_trim_nodes_num(BVHTree *tree, const int nodes_num)
+{
+  const int nodes_num_prev = (int)(MEM_allocN_len(tree->nodearray) / sizeof(*tree->nodearray));
+  if (nodes_num >= nodes_num_prev) {
+    return;
+  }
+
+  BVHNode **nodes = MEM_mallocN(sizeof(*nodes) * (size_t)nodes_num, "BVHNodes");
+  float *nodebv = MEM_mallocN(sizeof(float) * (size_t)(tree->axis * nodes_num), "BVHNodeBV");
+  BVHNode **nodechild = MEM_mallocN(sizeof(BVHNode *) * (size_t)(tree->tree_type * nodes_num),
+                                    "BVHNodeBV");
+  BVHNode *nodearray = MEM_mallocN(sizeof(BVHNode) * (size_t)nodes_num, "BVHNodeArray");
+
+  memcpy(nodebv, tree->nodebv, sizeof(float) * (size_t)(tree->axis * nodes_num));
+  memcpy(nodearray, tree->nodearray, sizeof(BVHNode) * (size_t)nodes_num);
+
+#define NODE_REBASE(node) ((node) ? &nodearray[(node)-tree->nodearray] : NULL)
+
+  for (int i = 0; i < nodes_num; i++) {
+    nodes[i] = NODE_REBASE(tree->nodes[i]);
+    nodearray[i].parent = NODE_REBASE(nodearray[i].parent);
+    nodearray[i].bv = &nodebv[i * tree->axis];
+    nodearray[i].children = &nodechild[i * tree->tree_type];
+    for (int k = 0; k < tree->tree_type; k++) {
+      nodechild[i * tree->tree_type + k] = NODE_REBASE(tree->nodechild[i * tree->tree_type + k]);
+    }
+  }
+
+#undef NODE_REBASE
+
+  MEM_freeN(tree->nodes);
+  MEM_freeN(tree->nodebv);
+  MEM_freeN(tree->nodechild);
+  MEM_freeN(tree->nodearray);
+  tree->nodes = nodes;
+  tree->nodebv = nodebv;
+  tree->nodechild = nodechild;
+  tree->nodearray = nodearray;
+}
+
+static void bvhtree_balance_sah(BVHTree *tree)
+{
+  BLI_assert(tree->totleaf >= 2);
+
+  /* Every branch has at least two children. */
+  bvhtree_ensure_nodes_num(tree, tree->totleaf + (tree->totleaf - 1));
+
+  BVHSAHBuildData data = {.tree = tree, .branches_num = 1};
+  BVHNode *root = &tree->nodearray[tree->totleaf];
+  tree->nodes[tree->totleaf] = root;
+  root->parent = NULL;
+
+  if (tree->totleaf > KDOPBVH_THREAD_LEAF_THRESHOLD) {
+    TaskPool *pool = BLI_task_pool_create(&data, TASK_PRIORITY_HIGH);
+    bvh_sah_build_branch(pool, &data, root, 0, tree->totleaf);
+    BLI_task_pool_work_and_wait(pool);
+    BLI_task_pool_free(pool);
+  }
+  else {
+    bvh_sah_build_branch(NULL, &data, root, 0, tree->totleaf);
+  }
+
+  tree->totbranch = data.branches_num;
+
+  /* Branches with more than two children leave the end of the worst case allocation unused. */
+  bvhtree_trim_nodes_num(tree, tree->totleaf + tree->totbranch);
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name BLI_bvhtree API
  * \{ */
@@ -955,7 +1429,7 @@ void BLI_bvhtree_free(BVHTree *tree)
   }
 }
 
-void BLI_bvhtree_balance(BVHTree *tree)
+void BLI_bvhtree_balance_ex(BVHTree *tree, const int flag)
 {
   BVHNode **leafs_array = tree->nodes;
 
@@ -963,15 +1437,20 @@ void BLI_bvhtree_balance(BVHTree *tree)
    * (some big bug goes here if its being called more than once per tree) */
   BLI_assert(tree->totbranch == 0);
 
-  /* Build the implicit tree */
-  non_recursive_bvh_div_nodes(
-      tree, tree->nodearray + (tree->totleaf - 1), leafs_array, tree->totleaf);
+  if ((flag & BVH_BALANCE_USE_SAH) && tree->totleaf >= 2) {
+    bvhtree_balance_sah(tree);
+  }
+  else {
+    /* Build the implicit tree */
+    non_recursive_bvh_div_nodes(
+        tree, tree->nodearray + (tree->totleaf - 1), leafs_array, tree->totleaf);
 
-  /* current code expects the branches to be linked to the nodes array
-   * we perform that linkage here */
-  tree->totbranch = implicit_needed_branches(tree->tree_type, tree->totleaf);
-  for (int i = 0; i < tree->totbranch; i++) {
-    tree->nodes[tree->totleaf + i] = &tree->nodearray[tree->totleaf + i];
+    /* current code expects the branches to be linked to the nodes array
+     * we perform that linkage here */
+    tree->totbranch = implicit_needed_branches(tree->tree_type, tree->totleaf);
+    for (int i = 0; i < tree->totbranch; i++) {
+      tree->nodes[tree->totleaf + i] = &tree->nodearray[tree->totleaf + i];
+    }
   }
 
 #ifdef USE_SKIP_LINKS
@@ -987,6 +1466,11 @@ void BLI_bvhtree_balance(BVHTree *tree)
 #endif
 }
 
+void BLI_bvhtree_balance(BVHTree *tree)
+{
+  BLI_bvhtree_balance_ex(tree, 0);
+}
+
 static void bvhtree_node_inflate(const BVHTree *tree, BVHNode *node, const float dist)
 {
   axis_t axis_iter;
@@ -2060,6 +2544,346 @@ void BLI_bvhtree_ray_cast_all(BVHTree *tree,
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name BLI_bvhtree batched queries
+ *
+ * Queries are sorted along a Morton curve (rays also by direction octant),
+ * so neighboring queries mostly visit the same nodes, then run in parallel chunks.
+ *
+ * - Nearest queries are seeded with the result of the previous query in the chunk,
+ *   which usually prunes most of the tree right away.
+ * - Rays are traversed in small packets that share the node loads and the traversal order.
+ *
+ * \{ */
+
+/* Number of rays traversed together. */
+#define BVH_BATCH_PACKET_SIZE 8
+BLI_STATIC_ASSERT(BVH_BATCH_PACKET_SIZE <= 32, "Packet mask must fit into an uint")
+/* Number of (sorted) queries handled by a single parallel task iteration. */
+#define BVH_BATCH_CHUNK_SIZE 256
+#define BVH_BATCH_THREAD_THRESHOLD 1024
+
+/* Bits per dimension of the Morton code, leaving room for the ray octant. */
+#define BVH_BATCH_MORTON_BITS 19
+
+typedef struct BVHBatchOrder {
+  uint64_t key;
+  int index;
+} BVHBatchOrder;
+
+typedef struct BVHNearestBatchData {
+  BVHTree *tree;
+  const float (*co)[3];
+  BVHTreeNearest *nearest;
+  const BVHBatchOrder *order;
+  int len;
+
+  BVHTree_NearestPointCallback callback;
+  void *userdata;
+  int flag;
+} BVHNearestBatchData;
+
+typedef struct BVHRayCastBatchData {
+  BVHTree *tree;
+  const float (*co)[3];
+  const float (*dir)[3];
+  float radius;
+  BVHTreeRayHit *hit;
+  const BVHBatchOrder *order;
+  int len;
+
+  BVHTree_RayCastCallback callback;
+  void *userdata;
+  int flag;
+} BVHRayCastBatchData;
+
+/* Spread the lower 21 bits of \a v so there are two zero bits between each. */
+static uint64_t bvh_batch_morton_expand(uint64_t v)
+{
+  v &= 0x1fffff;
+  v = (v | v << 32) & 0x1f00000000ffffULL;
+  v = (v | v << 16) & 0x1f0000ff0000ffULL;
+  v = (v | v << 8) & 0x100f00f00f00f00fULL;
+  v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+  v = (v | v << 2) & 0x1249249249249249ULL;
+  return v;
+}
+
+static int bvh_batch_order_cmp(const void *a_v, const void *b_v)
+{
+  const BVHBatchOrder *a = a_v;
+  const BVHBatchOrder *b = b_v;
+  if (a->key < b->key) {
+    return -1;
+  }
+  if (a->key > b->key) {
+    return 1;
+  }
+  /* Keep the order stable for equal keys. */
+  return (a->index > b->index) - (a->index < b->index);
+}
+
+/**
+ * Returns the query indices sorted for coherent traversal,
+ * \a dir is optional and groups rays by direction octant first.
+ */
+static BVHBatchOrder *bvh_batch_order_create(const float (*co)[3],
+                                             const float (*dir)[3],
+                                             const int len)
+{
+  BVHBatchOrder *order = MEM_mallocN(sizeof(*order) * (size_t)len, __func__);
+  const float scale_max = (float)((1 << BVH_BATCH_MORTON_BITS) - 1);
+  float min[3], max[3], scale[3];
+
+  INIT_MINMAX(min, max);
+  for (int i = 0; i < len; i++) {
+    minmax_v3v3_v3(min, max, co[i]);
+  }
+  for (int axis = 0; axis < 3; axis++) {
+    const float size = max[axis] - min[axis];
+    scale[axis] = (size > FLT_EPSILON) ? scale_max / size : 0.0f;
+  }
+
+  for (int i = 0; i < len; i++) {
+    uint64_t key = 0;
+    for (int axis = 0; axis < 3; axis++) {
+      const uint64_t cell = (uint64_t)((co[i][axis] - min[axis]) * scale[axis]);
+      key |= bvh_batch_morton_expand(cell) << axis;
+    }
+    if (dir) {
+      const uint64_t octant = (uint64_t)((dir[i][0] < 0.0f) | ((dir[i][1] < 0.0f) << 1) |
+                                         ((dir[i][2] < 0.0f) << 2));
+      key |= octant << (3 * BVH_BATCH_MORTON_BITS);
+    }
+    order[i].key = key;
+    order[i].index = i;
+  }
+
+  qsort(order, (size_t)len, sizeof(*order), bvh_batch_order_cmp);
+  return order;
+}
+
+static void bvh_batch_parallel_settings(TaskParallelSettings *settings, const int len)
+{
+  BLI_parallel_range_settings_defaults(settings);
+  settings->use_threading = (len > BVH_BATCH_THREAD_THRESHOLD);
+}
+
+static void bvhtree_find_nearest_batch_task_cb(void *__restrict userdata,
+                                               const int chunk,
+                                               const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BVHNearestBatchData *data = userdata;
+  const int start = chunk * BVH_BATCH_CHUNK_SIZE;
+  const int end = min_ii(start + BVH_BATCH_CHUNK_SIZE, data->len);
+
+  BVHTreeNearest nearest_prev;
+  nearest_prev.index = -1;
+
+  for (int i = start; i < end; i++) {
+    const int index = data->order[i].index;
+    const float *co = data->co[index];
+    BVHTreeNearest *nearest = &data->nearest[index];
+
+    /* The point found for the previous query is on the surface, so its distance is a valid
+     * upper bound for this query. Keeping its index makes it the result if nothing is closer. */
+    if (nearest_prev.index != -1) {
+      const float dist_sq = len_squared_v3v3(co, nearest_prev.co);
+      if (dist_sq < nearest->dist_sq) {
+        *nearest = nearest_prev;
+        nearest->dist_sq = dist_sq;
+      }
+    }
+
+    BLI_bvhtree_find_nearest_ex(
+        data->tree, co, nearest, data->callback, data->userdata, data->flag);
+
+    if (nearest->index != -1) {
+      nearest_prev = *nearest;
+    }
+  }
+}
+
+void BLI_bvhtree_find_nearest_batch(BVHTree *tree,
+                                    const float (*co)[3],
+                                    const int co_len,
+                                    BVHTreeNearest *r_nearest,
+                                    BVHTree_NearestPointCallback callback,
+                                    void *userdata,
+                                    int flag)
+{
+  if (co_len == 0 || tree->totleaf == 0) {
+    return;
+  }
+
+  BVHNearestBatchData data = {
+      .tree = tree,
+      .co = co,
+      .nearest = r_nearest,
+      .order = bvh_batch_order_create(co, NULL, co_len),
+      .len = co_len,
+      .callback = callback,
+      .userdata = userdata,
+      .flag = flag,
+  };
+
+  TaskParallelSettings settings;
+  bvh_batch_parallel_settings(&settings, co_len);
+  BLI_task_parallel_range(0,
+                          (co_len + BVH_BATCH_CHUNK_SIZE - 1) / BVH_BATCH_CHUNK_SIZE,
+                          &data,
+                          bvhtree_find_nearest_batch_task_cb,
+                          &settings);
+
+  MEM_freeN((void *)data.order);
+}
+
+/**
+ * Packet version of #dfs_raycast,
+ * \a mask holds the rays of the packet that still need to visit \a node.
+ */
+static void dfs_raycast_packet(BVHRayCastData *packet,
+                               const int packet_len,
+                               const uint mask,
+                               BVHNode *node)
+{
+  float dist[BVH_BATCH_PACKET_SIZE];
+  uint mask_hit = 0;
+  int i;
+
+  for (i = 0; i < packet_len; i++) {
+    if (mask & (1u << i)) {
+      const BVHRayCastData *data = &packet[i];
+      dist[i] = (data->ray.radius == 0.0f) ? fast_ray_nearest_hit(data, node) :
+                                             ray_nearest_hit(data, node->bv);
+      if (dist[i] < data->hit.dist) {
+        mask_hit |= (1u << i);
+      }
+    }
+  }
+
+  if (mask_hit == 0) {
+    return;
+  }
+
+  if (node->totnode == 0) {
+    for (i = 0; i < packet_len; i++) {
+      if (mask_hit & (1u << i)) {
+        BVHRayCastData *data = &packet[i];
+        if (data->callback) {
+          data->callback(data->userdata, node->index, &data->ray, &data->hit);
+        }
+        else {
+          data->hit.index = node->index;
+          data->hit.dist = dist[i];
+          madd_v3_v3v3fl(data->hit.co, data->ray.origin, data->ray.direction, dist[i]);
+        }
+      }
+    }
+  }
+  else {
+    /* Rays of a packet are sorted to mostly share the direction octant,
+     * so the first active ray picks the loop direction for all of them. */
+    const BVHRayCastData *data_first = packet;
+    for (i = 0; !(mask_hit & (1u << i)); i++) {
+      data_first++;
+    }
+
+    if (data_first->ray_dot_axis[node->main_axis] > 0.0f) {
+      for (i = 0; i != node->totnode; i++) {
+        dfs_raycast_packet(packet, packet_len, mask_hit, node->children[i]);
+      }
+    }
+    else {
+      for (i = node->totnode - 1; i >= 0; i--) {
+        dfs_raycast_packet(packet, packet_len, mask_hit, node->children[i]);
+      }
+    }
+  }
+}
+
+static void bvhtree_ray_cast_batch_task_cb(void *__restrict userdata,
+                                           const int chunk,
+                                           const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BVHRayCastBatchData *data = userdata;
+  BVHNode *root = data->tree->nodes[data->tree->totleaf];
+  const int start = chunk * BVH_BATCH_CHUNK_SIZE;
+  const int end = min_ii(start + BVH_BATCH_CHUNK_SIZE, data->len);
+
+  BVHRayCastData packet[BVH_BATCH_PACKET_SIZE];
+
+  for (int packet_start = start; packet_start < end; packet_start += BVH_BATCH_PACKET_SIZE) {
+    const int packet_len = min_ii(BVH_BATCH_PACKET_SIZE, end - packet_start);
+
+    for (int i = 0; i < packet_len; i++) {
+      const int index = data->order[packet_start + i].index;
+      BVHRayCastData *ray_data = &packet[i];
+
+      BLI_ASSERT_UNIT_V3(data->dir[index]);
+
+      ray_data->tree = data->tree;
+      ray_data->callback = data->callback;
+      ray_data->userdata = data->userdata;
+
+      copy_v3_v3(ray_data->ray.origin, data->co[index]);
+      copy_v3_v3(ray_data->ray.direction, data->dir[index]);
+      ray_data->ray.radius = data->radius;
+
+      bvhtree_ray_cast_data_precalc(ray_data, data->flag);
+
+      memcpy(&ray_data->hit, &data->hit[index], sizeof(ray_data->hit));
+    }
+
+    dfs_raycast_packet(packet, packet_len, (1u << packet_len) - 1, root);
+
+    for (int i = 0; i < packet_len; i++) {
+      const int index = data->order[packet_start + i].index;
+      memcpy(&data->hit[index], &packet[i].hit, sizeof(packet[i].hit));
+    }
+  }
+}
+
+void BLI_bvhtree_ray_cast_batch(BVHTree *tree,
+                                const float (*co)[3],
+                                const float (*dir)[3],
+                                const int rays_len,
+                                float radius,
+                                BVHTreeRayHit *r_hit,
+                                BVHTree_RayCastCallback callback,
+                                void *userdata,
+                                int flag)
+{
+  if (rays_len == 0 || tree->totleaf == 0) {
+    return;
+  }
+
+  BVHRayCastBatchData data = {
+      .tree = tree,
+      .co = co,
+      .dir = dir,
+      .radius = radius,
+      .hit = r_hit,
+      .order = bvh_batch_order_create(co, dir, rays_len),
+      .len = rays_len,
+      .callback = callback,
+      .userdata = userdata,
+      .flag = flag,
+  };
+
+  TaskParallelSettings settings;
+  bvh_batch_parallel_settings(&settings, rays_len);
+  BLI_task_parallel_range(0,
+                          (rays_len + BVH_BATCH_CHUNK_SIZE - 1) / BVH_BATCH_CHUNK_SIZE,
+                          &data,
+                          bvhtree_ray_cast_batch_task_cb,
+                          &settings);
+
+  MEM_freeN((void *)data.order);
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name BLI_bvhtree_range_query
  *
@@ -27,8 +27,11 @@
  * - Freeing chunks.
  * - Iterating over allocated chunks
  *   (optionally when using the #BLI_MEMPOOL_ALLOW_ITER flag).
+ * - Allocating from multiple threads
+ *   (optionally when using the #BLI_MEMPOOL_THREADSAFE flag).
  */
 
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -106,6 +109,35 @@ typedef struct BLI_mempool_chunk {
   struct BLI_mempool_chunk *next;
 } BLI_mempool_chunk;
 
+/**
+ * Number of per-thread caches of a #BLI_MEMPOOL_THREADSAFE pool,
+ * threads share a cache when there are more (see #mempool_thread_index_get).
+ */
+#define MEMPOOL_THREAD_CACHE_NUM 64
+/** Maximum number of elements moved between a thread cache and the pool at once. */
+#define MEMPOOL_THREAD_CACHE_BATCH_MAX 256u
+#define MEMPOOL_CACHE_LINE_SIZE 64u
+
+typedef struct BLI_mempool_thread_cache_data {
+  /** Only contended when threads share the cache. */
+  pthread_mutex_t lock;
+  /** Free elements owned by this cache, #BLI_freenode.freeword is set like for the pool. */
+  BLI_freenode *free;
+  uint free_len;
+  /** Elements allocated minus elements freed through this cache (may be negative). */
+  int used;
+} BLI_mempool_thread_cache_data;
+
+/**
+ * Free elements cached for the threads using this cache,
+ * padded so threads don't share cache lines.
+ */
+typedef union BLI_mempool_thread_cache {
+  BLI_mempool_thread_cache_data data;
+  char _pad[(sizeof(BLI_mempool_thread_cache_data) + MEMPOOL_CACHE_LINE_SIZE - 1) &
+            ~(MEMPOOL_CACHE_LINE_SIZE - 1)];
+} BLI_mempool_thread_cache;
+
 /**
  * The mempool, stores and tracks memory \a chunks and elements within those chunks \a free.
  */
@@ -129,12 +161,21 @@ struct BLI_mempool {
   BLI_freenode *free;
   /** Use to know how many chunks to keep for #BLI_mempool_clear. */
   uint maxchunks;
-  /** Number of elements currently in use. */
+  /** Number of elements currently in use (not counting thread caches, see #mempool_totused). */
   uint totused;
 #ifdef USE_TOTALLOC
   /** Number of elements allocated in total. */
   uint totalloc;
 #endif
+
+  /* Only used with #BLI_MEMPOOL_THREADSAFE. */
+
+  /** Protects \a chunks, \a chunk_tail and \a free. */
+  pthread_mutex_t lock;
+  /** #MEMPOOL_THREAD_CACHE_NUM caches. */
+  BLI_mempool_thread_cache *thread_caches;
+  /** Number of elements moved between a thread cache and \a free at once. */
+  uint thread_cache_batch;
 };
 
 #define MEMPOOL_ELEM_SIZE_MIN (sizeof(void *) * 2)
@@ -265,6 +306,194 @@ static void mempool_chunk_free_all(BLI_mempool_chunk *mpchunk)
   }
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Thread Caches
+ *
+ * With #BLI_MEMPOOL_THREADSAFE each thread allocates from and frees into its own cache of free
+ * elements, the pool is only locked to move a batch of elements in or out of a cache.
+ * Cached elements are tagged free like any other, so iteration works as usual.
+ * \{ */
+
+static void mempool_thread_caches_reset(BLI_mempool *pool)
+{
+  for (int i = 0; i < MEMPOOL_THREAD_CACHE_NUM; i++) {
+    BLI_mempool_thread_cache_data *cache = &pool->thread_caches[i].data;
+    cache->free = NULL;
+    cache->free_len = 0;
+    cache->used = 0;
+  }
+}
+
+static void mempool_thread_caches_init(BLI_mempool *pool)
+{
+  pthread_mutex_init(&pool->lock, NULL);
+  pool->thread_caches = MEM_mallocN_aligned(sizeof(BLI_mempool_thread_cache) *
+                                                MEMPOOL_THREAD_CACHE_NUM,
+                                            MEMPOOL_CACHE_LINE_SIZE,
+                                            "BLI_Mempool thread caches");
+  for (int i = 0; i < MEMPOOL_THREAD_CACHE_NUM; i++) {
+    pthread_mutex_init(&pool->thread_caches[i].data.lock, NULL);
+  }
+  mempool_thread_caches_reset(pool);
+  pool->thread_cache_batch = MIN2(pool->pchunk, MEMPOOL_THREAD_CACHE_BATCH_MAX);
+}
+
+static void mempool_thread_caches_free(BLI_mempool *pool)
+{
+  for (int i = 0; i < MEMPOOL_THREAD_CACHE_NUM; i++) {
+    pthread_mutex_destroy(&pool->thread_caches[i].data.lock);
+  }
+  MEM_freeN(pool->thread_caches);
+  pthread_mutex_destroy(&pool->lock);
+}
+
+/* Threads are used through pthreads directly instead of `BLI_threads.h`,
+ * because makesdna builds this file without `threads.cc`. */
+static pthread_once_t mempool_thread_index_once = PTHREAD_ONCE_INIT;
+static pthread_key_t mempool_thread_index_key;
+static uint32_t mempool_thread_index_counter = 0;
+
+static void mempool_thread_index_key_create(void)
+{
+  pthread_key_create(&mempool_thread_index_key, NULL);
+}
+
+/**
+ * Small number unique to the calling thread, assigned on first use.
+ */
+static uint mempool_thread_index_get(void)
+{
+  pthread_once(&mempool_thread_index_once, mempool_thread_index_key_create);
+  /* Stored plus one, so unassigned threads get NULL. */
+  uintptr_t index = (uintptr_t)pthread_getspecific(mempool_thread_index_key);
+  if (UNLIKELY(index == 0)) {
+    index = atomic_add_and_fetch_uint32(&mempool_thread_index_counter, 1);
+    pthread_setspecific(mempool_thread_index_key, (void *)index);
+  }
+  return (uint)(index - 1);
+}
+
+BLI_INLINE BLI_mempool_thread_cache_data *mempool_thread_cache_get(BLI_mempool *pool)
+{
+  return &pool->thread_caches[mempool_thread_index_get() % MEMPOOL_THREAD_CACHE_NUM].data;
+}
+
+/**
+ * Move a batch of free elements from the pool into \a cache, adding a chunk when there are none.
+ * \note The cache must be locked.
+ */
+static void mempool_thread_cache_refill(BLI_mempool *pool, BLI_mempool_thread_cache_data *cache)
+{
+  pthread_mutex_lock(&pool->lock);
+  if (UNLIKELY(pool->free == NULL)) {
+    /* Don't hold the lock while allocating,
+     * other threads may return free elements in the meantime. */
+    pthread_mutex_unlock(&pool->lock);
+    BLI_mempool_chunk *mpchunk = mempool_chunk_alloc(pool);
+    pthread_mutex_lock(&pool->lock);
+
+    BLI_freenode *free_prev = pool->free;
+    pool->free = NULL;
+    BLI_freenode *last_tail = mempool_chunk_add(pool, mpchunk, NULL);
+    last_tail->next = free_prev;
+  }
+
+  BLI_freenode *head = pool->free;
+  BLI_freenode *tail = head;
+  uint len = 1;
+  while ((len < pool->thread_cache_batch) && tail->next) {
+    tail = tail->next;
+    len++;
+  }
+  pool->free = tail->next;
+  pthread_mutex_unlock(&pool->lock);
+
+  tail->next = cache->free;
+  cache->free = head;
+  cache->free_len += len;
+}
+
+/**
+ * Move a batch of free elements from \a cache back into the pool, for other threads to use.
+ * \note The cache must be locked.
+ */
+static void mempool_thread_cache_flush(BLI_mempool *pool, BLI_mempool_thread_cache_data *cache)
+{
+  BLI_assert(cache->free_len >= pool->thread_cache_batch);
+  BLI_freenode *head = cache->free;
+  BLI_freenode *tail = head;
+  for (uint i = 1; i < pool->thread_cache_batch; i++) {
+    tail = tail->next;
+  }
+  cache->free = tail->next;
+  cache->free_len -= pool->thread_cache_batch;
+
+  pthread_mutex_lock(&pool->lock);
+  tail->next = pool->free;
+  pool->free = head;
+  pthread_mutex_unlock(&pool->lock);
+}
+
+static void *mempool_alloc_threadsafe(BLI_mempool *pool)
+{
+  BLI_mempool_thread_cache_data *cache = mempool_thread_cache_get(pool);
+  BLI_freenode *free_pop;
+
+  pthread_mutex_lock(&cache->lock);
+  if (UNLIKELY(cache->free == NULL)) {
+    mempool_thread_cache_refill(pool, cache);
+  }
+  free_pop = cache->free;
+  cache->free = free_pop->next;
+  cache->free_len--;
+  cache->used++;
+  pthread_mutex_unlock(&cache->lock);
+
+  if (pool->flag & BLI_MEMPOOL_ALLOW_ITER) {
+    free_pop->freeword = USEDWORD;
+  }
+
+#ifdef WITH_MEM_VALGRIND
+  VALGRIND_MEMPOOL_ALLOC(pool, free_pop, pool->esize);
+#endif
+
+  return (void *)free_pop;
+}
+
+static void mempool_free_threadsafe(BLI_mempool *pool, BLI_freenode *newhead)
+{
+  BLI_mempool_thread_cache_data *cache = mempool_thread_cache_get(pool);
+
+  pthread_mutex_lock(&cache->lock);
+  newhead->next = cache->free;
+  cache->free = newhead;
+  cache->free_len++;
+  cache->used--;
+  /* Keep some elements so alternating allocations and frees don't lock the pool. */
+  if (UNLIKELY(cache->free_len >= pool->thread_cache_batch * 2)) {
+    mempool_thread_cache_flush(pool, cache);
+  }
+  pthread_mutex_unlock(&cache->lock);
+}
+
+/**
+ * \return The number of elements in use, summing the thread caches when used.
+ */
+static uint mempool_totused(const BLI_mempool *pool)
+{
+  if (pool->flag & BLI_MEMPOOL_THREADSAFE) {
+    int totused = 0;
+    for (int i = 0; i < MEMPOOL_THREAD_CACHE_NUM; i++) {
+      totused += pool->thread_caches[i].data.used;
+    }
+    BLI_assert(totused >= 0);
+    return (uint)totused;
+  }
+  return pool->totused;
+}
+
+/** \} */
+
 BLI_mempool *BLI_mempool_create(uint esize, uint totelem, uint pchunk, uint flag)
 {
   BLI_mempool *pool;
@@ -315,6 +544,11 @@ BLI_mempool *BLI_mempool_create(uint esize, uint totelem, uint pchunk, uint flag
   pool->totalloc = 0;
 #endif
   pool->totused = 0;
+  pool->thread_caches = NULL;
+
+  if (flag & BLI_MEMPOOL_THREADSAFE) {
+    mempool_thread_caches_init(pool);
+  }
 
   if (totelem) {
     /* Allocate the actual chunks. */
@@ -335,6 +569,10 @@ void *BLI_mempool_alloc(BLI_mempool *pool)
 {
   BLI_freenode *free_pop;
 
+  if (pool->flag & BLI_MEMPOOL_THREADSAFE) {
+    return mempool_alloc_threadsafe(pool);
+  }
+
   if (UNLIKELY(pool->free == NULL)) {
     /* Need to allocate a new chunk. */
     BLI_mempool_chunk *mpchunk = mempool_chunk_alloc(pool);
@@ -379,12 +617,19 @@ void BLI_mempool_free(BLI_mempool *pool, void *addr)
   {
     BLI_mempool_chunk *chunk;
     bool found = false;
+    /* Other threads may be adding chunks. */
+    if (pool->flag & BLI_MEMPOOL_THREADSAFE) {
+      pthread_mutex_lock(&pool->lock);
+    }
     for (chunk = pool->chunks; chunk; chunk = chunk->next) {
       if (ARRAY_HAS_ITEM((char *)addr, (char *)CHUNK_DATA(chunk), pool->csize)) {
         found = true;
         break;
       }
     }
+    if (pool->flag & BLI_MEMPOOL_THREADSAFE) {
+      pthread_mutex_unlock(&pool->lock);
+    }
     if (!found) {
       BLI_assert(!"Attempt to free data which is not in pool.\n");
     }
@@ -404,6 +649,14 @@ void BLI_mempool_free(BLI_mempool *pool, void *addr)
     newhead->freeword = FREEWORD;
   }
 
+  if (pool->flag & BLI_MEMPOOL_THREADSAFE) {
+    mempool_free_threadsafe(pool, newhead);
+#ifdef WITH_MEM_VALGRIND
+    VALGRIND_MEMPOOL_FREE(pool, addr);
+#endif
+    return;
+  }
+
   newhead->next = pool->free;
   pool->free = newhead;
 
@@ -453,14 +706,14 @@ void BLI_mempool_free(BLI_mempool *pool, void *addr)
 
 int BLI_mempool_len(BLI_mempool *pool)
 {
-  return (int)pool->totused;
+  return (int)mempool_totused(pool);
 }
 
 void *BLI_mempool_findelem(BLI_mempool *pool, uint index)
 {
   BLI_assert(pool->flag & BLI_MEMPOOL_ALLOW_ITER);
 
-  if (index < pool->totused) {
+  if (index < mempool_totused(pool)) {
     /* We could have some faster mem chunk stepping code inline. */
     BLI_mempool_iter iter;
     void *elem;
@@ -491,7 +744,7 @@ void BLI_mempool_as_table(BLI_mempool *pool, void **data)
   while ((elem = BLI_mempool_iterstep(&iter))) {
     *p++ = elem;
   }
-  BLI_assert((uint)(p - data) == pool->totused);
+  BLI_assert((uint)(p - data) == mempool_totused(pool));
 }
 
 /**
@@ -499,7 +752,7 @@ void BLI_mempool_as_table(BLI_mempool *pool, void **data)
  */
 void **BLI_mempool_as_tableN(BLI_mempool *pool, const char *allocstr)
 {
-  void **data = MEM_mallocN((size_t)pool->totused * sizeof(void *), allocstr);
+  void **data = MEM_mallocN((size_t)mempool_totused(pool) * sizeof(void *), allocstr);
   BLI_mempool_as_table(pool, data);
   return data;
 }
@@ -518,7 +771,7 @@ void BLI_mempool_as_array(BLI_mempool *pool, void *data)
     memcpy(p, elem, (size_t)esize);
     p = NODE_STEP_NEXT(p);
   }
-  BLI_assert((uint)(p - (char *)data) == pool->totused * esize);
+  BLI_assert((uint)(p - (char *)data) == mempool_totused(pool) * esize);
 }
 
 /**
@@ -526,7 +779,7 @@ void BLI_mempool_as_array(BLI_mempool *pool, void *data)
  */
 void *BLI_mempool_as_arrayN(BLI_mempool *pool, const char *allocstr)
 {
-  char *data = MEM_malloc_arrayN(pool->totused, pool->esize, allocstr);
+  char *data = MEM_malloc_arrayN(mempool_totused(pool), pool->esize, allocstr);
   BLI_mempool_as_array(pool, data);
   return data;
 }
@@ -729,6 +982,9 @@ void BLI_mempool_clear_ex(BLI_mempool *pool, const int totelem_reserve)
   /* re-initialize */
   pool->free = NULL;
   pool->totused = 0;
+  if (pool->flag & BLI_MEMPOOL_THREADSAFE) {
+    mempool_thread_caches_reset(pool);
+  }
 #ifdef USE_TOTALLOC
   pool->totalloc = 0;
 #endif
@@ -758,6 +1014,10 @@ void BLI_mempool_destroy(BLI_mempool *pool)
 {
   mempool_chunk_free_all(pool->chunks);
 
+  if (pool->flag & BLI_MEMPOOL_THREADSAFE) {
+    mempool_thread_caches_free(pool);
+  }
+
 #ifdef WITH_MEM_VALGRIND
   VALGRIND_DESTROY_MEMPOOL(pool);
 #endif
@@ -22,6 +22,7 @@
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <type_traits>
 
 #include "BLI_array.hh"
 #include "BLI_double2.hh"
@@ -120,6 +121,8 @@ template<typename T> inline SymEdge<T> *prev(const SymEdge<T> *se)
 template<typename Arith_t> struct CDTVert {
   /** Coordinate. */
   vec2<Arith_t> co;
+  /** Approximation of \a co, for the floating point filters of the exact predicates. */
+  double2 approx_co;
   /** Some edge attached to it. */
   SymEdge<Arith_t> *symedge{nullptr};
   /** List of corresponding vertex input ids. */
@@ -539,6 +542,7 @@ template<typename T> bool in_line(const vec2<T> &a, const vec2<T> &b, const vec2
 template<typename T> CDTVert<T>::CDTVert(const vec2<T> &pt)
 {
   this->co = pt;
+  this->approx_co = double2(math_to_double(pt[0]), math_to_double(pt[1]));
   this->input_ids = nullptr;
   this->symedge = nullptr;
   this->index = -1;
@@ -955,21 +959,52 @@ template<typename T> void find_site_merges(Array<SiteInfo<T>> &sites)
   }
 }
 
+/**
+ * #orient2d and #incircle of vertices. With exact arithmetic, the floating point filters on the
+ * approximate coordinates decide most cases, so the exact predicates are only used for the rest.
+ */
+template<typename T>
+inline int vert_orient2d(const CDTVert<T> *a, const CDTVert<T> *b, const CDTVert<T> *c)
+{
+  if constexpr (!std::is_same_v<T, double>) {
+    const int orient = filter_orient2d(a->approx_co, b->approx_co, c->approx_co);
+    if (orient != 0) {
+      return orient;
+    }
+  }
+  return orient2d(a->co, b->co, c->co);
+}
+
+template<typename T>
+inline int vert_incircle(const CDTVert<T> *a,
+                         const CDTVert<T> *b,
+                         const CDTVert<T> *c,
+                         const CDTVert<T> *d)
+{
+  if constexpr (!std::is_same_v<T, double>) {
+    const int side = filter_incircle(a->approx_co, b->approx_co, c->approx_co, d->approx_co);
+    if (side != 0) {
+      return side;
+    }
+  }
+  return incircle(a->co, b->co, c->co, d->co);
+}
+
 template<typename T> inline bool vert_left_of_symedge(CDTVert<T> *v, SymEdge<T> *se)
 {
-  return orient2d(v->co, se->vert->co, se->next->vert->co) > 0;
+  return vert_orient2d(v, se->vert, se->next->vert) > 0;
 }
 
 template<typename T> inline bool vert_right_of_symedge(CDTVert<T> *v, SymEdge<T> *se)
 {
-  return orient2d(v->co, se->next->vert->co, se->vert->co) > 0;
+  return vert_orient2d(v, se->next->vert, se->vert) > 0;
 }
 
 /* Is se above basel? */
 template<typename T>
 inline bool dc_tri_valid(SymEdge<T> *se, SymEdge<T> *basel, SymEdge<T> *basel_sym)
 {
-  return orient2d(se->next->vert->co, basel_sym->vert->co, basel->vert->co) > 0;
+  return vert_orient2d(se->next->vert, basel_sym->vert, basel->vert) > 0;
 }
 
 /**
@@ -1013,7 +1048,7 @@ void dc_tri(CDTArrangement<T> *cdt,
     }
     CDTVert<T> *v3 = sites[start + 2].v;
     CDTEdge<T> *eb = cdt->add_vert_to_symedge_edge(v3, &ea->symedges[1]);
-    int orient = orient2d(v1->co, v2->co, v3->co);
+    int orient = vert_orient2d(v1, v2, v3);
     if (orient > 0) {
       cdt->add_diagonal(&eb->symedges[0], &ea->symedges[0]);
       *r_le = &ea->symedges[0];
@@ -1101,10 +1136,10 @@ void dc_tri(CDTArrangement<T> *cdt,
         std::cout << "found valid lcand\n";
         std::cout << "  lcand" << lcand << "\n";
       }
-      while (incircle(basel_sym->vert->co,
-                      basel->vert->co,
-                      lcand->next->vert->co,
-                      lcand->rot->next->vert->co) > 0.0) {
+      while (vert_incircle(basel_sym->vert,
+                           basel->vert,
+                           lcand->next->vert,
+                           lcand->rot->next->vert) > 0) {
         if (dbg_level > 1) {
           std::cout << "incircle says to remove lcand\n";
           std::cout << "  lcand" << lcand << "\n";
@@ -1120,10 +1155,10 @@ void dc_tri(CDTArrangement<T> *cdt,
         std::cout << "found valid rcand\n";
         std::cout << "  rcand" << rcand << "\n";
       }
-      while (incircle(basel_sym->vert->co,
-                      basel->vert->co,
-                      rcand->next->vert->co,
-                      sym(rcand)->next->next->vert->co) > 0.0) {
+      while (vert_incircle(basel_sym->vert,
+                           basel->vert,
+                           rcand->next->vert,
+                           sym(rcand)->next->next->vert) > 0) {
         if (dbg_level > 0) {
           std::cout << "incircle says to remove rcand\n";
           std::cout << "  rcand" << rcand << "\n";
@@ -1149,8 +1184,7 @@ void dc_tri(CDTArrangement<T> *cdt,
      * if both are valid, choose the appropriate one using the #incircle test. */
     if (!valid_lcand ||
         (valid_rcand &&
-         incircle(lcand->next->vert->co, lcand->vert->co, rcand->vert->co, rcand->next->vert->co) >
-             0)) {
+         vert_incircle(lcand->next->vert, lcand->vert, rcand->vert, rcand->next->vert) > 0)) {
       if (dbg_level > 0) {
         std::cout << "connecting rcand\n";
         std::cout << "  se1=basel_sym" << basel_sym << "\n";
@@ -1265,7 +1299,7 @@ template<typename T> static void re_delaunay_triangulate(CDTArrangement<T> *cdt,
   SymEdge<T> *cse = first;
   for (SymEdge<T> *ss = first->next; ss != se; ss = ss->next) {
     CDTVert<T> *v = ss->vert;
-    if (incircle(a->co, b->co, c->co, v->co) > 0) {
+    if (vert_incircle(a, b, c, v) > 0) {
       c = v;
       cse = ss;
     }
@@ -1290,7 +1324,7 @@ template<typename T> static void re_delaunay_triangulate(CDTArrangement<T> *cdt,
 
 template<typename T> inline int tri_orient(const SymEdge<T> *t)
 {
-  return orient2d(t->vert->co, t->next->vert->co, t->next->next->vert->co);
+  return vert_orient2d(t->vert, t->next->vert, t->next->next->vert);
 }
 
 /**
@@ -1537,14 +1571,14 @@ bool get_next_crossing_from_vert(CDT_state<T> *cdt_state,
     }
     CDTVert<T> *va = t->next->vert;
     CDTVert<T> *vb = t->next->next->vert;
-    int orient1 = orient2d(t->vert->co, va->co, v2->co);
+    int orient1 = vert_orient2d(t->vert, va, v2);
     if (orient1 == 0 && in_line<T>(vcur->co, va->co, v2->co)) {
       fill_crossdata_for_through_vert(va, t, cd, cd_next);
       ok = true;
       break;
     }
     if (t->face != cdt_state->cdt.outer_face) {
-      int orient2 = orient2d(vcur->co, vb->co, v2->co);
+      int orient2 = vert_orient2d(vcur, vb, v2);
       /* Don't handle orient2 == 0 case here: next rotation will get it. */
       if (orient1 > 0 && orient2 < 0) {
         /* Segment intersection. */
@@ -22,6 +22,7 @@
 
 #include "BLI_kdtree_impl.h"
 #include "BLI_math.h"
+#include "BLI_task.h"
 #include "BLI_strict_flags.h"
 #include "BLI_utildefines.h"
 
@@ -64,6 +65,12 @@ struct KDTree {
  */
 #define KD_NODE_ROOT_IS_INIT ((uint)-2)
 
+/* Sub-trees with more nodes than this are balanced in their own task. */
+#define KD_BALANCE_TASK_THRESHOLD 8192
+/* Number of queries handled by a single task of the batched queries. */
+#define KD_BATCH_CHUNK_SIZE 256
+#define KD_BATCH_THREAD_THRESHOLD 1024
+
 /* -------------------------------------------------------------------- */
 /** \name Local Math API
  * \{ */
@@ -145,7 +152,29 @@ void BLI_kdtree_nd_(insert)(KDTree *tree, int index, const float co[KD_DIMS])
 #endif
 }
 
-static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
+typedef struct KDBalanceTask {
+  KDTreeNode *nodes;
+  uint nodes_len;
+  uint axis;
+  uint ofs;
+} KDBalanceTask;
+
+static void kdtree_balance_task(TaskPool *__restrict pool, void *taskdata);
+
+/**
+ * The root of a balanced range is always its median,
+ * so parents can link to sub-trees that are still being balanced by other tasks.
+ */
+static uint kdtree_balance_root(const uint nodes_len, const uint ofs)
+{
+  return (nodes_len == 0) ? KD_NODE_UNSET : (nodes_len / 2) + ofs;
+}
+
+static void kdtree_balance_subtree(
+    TaskPool *pool, KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs);
+
+static uint kdtree_balance(
+    TaskPool *pool, KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
 {
   KDTreeNode *node;
   float co;
@@ -194,13 +223,41 @@ static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const u
   node = &nodes[median];
   node->d = axis;
   axis = (axis + 1) % KD_DIMS;
-  node->left = kdtree_balance(nodes, median, axis, ofs);
-  node->right = kdtree_balance(
-      nodes + median + 1, (nodes_len - (median + 1)), axis, (median + 1) + ofs);
+  node->left = kdtree_balance_root(median, ofs);
+  node->right = kdtree_balance_root(nodes_len - (median + 1), (median + 1) + ofs);
+  kdtree_balance_subtree(pool, nodes, median, axis, ofs);
+  kdtree_balance_subtree(
+      pool, nodes + median + 1, (nodes_len - (median + 1)), axis, (median + 1) + ofs);
 
   return median + ofs;
 }
 
+static void kdtree_balance_subtree(
+    TaskPool *pool, KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
+{
+  if (pool && nodes_len > KD_BALANCE_TASK_THRESHOLD) {
+    KDBalanceTask *task = MEM_mallocN(sizeof(*task), __func__);
+    task->nodes = nodes;
+    task->nodes_len = nodes_len;
+    task->axis = axis;
+    task->ofs = ofs;
+    BLI_task_pool_push(pool, kdtree_balance_task, task, true, NULL);
+  }
+  else {
+    kdtree_balance(pool, nodes, nodes_len, axis, ofs);
+  }
+}
+
+static void kdtree_balance_task(TaskPool *__restrict pool, void *taskdata)
+{
+  const KDBalanceTask *task = taskdata;
+  kdtree_balance(pool, task->nodes, task->nodes_len, task->axis, task->ofs);
+}
+
+/**
+ * Large trees are balanced in parallel, the left and right sub-trees of a node are independent
+ * once the nodes are partitioned around the median.
+ */
 void BLI_kdtree_nd_(balance)(KDTree *tree)
 {
   if (tree->root != KD_NODE_ROOT_IS_INIT) {
@@ -210,7 +267,15 @@ void BLI_kdtree_nd_(balance)(KDTree *tree)
     }
   }
 
-  tree->root = kdtree_balance(tree->nodes, tree->nodes_len, 0, 0);
+  if (tree->nodes_len > KD_BALANCE_TASK_THRESHOLD) {
+    TaskPool *pool = BLI_task_pool_create(NULL, TASK_PRIORITY_HIGH);
+    tree->root = kdtree_balance(pool, tree->nodes, tree->nodes_len, 0, 0);
+    BLI_task_pool_work_and_wait(pool);
+    BLI_task_pool_free(pool);
+  }
+  else {
+    tree->root = kdtree_balance(NULL, tree->nodes, tree->nodes_len, 0, 0);
+  }
 
 #ifdef DEBUG
   tree->is_balanced = true;
@@ -806,6 +871,267 @@ finally:
   }
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Batched Queries
+ *
+ * Queries for many coordinates at once, run in parallel.
+ * Results are written into flat buffers provided by the caller, there are no allocations
+ * per query (only for very deep trees that overflow the traversal stack).
+ * \{ */
+
+typedef struct KDRangeSearchBatchData {
+  const KDTree *tree;
+  const float (*co)[KD_DIMS];
+  uint co_len;
+  float range;
+  uint *offsets;
+  int *neighbors;
+  float *dist_sq;
+} KDRangeSearchBatchData;
+
+typedef struct KDFindNearestNBatchData {
+  const KDTree *tree;
+  const float (*co)[KD_DIMS];
+  uint co_len;
+  KDTreeNearest *nearest;
+  uint nearest_len_capacity;
+  int *nearest_len;
+} KDFindNearestNBatchData;
+
+/**
+ * Range search writing the indices (and optionally squared distances) of the points found
+ * into \a r_neighbors, only counting them when \a r_neighbors is NULL.
+ */
+static uint kdtree_range_search_flat(const KDTree *tree,
+                                     const float co[KD_DIMS],
+                                     const float range,
+                                     int *r_neighbors,
+                                     float *r_dist_sq)
+{
+  const KDTreeNode *nodes = tree->nodes;
+  uint *stack, stack_default[KD_STACK_INIT];
+  const float range_sq = range * range;
+  uint stack_len_capacity, cur = 0;
+  uint found = 0;
+
+  if (UNLIKELY(tree->root == KD_NODE_UNSET)) {
+    return 0;
+  }
+
+  stack = stack_default;
+  stack_len_capacity = ARRAY_SIZE(stack_default);
+
+  stack[cur++] = tree->root;
+
+  while (cur--) {
+    const KDTreeNode *node = &nodes[stack[cur]];
+
+    if (co[node->d] + range < node->co[node->d]) {
+      if (node->left != KD_NODE_UNSET) {
+        stack[cur++] = node->left;
+      }
+    }
+    else if (co[node->d] - range > node->co[node->d]) {
+      if (node->right != KD_NODE_UNSET) {
+        stack[cur++] = node->right;
+      }
+    }
+    else {
+      const float dist_sq = len_squared_vnvn(node->co, co);
+      if (dist_sq <= range_sq) {
+        if (r_neighbors) {
+          r_neighbors[found] = node->index;
+          if (r_dist_sq) {
+            r_dist_sq[found] = dist_sq;
+          }
+        }
+        found++;
+      }
+
+      if (node->left != KD_NODE_UNSET) {
+        stack[cur++] = node->left;
+      }
+      if (node->right != KD_NODE_UNSET) {
+        stack[cur++] = node->right;
+      }
+    }
+
+    if (UNLIKELY(cur + KD_DIMS > stack_len_capacity)) {
+      stack = realloc_nodes(stack, &stack_len_capacity, stack_default != stack);
+    }
+  }
+
+  if (stack != stack_default) {
+    MEM_freeN(stack);
+  }
+
+  return found;
+}
+
+static void kdtree_batch_parallel_range(const uint co_len,
+                                        void *userdata,
+                                        TaskParallelRangeFunc func)
+{
+  const int chunks_len = (int)((co_len + KD_BATCH_CHUNK_SIZE - 1) / KD_BATCH_CHUNK_SIZE);
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (co_len > KD_BATCH_THREAD_THRESHOLD);
+  BLI_task_parallel_range(0, chunks_len, userdata, func, &settings);
+}
+
+static void kdtree_range_search_batch_count_cb(void *__restrict userdata,
+                                               const int chunk,
+                                               const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const KDRangeSearchBatchData *data = userdata;
+  const uint start = (uint)chunk * KD_BATCH_CHUNK_SIZE;
+  const uint end = MIN2(start + KD_BATCH_CHUNK_SIZE, data->co_len);
+
+  for (uint i = start; i < end; i++) {
+    data->offsets[i] = kdtree_range_search_flat(data->tree, data->co[i], data->range, NULL, NULL);
+  }
+}
+
+static void kdtree_range_search_batch_fill_cb(void *__restrict userdata,
+                                              const int chunk,
+                                              const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const KDRangeSearchBatchData *data = userdata;
+  const uint start = (uint)chunk * KD_BATCH_CHUNK_SIZE;
+  const uint end = MIN2(start + KD_BATCH_CHUNK_SIZE, data->co_len);
+
+  for (uint i = start; i < end; i++) {
+    const uint offset = data->offsets[i];
+    const uint found = kdtree_range_search_flat(data->tree,
+                                                data->co[i],
+                                                data->range,
+                                                data->neighbors + offset,
+                                                data->dist_sq ? data->dist_sq + offset : NULL);
+    BLI_assert(found == data->offsets[i + 1] - offset);
+    UNUSED_VARS_NDEBUG(found);
+  }
+}
+
+/**
+ * First step of a batched #BLI_kdtree_3d_range_search,
+ * counts the points found for each of the \a co_len coordinates.
+ *
+ * \param r_offsets: An array of \a co_len + 1 offsets, filled with the start of the neighbors
+ * of each coordinate in the flat buffers passed to #BLI_kdtree_3d_range_search_batch (CSR style).
+ * \returns The total number of neighbors, the length of the flat buffers.
+ */
+uint BLI_kdtree_nd_(range_search_batch_count)(const KDTree *tree,
+                                              const float (*co)[KD_DIMS],
+                                              const uint co_len,
+                                              const float range,
+                                              uint *r_offsets)
+{
+#ifdef DEBUG
+  BLI_assert(tree->is_balanced == true);
+#endif
+
+  KDRangeSearchBatchData data = {
+      .tree = tree,
+      .co = co,
+      .co_len = co_len,
+      .range = range,
+      .offsets = r_offsets,
+  };
+  kdtree_batch_parallel_range(co_len, &data, kdtree_range_search_batch_count_cb);
+
+  /* Counts to offsets. */
+  uint total = 0;
+  for (uint i = 0; i < co_len; i++) {
+    const uint count = r_offsets[i];
+    r_offsets[i] = total;
+    total += count;
+  }
+  r_offsets[co_len] = total;
+  return total;
+}
+
+/**
+ * Second step of a batched #BLI_kdtree_3d_range_search,
+ * the neighbors of coordinate `i` are written to `r_neighbors[offsets[i]..offsets[i + 1]]`.
+ *
+ * \param offsets: Offsets computed by #BLI_kdtree_3d_range_search_batch_count
+ * (with the same coordinates and range).
+ * \param r_neighbors: The point indices found, unlike #BLI_kdtree_3d_range_search
+ * they aren't sorted by distance.
+ * \param r_dist_sq: Optional squared distances of the points found.
+ */
+void BLI_kdtree_nd_(range_search_batch)(const KDTree *tree,
+                                        const float (*co)[KD_DIMS],
+                                        const uint co_len,
+                                        const float range,
+                                        const uint *offsets,
+                                        int *r_neighbors,
+                                        float *r_dist_sq)
+{
+#ifdef DEBUG
+  BLI_assert(tree->is_balanced == true);
+#endif
+
+  KDRangeSearchBatchData data = {
+      .tree = tree,
+      .co = co,
+      .co_len = co_len,
+      .range = range,
+      .offsets = (uint *)offsets,
+      .neighbors = r_neighbors,
+      .dist_sq = r_dist_sq,
+  };
+  kdtree_batch_parallel_range(co_len, &data, kdtree_range_search_batch_fill_cb);
+}
+
+static void kdtree_find_nearest_n_batch_cb(void *__restrict userdata,
+                                           const int chunk,
+                                           const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const KDFindNearestNBatchData *data = userdata;
+  const uint start = (uint)chunk * KD_BATCH_CHUNK_SIZE;
+  const uint end = MIN2(start + KD_BATCH_CHUNK_SIZE, data->co_len);
+
+  for (uint i = start; i < end; i++) {
+    const int found = BLI_kdtree_nd_(find_nearest_n)(data->tree,
+                                                     data->co[i],
+                                                     data->nearest +
+                                                         i * data->nearest_len_capacity,
+                                                     data->nearest_len_capacity);
+    if (data->nearest_len) {
+      data->nearest_len[i] = found;
+    }
+  }
+}
+
+/**
+ * Batched #BLI_kdtree_3d_find_nearest_n.
+ *
+ * \param r_nearest: An array of \a co_len * \a nearest_len_capacity nearest,
+ * the results for coordinate `i` start at `i * nearest_len_capacity`.
+ * \param r_nearest_len: Optional array of \a co_len, the number of points found per coordinate
+ * (only less than \a nearest_len_capacity when the tree has fewer points).
+ */
+void BLI_kdtree_nd_(find_nearest_n_batch)(const KDTree *tree,
+                                          const float (*co)[KD_DIMS],
+                                          const uint co_len,
+                                          KDTreeNearest *r_nearest,
+                                          const uint nearest_len_capacity,
+                                          int *r_nearest_len)
+{
+  KDFindNearestNBatchData data = {
+      .tree = tree,
+      .co = co,
+      .co_len = co_len,
+      .nearest = r_nearest,
+      .nearest_len_capacity = nearest_len_capacity,
+      .nearest_len = r_nearest_len,
+  };
+  kdtree_batch_parallel_range(co_len, &data, kdtree_find_nearest_n_batch_cb);
+}
+
+/** \} */
+
 /**
  * Use when we want to loop over nodes ordered by index.
  * Requires indices to be aligned with nodes.
@@ -0,0 +1,263 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup bli
+ */
+
+#include <cmath>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+#include "BLI_math_batch.hh"
+#include "BLI_system.h"
+
+#include "math_batch_intern.hh"
+
+namespace blender::math {
+
+/* -------------------------------------------------------------------- */
+/** \name Scalar Kernels
+ * \{ */
+
+static void normalize_scalar(const float (*src)[3], float (*dst)[3], const int64_t size)
+{
+  for (int64_t i = 0; i < size; i++) {
+    const float x = src[i][0], y = src[i][1], z = src[i][2];
+    const float length_squared = x * x + y * y + z * z;
+    /* Same threshold as #normalize_v3. */
+    const float factor = (length_squared > 1.0e-35f) ? 1.0f / sqrtf(length_squared) : 0.0f;
+    dst[i][0] = x * factor;
+    dst[i][1] = y * factor;
+    dst[i][2] = z * factor;
+  }
+}
+
+#ifndef __SSE2__
+
+static void transform_points_scalar(const float (*m)[4],
+                                    const float (*src)[3],
+                                    float (*dst)[3],
+                                    const int64_t size)
+{
+  for (int64_t i = 0; i < size; i++) {
+    const float x = src[i][0], y = src[i][1], z = src[i][2];
+    dst[i][0] = m[0][0] * x + m[1][0] * y + m[2][0] * z + m[3][0];
+    dst[i][1] = m[0][1] * x + m[1][1] * y + m[2][1] * z + m[3][1];
+    dst[i][2] = m[0][2] * x + m[1][2] * y + m[2][2] * z + m[3][2];
+  }
+}
+
+static void transform_points_multi_scalar(const float (*matrices)[4][4],
+                                          const float (*src)[3],
+                                          float (*dst)[3],
+                                          const int64_t size)
+{
+  for (int64_t i = 0; i < size; i++) {
+    transform_points_scalar(matrices[i], src + i, dst + i, 1);
+  }
+}
+
+static void transform_directions_scalar(const float (*m)[4],
+                                        const float (*src)[3],
+                                        float (*dst)[3],
+                                        const int64_t size)
+{
+  for (int64_t i = 0; i < size; i++) {
+    const float x = src[i][0], y = src[i][1], z = src[i][2];
+    dst[i][0] = m[0][0] * x + m[1][0] * y + m[2][0] * z;
+    dst[i][1] = m[0][1] * x + m[1][1] * y + m[2][1] * z;
+    dst[i][2] = m[0][2] * x + m[1][2] * y + m[2][2] * z;
+  }
+}
+
+static const MathBatchKernels math_batch_kernels_scalar = {
+    transform_points_scalar,
+    transform_points_multi_scalar,
+    transform_directions_scalar,
+    normalize_scalar,
+};
+
+#endif /* !__SSE2__ */
+
+/** \} */
+
+#ifdef __SSE2__
+
+/* -------------------------------------------------------------------- */
+/** \name SSE2 Kernels
+ *
+ * Vectors are transformed one at a time, using one SIMD lane per component.
+ * \{ */
+
+BLI_INLINE __m128 transform_sse2(const __m128 c0,
+                                 const __m128 c1,
+                                 const __m128 c2,
+                                 const float v[3])
+{
+  return _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(v[0])), _mm_mul_ps(c1, _mm_set1_ps(v[1]))),
+      _mm_mul_ps(c2, _mm_set1_ps(v[2])));
+}
+
+/** Only write three floats, the next vector might not have been read yet. */
+BLI_INLINE void store_float3_sse2(float dst[3], const __m128 v)
+{
+  _mm_storel_pi(reinterpret_cast<__m64 *>(dst), v);
+  _mm_store_ss(dst + 2, _mm_movehl_ps(v, v));
+}
+
+static void transform_points_sse2(const float (*m)[4],
+                                  const float (*src)[3],
+                                  float (*dst)[3],
+                                  const int64_t size)
+{
+  const __m128 c0 = _mm_loadu_ps(m[0]);
+  const __m128 c1 = _mm_loadu_ps(m[1]);
+  const __m128 c2 = _mm_loadu_ps(m[2]);
+  const __m128 c3 = _mm_loadu_ps(m[3]);
+  for (int64_t i = 0; i < size; i++) {
+    store_float3_sse2(dst[i], _mm_add_ps(transform_sse2(c0, c1, c2, src[i]), c3));
+  }
+}
+
+static void transform_points_multi_sse2(const float (*matrices)[4][4],
+                                        const float (*src)[3],
+                                        float (*dst)[3],
+                                        const int64_t size)
+{
+  for (int64_t i = 0; i < size; i++) {
+    const float(*m)[4] = matrices[i];
+    const __m128 r = transform_sse2(
+        _mm_loadu_ps(m[0]), _mm_loadu_ps(m[1]), _mm_loadu_ps(m[2]), src[i]);
+    store_float3_sse2(dst[i], _mm_add_ps(r, _mm_loadu_ps(m[3])));
+  }
+}
+
+static void transform_directions_sse2(const float (*m)[4],
+                                      const float (*src)[3],
+                                      float (*dst)[3],
+                                      const int64_t size)
+{
+  const __m128 c0 = _mm_loadu_ps(m[0]);
+  const __m128 c1 = _mm_loadu_ps(m[1]);
+  const __m128 c2 = _mm_loadu_ps(m[2]);
+  for (int64_t i = 0; i < size; i++) {
+    store_float3_sse2(dst[i], transform_sse2(c0, c1, c2, src[i]));
+  }
+}
+
+/* Normalizing is left to the compiler, one vector per register would not be faster. */
+static const MathBatchKernels math_batch_kernels_sse2 = {
+    transform_points_sse2,
+    transform_points_multi_sse2,
+    transform_directions_sse2,
+    normalize_scalar,
+};
+
+/** \} */
+
+#endif /* __SSE2__ */
+
+/* -------------------------------------------------------------------- */
+/** \name Public API
+ * \{ */
+
+static const MathBatchKernels &kernels_choose()
+{
+#ifdef WITH_MATH_BATCH_AVX2
+  if (BLI_cpu_support_avx2()) {
+    return math_batch_kernels_avx2;
+  }
+#endif
+#ifdef __SSE2__
+  return math_batch_kernels_sse2;
+#else
+  return math_batch_kernels_scalar;
+#endif
+}
+
+static const MathBatchKernels &kernels_get()
+{
+  static const MathBatchKernels &kernels = kernels_choose();
+  return kernels;
+}
+
+static const float (*as_float3_ptr(Span<float3> span))[3]
+{
+  return reinterpret_cast<const float(*)[3]>(span.data());
+}
+
+static float (*as_float3_ptr(MutableSpan<float3> span))[3]
+{
+  return reinterpret_cast<float(*)[3]>(span.data());
+}
+
+void transform_points(const float4x4 &matrix, Span<float3> src, MutableSpan<float3> dst)
+{
+  BLI_assert(src.size() == dst.size());
+  kernels_get().transform_points(
+      matrix.values, as_float3_ptr(src), as_float3_ptr(dst), src.size());
+}
+
+void transform_points(const float4x4 &matrix, MutableSpan<float3> points)
+{
+  transform_points(matrix, points.as_span(), points);
+}
+
+void transform_points(Span<float4x4> matrices, Span<float3> src, MutableSpan<float3> dst)
+{
+  BLI_assert(matrices.size() == src.size());
+  BLI_assert(src.size() == dst.size());
+  kernels_get().transform_points_multi(reinterpret_cast<const float(*)[4][4]>(matrices.data()),
+                                       as_float3_ptr(src),
+                                       as_float3_ptr(dst),
+                                       src.size());
+}
+
+void transform_points(Span<float4x4> matrices, MutableSpan<float3> points)
+{
+  transform_points(matrices, points.as_span(), points);
+}
+
+void transform_directions(const float4x4 &matrix, Span<float3> src, MutableSpan<float3> dst)
+{
+  BLI_assert(src.size() == dst.size());
+  kernels_get().transform_directions(
+      matrix.values, as_float3_ptr(src), as_float3_ptr(dst), src.size());
+}
+
+void transform_directions(const float4x4 &matrix, MutableSpan<float3> directions)
+{
+  transform_directions(matrix, directions.as_span(), directions);
+}
+
+void normalize(Span<float3> src, MutableSpan<float3> dst)
+{
+  BLI_assert(src.size() == dst.size());
+  kernels_get().normalize(as_float3_ptr(src), as_float3_ptr(dst), src.size());
+}
+
+void normalize(MutableSpan<float3> vectors)
+{
+  normalize(vectors.as_span(), vectors);
+}
+
+/** \} */
+
+}  // namespace blender::math
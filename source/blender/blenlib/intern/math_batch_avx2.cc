@@ -0,0 +1,210 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup bli
+ *
+ * AVX2 kernels for BLI_math_batch.hh. This file is compiled with AVX2 and FMA enabled, the
+ * kernels are only used when #BLI_cpu_support_avx2 returns true.
+ */
+
+#include "BLI_compiler_compat.h"
+
+#include "math_batch_intern.hh"
+
+#ifdef __AVX2__
+
+#  include <immintrin.h>
+
+namespace blender::math {
+
+/* Three registers hold eight interleaved `float3`. In the deinterleaved registers, the lanes
+ * which come from the same source register form a repeating pattern with a period of three,
+ * so converting between the layouts takes two blends and a permute per register. */
+static const int blend_mask_0 = 0x49; /* Lanes 0, 3, 6. */
+static const int blend_mask_1 = 0x92; /* Lanes 1, 4, 7. */
+static const int blend_mask_2 = 0x24; /* Lanes 2, 5. */
+
+BLI_INLINE void load_float3_x8(const float (*src)[3], __m256 *r_x, __m256 *r_y, __m256 *r_z)
+{
+  const float *ptr = src[0];
+  const __m256 a = _mm256_loadu_ps(ptr);      /* x0 y0 z0 x1 y1 z1 x2 y2 */
+  const __m256 b = _mm256_loadu_ps(ptr + 8);  /* z2 x3 y3 z3 x4 y4 z4 x5 */
+  const __m256 c = _mm256_loadu_ps(ptr + 16); /* y5 z5 x6 y6 z6 x7 y7 z7 */
+
+  const __m256 x = _mm256_blend_ps(_mm256_blend_ps(a, b, blend_mask_1), c, blend_mask_2);
+  const __m256 y = _mm256_blend_ps(_mm256_blend_ps(a, b, blend_mask_2), c, blend_mask_0);
+  const __m256 z = _mm256_blend_ps(_mm256_blend_ps(a, b, blend_mask_0), c, blend_mask_1);
+
+  *r_x = _mm256_permutevar8x32_ps(x, _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5));
+  *r_y = _mm256_permutevar8x32_ps(y, _mm256_setr_epi32(1, 4, 7, 2, 5, 0, 3, 6));
+  *r_z = _mm256_permutevar8x32_ps(z, _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7));
+}
+
+BLI_INLINE void store_float3_x8(float (*dst)[3], const __m256 x, const __m256 y, const __m256 z)
+{
+  const __m256 tx = _mm256_permutevar8x32_ps(x, _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5));
+  const __m256 ty = _mm256_permutevar8x32_ps(y, _mm256_setr_epi32(5, 0, 3, 6, 1, 4, 7, 2));
+  const __m256 tz = _mm256_permutevar8x32_ps(z, _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7));
+
+  float *ptr = dst[0];
+  _mm256_storeu_ps(ptr, _mm256_blend_ps(_mm256_blend_ps(tx, ty, blend_mask_1), tz, blend_mask_2));
+  _mm256_storeu_ps(ptr + 8,
+                   _mm256_blend_ps(_mm256_blend_ps(tx, ty, blend_mask_2), tz, blend_mask_0));
+  _mm256_storeu_ps(ptr + 16,
+                   _mm256_blend_ps(_mm256_blend_ps(tx, ty, blend_mask_0), tz, blend_mask_1));
+}
+
+/** Only write three floats, the next vector might not have been read yet. */
+BLI_INLINE void store_float3(float dst[3], const __m128 v)
+{
+  _mm_storel_pi(reinterpret_cast<__m64 *>(dst), v);
+  _mm_store_ss(dst + 2, _mm_movehl_ps(v, v));
+}
+
+/** One vector per register, for the remaining vectors. */
+BLI_INLINE __m128 transform_float3(const float (*m)[4], const float v[3], const bool translate)
+{
+  const __m128 r = _mm_fmadd_ps(_mm_loadu_ps(m[2]),
+                                _mm_set1_ps(v[2]),
+                                translate ? _mm_loadu_ps(m[3]) : _mm_setzero_ps());
+  return _mm_fmadd_ps(_mm_loadu_ps(m[0]),
+                      _mm_set1_ps(v[0]),
+                      _mm_fmadd_ps(_mm_loadu_ps(m[1]), _mm_set1_ps(v[1]), r));
+}
+
+BLI_INLINE void transform_x8(const float (*m)[4],
+                             const float (*src)[3],
+                             float (*dst)[3],
+                             const int64_t size,
+                             const bool translate)
+{
+  const __m256 m00 = _mm256_broadcast_ss(&m[0][0]), m01 = _mm256_broadcast_ss(&m[0][1]),
+               m02 = _mm256_broadcast_ss(&m[0][2]);
+  const __m256 m10 = _mm256_broadcast_ss(&m[1][0]), m11 = _mm256_broadcast_ss(&m[1][1]),
+               m12 = _mm256_broadcast_ss(&m[1][2]);
+  const __m256 m20 = _mm256_broadcast_ss(&m[2][0]), m21 = _mm256_broadcast_ss(&m[2][1]),
+               m22 = _mm256_broadcast_ss(&m[2][2]);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 m30 = translate ? _mm256_broadcast_ss(&m[3][0]) : zero;
+  const __m256 m31 = translate ? _mm256_broadcast_ss(&m[3][1]) : zero;
+  const __m256 m32 = translate ? _mm256_broadcast_ss(&m[3][2]) : zero;
+
+  int64_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m256 x, y, z;
+    load_float3_x8(src + i, &x, &y, &z);
+    const __m256 rx = _mm256_fmadd_ps(
+        m00, x, _mm256_fmadd_ps(m10, y, _mm256_fmadd_ps(m20, z, m30)));
+    const __m256 ry = _mm256_fmadd_ps(
+        m01, x, _mm256_fmadd_ps(m11, y, _mm256_fmadd_ps(m21, z, m31)));
+    const __m256 rz = _mm256_fmadd_ps(
+        m02, x, _mm256_fmadd_ps(m12, y, _mm256_fmadd_ps(m22, z, m32)));
+    store_float3_x8(dst + i, rx, ry, rz);
+  }
+  for (; i < size; i++) {
+    store_float3(dst[i], transform_float3(m, src[i], translate));
+  }
+}
+
+static void transform_points_avx2(const float (*m)[4],
+                                  const float (*src)[3],
+                                  float (*dst)[3],
+                                  const int64_t size)
+{
+  transform_x8(m, src, dst, size, true);
+}
+
+static void transform_directions_avx2(const float (*m)[4],
+                                      const float (*src)[3],
+                                      float (*dst)[3],
+                                      const int64_t size)
+{
+  transform_x8(m, src, dst, size, false);
+}
+
+BLI_INLINE __m256 load_float4_x2(const float a[4], const float b[4])
+{
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(a)), _mm_loadu_ps(b), 1);
+}
+
+BLI_INLINE __m256 broadcast_float_x2(const float a, const float b)
+{
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(a)), _mm_set1_ps(b), 1);
+}
+
+/** Two vectors per register, every vector has a different matrix. */
+static void transform_points_multi_avx2(const float (*matrices)[4][4],
+                                        const float (*src)[3],
+                                        float (*dst)[3],
+                                        const int64_t size)
+{
+  int64_t i = 0;
+  for (; i + 2 <= size; i += 2) {
+    const float(*a)[4] = matrices[i];
+    const float(*b)[4] = matrices[i + 1];
+    const float *va = src[i];
+    const float *vb = src[i + 1];
+    __m256 r = _mm256_fmadd_ps(
+        load_float4_x2(a[2], b[2]), broadcast_float_x2(va[2], vb[2]), load_float4_x2(a[3], b[3]));
+    r = _mm256_fmadd_ps(load_float4_x2(a[1], b[1]), broadcast_float_x2(va[1], vb[1]), r);
+    r = _mm256_fmadd_ps(load_float4_x2(a[0], b[0]), broadcast_float_x2(va[0], vb[0]), r);
+    store_float3(dst[i], _mm256_castps256_ps128(r));
+    store_float3(dst[i + 1], _mm256_extractf128_ps(r, 1));
+  }
+  for (; i < size; i++) {
+    store_float3(dst[i], transform_float3(matrices[i], src[i], true));
+  }
+}
+
+static void normalize_avx2(const float (*src)[3], float (*dst)[3], const int64_t size)
+{
+  /* Same threshold as #normalize_v3. */
+  const __m256 threshold = _mm256_set1_ps(1.0e-35f);
+  const __m256 one = _mm256_set1_ps(1.0f);
+
+  int64_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m256 x, y, z;
+    load_float3_x8(src + i, &x, &y, &z);
+    const __m256 length_squared = _mm256_fmadd_ps(
+        x, x, _mm256_fmadd_ps(y, y, _mm256_mul_ps(z, z)));
+    const __m256 is_valid = _mm256_cmp_ps(length_squared, threshold, _CMP_GT_OQ);
+    const __m256 factor = _mm256_and_ps(_mm256_div_ps(one, _mm256_sqrt_ps(length_squared)),
+                                        is_valid);
+    store_float3_x8(
+        dst + i, _mm256_mul_ps(x, factor), _mm256_mul_ps(y, factor), _mm256_mul_ps(z, factor));
+  }
+  for (; i < size; i++) {
+    const __m128 v = _mm_setr_ps(src[i][0], src[i][1], src[i][2], 0.0f);
+    const __m128 length_squared = _mm_dp_ps(v, v, 0x7f);
+    const __m128 is_valid = _mm_cmpgt_ps(length_squared, _mm_set1_ps(1.0e-35f));
+    const __m128 factor = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length_squared)),
+                                     is_valid);
+    store_float3(dst[i], _mm_mul_ps(v, factor));
+  }
+}
+
+const MathBatchKernels math_batch_kernels_avx2 = {
+    transform_points_avx2,
+    transform_points_multi_avx2,
+    transform_directions_avx2,
+    normalize_avx2,
+};
+
+}  // namespace blender::math
+
+#endif /* __AVX2__ */
@@ -0,0 +1,50 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * Kernels behind BLI_math_batch.hh. The AVX2 kernels are in a file that is compiled with AVX2
+ * enabled, so it must not include headers with inline functions that could be shared with other
+ * translation units. That is why the kernels only use plain C types.
+ */
+
+#include "BLI_sys_types.h"
+
+namespace blender::math {
+
+struct MathBatchKernels {
+  void (*transform_points)(const float (*matrix)[4],
+                           const float (*src)[3],
+                           float (*dst)[3],
+                           int64_t size);
+  void (*transform_points_multi)(const float (*matrices)[4][4],
+                                 const float (*src)[3],
+                                 float (*dst)[3],
+                                 int64_t size);
+  void (*transform_directions)(const float (*matrix)[4],
+                               const float (*src)[3],
+                               float (*dst)[3],
+                               int64_t size);
+  void (*normalize)(const float (*src)[3], float (*dst)[3], int64_t size);
+};
+
+/** Only defined when the AVX2 kernels are compiled, see `WITH_MATH_BATCH_AVX2`. */
+extern const MathBatchKernels math_batch_kernels_avx2;
+
+}  // namespace blender::math
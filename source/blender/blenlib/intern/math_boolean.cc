@@ -18,6 +18,9 @@
  * \ingroup bli
  */
 
+#include <cfloat>
+#include <cmath>
+
 #include "BLI_double2.hh"
 #include "BLI_double3.hh"
 #include "BLI_float2.hh"
@@ -2524,6 +2527,69 @@ int insphere(
   return sgn(robust_pred::insphere(a, b, c, d, e));
 }
 
+/**
+ * The index of the double expression of #orient2d_fast and #orient3d_fast,
+ * when each input coordinate has index 1 (is within one rounding of the exact value).
+ * See the paper EXACT GEOMETRIC COMPUTATION USING CASCADING, by Burnikel, Funke, and Seel:
+ *    index(x op y) = 1 + max(index(x), index(y)) for op + or -
+ *    index(x * y)  = 1 + index(x) + index(y)
+ * The absolute error of the expression is then at most `supremum * index * DBL_EPSILON`,
+ * where the supremum is the expression using absolute values of the inputs and only additions.
+ */
+constexpr int index_orient2d = 6;
+constexpr int index_incircle = 15;
+constexpr int index_orient3d = 14;
+
+int filter_orient2d(const double2 &a, const double2 &b, const double2 &c)
+{
+  const double det = robust_pred::orient2dfast(a, b, c);
+  const double acx = std::abs(a[0]) + std::abs(c[0]);
+  const double bcx = std::abs(b[0]) + std::abs(c[0]);
+  const double acy = std::abs(a[1]) + std::abs(c[1]);
+  const double bcy = std::abs(b[1]) + std::abs(c[1]);
+  const double supremum = acx * bcy + acy * bcx;
+  if (std::abs(det) > supremum * index_orient2d * DBL_EPSILON) {
+    return sgn(det);
+  }
+  return 0;
+}
+
+int filter_incircle(const double2 &a, const double2 &b, const double2 &c, const double2 &d)
+{
+  const double det = robust_pred::incirclefast(a, b, c, d);
+  const double adx = std::abs(a[0]) + std::abs(d[0]);
+  const double bdx = std::abs(b[0]) + std::abs(d[0]);
+  const double cdx = std::abs(c[0]) + std::abs(d[0]);
+  const double ady = std::abs(a[1]) + std::abs(d[1]);
+  const double bdy = std::abs(b[1]) + std::abs(d[1]);
+  const double cdy = std::abs(c[1]) + std::abs(d[1]);
+  const double alift = adx * adx + ady * ady;
+  const double blift = bdx * bdx + bdy * bdy;
+  const double clift = cdx * cdx + cdy * cdy;
+  const double supremum = alift * (bdx * cdy + cdx * bdy) + blift * (cdx * ady + adx * cdy) +
+                          clift * (adx * bdy + bdx * ady);
+  if (std::abs(det) > supremum * index_incircle * DBL_EPSILON) {
+    return sgn(det);
+  }
+  return 0;
+}
+
+int filter_orient3d(const double3 &a, const double3 &b, const double3 &c, const double3 &d)
+{
+  const double det = robust_pred::orient3dfast(a, b, c, d);
+  const double3 abs_d = double3::abs(d);
+  const double3 ad = double3::abs(a) + abs_d;
+  const double3 bd = double3::abs(b) + abs_d;
+  const double3 cd = double3::abs(c) + abs_d;
+  const double supremum = ad.x * (bd.y * cd.z + bd.z * cd.y) +
+                          bd.x * (cd.y * ad.z + cd.z * ad.y) +
+                          cd.x * (ad.y * bd.z + ad.z * bd.y);
+  if (std::abs(det) > supremum * index_orient3d * DBL_EPSILON) {
+    return sgn(det);
+  }
+  return 0;
+}
+
 int insphere_fast(
     const double3 &a, const double3 &b, const double3 &c, const double3 &d, const double3 &e)
 {
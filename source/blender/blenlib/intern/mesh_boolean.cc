@@ -37,6 +37,7 @@
 #  include "BLI_set.hh"
 #  include "BLI_span.hh"
 #  include "BLI_stack.hh"
+#  include "BLI_task.h"
 #  include "BLI_vector.hh"
 #  include "BLI_vector_set.hh"
 
@@ -840,9 +841,6 @@ static int sort_tris_class(const Face &tri, const Face &tri0, const Edge e)
   if (dbg_level > 0) {
     std::cout << "classify  e = " << e << "\n";
   }
-  mpq3 a0 = tri0[0]->co_exact;
-  mpq3 a1 = tri0[1]->co_exact;
-  mpq3 a2 = tri0[2]->co_exact;
   bool rev;
   bool rev0;
   const Vert *flapv0 = find_flap_vert(tri0, e, &rev0);
@@ -854,9 +852,12 @@ static int sort_tris_class(const Face &tri, const Face &tri0, const Edge e)
     std::cout << " rev = " << rev << " flapv = " << flapv << "\n";
   }
   BLI_assert(flapv != nullptr && flapv0 != nullptr);
-  const mpq3 flap = flapv->co_exact;
-  /* orient will be positive if flap is below oriented plane of a0,a1,a2. */
-  int orient = orient3d(a0, a1, a2, flap);
+  /* orient will be positive if flap is below oriented plane of tri0.
+   * Only use exact arithmetic when the floating point filter can't decide. */
+  int orient = filter_orient3d(tri0[0]->co, tri0[1]->co, tri0[2]->co, flapv->co);
+  if (orient == 0) {
+    orient = orient3d(tri0[0]->co_exact, tri0[1]->co_exact, tri0[2]->co_exact, flapv->co_exact);
+  }
   int ans;
   if (orient > 0) {
     ans = rev0 ? 4 : 3;
@@ -1019,27 +1020,22 @@ static Array<int> sort_tris_around_edge(const IMesh &tm,
 }
 
 /**
- * Find the Cells around edge e.
+ * Find the Cells around edge e, given the triangles around e as sorted by sort_tris_around_edge.
  * This possibly makes new cells in \a cinfo, and sets up the
  * bipartite graph edges between cells and patches.
  * Will modify \a pinfo and \a cinfo and the patches and cells they contain.
  */
 static void find_cells_from_edge(const IMesh &tm,
-                                 const TriMeshTopology &tmtopo,
                                  PatchesInfo &pinfo,
                                  CellsInfo &cinfo,
-                                 const Edge e)
+                                 const Edge e,
+                                 const Span<int> sorted_tris)
 {
   const int dbg_level = 0;
   if (dbg_level > 0) {
     std::cout << "FIND_CELLS_FROM_EDGE " << e << "\n";
   }
-  const Vector<int> *edge_tris = tmtopo.edge_tris(e);
-  BLI_assert(edge_tris != nullptr);
-  Array<int> sorted_tris = sort_tris_around_edge(
-      tm, tmtopo, e, Span<int>(*edge_tris), (*edge_tris)[0], nullptr);
-
-  int n_edge_tris = edge_tris->size();
+  int n_edge_tris = sorted_tris.size();
   Array<int> edge_patches(n_edge_tris);
   for (int i = 0; i < n_edge_tris; ++i) {
     edge_patches[i] = pinfo.tri_patch(sorted_tris[i]);
@@ -1118,6 +1114,28 @@ static void find_cells_from_edge(const IMesh &tm,
   }
 }
 
+/**
+ * Data needed for parallelization of sorting the triangles around the patch edges.
+ */
+struct SortTrisAroundEdgesData {
+  const IMesh &tm;
+  const TriMeshTopology &tmtopo;
+  Span<Edge> edges;
+  MutableSpan<Array<int>> r_sorted_tris;
+};
+
+static void sort_tris_around_edge_range_func(void *__restrict userdata,
+                                             const int i,
+                                             const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  SortTrisAroundEdgesData *data = static_cast<SortTrisAroundEdgesData *>(userdata);
+  const Edge e = data->edges[i];
+  const Vector<int> *edge_tris = data->tmtopo.edge_tris(e);
+  BLI_assert(edge_tris != nullptr);
+  data->r_sorted_tris[i] = sort_tris_around_edge(
+      data->tm, data->tmtopo, e, Span<int>(*edge_tris), (*edge_tris)[0], nullptr);
+}
+
 /**
  * Find the partition of 3-space into Cells.
  * This assigns the cell_above and cell_below for each Patch.
@@ -1129,8 +1147,9 @@ static CellsInfo find_cells(const IMesh &tm, const TriMeshTopology &tmtopo, Patc
     std::cout << "\nFIND_CELLS\n";
   }
   CellsInfo cinfo;
-  /* For each unique edge shared between patch pairs, process it. */
+  /* Find the unique edges shared between patch pairs. */
   Set<Edge> processed_edges;
+  Vector<Edge> patch_edges;
   int np = pinfo.tot_patch();
   for (int p = 0; p < np; ++p) {
     for (int q = p + 1; q < np; ++q) {
@@ -1138,11 +1157,23 @@ static CellsInfo find_cells(const IMesh &tm, const TriMeshTopology &tmtopo, Patc
       if (e.v0() != nullptr) {
         if (!processed_edges.contains(e)) {
           processed_edges.add_new(e);
-          find_cells_from_edge(tm, tmtopo, pinfo, cinfo, e);
+          patch_edges.append(e);
         }
       }
     }
   }
+  /* Sorting the triangles around each edge is independent (and may need exact arithmetic),
+   * so do that in parallel. Processing the edges modifies the cells, so that stays in order. */
+  Array<Array<int>> sorted_tris(patch_edges.size());
+  SortTrisAroundEdgesData sort_data = {tm, tmtopo, patch_edges, sorted_tris};
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 64;
+  BLI_task_parallel_range(
+      0, patch_edges.size(), &sort_data, sort_tris_around_edge_range_func, &settings);
+  for (int i : patch_edges.index_range()) {
+    find_cells_from_edge(tm, pinfo, cinfo, patch_edges[i], sorted_tris[i]);
+  }
   /* Some patches may have no cells at this point. These are either:
    * (a) a closed manifold patch only incident on itself (sphere, torus, klein bottle, etc.).
    * (b) an open manifold patch only incident on itself (has non-manifold boundaries).
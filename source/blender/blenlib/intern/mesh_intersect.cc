@@ -29,6 +29,7 @@
 #  include "BLI_array.hh"
 #  include "BLI_assert.h"
 #  include "BLI_delaunay_2d.h"
+#  include "BLI_double2.hh"
 #  include "BLI_double3.hh"
 #  include "BLI_float3.hh"
 #  include "BLI_hash.hh"
@@ -1106,6 +1107,43 @@ static mpq2 project_3d_to_2d(const mpq3 &p3d, int proj_axis)
   return p2d;
 }
 
+/**
+ * Like the #mpq3 version, used to get the approximations of the projected points,
+ * projecting doesn't add any error.
+ */
+static double2 project_3d_to_2d(const double3 &p3d, int proj_axis)
+{
+  switch (proj_axis) {
+    case (0):
+      return double2(p3d[1], p3d[2]);
+    case (1):
+      return double2(p3d[0], p3d[2]);
+    case (2):
+      return double2(p3d[0], p3d[1]);
+    default:
+      BLI_assert(false);
+  }
+  return double2(0.0, 0.0);
+}
+
+/**
+ * #orient2d of exact points \a a, \a b, \a c, only using exact arithmetic when the
+ * floating point filter on their approximations \a da, \a db, \a dc can't decide.
+ */
+static int filtered_orient2d(const double2 &da,
+                             const double2 &db,
+                             const double2 &dc,
+                             const mpq2 &a,
+                             const mpq2 &b,
+                             const mpq2 &c)
+{
+  const int orient = filter_orient2d(da, db, dc);
+  if (orient != 0) {
+    return orient;
+  }
+  return orient2d(a, b, c);
+}
+
 /**
    Is a point in the interior of a 2d triangle or on one of its
  * edges but not either endpoint of the edge?
@@ -1214,8 +1252,13 @@ static bool same_triangles(const mpq2 *a[3], const mpq2 *b[3])
  * vertices or a shared edge? This is true if any point of one triangle is non-trivially inside the
  * other. NO: that isn't quite sufficient: there is also the case where the verts are all mutually
  * outside the other's triangle, but there is a hexagonal overlap region where they overlap.
+ * \a da and \a db are the double approximations of \a a and \a b, used to filter the orient
+ * tests.
  */
-static bool non_trivially_2d_intersect(const mpq2 *a[3], const mpq2 *b[3])
+static bool non_trivially_2d_intersect(const mpq2 *a[3],
+                                       const mpq2 *b[3],
+                                       const double2 *da[3],
+                                       const double2 *db[3])
 {
   /* TODO: Could experiment with trying bounding box tests before these.
    * TODO: Find a less expensive way than 18 orient tests to do this. */
@@ -1227,10 +1270,12 @@ static bool non_trivially_2d_intersect(const mpq2 *a[3], const mpq2 *b[3])
     for (int ai = 0; ai < 3; ++ai) {
       for (int bi = 0; bi < 3; ++bi) {
         if (ab == 0) {
-          orients[0][ai][bi] = orient2d(*b[bi], *b[(bi + 1) % 3], *a[ai]);
+          orients[0][ai][bi] = filtered_orient2d(
+              *db[bi], *db[(bi + 1) % 3], *da[ai], *b[bi], *b[(bi + 1) % 3], *a[ai]);
         }
         else {
-          orients[1][bi][ai] = orient2d(*a[ai], *a[(ai + 1) % 3], *b[bi]);
+          orients[1][bi][ai] = filtered_orient2d(
+              *da[ai], *da[(ai + 1) % 3], *db[bi], *a[ai], *a[(ai + 1) % 3], *b[bi]);
         }
       }
     }
@@ -1261,10 +1306,12 @@ static bool non_trivially_coplanar_intersects(const IMesh &tm,
   mpq2 v0 = project_3d_to_2d(tri[0]->co_exact, proj_axis);
   mpq2 v1 = project_3d_to_2d(tri[1]->co_exact, proj_axis);
   mpq2 v2 = project_3d_to_2d(tri[2]->co_exact, proj_axis);
-  if (orient2d(v0, v1, v2) != 1) {
-    mpq2 tmp = v1;
-    v1 = v2;
-    v2 = tmp;
+  double2 dv0 = project_3d_to_2d(tri[0]->co, proj_axis);
+  double2 dv1 = project_3d_to_2d(tri[1]->co, proj_axis);
+  double2 dv2 = project_3d_to_2d(tri[2]->co, proj_axis);
+  if (filtered_orient2d(dv0, dv1, dv2, v0, v1, v2) != 1) {
+    std::swap(v1, v2);
+    std::swap(dv1, dv2);
   }
   for (const int cl_t : cl) {
     if (!itt_map.contains(std::pair<int, int>(t, cl_t)) &&
@@ -1275,14 +1322,18 @@ static bool non_trivially_coplanar_intersects(const IMesh &tm,
     mpq2 ctv0 = project_3d_to_2d(cl_tri[0]->co_exact, proj_axis);
     mpq2 ctv1 = project_3d_to_2d(cl_tri[1]->co_exact, proj_axis);
     mpq2 ctv2 = project_3d_to_2d(cl_tri[2]->co_exact, proj_axis);
-    if (orient2d(ctv0, ctv1, ctv2) != 1) {
-      mpq2 tmp = ctv1;
-      ctv1 = ctv2;
-      ctv2 = tmp;
+    double2 dctv0 = project_3d_to_2d(cl_tri[0]->co, proj_axis);
+    double2 dctv1 = project_3d_to_2d(cl_tri[1]->co, proj_axis);
+    double2 dctv2 = project_3d_to_2d(cl_tri[2]->co, proj_axis);
+    if (filtered_orient2d(dctv0, dctv1, dctv2, ctv0, ctv1, ctv2) != 1) {
+      std::swap(ctv1, ctv2);
+      std::swap(dctv1, dctv2);
     }
     const mpq2 *v[] = {&v0, &v1, &v2};
     const mpq2 *ctv[] = {&ctv0, &ctv1, &ctv2};
-    if (non_trivially_2d_intersect(v, ctv)) {
+    const double2 *dv[] = {&dv0, &dv1, &dv2};
+    const double2 *dctv[] = {&dctv0, &dctv1, &dctv2};
+    if (non_trivially_2d_intersect(v, ctv, dv, dctv)) {
       return true;
     }
   }
@@ -1423,60 +1474,6 @@ static double supremum_dot(const double3 &a, const double3 &b)
   return double3::dot(abs_a, abs_b);
 }
 
-static double supremum_orient3d(const double3 &a,
-                                const double3 &b,
-                                const double3 &c,
-                                const double3 &d)
-{
-  double3 abs_a = double3::abs(a);
-  double3 abs_b = double3::abs(b);
-  double3 abs_c = double3::abs(c);
-  double3 abs_d = double3::abs(d);
-  double adx = abs_a[0] + abs_d[0];
-  double bdx = abs_b[0] + abs_d[0];
-  double cdx = abs_c[0] + abs_d[0];
-  double ady = abs_a[1] + abs_d[1];
-  double bdy = abs_b[1] + abs_d[1];
-  double cdy = abs_c[1] + abs_d[1];
-  double adz = abs_a[2] + abs_d[2];
-  double bdz = abs_b[2] + abs_d[2];
-  double cdz = abs_c[2] + abs_d[2];
-
-  double bdxcdy = bdx * cdy;
-  double cdxbdy = cdx * bdy;
-
-  double cdxady = cdx * ady;
-  double adxcdy = adx * cdy;
-
-  double adxbdy = adx * bdy;
-  double bdxady = bdx * ady;
-
-  double det = adz * (bdxcdy + cdxbdy) + bdz * (cdxady + adxcdy) + cdz * (adxbdy + bdxady);
-  return det;
-}
-
-/** Actually index_orient3d = 10 + 4 * (max degree of input coordinates) */
-constexpr int index_orient3d = 14;
-
-/**
- * Return the approximate orient3d of the four double3's, with
- * the guarantee that if the value is -1 or 1 then the underlying
- * mpq3 test would also have returned that value.
- * When the return value is 0, we are not sure of the sign.
- */
-static int filter_orient3d(const double3 &a, const double3 &b, const double3 &c, const double3 &d)
-{
-  double o3dfast = orient3d_fast(a, b, c, d);
-  if (o3dfast == 0.0) {
-    return 0;
-  }
-  double err_bound = supremum_orient3d(a, b, c, d) * index_orient3d * DBL_EPSILON;
-  if (fabs(o3dfast) > err_bound) {
-    return o3dfast > 0.0 ? 1 : -1;
-  }
-  return 0;
-}
-
 /**
  * Return the approximate orient3d of the triangle plane points and v, with
  * the guarantee that if the value is -1 or 1 then the underlying
@@ -1550,7 +1547,7 @@ static int filter_plane_side(const double3 &p,
   }
   double supremum = double3::dot(abs_p + abs_plane_p, abs_plane_no);
   double err_bound = supremum * index_plane_side * DBL_EPSILON;
-  if (d > err_bound) {
+  if (fabs(d) > err_bound) {
     return d > 0 ? 1 : -1;
   }
   return 0;
@@ -1657,14 +1654,18 @@ static inline mpq3 tti_interp(const mpq3 &a, const mpq3 &b, const mpq3 &c, const
 }
 
 /**
- * Return +1, 0, -1 as a + ad is above, on, or below the oriented plane containing a, b, c in CCW
- * order. This is the same as -oriented(a, b, c, a + ad), but uses fewer arithmetic operations.
- * TODO: change arguments to `const Vert *` and use floating filters.
+ * Return +1, 0, -1 as p is above, on, or below the oriented plane containing a, b, c in CCW
+ * order. This is the same as -orient3d(a, b, c, p), only using exact arithmetic when the
+ * floating point filter can't decide.
  */
-static inline int tti_above(const mpq3 &a, const mpq3 &b, const mpq3 &c, const mpq3 &ad)
+static inline int tti_above(const Vert *a, const Vert *b, const Vert *c, const Vert *p)
 {
-  mpq3 n = mpq3::cross(b - a, c - a);
-  return sgn(mpq3::dot(ad, n));
+  const int orient = filter_orient3d(a->co, b->co, c->co, p->co);
+  if (orient != 0) {
+    return -orient;
+  }
+  mpq3 n = mpq3::cross(b->co_exact - a->co_exact, c->co_exact - a->co_exact);
+  return sgn(mpq3::dot(p->co_exact - a->co_exact, n));
 }
 
 /**
@@ -1680,12 +1681,12 @@ static inline int tti_above(const mpq3 &a, const mpq3 &b, const mpq3 &c, const m
  *   of the plane and at least one of q1 and r1 are off the plane.
  * Similarly for p2, q2, r2 with respect to the first triangle's plane.
  */
-static ITT_value itt_canon2(const mpq3 &p1,
-                            const mpq3 &q1,
-                            const mpq3 &r1,
-                            const mpq3 &p2,
-                            const mpq3 &q2,
-                            const mpq3 &r2,
+static ITT_value itt_canon2(const Vert *p1,
+                            const Vert *q1,
+                            const Vert *r1,
+                            const Vert *p2,
+                            const Vert *q2,
+                            const Vert *r2,
                             const mpq3 &n1,
                             const mpq3 &n2)
 {
@@ -1695,33 +1696,23 @@ static ITT_value itt_canon2(const mpq3 &p1,
     std::cout << "p1=" << p1 << " q1=" << q1 << " r1=" << r1 << "\n";
     std::cout << "p2=" << p2 << " q2=" << q2 << " r2=" << r2 << "\n";
     std::cout << "n1=" << n1 << " n2=" << n2 << "\n";
-    std::cout << "approximate values:\n";
-    std::cout << "p1=(" << p1[0].get_d() << "," << p1[1].get_d() << "," << p1[2].get_d() << ")\n";
-    std::cout << "q1=(" << q1[0].get_d() << "," << q1[1].get_d() << "," << q1[2].get_d() << ")\n";
-    std::cout << "r1=(" << r1[0].get_d() << "," << r1[1].get_d() << "," << r1[2].get_d() << ")\n";
-    std::cout << "p2=(" << p2[0].get_d() << "," << p2[1].get_d() << "," << p2[2].get_d() << ")\n";
-    std::cout << "q2=(" << q2[0].get_d() << "," << q2[1].get_d() << "," << q2[2].get_d() << ")\n";
-    std::cout << "r2=(" << r2[0].get_d() << "," << r2[1].get_d() << "," << r2[2].get_d() << ")\n";
-    std::cout << "n1=(" << n1[0].get_d() << "," << n1[1].get_d() << "," << n1[2].get_d() << ")\n";
-    std::cout << "n2=(" << n2[0].get_d() << "," << n2[1].get_d() << "," << n2[2].get_d() << ")\n";
-  }
-  mpq3 p1p2 = p2 - p1;
+  }
   mpq3 intersect_1;
   mpq3 intersect_2;
   bool no_overlap = false;
   /* Top test in classification tree. */
-  if (tti_above(p1, q1, r2, p1p2) > 0) {
+  if (tti_above(p1, q1, r2, p2) > 0) {
     /* Middle right test in classification tree. */
-    if (tti_above(p1, r1, r2, p1p2) <= 0) {
+    if (tti_above(p1, r1, r2, p2) <= 0) {
       /* Bottom right test in classification tree. */
-      if (tti_above(p1, r1, q2, p1p2) > 0) {
+      if (tti_above(p1, r1, q2, p2) > 0) {
         /* Overlap is [k [i l] j]. */
         if (dbg_level > 0) {
           std::cout << "overlap [k [i l] j]\n";
         }
         /* i is intersect with p1r1. l is intersect with p2r2. */
-        intersect_1 = tti_interp(p1, r1, p2, n2);
-        intersect_2 = tti_interp(p2, r2, p1, n1);
+        intersect_1 = tti_interp(p1->co_exact, r1->co_exact, p2->co_exact, n2);
+        intersect_2 = tti_interp(p2->co_exact, r2->co_exact, p1->co_exact, n1);
       }
       else {
         /* Overlap is [i [k l] j]. */
@@ -1729,8 +1720,8 @@ static ITT_value itt_canon2(const mpq3 &p1,
           std::cout << "overlap [i [k l] j]\n";
         }
         /* k is intersect with p2q2. l is intersect is p2r2. */
-        intersect_1 = tti_interp(p2, q2, p1, n1);
-        intersect_2 = tti_interp(p2, r2, p1, n1);
+        intersect_1 = tti_interp(p2->co_exact, q2->co_exact, p1->co_exact, n1);
+        intersect_2 = tti_interp(p2->co_exact, r2->co_exact, p1->co_exact, n1);
       }
     }
     else {
@@ -1743,7 +1734,7 @@ static ITT_value itt_canon2(const mpq3 &p1,
   }
   else {
     /* Middle left test in classification tree. */
-    if (tti_above(p1, q1, q2, p1p2) < 0) {
+    if (tti_above(p1, q1, q2, p2) < 0) {
       /* No overlap: [i j] [k l]. */
       if (dbg_level > 0) {
         std::cout << "no overlap: [i j] [k l]\n";
@@ -1752,14 +1743,14 @@ static ITT_value itt_canon2(const mpq3 &p1,
     }
     else {
       /* Bottom left test in classification tree. */
-      if (tti_above(p1, r1, q2, p1p2) >= 0) {
+      if (tti_above(p1, r1, q2, p2) >= 0) {
         /* Overlap is [k [i j] l]. */
         if (dbg_level > 0) {
           std::cout << "overlap [k [i j] l]\n";
         }
         /* i is intersect with p1r1. j is intersect with p1q1. */
-        intersect_1 = tti_interp(p1, r1, p2, n2);
-        intersect_2 = tti_interp(p1, q1, p2, n2);
+        intersect_1 = tti_interp(p1->co_exact, r1->co_exact, p2->co_exact, n2);
+        intersect_2 = tti_interp(p1->co_exact, q1->co_exact, p2->co_exact, n2);
       }
       else {
         /* Overlap is [i [k j] l]. */
@@ -1767,8 +1758,8 @@ static ITT_value itt_canon2(const mpq3 &p1,
           std::cout << "overlap [i [k j] l]\n";
         }
         /* k is intersect with p2q2. j is intersect with p1q1. */
-        intersect_1 = tti_interp(p2, q2, p1, n1);
-        intersect_2 = tti_interp(p1, q1, p2, n2);
+        intersect_1 = tti_interp(p2->co_exact, q2->co_exact, p1->co_exact, n1);
+        intersect_2 = tti_interp(p1->co_exact, q1->co_exact, p2->co_exact, n2);
       }
     }
   }
@@ -1789,12 +1780,12 @@ static ITT_value itt_canon2(const mpq3 &p1,
 
 /* Helper function for intersect_tri_tri. Args have been canonicalized for triangle 1. */
 
-static ITT_value itt_canon1(const mpq3 &p1,
-                            const mpq3 &q1,
-                            const mpq3 &r1,
-                            const mpq3 &p2,
-                            const mpq3 &q2,
-                            const mpq3 &r2,
+static ITT_value itt_canon1(const Vert *p1,
+                            const Vert *q1,
+                            const Vert *r1,
+                            const Vert *p2,
+                            const Vert *q2,
+                            const Vert *r2,
                             const mpq3 &n1,
                             const mpq3 &n2,
                             int sp2,
@@ -1983,49 +1974,49 @@ static ITT_value intersect_tri_tri(const IMesh &tm, int t1, int t2)
   ITT_value ans;
   if (sp1 > 0) {
     if (sq1 > 0) {
-      ans = itt_canon1(r1, p1, q1, p2, r2, q2, n1, n2, sp2, sr2, sq2);
+      ans = itt_canon1(vr1, vp1, vq1, vp2, vr2, vq2, n1, n2, sp2, sr2, sq2);
     }
     else if (sr1 > 0) {
-      ans = itt_canon1(q1, r1, p1, p2, r2, q2, n1, n2, sp2, sr2, sq2);
+      ans = itt_canon1(vq1, vr1, vp1, vp2, vr2, vq2, n1, n2, sp2, sr2, sq2);
     }
     else {
-      ans = itt_canon1(p1, q1, r1, p2, q2, r2, n1, n2, sp2, sq2, sr2);
+      ans = itt_canon1(vp1, vq1, vr1, vp2, vq2, vr2, n1, n2, sp2, sq2, sr2);
     }
   }
   else if (sp1 < 0) {
     if (sq1 < 0) {
-      ans = itt_canon1(r1, p1, q1, p2, q2, r2, n1, n2, sp2, sq2, sr2);
+      ans = itt_canon1(vr1, vp1, vq1, vp2, vq2, vr2, n1, n2, sp2, sq2, sr2);
     }
     else if (sr1 < 0) {
-      ans = itt_canon1(q1, r1, p1, p2, q2, r2, n1, n2, sp2, sq2, sr2);
+      ans = itt_canon1(vq1, vr1, vp1, vp2, vq2, vr2, n1, n2, sp2, sq2, sr2);
     }
     else {
-      ans = itt_canon1(p1, q1, r1, p2, r2, q2, n1, n2, sp2, sr2, sq2);
+      ans = itt_canon1(vp1, vq1, vr1, vp2, vr2, vq2, n1, n2, sp2, sr2, sq2);
     }
   }
   else {
     if (sq1 < 0) {
       if (sr1 >= 0) {
-        ans = itt_canon1(q1, r1, p1, p2, r2, q2, n1, n2, sp2, sr2, sq2);
+        ans = itt_canon1(vq1, vr1, vp1, vp2, vr2, vq2, n1, n2, sp2, sr2, sq2);
       }
       else {
-        ans = itt_canon1(p1, q1, r1, p2, q2, r2, n1, n2, sp2, sq2, sr2);
+        ans = itt_canon1(vp1, vq1, vr1, vp2, vq2, vr2, n1, n2, sp2, sq2, sr2);
       }
     }
     else if (sq1 > 0) {
       if (sr1 > 0) {
-        ans = itt_canon1(p1, q1, r1, p2, r2, q2, n1, n2, sp2, sr2, sq2);
+        ans = itt_canon1(vp1, vq1, vr1, vp2, vr2, vq2, n1, n2, sp2, sr2, sq2);
       }
       else {
-        ans = itt_canon1(q1, r1, p1, p2, q2, r2, n1, n2, sp2, sq2, sr2);
+        ans = itt_canon1(vq1, vr1, vp1, vp2, vq2, vr2, n1, n2, sp2, sq2, sr2);
       }
     }
     else {
       if (sr1 > 0) {
-        ans = itt_canon1(r1, p1, q1, p2, q2, r2, n1, n2, sp2, sq2, sr2);
+        ans = itt_canon1(vr1, vp1, vq1, vp2, vq2, vr2, n1, n2, sp2, sq2, sr2);
       }
       else if (sr1 < 0) {
-        ans = itt_canon1(r1, p1, q1, p2, r2, q2, n1, n2, sp2, sr2, sq2);
+        ans = itt_canon1(vr1, vp1, vq1, vp2, vr2, vq2, n1, n2, sp2, sr2, sq2);
       }
       else {
         if (dbg_level > 0) {
@@ -2787,6 +2778,72 @@ static CDT_data calc_cluster_subdivided(const CoplanarClusterInfo &clinfo,
   return cd_data;
 }
 
+/**
+ * Data needed for parallelization of calc_cluster_subdivided.
+ */
+struct ClusterSubdivideData {
+  Array<CDT_data> &r_cluster_subdivided;
+  const CoplanarClusterInfo &clinfo;
+  const IMesh &tm;
+  const TriOverlaps &ov;
+  const Map<std::pair<int, int>, ITT_value> &itt_map;
+  IMeshArena *arena;
+};
+
+static void calc_cluster_subdivided_range_func(void *__restrict userdata,
+                                               const int c,
+                                               const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  ClusterSubdivideData *data = static_cast<ClusterSubdivideData *>(userdata);
+  data->r_cluster_subdivided[c] = calc_cluster_subdivided(
+      data->clinfo, c, data->tm, data->ov, data->itt_map, data->arena);
+}
+
+/**
+ * Data needed for parallelization of the extraction of the subdivided triangles.
+ */
+struct ExtractTrisData {
+  Array<IMesh> &r_tri_subdivided;
+  const Array<CDT_data> &cluster_subdivided;
+  const CoplanarClusterInfo &clinfo;
+  const IMesh &tm;
+  IMeshArena *arena;
+};
+
+static void extract_tri_range_func(void *__restrict userdata,
+                                   const int t,
+                                   const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  ExtractTrisData *data = static_cast<ExtractTrisData *>(userdata);
+  int c = data->clinfo.tri_cluster(t);
+  if (c != NO_INDEX) {
+    BLI_assert(data->r_tri_subdivided[t].face_size() == 0);
+    data->r_tri_subdivided[t] = extract_subdivided_tri(
+        data->cluster_subdivided[c], data->tm, t, data->arena);
+  }
+  else if (data->r_tri_subdivided[t].face_size() == 0) {
+    data->r_tri_subdivided[t] = extract_single_tri(data->tm, t);
+  }
+}
+
+/**
+ * Data needed for parallelization of the exact plane calculation.
+ */
+struct PopulatePlaneData {
+  const IMesh &tm;
+  const TriOverlaps &ov;
+};
+
+static void populate_plane_range_func(void *__restrict userdata,
+                                      const int t,
+                                      const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  PopulatePlaneData *data = static_cast<PopulatePlaneData *>(userdata);
+  if (data->ov.first_overlap_index(t) != -1) {
+    data->tm.face(t)->populate_plane(true);
+  }
+}
+
 static IMesh union_tri_subdivides(const blender::Array<IMesh> &tri_subdivided)
 {
   int tot_tri = 0;
@@ -3077,11 +3134,14 @@ IMesh trimesh_nary_intersect(const IMesh &tm_in,
   double overlap_time = PIL_check_seconds_timer();
   std::cout << "intersect overlaps calculated, time = " << overlap_time - bb_calc_time << "\n";
 #  endif
-  for (int t : tm_clean->face_index_range()) {
-    if (tri_ov.first_overlap_index(t) != -1) {
-      tm_clean->face(t)->populate_plane(true);
-    }
-  }
+  /* The exact planes are expensive to compute, do it in parallel. */
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 1000;
+  settings.use_threading = intersect_use_threading;
+  PopulatePlaneData populate_data = {*tm_clean, tri_ov};
+  BLI_task_parallel_range(
+      0, tm_clean->face_size(), &populate_data, populate_plane_range_func, &settings);
 #  ifdef PERFDEBUG
   double plane_populate = PIL_check_seconds_timer();
   std::cout << "planes populated, time = " << plane_populate - overlap_time << "\n";
@@ -3113,24 +3173,20 @@ IMesh trimesh_nary_intersect(const IMesh &tm_in,
   std::cout << "subdivided tris found, time = " << subdivided_tris_time - itt_time << "\n";
 #  endif
   Array<CDT_data> cluster_subdivided(clinfo.tot_cluster());
-  for (int c : clinfo.index_range()) {
-    cluster_subdivided[c] = calc_cluster_subdivided(clinfo, c, *tm_clean, tri_ov, itt_map, arena);
-  }
+  ClusterSubdivideData cluster_data = {
+      cluster_subdivided, clinfo, *tm_clean, tri_ov, itt_map, arena};
+  settings.min_iter_per_thread = 1;
+  BLI_task_parallel_range(
+      0, clinfo.tot_cluster(), &cluster_data, calc_cluster_subdivided_range_func, &settings);
 #  ifdef PERFDEBUG
   double cluster_subdivide_time = PIL_check_seconds_timer();
   std::cout << "subdivided clusters found, time = "
             << cluster_subdivide_time - subdivided_tris_time << "\n";
 #  endif
-  for (int t : tm_clean->face_index_range()) {
-    int c = clinfo.tri_cluster(t);
-    if (c != NO_INDEX) {
-      BLI_assert(tri_subdivided[t].face_size() == 0);
-      tri_subdivided[t] = extract_subdivided_tri(cluster_subdivided[c], *tm_clean, t, arena);
-    }
-    else if (tri_subdivided[t].face_size() == 0) {
-      tri_subdivided[t] = extract_single_tri(*tm_clean, t);
-    }
-  }
+  ExtractTrisData extract_data = {tri_subdivided, cluster_subdivided, clinfo, *tm_clean, arena};
+  settings.min_iter_per_thread = 1000;
+  BLI_task_parallel_range(
+      0, tm_clean->face_size(), &extract_data, extract_tri_range_func, &settings);
 #  ifdef PERFDEBUG
   double extract_time = PIL_check_seconds_timer();
   std::cout << "triangles extracted, time = " << extract_time - cluster_subdivide_time << "\n";
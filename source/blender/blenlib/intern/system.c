@@ -162,6 +162,60 @@ int BLI_cpu_support_sse41(void)
   return 0;
 }
 
+static unsigned long long cpu_xgetbv(void)
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  return _xgetbv(0);
+#elif defined(__x86_64__) || defined(__i386__)
+  unsigned int eax, edx;
+  /* `xgetbv` spelled as bytes, older assemblers don't know the instruction. */
+  __asm__(".byte 0x0f, 0x01, 0xd0" : "=a"(eax), "=d"(edx) : "c"(0));
+  return ((unsigned long long)edx << 32) | eax;
+#else
+  return 0;
+#endif
+}
+
+int BLI_cpu_support_avx2(void)
+{
+  int result[4], num;
+  __cpuid(result, 0);
+  num = result[0];
+
+  if (num < 7) {
+    return 0;
+  }
+  __cpuid(result, 0x00000001);
+  /* OSXSAVE, AVX and FMA. */
+  const int avx_fma_bits = ((int)1 << 27) | ((int)1 << 28) | ((int)1 << 12);
+  if ((result[2] & avx_fma_bits) != avx_fma_bits) {
+    return 0;
+  }
+  /* The OS has to save the XMM and YMM registers on context switches. */
+  if ((cpu_xgetbv() & 0x6) != 0x6) {
+    return 0;
+  }
+  /* Leaf 7 has sub-leaves, the AVX2 bit is in sub-leaf 0. */
+#if defined(_MSC_VER) && !defined(FREE_WINDOWS)
+  __cpuidex(result, 7, 0);
+#elif defined(__x86_64__)
+  asm("cpuid"
+      : "=a"(result[0]), "=b"(result[1]), "=c"(result[2]), "=d"(result[3])
+      : "a"(7), "c"(0));
+#elif defined(__i386__)
+  asm("pushl %%ebx    \n\t"
+      "cpuid          \n\t"
+      "movl %%ebx, %1 \n\t"
+      "popl %%ebx     \n\t"
+      : "=a"(result[0]), "=r"(result[1]), "=c"(result[2]), "=d"(result[3])
+      : "a"(7), "c"(0)
+      : "ebx");
+#else
+  return 0;
+#endif
+  return (result[1] & ((int)1 << 5)) != 0;
+}
+
 void BLI_hostname_get(char *buffer, size_t bufsize)
 {
 #ifndef WIN32
@@ -28,6 +28,8 @@
 
 #include "DNA_listBase.h"
 
+#include "atomic_ops.h"
+
 #include "BLI_math.h"
 #include "BLI_mempool.h"
 #include "BLI_task.h"
@@ -147,6 +149,38 @@ class TBBTaskGroup : public tbb::task_group {
 };
 #endif
 
+/* Affinity
+ *
+ * Tasks pushed with the same affinity hint are likely to touch the same data. When a running task
+ * pushes a task with its own hint, the new task is also kept as the next task of that thread,
+ * which runs it right after the current task, while its data is still in the caches. The task is
+ * scheduled as usual as well, whichever thread gets to it first runs it. So the hint never holds
+ * back a task that is ready while other threads are idle. */
+
+struct TaskAffinityNode {
+  Task task;
+  const void *affinity;
+  /* Set by the thread which runs the task. */
+  int32_t claimed;
+  /* The scheduled TBB task and the next task of a thread both reference the node. */
+  int32_t users;
+};
+
+struct TaskAffinityThreadState {
+  TaskPool *pool;
+  /* Hint of the task the thread is running. */
+  const void *affinity;
+  TaskAffinityNode *next;
+};
+
+static thread_local TaskAffinityThreadState task_affinity_thread_state = {NULL, NULL, NULL};
+
+/* Suspended task, along with its affinity hint to use once it gets scheduled. */
+struct TaskSuspended {
+  Task task;
+  const void *affinity;
+};
+
 /* Task Pool */
 
 typedef enum TaskPoolType {
@@ -171,6 +205,9 @@ struct TaskPool {
   volatile bool is_suspended;
   BLI_mempool *suspended_mempool;
 
+  /* Updated atomically, see #BLI_task_pool_stats_get. */
+  TaskPoolStats stats;
+
   /* Background task pool. */
   ListBase background_threads;
   ThreadQueue *background_queue;
@@ -189,7 +226,8 @@ static void tbb_task_pool_create(TaskPool *pool, TaskPriority priority)
 {
   if (pool->type == TASK_POOL_TBB_SUSPENDED) {
     pool->is_suspended = true;
-    pool->suspended_mempool = BLI_mempool_create(sizeof(Task), 512, 512, BLI_MEMPOOL_ALLOW_ITER);
+    pool->suspended_mempool = BLI_mempool_create(
+        sizeof(TaskSuspended), 512, 512, BLI_MEMPOOL_ALLOW_ITER);
   }
 
 #ifdef WITH_TBB
@@ -201,12 +239,139 @@ static void tbb_task_pool_create(TaskPool *pool, TaskPriority priority)
 #endif
 }
 
-static void tbb_task_pool_run(TaskPool *pool, Task &&task)
+#ifdef WITH_TBB
+static bool task_affinity_node_claim(TaskAffinityNode *node)
+{
+  return atomic_cas_int32(&node->claimed, 0, 1) == 0;
+}
+
+static void task_affinity_node_release(TaskAffinityNode *node)
+{
+  if (atomic_sub_and_fetch_int32(&node->users, 1) == 0) {
+    node->task.~Task();
+    MEM_freeN(node);
+  }
+}
+
+static void task_pool_stats_affinity_run_add(TaskPool *pool, const int run_len)
+{
+  atomic_add_and_fetch_int32(&pool->stats.num_affinity_runs, 1);
+  int32_t run_len_max = pool->stats.max_affinity_run_len;
+  while (run_len > run_len_max) {
+    const int32_t run_len_max_prev = atomic_cas_int32(
+        &pool->stats.max_affinity_run_len, run_len_max, run_len);
+    if (run_len_max_prev == run_len_max) {
+      break;
+    }
+    run_len_max = run_len_max_prev;
+  }
+}
+
+/* Run a claimed task, followed by the tasks with the same hint it kept as next task, unless
+ * another thread started them already. */
+static void tbb_task_pool_affinity_execute(TaskPool *pool, TaskAffinityNode *node)
+{
+  TaskAffinityThreadState &state = task_affinity_thread_state;
+  /* Tasks can run nested while a task waits for other work. */
+  const TaskAffinityThreadState state_prev = state;
+  int run_len = 0;
+
+  state.pool = pool;
+  state.affinity = node->affinity;
+  state.next = NULL;
+  if (!pool->tbb_group.is_canceling()) {
+    node->task();
+    run_len++;
+  }
+
+  while (TaskAffinityNode *next = state.next) {
+    state.next = NULL;
+    if (task_affinity_node_claim(next)) {
+      state.affinity = next->affinity;
+      if (!pool->tbb_group.is_canceling()) {
+        next->task();
+        run_len++;
+      }
+    }
+    task_affinity_node_release(next);
+  }
+
+  state = state_prev;
+
+  if (run_len != 0) {
+    task_pool_stats_affinity_run_add(pool, run_len);
+  }
+}
+
+/* Scheduled TBB task of a task with an affinity hint. Like #Task, it's only moved and releases
+ * the node when destroyed, also when the pool is canceled before it runs. */
+class TaskAffinityRun {
+ public:
+  TaskPool *pool;
+  TaskAffinityNode *node;
+
+  TaskAffinityRun(TaskPool *pool, TaskAffinityNode *node) : pool(pool), node(node)
+  {
+  }
+
+  ~TaskAffinityRun()
+  {
+    if (node) {
+      task_affinity_node_release(node);
+    }
+  }
+
+  TaskAffinityRun(TaskAffinityRun &&other) : pool(other.pool), node(other.node)
+  {
+    other.node = NULL;
+  }
+
+#  if TBB_INTERFACE_VERSION_MAJOR < 10
+  TaskAffinityRun(const TaskAffinityRun &other) : pool(other.pool), node(other.node)
+  {
+    ((TaskAffinityRun &)other).node = NULL;
+  }
+#  else
+  TaskAffinityRun(const TaskAffinityRun &other) = delete;
+#  endif
+
+  TaskAffinityRun &operator=(const TaskAffinityRun &other) = delete;
+  TaskAffinityRun &operator=(TaskAffinityRun &&other) = delete;
+
+  void operator()() const
+  {
+    if (task_affinity_node_claim(node)) {
+      tbb_task_pool_affinity_execute(pool, node);
+    }
+  }
+};
+
+static void tbb_task_pool_affinity_run(TaskPool *pool, Task &&task, const void *affinity)
+{
+  TaskAffinityNode *node = (TaskAffinityNode *)MEM_mallocN(sizeof(TaskAffinityNode), __func__);
+  new (&node->task) Task(std::move(task));
+  node->affinity = affinity;
+  node->claimed = 0;
+  node->users = 1;
+
+  /* Keep the task as next task of this thread when it's pushed by a related task. */
+  TaskAffinityThreadState &state = task_affinity_thread_state;
+  if (state.pool == pool && state.affinity == affinity && state.next == NULL) {
+    node->users = 2;
+    state.next = node;
+  }
+
+  pool->tbb_group.run(TaskAffinityRun(pool, node));
+}
+#endif
+
+static void tbb_task_pool_run(TaskPool *pool, Task &&task, const void *affinity)
 {
   if (pool->is_suspended) {
     /* Suspended task that will be executed in work_and_wait(). */
-    Task *task_mem = (Task *)BLI_mempool_alloc(pool->suspended_mempool);
-    new (task_mem) Task(std::move(task));
+    TaskSuspended *task_mem = (TaskSuspended *)BLI_mempool_alloc(pool->suspended_mempool);
+    new (&task_mem->task) Task(std::move(task));
+    task_mem->affinity = affinity;
 #ifdef __GNUC__
     /* Work around apparent compiler bug where task is not properly copied
      * to task_mem. This appears unrelated to the use of placement new or
@@ -217,11 +382,18 @@ static void tbb_task_pool_run(TaskPool *pool, Task &&task)
   }
 #ifdef WITH_TBB
   else if (pool->use_threads) {
-    /* Execute in TBB task group. */
-    pool->tbb_group.run(std::move(task));
+    if (affinity != NULL) {
+      /* Execute preferably after a related task on the same thread. */
+      tbb_task_pool_affinity_run(pool, std::move(task), affinity);
+    }
+    else {
+      /* Execute in TBB task group. */
+      pool->tbb_group.run(std::move(task));
+    }
   }
 #endif
   else {
+    UNUSED_VARS(affinity);
     /* Execute immediately. */
     task();
   }
@@ -235,8 +407,8 @@ static void tbb_task_pool_work_and_wait(TaskPool *pool)
 
     BLI_mempool_iter iter;
     BLI_mempool_iternew(pool->suspended_mempool, &iter);
-    while (Task *task = (Task *)BLI_mempool_iterstep(&iter)) {
-      tbb_task_pool_run(pool, std::move(*task));
+    while (TaskSuspended *task = (TaskSuspended *)BLI_mempool_iterstep(&iter)) {
+      tbb_task_pool_run(pool, std::move(task->task), task->affinity);
     }
 
     BLI_mempool_clear(pool->suspended_mempool);
@@ -469,19 +641,25 @@ void BLI_task_pool_free(TaskPool *pool)
   MEM_freeN(pool);
 }
 
-void BLI_task_pool_push(TaskPool *pool,
-                        TaskRunFunction run,
-                        void *taskdata,
-                        bool free_taskdata,
-                        TaskFreeFunction freedata)
+static void task_pool_push_ex(TaskPool *pool,
+                              TaskRunFunction run,
+                              void *taskdata,
+                              bool free_taskdata,
+                              TaskFreeFunction freedata,
+                              const void *affinity)
 {
   Task task(pool, run, taskdata, free_taskdata, freedata);
 
+  atomic_add_and_fetch_int32(&pool->stats.num_tasks, 1);
+  if (affinity != NULL) {
+    atomic_add_and_fetch_int32(&pool->stats.num_affinity_tasks, 1);
+  }
+
   switch (pool->type) {
     case TASK_POOL_TBB:
     case TASK_POOL_TBB_SUSPENDED:
     case TASK_POOL_NO_THREADS:
-      tbb_task_pool_run(pool, std::move(task));
+      tbb_task_pool_run(pool, std::move(task), affinity);
       break;
     case TASK_POOL_BACKGROUND:
     case TASK_POOL_BACKGROUND_SERIAL:
@@ -490,6 +668,33 @@ void BLI_task_pool_push(TaskPool *pool,
   }
 }
 
+void BLI_task_pool_push(TaskPool *pool,
+                        TaskRunFunction run,
+                        void *taskdata,
+                        bool free_taskdata,
+                        TaskFreeFunction freedata)
+{
+  task_pool_push_ex(pool, run, taskdata, free_taskdata, freedata, NULL);
+}
+
+/**
+ * Push a task with a hint which data it operates on, for example an ID.
+ * When a task pushes a task with its own \a affinity, the new task runs next on the same thread
+ * unless an idle thread picks it up first, so the data is likely still in the caches.
+ *
+ * The hint never delays a task, tasks sharing a hint still run in parallel.
+ * Pools which don't run tasks in parallel ignore it.
+ */
+void BLI_task_pool_push_affinity(TaskPool *pool,
+                                 TaskRunFunction run,
+                                 void *taskdata,
+                                 bool free_taskdata,
+                                 TaskFreeFunction freedata,
+                                 const void *affinity)
+{
+  task_pool_push_ex(pool, run, taskdata, free_taskdata, freedata, affinity);
+}
+
 void BLI_task_pool_work_and_wait(TaskPool *pool)
 {
   switch (pool->type) {
@@ -544,3 +749,12 @@ ThreadMutex *BLI_task_pool_user_mutex(TaskPool *pool)
 {
   return &pool->user_mutex;
 }
+
+/**
+ * Statistics about the tasks pushed to the pool so far,
+ * only complete after #BLI_task_pool_work_and_wait.
+ */
+void BLI_task_pool_stats_get(TaskPool *pool, TaskPoolStats *r_stats)
+{
+  *r_stats = pool->stats;
+}
@@ -238,6 +238,16 @@ int BLI_thread_is_main(void)
   return pthread_equal(pthread_self(), mainid);
 }
 
+int BLI_thread_index_get(void)
+{
+  static int thread_index_counter = 0;
+  static thread_local int thread_index = -1;
+  if (UNLIKELY(thread_index == -1)) {
+    thread_index = atomic_fetch_and_add_int32(&thread_index_counter, 1);
+  }
+  return thread_index;
+}
+
 void BLI_threadpool_insert(ListBase *threadbase, void *callerdata)
 {
   LISTBASE_FOREACH (ThreadSlot *, tslot, threadbase) {
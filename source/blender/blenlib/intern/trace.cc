@@ -0,0 +1,249 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup bli
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "BLI_fileops.h"
+#include "BLI_string_utf8.h"
+#include "BLI_threads.h"
+#include "BLI_trace.h"
+#include "BLI_utildefines.h"
+#include "BLI_vector.hh"
+
+namespace blender::trace {
+
+using Clock = std::chrono::steady_clock;
+
+/** Zones of a thread older than this are overwritten by newer ones. */
+static constexpr uint64_t events_per_thread = 1 << 16;
+/** Deeper zones are not recorded, but still have to be ended. */
+static constexpr int zone_depth_max = 64;
+
+struct TraceEvent {
+  const char *category;
+  char name[48];
+  int64_t start_ns;
+  /** Negative while the zone hasn't ended. */
+  int64_t duration_ns;
+};
+
+struct ThreadBuffer {
+  int thread_index;
+  bool is_main;
+  std::unique_ptr<TraceEvent[]> events;
+  /** Number of events ever recorded, the ring buffer index is this modulo its size. */
+  uint64_t events_num = 0;
+  /** Event indices of the zones that haven't ended. */
+  uint64_t open_zones[zone_depth_max];
+  int depth = 0;
+};
+
+struct TraceSession {
+  std::string filepath;
+  Clock::time_point start;
+  /** Protects #buffers, every thread adds its own buffer on its first zone. */
+  std::mutex mutex;
+  Vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+static std::atomic<bool> trace_active = false;
+static TraceSession *trace_session = nullptr;
+/** Increased for every session, so thread buffers from previous sessions aren't used. */
+static std::atomic<int> trace_session_index = 0;
+
+static thread_local ThreadBuffer *thread_buffer = nullptr;
+static thread_local int thread_buffer_session_index = -1;
+
+static int64_t time_since_start_ns(const TraceSession *session)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - session->start)
+      .count();
+}
+
+static ThreadBuffer *thread_buffer_ensure(TraceSession *session)
+{
+  if (thread_buffer_session_index == trace_session_index) {
+    return thread_buffer;
+  }
+  std::unique_ptr<ThreadBuffer> buffer = std::make_unique<ThreadBuffer>();
+  buffer->thread_index = BLI_thread_index_get();
+  buffer->is_main = BLI_thread_is_main();
+  buffer->events = std::make_unique<TraceEvent[]>(events_per_thread);
+
+  thread_buffer = buffer.get();
+  thread_buffer_session_index = trace_session_index;
+
+  std::lock_guard<std::mutex> lock(session->mutex);
+  session->buffers.append(std::move(buffer));
+  return thread_buffer;
+}
+
+static void zone_begin(const char *category, const char *name)
+{
+  TraceSession *session = trace_session;
+  ThreadBuffer *buffer = thread_buffer_ensure(session);
+  if (buffer->depth < zone_depth_max) {
+    const uint64_t event_index = buffer->events_num++;
+    TraceEvent &event = buffer->events[event_index % events_per_thread];
+    event.category = category;
+    BLI_strncpy_utf8(event.name, name, sizeof(event.name));
+    event.duration_ns = -1;
+    buffer->open_zones[buffer->depth] = event_index;
+    /* Read the time last, to leave out the time spent recording the zone. */
+    event.start_ns = time_since_start_ns(session);
+  }
+  buffer->depth++;
+}
+
+static void zone_end()
+{
+  if (thread_buffer_session_index != trace_session_index) {
+    /* The zone began before the session. */
+    return;
+  }
+  ThreadBuffer *buffer = thread_buffer;
+  if (buffer->depth == 0) {
+    return;
+  }
+  const int64_t end_ns = time_since_start_ns(trace_session);
+  buffer->depth--;
+  if (buffer->depth < zone_depth_max) {
+    const uint64_t event_index = buffer->open_zones[buffer->depth];
+    /* Skip zones that have been overwritten by the zones they contain. */
+    if (buffer->events_num - event_index <= events_per_thread) {
+      TraceEvent &event = buffer->events[event_index % events_per_thread];
+      event.duration_ns = end_ns - event.start_ns;
+    }
+  }
+}
+
+static void write_json_string(FILE *file, const char *str)
+{
+  fputc('"', file);
+  for (const char *c = str; *c; c++) {
+    if (ELEM(*c, '"', '\\')) {
+      fputc('\\', file);
+      fputc(*c, file);
+    }
+    else if ((unsigned char)*c < 0x20) {
+      fprintf(file, "\\u%04x", (unsigned int)*c);
+    }
+    else {
+      fputc(*c, file);
+    }
+  }
+  fputc('"', file);
+}
+
+static bool session_write(const TraceSession *session)
+{
+  FILE *file = BLI_fopen(session->filepath.c_str(), "w");
+  if (file == nullptr) {
+    return false;
+  }
+  const int64_t end_ns = time_since_start_ns(session);
+
+  fprintf(file, "{\"traceEvents\":[\n");
+  bool is_first = true;
+  for (const std::unique_ptr<ThreadBuffer> &buffer : session->buffers) {
+    fprintf(file,
+            "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+            "\"args\":{\"name\":\"%s %d\"}}",
+            is_first ? "" : ",\n",
+            buffer->thread_index,
+            buffer->is_main ? "Main" : "Thread",
+            buffer->thread_index);
+    is_first = false;
+
+    const uint64_t first_event = (buffer->events_num > events_per_thread) ?
+                                     buffer->events_num - events_per_thread :
+                                     0;
+    for (uint64_t i = first_event; i < buffer->events_num; i++) {
+      const TraceEvent &event = buffer->events[i % events_per_thread];
+      const int64_t duration_ns = (event.duration_ns < 0) ? end_ns - event.start_ns :
+                                                            event.duration_ns;
+      fprintf(file, ",\n{\"name\":");
+      write_json_string(file, event.name);
+      fprintf(file,
+              ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+              event.category,
+              (double)event.start_ns / 1000.0,
+              (double)duration_ns / 1000.0,
+              buffer->thread_index);
+    }
+  }
+  fprintf(file, "\n]}\n");
+
+  const bool ok = (ferror(file) == 0);
+  fclose(file);
+  return ok;
+}
+
+}  // namespace blender::trace
+
+using namespace blender::trace;
+
+void BLI_trace_session_begin(const char *filepath)
+{
+  BLI_assert(!BLI_trace_is_active());
+  trace_session = new TraceSession();
+  trace_session->filepath = filepath;
+  trace_session->start = Clock::now();
+  trace_session_index++;
+  trace_active.store(true, std::memory_order_release);
+}
+
+bool BLI_trace_session_end(void)
+{
+  if (trace_session == nullptr) {
+    return false;
+  }
+  trace_active.store(false, std::memory_order_release);
+  const bool ok = session_write(trace_session);
+  delete trace_session;
+  trace_session = nullptr;
+  /* Invalidate the thread buffers, they have been freed with the session. */
+  trace_session_index++;
+  return ok;
+}
+
+bool BLI_trace_is_active(void)
+{
+  return trace_active.load(std::memory_order_acquire);
+}
+
+void BLI_trace_zone_begin(const char *category, const char *name)
+{
+  if (BLI_trace_is_active()) {
+    zone_begin(category, name);
+  }
+}
+
+void BLI_trace_zone_end(void)
+{
+  if (BLI_trace_is_active()) {
+    zone_end();
+  }
+}
@@ -0,0 +1,215 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+#include <string>
+
+#include "atomic_ops.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_concurrent_map.hh"
+#include "BLI_concurrent_set.hh"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+
+namespace blender {
+namespace tests {
+
+TEST(concurrent_map, DefaultConstructor)
+{
+  ConcurrentMap<int, float> map;
+  EXPECT_EQ(map.size(), 0);
+  EXPECT_TRUE(map.is_empty());
+}
+
+TEST(concurrent_map, AddAndLookup)
+{
+  ConcurrentMap<int, float> map;
+  EXPECT_TRUE(map.add(2, 5.0f));
+  EXPECT_TRUE(map.add(3, 6.0f));
+  EXPECT_FALSE(map.add(2, 7.0f));
+  EXPECT_EQ(map.size(), 2);
+  EXPECT_TRUE(map.contains(2));
+  EXPECT_TRUE(map.contains(3));
+  EXPECT_FALSE(map.contains(4));
+  EXPECT_EQ(map.lookup_default(2, 0.0f), 5.0f);
+  EXPECT_EQ(map.lookup_default(4, 1.0f), 1.0f);
+  EXPECT_EQ(*map.lookup_try(3), 6.0f);
+  EXPECT_FALSE(map.lookup_try(4).has_value());
+}
+
+TEST(concurrent_map, LookupOrAdd)
+{
+  ConcurrentMap<int, int> map;
+  EXPECT_EQ(map.lookup_or_add(1, 10), 10);
+  EXPECT_EQ(map.lookup_or_add(1, 20), 10);
+  EXPECT_EQ(map.size(), 1);
+}
+
+TEST(concurrent_map, StringKeys)
+{
+  ConcurrentMap<std::string, int> map;
+  map.add("a", 1);
+  map.add("bcd", 2);
+  EXPECT_EQ(map.lookup_default("a", 0), 1);
+  EXPECT_EQ(map.lookup_default("bcd", 0), 2);
+  EXPECT_FALSE(map.contains("b"));
+}
+
+TEST(concurrent_map, Grow)
+{
+  ConcurrentMap<int, int> map;
+  const int64_t initial_capacity = map.capacity();
+  for (int i = 0; i < 10000; i++) {
+    EXPECT_TRUE(map.add(i, i * 2));
+  }
+  EXPECT_EQ(map.size(), 10000);
+  EXPECT_GT(map.capacity(), initial_capacity);
+  for (int i = 0; i < 10000; i++) {
+    EXPECT_EQ(map.lookup_default(i, -1), i * 2);
+  }
+}
+
+TEST(concurrent_map, Reserve)
+{
+  ConcurrentMap<int, int> map;
+  map.add(1, 1);
+  map.reserve(1000);
+  const int64_t capacity = map.capacity();
+  for (int i = 0; i < 1000; i++) {
+    map.add(i, i);
+  }
+  EXPECT_EQ(map.capacity(), capacity);
+  EXPECT_EQ(map.size(), 1000);
+  EXPECT_EQ(map.lookup_default(1, 0), 1);
+}
+
+TEST(concurrent_map, Clear)
+{
+  ConcurrentMap<int, std::string> map;
+  for (int i = 0; i < 100; i++) {
+    map.add(i, std::to_string(i));
+  }
+  map.clear();
+  EXPECT_EQ(map.size(), 0);
+  EXPECT_FALSE(map.contains(5));
+  map.add(5, "5");
+  EXPECT_EQ(map.lookup_default(5, ""), "5");
+}
+
+TEST(concurrent_map, ForeachItem)
+{
+  ConcurrentMap<int, int> map;
+  for (int i = 0; i < 100; i++) {
+    map.add(i, i + 1);
+  }
+  int key_sum = 0;
+  int value_sum = 0;
+  map.foreach_item([&](const int key, const int value) {
+    key_sum += key;
+    value_sum += value;
+  });
+  EXPECT_EQ(key_sum, 4950);
+  EXPECT_EQ(value_sum, 5050);
+}
+
+/* Every key is added by several threads, while the map grows many times. */
+TEST(concurrent_map, ParallelAdd)
+{
+  BLI_threadapi_init();
+
+  const int keys_num = 100000;
+  const int repeat = 4;
+  ConcurrentMap<int, int> map;
+  int added_num = 0;
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 64;
+
+  auto add_fn = [&](const int i) {
+    const int key = i % keys_num;
+    if (map.add(key, key * 3)) {
+      atomic_add_and_fetch_int32(&added_num, 1);
+    }
+    EXPECT_EQ(map.lookup_default(key, -1), key * 3);
+  };
+  BLI_task_parallel_range(
+      0,
+      keys_num * repeat,
+      &add_fn,
+      [](void *__restrict userdata, const int i, const TaskParallelTLS *__restrict UNUSED(tls)) {
+        (*static_cast<decltype(add_fn) *>(userdata))(i);
+      },
+      &settings);
+
+  EXPECT_EQ(added_num, keys_num);
+  EXPECT_EQ(map.size(), keys_num);
+  for (int i = 0; i < keys_num; i++) {
+    EXPECT_EQ(map.lookup_default(i, -1), i * 3);
+  }
+}
+
+TEST(concurrent_map, ParallelLookupOrAdd)
+{
+  BLI_threadapi_init();
+
+  const int keys_num = 1000;
+  ConcurrentMap<int, int> map;
+  int *values = static_cast<int *>(MEM_calloc_arrayN(keys_num * 8, sizeof(int), __func__));
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 16;
+
+  struct Data {
+    ConcurrentMap<int, int> *map;
+    int *values;
+  } data = {&map, values};
+  BLI_task_parallel_range(
+      0,
+      keys_num * 8,
+      &data,
+      [](void *__restrict userdata, const int i, const TaskParallelTLS *__restrict UNUSED(tls)) {
+        Data *data = static_cast<Data *>(userdata);
+        data->values[i] = data->map->lookup_or_add(i / 8, i);
+      },
+      &settings);
+
+  /* All threads must have got the value of the thread that added the key first. */
+  for (int i = 0; i < keys_num * 8; i++) {
+    EXPECT_EQ(values[i], map.lookup_default(i / 8, -1));
+    EXPECT_EQ(values[i] / 8, i / 8);
+  }
+  MEM_freeN(values);
+}
+
+TEST(concurrent_set, ParallelAdd)
+{
+  BLI_threadapi_init();
+
+  const int keys_num = 50000;
+  ConcurrentSet<int> set;
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+
+  BLI_task_parallel_range(
+      0,
+      keys_num * 2,
+      &set,
+      [](void *__restrict userdata, const int i, const TaskParallelTLS *__restrict UNUSED(tls)) {
+        static_cast<ConcurrentSet<int> *>(userdata)->add(i / 2);
+      },
+      &settings);
+
+  EXPECT_EQ(set.size(), keys_num);
+  int64_t key_sum = 0;
+  set.foreach_key([&](const int key) { key_sum += key; });
+  EXPECT_EQ(key_sum, int64_t(keys_num) * (keys_num - 1) / 2);
+  EXPECT_TRUE(set.contains(0));
+  EXPECT_FALSE(set.contains(keys_num));
+}
+
+}  // namespace tests
+}  // namespace blender
@@ -0,0 +1,159 @@
+/* Apache License, Version 2.0 */
+
+#include "BLI_group_probing_map.hh"
+#include "BLI_strict_flags.h"
+#include "BLI_vector.hh"
+#include "testing/testing.h"
+
+#include <string>
+
+namespace blender::tests {
+
+TEST(group_probing_map, DefaultConstructor)
+{
+  GroupProbingMap<int, float> map;
+  EXPECT_EQ(map.size(), 0);
+  EXPECT_TRUE(map.is_empty());
+  EXPECT_FALSE(map.contains(0));
+  EXPECT_EQ(map.lookup_ptr(3), nullptr);
+}
+
+TEST(group_probing_map, AddIncreasesSize)
+{
+  GroupProbingMap<int, float> map;
+  EXPECT_TRUE(map.add(2, 5.0f));
+  EXPECT_EQ(map.size(), 1);
+  EXPECT_FALSE(map.add(2, 6.0f));
+  EXPECT_EQ(map.size(), 1);
+  EXPECT_EQ(map.lookup(2), 5.0f);
+  map.add_new(6, 2.0f);
+  EXPECT_EQ(map.size(), 2);
+  EXPECT_FALSE(map.is_empty());
+}
+
+TEST(group_probing_map, AddOverwrite)
+{
+  GroupProbingMap<int, float> map;
+  EXPECT_TRUE(map.add_overwrite(3, 6.0f));
+  EXPECT_FALSE(map.add_overwrite(3, 2.0f));
+  EXPECT_EQ(map.size(), 1);
+  EXPECT_EQ(map.lookup(3), 2.0f);
+}
+
+TEST(group_probing_map, LookupDefault)
+{
+  GroupProbingMap<int, float> map;
+  map.add(2, 4.0f);
+  EXPECT_EQ(map.lookup_default(2, 1.0f), 4.0f);
+  EXPECT_EQ(map.lookup_default(3, 1.0f), 1.0f);
+}
+
+TEST(group_probing_map, ManyKeys)
+{
+  GroupProbingMap<int, int> map;
+  for (int i = 0; i < 100000; i++) {
+    map.add_new(i, i * 2);
+  }
+  EXPECT_EQ(map.size(), 100000);
+  EXPECT_GE(map.capacity(), 100000);
+  for (int i = 0; i < 100000; i++) {
+    EXPECT_EQ(map.lookup(i), i * 2);
+  }
+  EXPECT_FALSE(map.contains(-1));
+  EXPECT_FALSE(map.contains(100000));
+}
+
+TEST(group_probing_map, Remove)
+{
+  GroupProbingMap<int, int> map;
+  for (int i = 0; i < 10000; i++) {
+    map.add_new(i * 64, i);
+  }
+  for (int i = 0; i < 10000; i += 2) {
+    EXPECT_TRUE(map.remove(i * 64));
+  }
+  EXPECT_FALSE(map.remove(0));
+  EXPECT_EQ(map.size(), 5000);
+  for (int i = 0; i < 10000; i++) {
+    EXPECT_EQ(map.lookup_default(i * 64, -1), (i % 2) ? i : -1);
+  }
+  map.remove_contained(64);
+  EXPECT_FALSE(map.contains(64));
+}
+
+TEST(group_probing_map, AddRemoveRepeatedly)
+{
+  /* Removed slots have to be reused or cleaned up by growing, otherwise lookups of missing keys
+   * would never find an empty slot. */
+  GroupProbingMap<int, int> map;
+  for (int i = 0; i < 100000; i++) {
+    map.add_new(i, i);
+    map.remove_contained(i);
+  }
+  EXPECT_TRUE(map.is_empty());
+  EXPECT_LT(map.capacity(), 1000);
+  EXPECT_FALSE(map.contains(5));
+}
+
+struct HashIntModN100 {
+  uint64_t operator()(const int value) const
+  {
+    return (uint64_t)(value % 100);
+  }
+};
+
+TEST(group_probing_map, ManyCollisions)
+{
+  /* Many keys with the same hash, so that they need more than one group. */
+  GroupProbingMap<int, int, HashIntModN100> map;
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_TRUE(map.add(i, i));
+  }
+  EXPECT_FALSE(map.add(999, 0));
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_EQ(map.lookup(i), i);
+  }
+  EXPECT_FALSE(map.contains(1000));
+}
+
+TEST(group_probing_map, ForeachItem)
+{
+  GroupProbingMap<int, int> map;
+  map.add(3, 4);
+  map.add(1, 8);
+  Vector<int> keys;
+  Vector<int> values;
+  map.foreach_item([&](int key, int value) {
+    keys.append(key);
+    values.append(value);
+  });
+  EXPECT_EQ(keys.size(), 2);
+  EXPECT_EQ(values[keys.first_index_of(3)], 4);
+  EXPECT_EQ(values[keys.first_index_of(1)], 8);
+}
+
+TEST(group_probing_map, CopyAndMove)
+{
+  GroupProbingMap<int, std::string> map;
+  for (int i = 0; i < 100; i++) {
+    map.add_new(i, std::to_string(i));
+  }
+  GroupProbingMap<int, std::string> map_copy = map;
+  EXPECT_EQ(map_copy.size(), 100);
+  EXPECT_EQ(map_copy.lookup(42), "42");
+  EXPECT_EQ(map.lookup(42), "42");
+
+  GroupProbingMap<int, std::string> map_moved = std::move(map);
+  EXPECT_EQ(map_moved.size(), 100);
+  EXPECT_EQ(map_moved.lookup(42), "42");
+  EXPECT_EQ(map.size(), 0); /* NOLINT: bugprone-use-after-move */
+  map.add(1, "1");
+  EXPECT_EQ(map.lookup(1), "1");
+
+  map_copy = map_moved;
+  map_copy.clear();
+  EXPECT_TRUE(map_copy.is_empty());
+  EXPECT_FALSE(map_copy.contains(42));
+}
+
+}  // namespace blender::tests
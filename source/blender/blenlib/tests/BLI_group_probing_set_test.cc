@@ -0,0 +1,142 @@
+/* Apache License, Version 2.0 */
+
+#include "BLI_group_probing_set.hh"
+#include "BLI_strict_flags.h"
+#include "BLI_vector.hh"
+#include "testing/testing.h"
+
+#include <string>
+
+namespace blender::tests {
+
+TEST(group_probing_set, DefaultConstructor)
+{
+  GroupProbingSet<int> set;
+  EXPECT_EQ(set.size(), 0);
+  EXPECT_TRUE(set.is_empty());
+  EXPECT_FALSE(set.contains(0));
+}
+
+TEST(group_probing_set, AddIncreasesSize)
+{
+  GroupProbingSet<int> set;
+  EXPECT_TRUE(set.add(2));
+  EXPECT_EQ(set.size(), 1);
+  EXPECT_FALSE(set.add(2));
+  EXPECT_EQ(set.size(), 1);
+  set.add_new(6);
+  EXPECT_EQ(set.size(), 2);
+  EXPECT_TRUE(set.contains(6));
+  EXPECT_FALSE(set.is_empty());
+}
+
+TEST(group_probing_set, ManyKeys)
+{
+  GroupProbingSet<int> set;
+  for (int i = 0; i < 100000; i++) {
+    set.add_new(i);
+  }
+  EXPECT_EQ(set.size(), 100000);
+  EXPECT_GE(set.capacity(), 100000);
+  for (int i = 0; i < 100000; i++) {
+    EXPECT_TRUE(set.contains(i));
+  }
+  EXPECT_FALSE(set.contains(-1));
+  EXPECT_FALSE(set.contains(100000));
+}
+
+TEST(group_probing_set, Remove)
+{
+  GroupProbingSet<int> set;
+  for (int i = 0; i < 10000; i++) {
+    set.add_new(i * 64);
+  }
+  for (int i = 0; i < 10000; i += 2) {
+    EXPECT_TRUE(set.remove(i * 64));
+  }
+  EXPECT_FALSE(set.remove(0));
+  EXPECT_EQ(set.size(), 5000);
+  for (int i = 0; i < 10000; i++) {
+    EXPECT_EQ(set.contains(i * 64), (i % 2) == 1);
+  }
+  set.remove_contained(64);
+  EXPECT_FALSE(set.contains(64));
+}
+
+TEST(group_probing_set, AddRemoveRepeatedly)
+{
+  GroupProbingSet<int> set;
+  for (int i = 0; i < 100000; i++) {
+    set.add_new(i);
+    set.remove_contained(i);
+  }
+  EXPECT_TRUE(set.is_empty());
+  EXPECT_LT(set.capacity(), 1000);
+  EXPECT_FALSE(set.contains(5));
+}
+
+struct HashIntModN100 {
+  uint64_t operator()(const int value) const
+  {
+    return (uint64_t)(value % 100);
+  }
+};
+
+TEST(group_probing_set, ManyCollisions)
+{
+  GroupProbingSet<int, HashIntModN100> set;
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_TRUE(set.add(i));
+  }
+  EXPECT_FALSE(set.add(999));
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_TRUE(set.contains(i));
+  }
+  EXPECT_FALSE(set.contains(1000));
+}
+
+TEST(group_probing_set, RangeBasedForLoop)
+{
+  GroupProbingSet<int> set;
+  set.add(5);
+  set.add(2);
+  set.add(3);
+
+  Vector<int> keys;
+  for (const int key : set) {
+    keys.append(key);
+  }
+  EXPECT_EQ(keys.size(), 3);
+  EXPECT_TRUE(keys.contains(5));
+  EXPECT_TRUE(keys.contains(2));
+  EXPECT_TRUE(keys.contains(3));
+
+  GroupProbingSet<int> empty_set;
+  EXPECT_FALSE(empty_set.begin() != empty_set.end());
+}
+
+TEST(group_probing_set, CopyAndMove)
+{
+  GroupProbingSet<std::string> set;
+  for (int i = 0; i < 100; i++) {
+    set.add_new(std::to_string(i));
+  }
+  GroupProbingSet<std::string> set_copy = set;
+  EXPECT_EQ(set_copy.size(), 100);
+  EXPECT_TRUE(set_copy.contains("42"));
+  EXPECT_TRUE(set.contains("42"));
+
+  GroupProbingSet<std::string> set_moved = std::move(set);
+  EXPECT_EQ(set_moved.size(), 100);
+  EXPECT_TRUE(set_moved.contains("42"));
+  EXPECT_EQ(set.size(), 0); /* NOLINT: bugprone-use-after-move */
+  set.add("1");
+  EXPECT_TRUE(set.contains("1"));
+
+  set_copy = set_moved;
+  set_copy.clear();
+  EXPECT_TRUE(set_copy.is_empty());
+  EXPECT_FALSE(set_copy.contains("42"));
+}
+
+}  // namespace blender::tests
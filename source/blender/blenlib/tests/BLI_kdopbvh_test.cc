@@ -66,11 +66,16 @@ static void optimal_check_callback(void *userdata,
  * Note that a small epsilon is added to the BVH nodes bounds, even if we pass in zero.
  * Use rounding to ensure very close nodes don't cause the wrong node to be found as nearest.
  */
-static void find_nearest_points_test(
-    int points_len, float scale, int round, int random_seed, bool optimal = false)
+static void find_nearest_points_test(int points_len,
+                                     float scale,
+                                     int round,
+                                     int random_seed,
+                                     bool optimal = false,
+                                     int balance_flag = 0,
+                                     char tree_type = 8)
 {
   struct RNG *rng = BLI_rng_new(random_seed);
-  BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, 8, 8);
+  BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, tree_type, 8);
 
   void *mem = MEM_mallocN(sizeof(float[3]) * points_len, __func__);
   float(*points)[3] = (float(*)[3])mem;
@@ -79,7 +84,7 @@ static void find_nearest_points_test(
     rng_v3_round(points[i], 3, rng, round, scale);
     BLI_bvhtree_insert(tree, i, points[i], 1);
   }
-  BLI_bvhtree_balance(tree);
+  BLI_bvhtree_balance_ex(tree, balance_flag);
 
   /* first find each point */
   BVHTree_NearestPointCallback callback = optimal ? optimal_check_callback : NULL;
@@ -132,3 +137,178 @@ TEST(kdopbvh, OptimalFindNearest_500)
 {
   find_nearest_points_test(500, 1.0, 1000, 12, true);
 }
+
+TEST(kdopbvh, SAHFindNearest_2)
+{
+  find_nearest_points_test(2, 1.0, 1000, 123, false, BVH_BALANCE_USE_SAH);
+}
+TEST(kdopbvh, SAHFindNearest_500)
+{
+  find_nearest_points_test(500, 1.0, 1000, 12, false, BVH_BALANCE_USE_SAH);
+}
+TEST(kdopbvh, SAHFindNearest_Binary_500)
+{
+  find_nearest_points_test(500, 1.0, 1000, 12, false, BVH_BALANCE_USE_SAH, 2);
+}
+TEST(kdopbvh, SAHFindNearest_Quad_20000)
+{
+  /* Enough points to build sub-trees in parallel. */
+  find_nearest_points_test(20000, 1.0, 100000, 12, false, BVH_BALANCE_USE_SAH, 4);
+}
+TEST(kdopbvh, SAHOptimalFindNearest_500)
+{
+  find_nearest_points_test(500, 1.0, 1000, 12, true, BVH_BALANCE_USE_SAH);
+}
+
+TEST(kdopbvh, SAHDuplicatePoints)
+{
+  /* All centroids at the same position can't be split by the heuristic. */
+  const int points_len = 100;
+  BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, 4, 8);
+  const float co[3] = {1.0f, 2.0f, 3.0f};
+  for (int i = 0; i < points_len; i++) {
+    BLI_bvhtree_insert(tree, i, co, 1);
+  }
+  BLI_bvhtree_balance_ex(tree, BVH_BALANCE_USE_SAH);
+  EXPECT_EQ(BLI_bvhtree_get_len(tree), points_len);
+  EXPECT_EQ(BLI_bvhtree_find_nearest(tree, co, NULL, NULL, NULL), 0);
+  BLI_bvhtree_free(tree);
+}
+
+/**
+ * Moving the points after balancing and refitting the tree must still find them,
+ * this relies on children being stored after their parent.
+ */
+TEST(kdopbvh, SAHUpdateTree)
+{
+  const int points_len = 2000;
+  struct RNG *rng = BLI_rng_new(42);
+  BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, 4, 8);
+  float(*points)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+
+  for (int i = 0; i < points_len; i++) {
+    rng_v3_round(points[i], 3, rng, 1000, 1.0f);
+    BLI_bvhtree_insert(tree, i, points[i], 1);
+  }
+  BLI_bvhtree_balance_ex(tree, BVH_BALANCE_USE_SAH);
+
+  for (int i = 0; i < points_len; i++) {
+    points[i][0] += 10.0f;
+    BLI_bvhtree_update_node(tree, i, points[i], NULL, 1);
+  }
+  BLI_bvhtree_update_tree(tree);
+
+  for (int i = 0; i < points_len; i++) {
+    const int j = BLI_bvhtree_find_nearest(tree, points[i], NULL, NULL, NULL);
+    ASSERT_GE(j, 0);
+    EXPECT_EQ_ARRAY(points[i], points[j], 3);
+  }
+
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+  MEM_freeN(points);
+}
+
+/**
+ * Batched queries must give the same results as the single queries,
+ * use enough queries to run in parallel and to span several packets and chunks.
+ */
+TEST(kdopbvh, BatchFindNearest)
+{
+  const int points_len = 2000;
+  const int queries_len = 5000;
+  struct RNG *rng = BLI_rng_new(7);
+  BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, 4, 8);
+  float(*points)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+  float(*queries)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * queries_len, __func__);
+  BVHTreeNearest *nearest = (BVHTreeNearest *)MEM_mallocN(sizeof(*nearest) * queries_len,
+                                                          __func__);
+
+  for (int i = 0; i < points_len; i++) {
+    rng_v3_round(points[i], 3, rng, 1000, 1.0f);
+    BLI_bvhtree_insert(tree, i, points[i], 1);
+  }
+  BLI_bvhtree_balance(tree);
+
+  for (int i = 0; i < queries_len; i++) {
+    rng_v3_round(queries[i], 3, rng, 100000, 1.5f);
+    nearest[i].index = -1;
+    /* Skip every tenth query. */
+    nearest[i].dist_sq = (i % 10 == 0) ? 0.0f : FLT_MAX;
+  }
+
+  BLI_bvhtree_find_nearest_batch(tree, queries, queries_len, nearest, NULL, NULL, 0);
+
+  for (int i = 0; i < queries_len; i++) {
+    if (i % 10 == 0) {
+      EXPECT_EQ(nearest[i].index, -1);
+      continue;
+    }
+    BVHTreeNearest nearest_single;
+    nearest_single.index = -1;
+    nearest_single.dist_sq = FLT_MAX;
+    BLI_bvhtree_find_nearest(tree, queries[i], &nearest_single, NULL, NULL);
+
+    ASSERT_GE(nearest[i].index, 0);
+    EXPECT_FLOAT_EQ(nearest[i].dist_sq, nearest_single.dist_sq);
+    EXPECT_NEAR(nearest[i].dist_sq, len_squared_v3v3(queries[i], points[nearest[i].index]), 1e-6f);
+  }
+
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+  MEM_freeN(points);
+  MEM_freeN(queries);
+  MEM_freeN(nearest);
+}
+
+TEST(kdopbvh, BatchRayCast)
+{
+  const int points_len = 2000;
+  const int rays_len = 5000;
+  struct RNG *rng = BLI_rng_new(11);
+  /* The epsilon turns the points into small boxes the rays can hit. */
+  BVHTree *tree = BLI_bvhtree_new(points_len, 0.02f, 4, 8);
+  float(*co)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * rays_len, __func__);
+  float(*dir)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * rays_len, __func__);
+  BVHTreeRayHit *hit = (BVHTreeRayHit *)MEM_mallocN(sizeof(*hit) * rays_len, __func__);
+
+  for (int i = 0; i < points_len; i++) {
+    float point[3];
+    rng_v3_round(point, 3, rng, 1000, 1.0f);
+    BLI_bvhtree_insert(tree, i, point, 1);
+  }
+  BLI_bvhtree_balance(tree);
+
+  for (int i = 0; i < rays_len; i++) {
+    rng_v3_round(co[i], 3, rng, 100000, 1.5f);
+    do {
+      rng_v3_round(dir[i], 3, rng, 100000, 1.0f);
+    } while (normalize_v3(dir[i]) == 0.0f);
+    hit[i].index = -1;
+    hit[i].dist = BVH_RAYCAST_DIST_MAX;
+  }
+
+  BLI_bvhtree_ray_cast_batch(tree, co, dir, rays_len, 0.0f, hit, NULL, NULL, 0);
+
+  int hits_num = 0;
+  for (int i = 0; i < rays_len; i++) {
+    BVHTreeRayHit hit_single;
+    hit_single.index = -1;
+    hit_single.dist = BVH_RAYCAST_DIST_MAX;
+    BLI_bvhtree_ray_cast_ex(tree, co[i], dir[i], 0.0f, &hit_single, NULL, NULL, 0);
+
+    EXPECT_EQ(hit[i].index, hit_single.index);
+    if (hit_single.index != -1) {
+      EXPECT_FLOAT_EQ(hit[i].dist, hit_single.dist);
+      hits_num++;
+    }
+  }
+  /* Make sure the test isn't trivially passing. */
+  EXPECT_GT(hits_num, rays_len / 10);
+
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+  MEM_freeN(co);
+  MEM_freeN(dir);
+  MEM_freeN(hit);
+}
@@ -0,0 +1,144 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_kdtree.h"
+#include "BLI_math_vector.h"
+#include "BLI_rand.h"
+
+/* -------------------------------------------------------------------- */
+/* Helper Functions */
+
+static KDTree_3d *kdtree_random_create(const int points_len,
+                                       const int random_seed,
+                                       std::vector<std::array<float, 3>> &r_points)
+{
+  RNG *rng = BLI_rng_new(random_seed);
+  KDTree_3d *tree = BLI_kdtree_3d_new((uint)points_len);
+  r_points.resize(points_len);
+  for (int i = 0; i < points_len; i++) {
+    BLI_rng_get_float_unit_v3(rng, r_points[i].data());
+    mul_v3_fl(r_points[i].data(), BLI_rng_get_float(rng));
+    BLI_kdtree_3d_insert(tree, i, r_points[i].data());
+  }
+  BLI_kdtree_3d_balance(tree);
+  BLI_rng_free(rng);
+  return tree;
+}
+
+/* -------------------------------------------------------------------- */
+/* Tests */
+
+TEST(kdtree, Empty)
+{
+  KDTree_3d *tree = BLI_kdtree_3d_new(0);
+  BLI_kdtree_3d_balance(tree);
+  const float co[3] = {0.0f, 0.0f, 0.0f};
+  EXPECT_EQ(BLI_kdtree_3d_find_nearest(tree, co, nullptr), -1);
+
+  uint offsets[2];
+  EXPECT_EQ(BLI_kdtree_3d_range_search_batch_count(tree, &co, 1, 1.0f, offsets), 0u);
+  EXPECT_EQ(offsets[0], 0u);
+  EXPECT_EQ(offsets[1], 0u);
+  BLI_kdtree_3d_free(tree);
+}
+
+/**
+ * Enough points to balance sub-trees in parallel,
+ * every point must still be found at its own position.
+ */
+TEST(kdtree, BalanceParallel)
+{
+  const int points_len = 100000;
+  std::vector<std::array<float, 3>> points;
+  KDTree_3d *tree = kdtree_random_create(points_len, 3, points);
+
+  for (int i = 0; i < points_len; i++) {
+    KDTreeNearest_3d nearest;
+    const int index = BLI_kdtree_3d_find_nearest(tree, points[i].data(), &nearest);
+    ASSERT_GE(index, 0);
+    EXPECT_EQ(nearest.dist, 0.0f);
+  }
+
+  /* Re-balancing must give the same result. */
+  BLI_kdtree_3d_balance(tree);
+  for (int i = 0; i < points_len; i += 100) {
+    KDTreeNearest_3d nearest;
+    BLI_kdtree_3d_find_nearest(tree, points[i].data(), &nearest);
+    EXPECT_EQ(nearest.dist, 0.0f);
+  }
+
+  BLI_kdtree_3d_free(tree);
+}
+
+TEST(kdtree, RangeSearchBatch)
+{
+  const int points_len = 20000;
+  const float range = 0.05f;
+  std::vector<std::array<float, 3>> points;
+  KDTree_3d *tree = kdtree_random_create(points_len, 5, points);
+  const float(*co)[3] = (const float(*)[3])points.data();
+
+  std::vector<uint> offsets(points_len + 1);
+  const uint total = BLI_kdtree_3d_range_search_batch_count(
+      tree, co, (uint)points_len, range, offsets.data());
+  std::vector<int> neighbors(total);
+  std::vector<float> dist_sq(total);
+  BLI_kdtree_3d_range_search_batch(
+      tree, co, (uint)points_len, range, offsets.data(), neighbors.data(), dist_sq.data());
+
+  for (int i = 0; i < points_len; i++) {
+    KDTreeNearest_3d *nearest = nullptr;
+    const int found = BLI_kdtree_3d_range_search(tree, co[i], &nearest, range);
+    ASSERT_EQ((uint)found, offsets[i + 1] - offsets[i]);
+
+    std::vector<int> expected, actual;
+    for (int j = 0; j < found; j++) {
+      expected.push_back(nearest[j].index);
+    }
+    for (uint j = offsets[i]; j < offsets[i + 1]; j++) {
+      actual.push_back(neighbors[j]);
+      EXPECT_FLOAT_EQ(dist_sq[j], len_squared_v3v3(co[i], co[neighbors[j]]));
+    }
+    std::sort(expected.begin(), expected.end());
+    std::sort(actual.begin(), actual.end());
+    EXPECT_EQ_VECTOR(expected, actual);
+
+    if (nearest) {
+      MEM_freeN(nearest);
+    }
+  }
+
+  BLI_kdtree_3d_free(tree);
+}
+
+TEST(kdtree, FindNearestNBatch)
+{
+  const int points_len = 5000;
+  const uint nearest_len = 4;
+  std::vector<std::array<float, 3>> points;
+  KDTree_3d *tree = kdtree_random_create(points_len, 9, points);
+  const float(*co)[3] = (const float(*)[3])points.data();
+
+  std::vector<KDTreeNearest_3d> nearest(points_len * nearest_len);
+  std::vector<int> found(points_len);
+  BLI_kdtree_3d_find_nearest_n_batch(
+      tree, co, (uint)points_len, nearest.data(), nearest_len, found.data());
+
+  for (int i = 0; i < points_len; i++) {
+    KDTreeNearest_3d expected[nearest_len];
+    ASSERT_EQ(BLI_kdtree_3d_find_nearest_n(tree, co[i], expected, nearest_len), found[i]);
+    for (int j = 0; j < found[i]; j++) {
+      EXPECT_EQ(nearest[i * nearest_len + j].index, expected[j].index);
+      EXPECT_EQ(nearest[i * nearest_len + j].dist, expected[j].dist);
+    }
+  }
+
+  BLI_kdtree_3d_free(tree);
+}
@@ -0,0 +1,107 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "BLI_array.hh"
+#include "BLI_math_batch.hh"
+#include "BLI_rand.h"
+
+namespace blender::math::tests {
+
+/* Sizes that are not a multiple of the SIMD width, so that the remainder loops are tested too. */
+static const int test_sizes[] = {0, 1, 2, 7, 8, 9, 31, 1000};
+
+static Array<float3> random_vectors(const int size, const unsigned int seed)
+{
+  Array<float3> vectors(size);
+  RNG *rng = BLI_rng_new(seed);
+  for (float3 &vector : vectors) {
+    vector = float3(BLI_rng_get_float(rng) * 20.0f - 10.0f,
+                    BLI_rng_get_float(rng) * 20.0f - 10.0f,
+                    BLI_rng_get_float(rng) * 20.0f - 10.0f);
+  }
+  BLI_rng_free(rng);
+  return vectors;
+}
+
+static float4x4 test_matrix(const float offset)
+{
+  float4x4 matrix;
+  float loc[3] = {1.0f + offset, -2.0f, 3.0f};
+  float rot[3] = {0.3f, -1.2f, 2.0f + offset};
+  float size[3] = {1.5f, 0.5f, -2.0f};
+  loc_eul_size_to_mat4(matrix.values, loc, rot, size);
+  return matrix;
+}
+
+static void expect_near(const float3 &a, const float3 &b)
+{
+  EXPECT_NEAR(a.x, b.x, 1e-4f);
+  EXPECT_NEAR(a.y, b.y, 1e-4f);
+  EXPECT_NEAR(a.z, b.z, 1e-4f);
+}
+
+TEST(math_batch, TransformPoints)
+{
+  const float4x4 matrix = test_matrix(0.0f);
+  for (const int size : test_sizes) {
+    const Array<float3> src = random_vectors(size, 1);
+    Array<float3> dst(size);
+    transform_points(matrix, src, dst);
+    for (const int i : IndexRange(size)) {
+      expect_near(dst[i], matrix * src[i]);
+    }
+
+    Array<float3> points = src;
+    transform_points(matrix, points);
+    for (const int i : IndexRange(size)) {
+      expect_near(points[i], matrix * src[i]);
+    }
+  }
+}
+
+TEST(math_batch, TransformPointsPerElement)
+{
+  for (const int size : test_sizes) {
+    const Array<float3> src = random_vectors(size, 2);
+    Array<float4x4> matrices(size);
+    for (const int i : IndexRange(size)) {
+      matrices[i] = test_matrix(static_cast<float>(i));
+    }
+    Array<float3> points = src;
+    transform_points(matrices, points);
+    for (const int i : IndexRange(size)) {
+      expect_near(points[i], matrices[i] * src[i]);
+    }
+  }
+}
+
+TEST(math_batch, TransformDirections)
+{
+  const float4x4 matrix = test_matrix(0.0f);
+  for (const int size : test_sizes) {
+    const Array<float3> src = random_vectors(size, 3);
+    Array<float3> dst(size);
+    transform_directions(matrix, src, dst);
+    for (const int i : IndexRange(size)) {
+      expect_near(dst[i], matrix.ref_3x3() * src[i]);
+    }
+  }
+}
+
+TEST(math_batch, Normalize)
+{
+  for (const int size : test_sizes) {
+    Array<float3> vectors = random_vectors(size, 4);
+    if (size > 3) {
+      vectors[3] = float3(0.0f);
+    }
+    const Array<float3> src = vectors;
+    normalize(vectors);
+    for (const int i : IndexRange(size)) {
+      expect_near(vectors[i], src[i].normalized());
+    }
+  }
+}
+
+}  // namespace blender::math::tests
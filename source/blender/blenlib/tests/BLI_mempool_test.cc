@@ -0,0 +1,124 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_mempool.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+#include "BLI_utildefines.h"
+
+struct MempoolTestElem {
+  int value;
+  int pad[3];
+};
+
+static int mempool_sum_values(BLI_mempool *pool, int *r_len)
+{
+  BLI_mempool_iter iter;
+  BLI_mempool_iternew(pool, &iter);
+  int sum = 0, len = 0;
+  for (MempoolTestElem *elem = (MempoolTestElem *)BLI_mempool_iterstep(&iter); elem;
+       elem = (MempoolTestElem *)BLI_mempool_iterstep(&iter)) {
+    sum += elem->value;
+    len++;
+  }
+  *r_len = len;
+  return sum;
+}
+
+TEST(mempool, AllocFreeIter)
+{
+  BLI_mempool *pool = BLI_mempool_create(
+      sizeof(MempoolTestElem), 0, 32, BLI_MEMPOOL_ALLOW_ITER);
+  MempoolTestElem *elems[100];
+  for (int i = 0; i < 100; i++) {
+    elems[i] = (MempoolTestElem *)BLI_mempool_calloc(pool);
+    elems[i]->value = i;
+  }
+  for (int i = 0; i < 100; i += 2) {
+    BLI_mempool_free(pool, elems[i]);
+  }
+  EXPECT_EQ(BLI_mempool_len(pool), 50);
+
+  int len;
+  /* Sum of the odd numbers below 100. */
+  EXPECT_EQ(mempool_sum_values(pool, &len), 2500);
+  EXPECT_EQ(len, 50);
+
+  BLI_mempool_destroy(pool);
+}
+
+struct MempoolThreadData {
+  BLI_mempool *pool;
+  MempoolTestElem **elems;
+};
+
+static void mempool_alloc_cb(void *__restrict userdata,
+                             const int i,
+                             const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  MempoolThreadData *data = (MempoolThreadData *)userdata;
+  MempoolTestElem *elem = (MempoolTestElem *)BLI_mempool_alloc(data->pool);
+  elem->value = 1;
+  data->elems[i] = elem;
+}
+
+static void mempool_free_odd_cb(void *__restrict userdata,
+                                const int i,
+                                const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  MempoolThreadData *data = (MempoolThreadData *)userdata;
+  if (i & 1) {
+    BLI_mempool_free(data->pool, data->elems[i]);
+    data->elems[i] = NULL;
+  }
+}
+
+TEST(mempool, ThreadSafe)
+{
+  const int elems_len = 100000;
+  BLI_threadapi_init();
+
+  MempoolThreadData data;
+  data.pool = BLI_mempool_create(
+      sizeof(MempoolTestElem), 0, 512, BLI_MEMPOOL_ALLOW_ITER | BLI_MEMPOOL_THREADSAFE);
+  data.elems = (MempoolTestElem **)MEM_malloc_arrayN(
+      elems_len, sizeof(*data.elems), __func__);
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 64;
+
+  BLI_task_parallel_range(0, elems_len, &data, mempool_alloc_cb, &settings);
+  EXPECT_EQ(BLI_mempool_len(data.pool), elems_len);
+
+  /* All elements are distinct. */
+  int len;
+  EXPECT_EQ(mempool_sum_values(data.pool, &len), elems_len);
+  EXPECT_EQ(len, elems_len);
+
+  BLI_task_parallel_range(0, elems_len, &data, mempool_free_odd_cb, &settings);
+  EXPECT_EQ(BLI_mempool_len(data.pool), elems_len / 2);
+  EXPECT_EQ(mempool_sum_values(data.pool, &len), elems_len / 2);
+  EXPECT_EQ(len, elems_len / 2);
+
+  /* Freed elements are reused (from the thread caches or the pool). */
+  BLI_task_parallel_range(0, elems_len / 2, &data, mempool_alloc_cb, &settings);
+  EXPECT_EQ(BLI_mempool_len(data.pool), elems_len);
+  EXPECT_EQ(mempool_sum_values(data.pool, &len), elems_len);
+
+  void **table = BLI_mempool_as_tableN(data.pool, __func__);
+  MEM_freeN(table);
+
+  BLI_mempool_clear(data.pool);
+  EXPECT_EQ(BLI_mempool_len(data.pool), 0);
+  EXPECT_EQ(mempool_sum_values(data.pool, &len), 0);
+  BLI_task_parallel_range(0, elems_len, &data, mempool_alloc_cb, &settings);
+  EXPECT_EQ(BLI_mempool_len(data.pool), elems_len);
+
+  MEM_freeN(data.elems);
+  BLI_mempool_destroy(data.pool);
+  BLI_threadapi_exit();
+}
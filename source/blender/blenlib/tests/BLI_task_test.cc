@@ -12,6 +12,9 @@
 #include "BLI_listbase.h"
 #include "BLI_mempool.h"
 #include "BLI_task.h"
+#include "BLI_threads.h"
+
+#include "PIL_time.h"
 
 #define NUM_ITEMS 10000
 
@@ -181,3 +184,195 @@ TEST(task, ListBaseIter)
   MEM_freeN(items_buffer);
   BLI_threadapi_exit();
 }
+
+/* *** Task pool with affinity hints. *** */
+
+#define NUM_AFFINITY_GROUPS 16
+
+/* Hints are ignored without threads, also test them on machines with a single core. */
+static void task_pool_affinity_threads_begin()
+{
+  BLI_threadapi_init();
+  BLI_system_num_threads_override_set(4);
+  BLI_task_scheduler_init();
+}
+
+static void task_pool_affinity_threads_end()
+{
+  BLI_task_scheduler_exit();
+  BLI_system_num_threads_override_set(0);
+  BLI_task_scheduler_init();
+  BLI_threadapi_exit();
+}
+
+static void task_pool_affinity_func(TaskPool *__restrict pool, void *taskdata)
+{
+  int *data = (int *)BLI_task_pool_user_data(pool);
+  int *group = (int *)taskdata;
+
+  atomic_add_and_fetch_uint32((uint32_t *)group, 1);
+  atomic_add_and_fetch_uint32((uint32_t *)data, 1);
+}
+
+TEST(task, PoolAffinity)
+{
+  int groups[NUM_AFFINITY_GROUPS] = {0};
+  int count = 0;
+
+  task_pool_affinity_threads_begin();
+
+  TaskPool *pool = BLI_task_pool_create(&count, TASK_PRIORITY_HIGH);
+  for (int i = 0; i < NUM_ITEMS; i++) {
+    int *group = &groups[i % NUM_AFFINITY_GROUPS];
+    BLI_task_pool_push_affinity(pool, task_pool_affinity_func, group, false, NULL, group);
+  }
+  BLI_task_pool_work_and_wait(pool);
+
+  TaskPoolStats stats;
+  BLI_task_pool_stats_get(pool, &stats);
+  BLI_task_pool_free(pool);
+
+  EXPECT_EQ(count, NUM_ITEMS);
+  for (int i = 0; i < NUM_AFFINITY_GROUPS; i++) {
+    EXPECT_EQ(groups[i], NUM_ITEMS / NUM_AFFINITY_GROUPS);
+  }
+  EXPECT_EQ(stats.num_tasks, NUM_ITEMS);
+  EXPECT_EQ(stats.num_affinity_tasks, NUM_ITEMS);
+#ifdef WITH_TBB
+  /* Tasks pushed from outside the pool are not related to a running task. */
+  EXPECT_EQ(stats.num_affinity_runs, NUM_ITEMS);
+#endif
+
+  task_pool_affinity_threads_end();
+}
+
+/* Chains of tasks, every task pushes the next one of its chain with the same hint. */
+
+#define NUM_AFFINITY_CHAIN_LEN 1000
+
+struct AffinityChain {
+  int len;
+  int num_same_thread;
+  int thread_id;
+};
+
+static void task_pool_affinity_chain_func(TaskPool *__restrict pool, void *taskdata)
+{
+  AffinityChain *chain = (AffinityChain *)taskdata;
+  const int thread_id = BLI_task_parallel_thread_id(NULL);
+
+  /* Only one task of a chain exists at a time. */
+  if (chain->len != 0 && chain->thread_id == thread_id) {
+    chain->num_same_thread++;
+  }
+  chain->thread_id = thread_id;
+  chain->len++;
+
+  if (chain->len < NUM_AFFINITY_CHAIN_LEN) {
+    BLI_task_pool_push_affinity(pool, task_pool_affinity_chain_func, chain, false, NULL, chain);
+  }
+}
+
+TEST(task, PoolAffinityChain)
+{
+  AffinityChain chains[NUM_AFFINITY_GROUPS] = {{0}};
+
+  task_pool_affinity_threads_begin();
+
+  TaskPool *pool = BLI_task_pool_create(NULL, TASK_PRIORITY_HIGH);
+  for (int i = 0; i < NUM_AFFINITY_GROUPS; i++) {
+    BLI_task_pool_push_affinity(
+        pool, task_pool_affinity_chain_func, &chains[i], false, NULL, &chains[i]);
+  }
+  BLI_task_pool_work_and_wait(pool);
+
+  TaskPoolStats stats;
+  BLI_task_pool_stats_get(pool, &stats);
+  BLI_task_pool_free(pool);
+
+  for (int i = 0; i < NUM_AFFINITY_GROUPS; i++) {
+    EXPECT_EQ(chains[i].len, NUM_AFFINITY_CHAIN_LEN);
+    /* The next task of a chain is run by the thread which pushed it, unless an idle thread
+     * started it first. That can happen, but not for most tasks of the chain. */
+    EXPECT_GT(chains[i].num_same_thread, NUM_AFFINITY_CHAIN_LEN / 2);
+  }
+  EXPECT_EQ(stats.num_affinity_tasks, NUM_AFFINITY_GROUPS * NUM_AFFINITY_CHAIN_LEN);
+#ifdef WITH_TBB
+  EXPECT_LT(stats.num_affinity_runs, stats.num_affinity_tasks / 2);
+  EXPECT_GT(stats.max_affinity_run_len, 1);
+#endif
+
+  task_pool_affinity_threads_end();
+}
+
+#ifdef WITH_TBB
+/* Tasks which only finish once the other task started, so they have to run concurrently. */
+
+struct AffinityRendezvous {
+  int num_started;
+  int num_timeout;
+  /* Hint of the task pushed by the first task. */
+  const void *affinity_other;
+};
+
+static void task_pool_affinity_rendezvous_wait(AffinityRendezvous *rendezvous)
+{
+  atomic_add_and_fetch_uint32((uint32_t *)&rendezvous->num_started, 1);
+  const double time_end = PIL_check_seconds_timer() + 10.0;
+  while (atomic_add_and_fetch_uint32((uint32_t *)&rendezvous->num_started, 0) < 2) {
+    if (PIL_check_seconds_timer() > time_end) {
+      atomic_add_and_fetch_uint32((uint32_t *)&rendezvous->num_timeout, 1);
+      break;
+    }
+  }
+}
+
+static void task_pool_affinity_rendezvous_other_func(TaskPool *__restrict pool,
+                                                     void *UNUSED(taskdata))
+{
+  task_pool_affinity_rendezvous_wait((AffinityRendezvous *)BLI_task_pool_user_data(pool));
+}
+
+static void task_pool_affinity_rendezvous_func(TaskPool *__restrict pool, void *UNUSED(taskdata))
+{
+  AffinityRendezvous *rendezvous = (AffinityRendezvous *)BLI_task_pool_user_data(pool);
+  /* The pushed task must not wait for this one to finish. */
+  BLI_task_pool_push_affinity(pool,
+                              task_pool_affinity_rendezvous_other_func,
+                              NULL,
+                              false,
+                              NULL,
+                              rendezvous->affinity_other);
+  task_pool_affinity_rendezvous_wait(rendezvous);
+}
+
+static void task_pool_affinity_rendezvous_test(const bool same_affinity)
+{
+  AffinityRendezvous rendezvous = {0};
+  int affinity_first, affinity_second;
+  rendezvous.affinity_other = same_affinity ? &affinity_first : &affinity_second;
+
+  TaskPool *pool = BLI_task_pool_create(&rendezvous, TASK_PRIORITY_HIGH);
+  BLI_task_pool_push_affinity(
+      pool, task_pool_affinity_rendezvous_func, NULL, false, NULL, &affinity_first);
+  BLI_task_pool_work_and_wait(pool);
+  BLI_task_pool_free(pool);
+
+  EXPECT_EQ(rendezvous.num_started, 2);
+  EXPECT_EQ(rendezvous.num_timeout, 0);
+}
+
+TEST(task, PoolAffinityConcurrent)
+{
+  /* The scheduler does not run more tasks at once than there are cores. */
+  if (BLI_system_thread_count() < 2) {
+    GTEST_SKIP();
+  }
+  task_pool_affinity_threads_begin();
+
+  task_pool_affinity_rendezvous_test(false);
+  task_pool_affinity_rendezvous_test(true);
+
+  task_pool_affinity_threads_end();
+}
+#endif
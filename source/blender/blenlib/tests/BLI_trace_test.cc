@@ -0,0 +1,100 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "BLI_fileops.h"
+#include "BLI_trace.h"
+
+namespace blender::trace::tests {
+
+static std::string trace_filepath()
+{
+  return ::testing::TempDir() + "BLI_trace_test.json";
+}
+
+static std::string trace_read_and_delete(const std::string &filepath)
+{
+  std::ifstream file(filepath);
+  std::stringstream stream;
+  stream << file.rdbuf();
+  file.close();
+  BLI_delete(filepath.c_str(), false, false);
+  return stream.str();
+}
+
+static int count_occurrences(const std::string &str, const std::string &sub)
+{
+  int count = 0;
+  for (size_t pos = str.find(sub); pos != std::string::npos; pos = str.find(sub, pos + 1)) {
+    count++;
+  }
+  return count;
+}
+
+TEST(trace, NestedZones)
+{
+  const std::string filepath = trace_filepath();
+  BLI_trace_session_begin(filepath.c_str());
+  EXPECT_TRUE(BLI_trace_is_active());
+  BLI_trace_zone_begin("test", "Outer");
+  {
+    ScopedZone zone("test", "Inner \"quoted\"");
+  }
+  BLI_trace_zone_end();
+  EXPECT_TRUE(BLI_trace_session_end());
+  EXPECT_FALSE(BLI_trace_is_active());
+
+  const std::string json = trace_read_and_delete(filepath);
+  EXPECT_EQ(json.rfind("{\"traceEvents\":[", 0), 0);
+  EXPECT_EQ(count_occurrences(json, "\"ph\":\"X\""), 2);
+  EXPECT_EQ(count_occurrences(json, "\"cat\":\"test\""), 2);
+  EXPECT_NE(json.find("\"name\":\"Outer\""), std::string::npos);
+  EXPECT_NE(json.find("\"name\":\"Inner \\\"quoted\\\"\""), std::string::npos);
+}
+
+TEST(trace, InactiveZones)
+{
+  /* Zones outside of a session are ignored, also when they end during a session. */
+  BLI_trace_zone_begin("test", "Before");
+  const std::string filepath = trace_filepath();
+  BLI_trace_session_begin(filepath.c_str());
+  BLI_trace_zone_end();
+  BLI_trace_zone_begin("test", "During");
+  BLI_trace_zone_end();
+  EXPECT_TRUE(BLI_trace_session_end());
+  BLI_trace_zone_begin("test", "After");
+  BLI_trace_zone_end();
+
+  const std::string json = trace_read_and_delete(filepath);
+  EXPECT_EQ(count_occurrences(json, "\"ph\":\"X\""), 1);
+  EXPECT_NE(json.find("\"name\":\"During\""), std::string::npos);
+}
+
+TEST(trace, Threads)
+{
+  const std::string filepath = trace_filepath();
+  BLI_trace_session_begin(filepath.c_str());
+  std::thread threads[4];
+  for (std::thread &thread : threads) {
+    thread = std::thread([]() {
+      for (int i = 0; i < 100; i++) {
+        ScopedZone zone("test", "Work");
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  EXPECT_TRUE(BLI_trace_session_end());
+
+  const std::string json = trace_read_and_delete(filepath);
+  EXPECT_EQ(count_occurrences(json, "\"ph\":\"X\""), 400);
+  EXPECT_EQ(count_occurrences(json, "\"name\":\"thread_name\""), 4);
+}
+
+}  // namespace blender::trace::tests
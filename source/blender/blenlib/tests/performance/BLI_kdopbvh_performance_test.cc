@@ -0,0 +1,254 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_kdopbvh.h"
+#include "BLI_math.h"
+#include "BLI_rand.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+#include "BLI_utildefines.h"
+
+#include "PIL_time.h"
+
+/* Compares the build and query time of the median split trees with the binned SAH trees
+ * (#BVH_BALANCE_USE_SAH), on triangle soups similar to scans: dense clusters of small triangles
+ * next to a few large ones. The single queries are also compared with the batched queries. */
+
+#define NUM_RUN_AVERAGED 5
+#define NUM_QUERIES 200000
+
+struct TriangleSoup {
+  float (*verts)[3];
+  int tris_num;
+};
+
+static TriangleSoup triangle_soup_create(const int tris_num, const int random_seed)
+{
+  TriangleSoup soup;
+  soup.tris_num = tris_num;
+  soup.verts = (float(*)[3])MEM_mallocN(sizeof(float[3]) * 3 * (size_t)tris_num, __func__);
+
+  RNG *rng = BLI_rng_new(random_seed);
+  const int clusters_num = 64;
+  float(*cluster_centers)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * clusters_num,
+                                                       __func__);
+  for (int i = 0; i < clusters_num; i++) {
+    BLI_rng_get_float_unit_v3(rng, cluster_centers[i]);
+    mul_v3_fl(cluster_centers[i], 10.0f * BLI_rng_get_float(rng));
+  }
+
+  for (int i = 0; i < tris_num; i++) {
+    float center[3], offset[3];
+    /* Every hundredth triangle is large, the others are in a cluster. */
+    const bool is_large = (i % 100) == 0;
+    const float size = is_large ? 1.0f : 0.01f;
+    if (is_large) {
+      BLI_rng_get_float_unit_v3(rng, center);
+      mul_v3_fl(center, 10.0f * BLI_rng_get_float(rng));
+    }
+    else {
+      BLI_rng_get_float_unit_v3(rng, offset);
+      madd_v3_v3v3fl(center,
+                     cluster_centers[BLI_rng_get_int(rng) % clusters_num],
+                     offset,
+                     BLI_rng_get_float(rng));
+    }
+    for (int j = 0; j < 3; j++) {
+      BLI_rng_get_float_unit_v3(rng, offset);
+      madd_v3_v3v3fl(soup.verts[i * 3 + j], center, offset, size);
+    }
+  }
+
+  MEM_freeN(cluster_centers);
+  BLI_rng_free(rng);
+  return soup;
+}
+
+static void triangle_soup_free(TriangleSoup *soup)
+{
+  MEM_freeN(soup->verts);
+}
+
+static BVHTree *triangle_soup_tree_build(const TriangleSoup *soup,
+                                         const char tree_type,
+                                         const int balance_flag)
+{
+  BVHTree *tree = BLI_bvhtree_new(soup->tris_num, 0.0f, tree_type, 6);
+  for (int i = 0; i < soup->tris_num; i++) {
+    BLI_bvhtree_insert(tree, i, soup->verts[i * 3], 3);
+  }
+  BLI_bvhtree_balance_ex(tree, balance_flag);
+  return tree;
+}
+
+static void raycast_cb(void *userdata, int index, const BVHTreeRay *ray, BVHTreeRayHit *hit)
+{
+  const TriangleSoup *soup = (const TriangleSoup *)userdata;
+  const float(*tri)[3] = &soup->verts[index * 3];
+  float dist;
+  if (isect_ray_tri_v3(ray->origin, ray->direction, tri[0], tri[1], tri[2], &dist, NULL) &&
+      dist < hit->dist) {
+    hit->index = index;
+    hit->dist = dist;
+  }
+}
+
+static void nearest_cb(void *userdata, int index, const float co[3], BVHTreeNearest *nearest)
+{
+  const TriangleSoup *soup = (const TriangleSoup *)userdata;
+  const float(*tri)[3] = &soup->verts[index * 3];
+  float closest[3];
+  closest_on_tri_to_point_v3(closest, co, tri[0], tri[1], tri[2]);
+  const float dist_sq = len_squared_v3v3(co, closest);
+  if (dist_sq < nearest->dist_sq) {
+    nearest->index = index;
+    nearest->dist_sq = dist_sq;
+    copy_v3_v3(nearest->co, closest);
+  }
+}
+
+struct QueryData {
+  BVHTree *tree;
+  const TriangleSoup *soup;
+  float (*origins)[3];
+  float (*directions)[3];
+  BVHTreeRayHit *hits;
+  BVHTreeNearest *nearest;
+};
+
+static void raycast_task_cb(void *__restrict userdata,
+                            const int i,
+                            const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  QueryData *data = (QueryData *)userdata;
+  BVHTreeRayHit hit;
+  hit.index = -1;
+  hit.dist = BVH_RAYCAST_DIST_MAX;
+  BLI_bvhtree_ray_cast(data->tree,
+                       data->origins[i],
+                       data->directions[i],
+                       0.0f,
+                       &hit,
+                       raycast_cb,
+                       (void *)data->soup);
+}
+
+static void nearest_task_cb(void *__restrict userdata,
+                            const int i,
+                            const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  QueryData *data = (QueryData *)userdata;
+  BVHTreeNearest nearest;
+  nearest.index = -1;
+  nearest.dist_sq = FLT_MAX;
+  BLI_bvhtree_find_nearest(
+      data->tree, data->origins[i], &nearest, nearest_cb, (void *)data->soup);
+}
+
+static void kdopbvh_performance_test(const int tris_num, const char tree_type)
+{
+  printf("\n========== %d triangles, tree type %d ==========\n", tris_num, tree_type);
+
+  BLI_threadapi_init();
+  TriangleSoup soup = triangle_soup_create(tris_num, 42);
+
+  QueryData data = {NULL, &soup, NULL, NULL, NULL, NULL};
+  data.origins = (float(*)[3])MEM_mallocN(sizeof(float[3]) * NUM_QUERIES, __func__);
+  data.directions = (float(*)[3])MEM_mallocN(sizeof(float[3]) * NUM_QUERIES, __func__);
+  data.hits = (BVHTreeRayHit *)MEM_mallocN(sizeof(BVHTreeRayHit) * NUM_QUERIES, __func__);
+  data.nearest = (BVHTreeNearest *)MEM_mallocN(sizeof(BVHTreeNearest) * NUM_QUERIES, __func__);
+  RNG *rng = BLI_rng_new(1);
+  for (int i = 0; i < NUM_QUERIES; i++) {
+    BLI_rng_get_float_unit_v3(rng, data.origins[i]);
+    mul_v3_fl(data.origins[i], 12.0f * BLI_rng_get_float(rng));
+    BLI_rng_get_float_unit_v3(rng, data.directions[i]);
+  }
+  BLI_rng_free(rng);
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+
+  const char *names[2] = {"Median", "SAH"};
+  const int flags[2] = {0, BVH_BALANCE_USE_SAH};
+  for (int mode = 0; mode < 2; mode++) {
+    double build_time = 0.0, raycast_time = 0.0, nearest_time = 0.0;
+    double raycast_batch_time = 0.0, nearest_batch_time = 0.0;
+    for (int run = 0; run < NUM_RUN_AVERAGED; run++) {
+      double time = PIL_check_seconds_timer();
+      data.tree = triangle_soup_tree_build(&soup, tree_type, flags[mode]);
+      build_time += PIL_check_seconds_timer() - time;
+
+      time = PIL_check_seconds_timer();
+      BLI_task_parallel_range(0, NUM_QUERIES, &data, raycast_task_cb, &settings);
+      raycast_time += PIL_check_seconds_timer() - time;
+
+      time = PIL_check_seconds_timer();
+      BLI_task_parallel_range(0, NUM_QUERIES, &data, nearest_task_cb, &settings);
+      nearest_time += PIL_check_seconds_timer() - time;
+
+      for (int i = 0; i < NUM_QUERIES; i++) {
+        data.hits[i].index = -1;
+        data.hits[i].dist = BVH_RAYCAST_DIST_MAX;
+        data.nearest[i].index = -1;
+        data.nearest[i].dist_sq = FLT_MAX;
+      }
+
+      time = PIL_check_seconds_timer();
+      BLI_bvhtree_ray_cast_batch(data.tree,
+                                 data.origins,
+                                 data.directions,
+                                 NUM_QUERIES,
+                                 0.0f,
+                                 data.hits,
+                                 raycast_cb,
+                                 &soup,
+                                 0);
+      raycast_batch_time += PIL_check_seconds_timer() - time;
+
+      time = PIL_check_seconds_timer();
+      BLI_bvhtree_find_nearest_batch(
+          data.tree, data.origins, NUM_QUERIES, data.nearest, nearest_cb, &soup, 0);
+      nearest_batch_time += PIL_check_seconds_timer() - time;
+
+      BLI_bvhtree_free(data.tree);
+    }
+    printf("\t%s: build %fs, %d ray-casts %fs, %d nearest %fs (average of %d runs)\n",
+           names[mode],
+           build_time / NUM_RUN_AVERAGED,
+           NUM_QUERIES,
+           raycast_time / NUM_RUN_AVERAGED,
+           NUM_QUERIES,
+           nearest_time / NUM_RUN_AVERAGED,
+           NUM_RUN_AVERAGED);
+    printf("\t%s batched: %d ray-casts %fs, %d nearest %fs\n",
+           names[mode],
+           NUM_QUERIES,
+           raycast_batch_time / NUM_RUN_AVERAGED,
+           NUM_QUERIES,
+           nearest_batch_time / NUM_RUN_AVERAGED);
+  }
+
+  MEM_freeN(data.origins);
+  MEM_freeN(data.directions);
+  MEM_freeN(data.hits);
+  MEM_freeN(data.nearest);
+  triangle_soup_free(&soup);
+}
+
+TEST(kdopbvh, Build100k_Binary)
+{
+  kdopbvh_performance_test(100000, 2);
+}
+
+TEST(kdopbvh, Build100k_Quad)
+{
+  kdopbvh_performance_test(100000, 4);
+}
+
+TEST(kdopbvh, Build2M_Quad)
+{
+  kdopbvh_performance_test(2000000, 4);
+}
@@ -0,0 +1,159 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "BLI_group_probing_map.hh"
+#include "BLI_group_probing_set.hh"
+#include "BLI_map.hh"
+#include "BLI_rand.h"
+#include "BLI_set.hh"
+#include "BLI_timeit.hh"
+#include "BLI_vector.hh"
+
+/* Compares the probing strategies of #blender::Map and #blender::Set with #GroupProbingMap and
+ * #GroupProbingSet on tables with millions of entries, where most probes are cache misses.
+ * Lookups are done for existing and missing keys, because failed lookups have to probe until an
+ * empty slot is found. */
+
+namespace blender::tests {
+
+template<typename MapT>
+BLI_NOINLINE void benchmark_map(StringRef name, Span<int64_t> keys, Span<int64_t> missing_keys)
+{
+  MapT map;
+  {
+    SCOPED_TIMER(name + " Add");
+    for (const int64_t key : keys) {
+      map.add(key, key);
+    }
+  }
+  int64_t count = 0;
+  {
+    SCOPED_TIMER(name + " Lookup");
+    for (const int64_t key : keys) {
+      count += *map.lookup_ptr(key);
+    }
+  }
+  {
+    SCOPED_TIMER(name + " Lookup missing");
+    for (const int64_t key : missing_keys) {
+      count += map.contains(key);
+    }
+  }
+  {
+    SCOPED_TIMER(name + " Remove");
+    for (const int64_t key : keys) {
+      count += map.remove(key);
+    }
+  }
+  /* Print the value for simple error checking and to avoid some compiler optimizations. */
+  std::cout << "Count: " << count << "\n";
+}
+
+template<typename SetT>
+BLI_NOINLINE void benchmark_set(StringRef name, Span<int64_t> keys, Span<int64_t> missing_keys)
+{
+  SetT set;
+  {
+    SCOPED_TIMER(name + " Add");
+    for (const int64_t key : keys) {
+      set.add(key);
+    }
+  }
+  int64_t count = 0;
+  {
+    SCOPED_TIMER(name + " Contains");
+    for (const int64_t key : keys) {
+      count += set.contains(key);
+    }
+  }
+  {
+    SCOPED_TIMER(name + " Contains missing");
+    for (const int64_t key : missing_keys) {
+      count += set.contains(key);
+    }
+  }
+  std::cout << "Count: " << count << "\n";
+}
+
+static void benchmark_maps(Span<int64_t> keys, Span<int64_t> missing_keys)
+{
+  benchmark_map<Map<int64_t, int64_t>>("Python     ", keys, missing_keys);
+  benchmark_map<Map<int64_t, int64_t, 4, PythonProbingStrategy<4>>>(
+      "Python<4>  ", keys, missing_keys);
+  benchmark_map<Map<int64_t, int64_t, 4, ShuffleProbingStrategy<>>>(
+      "Shuffle    ", keys, missing_keys);
+  benchmark_map<GroupProbingMap<int64_t, int64_t>>("Group map  ", keys, missing_keys);
+}
+
+static void benchmark_sets(Span<int64_t> keys, Span<int64_t> missing_keys)
+{
+  benchmark_set<Set<int64_t>>("Python     ", keys, missing_keys);
+  benchmark_set<Set<int64_t, 4, PythonProbingStrategy<4>>>("Python<4>  ", keys, missing_keys);
+  benchmark_set<Set<int64_t, 4, ShuffleProbingStrategy<>>>("Shuffle    ", keys, missing_keys);
+  benchmark_set<GroupProbingSet<int64_t>>("Group set  ", keys, missing_keys);
+}
+
+static void random_keys(const int amount, Vector<int64_t> &r_keys, Vector<int64_t> &r_missing)
+{
+  RNG *rng = BLI_rng_new(0);
+  for (int i = 0; i < amount; i++) {
+    /* Odd keys are added, even keys are used for the failed lookups. */
+    const int64_t value = (int64_t)(BLI_rng_get_uint(rng) >> 1);
+    r_keys.append(value * 2 + 1);
+    r_missing.append(value * 2);
+  }
+  BLI_rng_free(rng);
+}
+
+/* Keys like the ones for edge hashing of a grid mesh, both vertex indices packed into one
+ * integer. Looked up in the order they are added, like when iterating over the faces. */
+static void grid_edge_keys(const int size, Vector<int64_t> &r_keys, Vector<int64_t> &r_missing)
+{
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      const int64_t v = y * (size + 1) + x;
+      r_keys.append((v << 32) | (v + 1));
+      r_keys.append((v << 32) | (v + size + 1));
+      /* Diagonals aren't edges. */
+      r_missing.append((v << 32) | (v + size + 2));
+    }
+  }
+}
+
+TEST(map_performance, RandomInts1M)
+{
+  Vector<int64_t> keys, missing;
+  random_keys(1000000, keys, missing);
+  benchmark_maps(keys, missing);
+}
+
+TEST(map_performance, RandomInts8M)
+{
+  Vector<int64_t> keys, missing;
+  random_keys(8000000, keys, missing);
+  benchmark_maps(keys, missing);
+}
+
+TEST(map_performance, GridEdges4M)
+{
+  Vector<int64_t> keys, missing;
+  grid_edge_keys(1414, keys, missing);
+  benchmark_maps(keys, missing);
+}
+
+TEST(set_performance, RandomInts8M)
+{
+  Vector<int64_t> keys, missing;
+  random_keys(8000000, keys, missing);
+  benchmark_sets(keys, missing);
+}
+
+TEST(set_performance, GridEdges4M)
+{
+  Vector<int64_t> keys, missing;
+  grid_edge_keys(1414, keys, missing);
+  benchmark_sets(keys, missing);
+}
+
+}  // namespace blender::tests
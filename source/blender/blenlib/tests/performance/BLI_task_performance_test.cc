@@ -208,3 +208,104 @@ TEST(task, ListBaseIter100k)
 {
   task_listbase_test("ListBase parallel iteration - Threaded - 100000 items", 100000, true);
 }
+
+/* *** Task pool evaluating a rig-like graph, with and without affinity hints. *** */
+
+/* Each ID is evaluated by a chain of small operations on its own data, like the bones of an
+ * armature. The chain of an ID starts once the chain of its parent ID finished. */
+#define RIG_NUM_IDS 512
+#define RIG_NUM_CHILDREN 4
+#define RIG_NUM_OPERATIONS 16
+#define RIG_DATA_SIZE 4096
+#define RIG_NUM_RUN_AVERAGED 20
+
+typedef struct RigBenchmark {
+  float *data;
+  bool use_affinity;
+} RigBenchmark;
+
+static void task_pool_rig_push(TaskPool *pool, const int id, const int operation);
+
+static void task_pool_rig_func(TaskPool *__restrict pool, void *taskdata)
+{
+  RigBenchmark *rig = (RigBenchmark *)BLI_task_pool_user_data(pool);
+  const int id = POINTER_AS_INT(taskdata) / RIG_NUM_OPERATIONS;
+  const int operation = POINTER_AS_INT(taskdata) % RIG_NUM_OPERATIONS;
+
+  float *data = &rig->data[id * RIG_DATA_SIZE];
+  for (int i = 0; i < RIG_DATA_SIZE; i++) {
+    data[i] = data[i] * 0.5f + (float)operation;
+  }
+
+  if (operation + 1 < RIG_NUM_OPERATIONS) {
+    task_pool_rig_push(pool, id, operation + 1);
+    return;
+  }
+  for (int child = id * RIG_NUM_CHILDREN + 1;
+       child <= id * RIG_NUM_CHILDREN + RIG_NUM_CHILDREN && child < RIG_NUM_IDS;
+       child++) {
+    task_pool_rig_push(pool, child, 0);
+  }
+}
+
+static void task_pool_rig_push(TaskPool *pool, const int id, const int operation)
+{
+  RigBenchmark *rig = (RigBenchmark *)BLI_task_pool_user_data(pool);
+  void *taskdata = POINTER_FROM_INT(id * RIG_NUM_OPERATIONS + operation);
+  if (rig->use_affinity) {
+    BLI_task_pool_push_affinity(
+        pool, task_pool_rig_func, taskdata, false, NULL, &rig->data[id * RIG_DATA_SIZE]);
+  }
+  else {
+    BLI_task_pool_push(pool, task_pool_rig_func, taskdata, false, NULL);
+  }
+}
+
+static void task_pool_rig_test(const char *id, const bool use_affinity)
+{
+  printf("\n========== STARTING %s ==========\n", id);
+
+  BLI_threadapi_init();
+  BLI_task_scheduler_init();
+
+  RigBenchmark rig;
+  rig.data = (float *)MEM_calloc_arrayN(
+      RIG_NUM_IDS * RIG_DATA_SIZE, sizeof(*rig.data), __func__);
+  rig.use_affinity = use_affinity;
+
+  double averaged_timing = 0.0;
+  for (int i = 0; i < RIG_NUM_RUN_AVERAGED; i++) {
+    const double init_time = PIL_check_seconds_timer();
+    TaskPool *pool = BLI_task_pool_create(&rig, TASK_PRIORITY_HIGH);
+    task_pool_rig_push(pool, 0, 0);
+    BLI_task_pool_work_and_wait(pool);
+
+    TaskPoolStats stats;
+    BLI_task_pool_stats_get(pool, &stats);
+    BLI_task_pool_free(pool);
+    averaged_timing += PIL_check_seconds_timer() - init_time;
+
+    EXPECT_EQ(stats.num_tasks, RIG_NUM_IDS * RIG_NUM_OPERATIONS);
+  }
+
+  printf("\t%d threads: done in %fs on average over %d runs\n",
+         BLI_task_scheduler_num_threads(),
+         averaged_timing / RIG_NUM_RUN_AVERAGED,
+         RIG_NUM_RUN_AVERAGED);
+
+  MEM_freeN(rig.data);
+  BLI_task_scheduler_exit();
+  BLI_threadapi_exit();
+
+  printf("========== ENDED %s ==========\n\n", id);
+}
+
+TEST(task, PoolRig)
+{
+  task_pool_rig_test("Task pool rig evaluation - No affinity", false);
+}
+
+TEST(task, PoolRigAffinity)
+{
+  task_pool_rig_test("Task pool rig evaluation - Affinity", true);
+}
@@ -24,6 +24,10 @@
  * \ingroup blenloader
  */
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 struct Scene;
 struct GHash;
 
@@ -32,7 +36,8 @@ typedef struct {
   const char *buf;
   /** Size in bytes. */
   unsigned int size;
-  /** When true, this chunk doesn't own the memory, it's shared with a previous #MemFileChunk */
+  /** When true, this chunk is identical to the one at the same position in the previous step.
+   * The memory of all chunks is shared by content between steps, see #BLO_memfile_chunk_add. */
   bool is_identical;
   /** When true, this chunk is also identical to the one in the next step (used by undo code to
    * detect unchanged IDs).
@@ -45,6 +50,7 @@ typedef struct {
 
 typedef struct MemFile {
   ListBase chunks;
+  /** Size of the memory accounted for by this memory file (not shared with previous steps). */
   size_t size;
 } MemFile;
 
@@ -78,9 +84,14 @@ void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, unsigned
 extern void BLO_memfile_free(MemFile *memfile);
 extern void BLO_memfile_merge(MemFile *first, MemFile *second);
 extern void BLO_memfile_clear_future(MemFile *memfile);
+extern void BLO_memfile_duplicate(const MemFile *memfile, MemFile *r_memfile);
 
 /* utilities */
 extern struct Main *BLO_memfile_main_get(struct MemFile *memfile,
                                          struct Main *bmain,
                                          struct Scene **r_scene);
 extern bool BLO_memfile_write_file(struct MemFile *memfile, const char *filename);
+
+#ifdef __cplusplus
+}
+#endif
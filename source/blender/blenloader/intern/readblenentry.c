@@ -35,6 +35,7 @@
 #include "BLI_linklist.h"
 #include "BLI_listbase.h"
 #include "BLI_string.h"
+#include "BLI_trace.h"
 #include "BLI_utildefines.h"
 
 #include "DNA_genfile.h"
@@ -71,7 +72,7 @@ BlendHandle *BLO_blendhandle_from_file(const char *filepath, ReportList *reports
 {
   BlendHandle *bh;
 
-  bh = (BlendHandle *)blo_filedata_from_file(filepath, reports);
+  bh = (BlendHandle *)blo_filedata_from_file_for_linking(filepath, reports);
 
   return bh;
 }
@@ -312,6 +313,8 @@ BlendFileData *BLO_read_from_file(const char *filepath,
   BlendFileData *bfd = NULL;
   FileData *fd;
 
+  TRACE_ZONE_BEGIN("io", "Read file");
+
   fd = blo_filedata_from_file(filepath, reports);
   if (fd) {
     fd->reports = reports;
@@ -320,6 +323,8 @@ BlendFileData *BLO_read_from_file(const char *filepath,
     blo_filedata_free(fd);
   }
 
+  TRACE_ZONE_END();
+
   return bfd;
 }
 
@@ -369,6 +374,8 @@ BlendFileData *BLO_read_from_memfile(Main *oldmain,
   FileData *fd;
   ListBase old_mainlist;
 
+  TRACE_ZONE_BEGIN("io", "Read undo step");
+
   fd = blo_filedata_from_memfile(memfile, params, reports);
   if (fd) {
     fd->reports = reports;
@@ -411,6 +418,8 @@ BlendFileData *BLO_read_from_memfile(Main *oldmain,
     blo_filedata_free(fd);
   }
 
+  TRACE_ZONE_END();
+
   return bfd;
 }
 
@@ -100,6 +100,7 @@
 
 #include "MEM_guardedalloc.h"
 
+#include "BLI_alloca.h"
 #include "BLI_blenlib.h"
 #include "BLI_endian_switch.h"
 #include "BLI_ghash.h"
@@ -107,6 +108,8 @@
 #include "BLI_math.h"
 #include "BLI_memarena.h"
 #include "BLI_mempool.h"
+#include "BLI_mmap.h"
+#include "BLI_task.h"
 #include "BLI_threads.h"
 
 #include "BLT_translation.h"
@@ -242,6 +245,8 @@
  *
  * \note This is disabled when using compression,
  * while zlib supports seek it's unusably slow, see: T61880.
+ * Files compressed in frames (see #BLEND_ZLIB_FRAMES_MAGIC) are the exception,
+ * seeking only needs to decompress the frame containing the new position.
  */
 #define USE_BHEAD_READ_ON_DEMAND
 
@@ -251,6 +256,10 @@
 /* Use GHash for restoring pointers by name */
 #define USE_GHASH_RESTORE_POINTER
 
+/* Reconstruct the data of all ID's using multiple threads when reading a whole file,
+ * see #read_data_prefetch. */
+#define USE_READ_DATA_PREFETCH
+
 /* Define this to have verbose debug prints. */
 //#define USE_DEBUG_PRINT
 
@@ -279,6 +288,12 @@ typedef struct BHeadN {
   off64_t file_offset;
   /** When set, the remainder of this allocation is the data, otherwise it needs to be read. */
   bool has_data;
+#endif
+  /** Offset of the block header in the file, see #BHeadIndex. */
+  off64_t bhead_offset;
+#ifdef USE_READ_DATA_PREFETCH
+  /** Result of #read_struct done in advance, owned by this block until #read_struct takes it. */
+  void *data_read;
 #endif
   bool is_memchunk_identical;
   struct BHead bhead;
@@ -290,6 +305,28 @@ typedef struct BHeadN {
  * because ID names are used in lookup tables. */
 #define BHEAD_USE_READ_ON_DEMAND(bhead) ((bhead)->code == DATA)
 
+/** See #BLEND_BHEAD_INDEX_MAGIC. */
+typedef struct BHeadIndex {
+  /** Payload of the index block, which the entries point into. */
+  void *data;
+  const BlendBHeadIndexEntry *entries;
+  int entries_len;
+  off64_t glob_offset;
+  off64_t dna1_offset;
+  /** Map file offsets to the #BHeadN read from there. */
+  GHash *bhead_from_offset;
+  /** Entries sorted by #BlendBHeadIndexEntry.old, created on demand by #find_bhead. */
+  const BlendBHeadIndexEntry **entries_by_old;
+  /** Map ID names to entries of linkable ID's, see #USE_GHASH_BHEAD. */
+  GHash *entry_from_idname;
+} BHeadIndex;
+
+BLI_STATIC_ASSERT(sizeof(BlendBHeadIndexHeader) == 32, "Must match the file format")
+BLI_STATIC_ASSERT(sizeof(BlendBHeadIndexEntry) == 88, "Must match the file format")
+BLI_STATIC_ASSERT(sizeof(BlendBHeadIndexFooter) == 16, "Must match the file format")
+
+static BHead *blo_bhead_index_bhead_at(FileData *fd, off64_t offset, BHeadN *bhead_prev);
+
 /**
  * This function ensures that reports are printed,
  * in the case of library linking errors this is important!
@@ -607,7 +644,11 @@ static void read_file_version(FileData *fd, Main *main)
 {
   BHead *bhead;
 
-  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
+  /* With a block index only the #GLOB block is read, not the whole file. */
+  bhead = (fd->bhead_index != NULL) ?
+              blo_bhead_index_bhead_at(fd, fd->bhead_index->glob_offset, NULL) :
+              blo_bhead_first(fd);
+  for (; bhead; bhead = blo_bhead_next(fd, bhead)) {
     if (bhead->code == GLOB) {
       FileGlobal *fg = read_struct(fd, bhead, "Global");
       if (fg) {
@@ -619,6 +660,9 @@ static void read_file_version(FileData *fd, Main *main)
       else if (bhead->code == ENDB) {
         break;
       }
+      if (fd->bhead_index != NULL) {
+        break;
+      }
     }
   }
   if (main->curlib) {
@@ -637,6 +681,20 @@ static void read_file_bhead_idname_map_create(FileData *fd)
   int code_prev = ENDB;
   uint reserve = 0;
 
+  if (fd->bhead_index != NULL) {
+    /* Map to the index entries, the blocks are only read once they are looked up. */
+    BHeadIndex *index = fd->bhead_index;
+    BLI_assert(index->entry_from_idname == NULL);
+    index->entry_from_idname = BLI_ghash_str_new_ex(__func__, (uint)index->entries_len);
+    for (int i = 0; i < index->entries_len; i++) {
+      const BlendBHeadIndexEntry *entry = &index->entries[i];
+      if (BKE_idtype_idcode_is_valid(entry->code) && BKE_idtype_idcode_is_linkable(entry->code)) {
+        BLI_ghash_insert(index->entry_from_idname, (void *)entry->name, (void *)entry);
+      }
+    }
+    return;
+  }
+
   for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
     if (code_prev != bhead->code) {
       code_prev = bhead->code;
@@ -806,9 +864,14 @@ static void bh8_from_bh4(BHead *bhead, BHead4 *bhead4)
   }
 }
 
+/**
+ * Read the block at the current position, the caller is responsible for adding it to
+ * #FileData.bhead_list.
+ */
 static BHeadN *get_bhead(FileData *fd)
 {
   BHeadN *new_bhead = NULL;
+  const off64_t bhead_offset = fd->file_offset;
   int readsize;
 
   if (fd) {
@@ -892,6 +955,9 @@ static BHeadN *get_bhead(FileData *fd)
           new_bhead->next = new_bhead->prev = NULL;
           new_bhead->file_offset = fd->file_offset;
           new_bhead->has_data = false;
+#  ifdef USE_READ_DATA_PREFETCH
+          new_bhead->data_read = NULL;
+#  endif
           new_bhead->is_memchunk_identical = false;
           new_bhead->bhead = bhead;
           off64_t seek_new = fd->seek(fd, bhead.len, SEEK_CUR);
@@ -914,6 +980,9 @@ static BHeadN *get_bhead(FileData *fd)
 #ifdef USE_BHEAD_READ_ON_DEMAND
           new_bhead->file_offset = 0; /* don't seek. */
           new_bhead->has_data = true;
+#endif
+#ifdef USE_READ_DATA_PREFETCH
+          new_bhead->data_read = NULL;
 #endif
           new_bhead->is_memchunk_identical = false;
           new_bhead->bhead = bhead;
@@ -933,27 +1002,246 @@ static BHeadN *get_bhead(FileData *fd)
     }
   }
 
-  /* We've read a new block. Now add it to the list
-   * of blocks.
-   */
   if (new_bhead) {
-    BLI_addtail(&fd->bhead_list, new_bhead);
+    new_bhead->bhead_offset = bhead_offset;
   }
 
   return new_bhead;
 }
 
+/* -------------------------------------------------------------------- */
+/** \name File Block Index
+ *
+ * When a file has a block index (see #BLEND_BHEAD_INDEX_MAGIC), blocks are read as they are
+ * needed instead of in file order. #FileData.bhead_list is not sorted then,
+ * #blo_bhead_next finds the following block from the file offset instead.
+ * \{ */
+
+static void blo_bhead_index_free(BHeadIndex *index)
+{
+  BLI_ghash_free(index->bhead_from_offset, NULL, NULL);
+  if (index->entry_from_idname) {
+    BLI_ghash_free(index->entry_from_idname, NULL, NULL);
+  }
+  MEM_SAFE_FREE(index->entries_by_old);
+  MEM_freeN(index->data);
+  MEM_freeN(index);
+}
+
+/**
+ * Return the block at \a offset, reading it when it wasn't read before.
+ *
+ * \param bhead_prev: The block before \a offset when known, keeping blocks read in order
+ * next to each other in #FileData.bhead_list.
+ */
+static BHead *blo_bhead_index_bhead_at(FileData *fd, off64_t offset, BHeadN *bhead_prev)
+{
+  BHeadIndex *index = fd->bhead_index;
+  BHeadN *new_bhead = BLI_ghash_lookup(index->bhead_from_offset, (void *)(intptr_t)offset);
+
+  if (new_bhead == NULL) {
+    if (fd->seek(fd, offset, SEEK_SET) == -1) {
+      return NULL;
+    }
+    /* Every read is positioned explicitly, a failed one doesn't affect the others. */
+    fd->is_eof = false;
+    new_bhead = get_bhead(fd);
+    if (new_bhead == NULL) {
+      return NULL;
+    }
+    if (bhead_prev) {
+      BLI_insertlinkafter(&fd->bhead_list, bhead_prev, new_bhead);
+    }
+    else {
+      BLI_addtail(&fd->bhead_list, new_bhead);
+    }
+    BLI_ghash_insert(index->bhead_from_offset, (void *)(intptr_t)offset, new_bhead);
+  }
+
+  return &new_bhead->bhead;
+}
+
+/**
+ * Read the block of an index entry, NULL when it doesn't match the entry.
+ */
+static BHead *blo_bhead_index_entry_bhead(FileData *fd, const BlendBHeadIndexEntry *entry)
+{
+  BHead *bhead = blo_bhead_index_bhead_at(fd, (off64_t)entry->offset, NULL);
+  if (bhead == NULL || (uint64_t)(uintptr_t)bhead->old != entry->old) {
+    return NULL;
+  }
+  /* Compare the ID name too, the code may be patched by versioning (#ID_SCRN). */
+  if (!STREQLEN(blo_bhead_id_name(fd, bhead), entry->name, sizeof(entry->name))) {
+    return NULL;
+  }
+  return bhead;
+}
+
+/**
+ * Read the block index from the end of the file, when there is one that can be used.
+ * Needs #FileData.id_name_offs to be valid before the entries are accessed.
+ */
+static void blo_bhead_index_read(FileData *fd)
+{
+  /* The index stores 64 bit offsets and pointers in the byte order of the file. */
+  if (fd->seek == NULL || fd->memfile != NULL || sizeof(void *) != 8 ||
+      (fd->flags & (FD_FLAGS_SWITCH_ENDIAN | FD_FLAGS_FILE_POINTSIZE_IS_4 |
+                    FD_FLAGS_POINTSIZE_DIFFERS))) {
+    return;
+  }
+
+  struct {
+    BlendBHeadIndexFooter footer;
+    BHead endb;
+  } tail;
+  BLI_STATIC_ASSERT(sizeof(tail) == sizeof(BlendBHeadIndexFooter) + sizeof(BHead),
+                    "Must match the file format")
+  const off64_t offset_backup = fd->file_offset;
+  const off64_t file_len = fd->seek(fd, 0, SEEK_END);
+  const off64_t tail_offset = file_len - (off64_t)sizeof(tail);
+  BHead bhead;
+  void *data = NULL;
+
+  bool ok = (file_len != -1) && (tail_offset > SIZEOFBLENDERHEADER);
+  ok = ok && (fd->seek(fd, tail_offset, SEEK_SET) != -1) &&
+       (fd->read(fd, &tail, sizeof(tail), NULL) == sizeof(tail));
+  ok = ok && (tail.endb.code == ENDB) &&
+       STREQLEN(tail.footer.magic, BLEND_BHEAD_INDEX_MAGIC, sizeof(tail.footer.magic));
+  ok = ok && (tail.footer.offset < (uint64_t)tail_offset) &&
+       (fd->seek(fd, (off64_t)tail.footer.offset, SEEK_SET) != -1) &&
+       (fd->read(fd, &bhead, sizeof(bhead), NULL) == sizeof(bhead));
+  /* The index block ends right before #ENDB. */
+  ok = ok && (bhead.code == DATA) &&
+       (bhead.len >= (int)(sizeof(BlendBHeadIndexHeader) + sizeof(BlendBHeadIndexFooter))) &&
+       ((off64_t)tail.footer.offset + (off64_t)sizeof(BHead) + bhead.len ==
+        file_len - (off64_t)sizeof(BHead));
+  if (ok) {
+    data = MEM_mallocN((size_t)bhead.len, __func__);
+    ok = (fd->read(fd, data, bhead.len, NULL) == bhead.len);
+  }
+  if (ok) {
+    const BlendBHeadIndexHeader *header = data;
+    ok = STREQLEN(header->magic, BLEND_BHEAD_INDEX_MAGIC, sizeof(header->magic)) &&
+         (header->version == BLEND_BHEAD_INDEX_VERSION) && (header->entries_len >= 0) &&
+         ((size_t)bhead.len == sizeof(BlendBHeadIndexHeader) +
+                                   (size_t)header->entries_len * sizeof(BlendBHeadIndexEntry) +
+                                   sizeof(BlendBHeadIndexFooter)) &&
+         (header->glob_offset < (uint64_t)tail_offset) &&
+         (header->dna1_offset < (uint64_t)tail_offset);
+  }
+
+  if (ok) {
+    const BlendBHeadIndexHeader *header = data;
+    BHeadIndex *index = MEM_callocN(sizeof(*index), __func__);
+    index->data = data;
+    index->entries = (const BlendBHeadIndexEntry *)(header + 1);
+    index->entries_len = header->entries_len;
+    index->glob_offset = (off64_t)header->glob_offset;
+    index->dna1_offset = (off64_t)header->dna1_offset;
+    index->bhead_from_offset = BLI_ghash_ptr_new(__func__);
+    fd->bhead_index = index;
+
+    /* Don't trust an index which is out of sync with the file (edited by other tools). */
+    BHead *bhead_glob = blo_bhead_index_bhead_at(fd, index->glob_offset, NULL);
+    BHead *bhead_dna1 = blo_bhead_index_bhead_at(fd, index->dna1_offset, NULL);
+    if (bhead_glob == NULL || bhead_glob->code != GLOB || bhead_dna1 == NULL ||
+        bhead_dna1->code != DNA1) {
+      BLI_freelistN(&fd->bhead_list);
+      blo_bhead_index_free(index);
+      fd->bhead_index = NULL;
+    }
+    fd->is_eof = false;
+  }
+  else {
+    MEM_SAFE_FREE(data);
+  }
+
+  fd->seek(fd, offset_backup, SEEK_SET);
+}
+
+static int blo_bhead_index_entry_cmp_old(const void *a_v, const void *b_v)
+{
+  const BlendBHeadIndexEntry *a = *(const BlendBHeadIndexEntry **)a_v;
+  const BlendBHeadIndexEntry *b = *(const BlendBHeadIndexEntry **)b_v;
+
+  if (a->old > b->old) {
+    return 1;
+  }
+  if (a->old < b->old) {
+    return -1;
+  }
+  return 0;
+}
+
+static const BlendBHeadIndexEntry *blo_bhead_index_find_old(BHeadIndex *index, const void *old)
+{
+  if (index->entries_by_old == NULL) {
+    index->entries_by_old = MEM_malloc_arrayN(
+        (size_t)MAX2(index->entries_len, 1), sizeof(*index->entries_by_old), __func__);
+    for (int i = 0; i < index->entries_len; i++) {
+      index->entries_by_old[i] = &index->entries[i];
+    }
+    qsort(index->entries_by_old,
+          (size_t)index->entries_len,
+          sizeof(*index->entries_by_old),
+          blo_bhead_index_entry_cmp_old);
+  }
+
+  BlendBHeadIndexEntry entry_key = {.old = (uint64_t)(uintptr_t)old};
+  const BlendBHeadIndexEntry *entry_key_p = &entry_key;
+  const BlendBHeadIndexEntry **entry_p = bsearch(&entry_key_p,
+                                                 index->entries_by_old,
+                                                 (size_t)index->entries_len,
+                                                 sizeof(*index->entries_by_old),
+                                                 blo_bhead_index_entry_cmp_old);
+  return entry_p ? *entry_p : NULL;
+}
+
+/**
+ * Entries are in file order, so the library of a #ID_LINK_PLACEHOLDER
+ * is the closest #ID_LI entry before it.
+ */
+static const BlendBHeadIndexEntry *blo_bhead_index_find_library(const BHeadIndex *index,
+                                                                off64_t offset)
+{
+  int lo = 0, hi = index->entries_len;
+  while (lo < hi) {
+    const int mid = (lo + hi) / 2;
+    if ((off64_t)index->entries[mid].offset < offset) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  for (int i = MIN2(lo, index->entries_len - 1); i >= 0; i--) {
+    if (index->entries[i].code == ID_LI && (off64_t)index->entries[i].offset <= offset) {
+      return &index->entries[i];
+    }
+  }
+  return NULL;
+}
+
+/** \} */
+
 BHead *blo_bhead_first(FileData *fd)
 {
   BHeadN *new_bhead;
   BHead *bhead = NULL;
 
+  if (fd->bhead_index != NULL) {
+    return blo_bhead_index_bhead_at(fd, SIZEOFBLENDERHEADER, NULL);
+  }
+
   /* Rewind the file
    * Read in a new block if necessary
    */
   new_bhead = fd->bhead_list.first;
   if (new_bhead == NULL) {
     new_bhead = get_bhead(fd);
+    if (new_bhead) {
+      BLI_addtail(&fd->bhead_list, new_bhead);
+    }
   }
 
   if (new_bhead) {
@@ -963,11 +1251,15 @@ BHead *blo_bhead_first(FileData *fd)
   return bhead;
 }
 
-BHead *blo_bhead_prev(FileData *UNUSED(fd), BHead *thisblock)
+BHead *blo_bhead_prev(FileData *fd, BHead *thisblock)
 {
   BHeadN *bheadn = BHEADN_FROM_BHEAD(thisblock);
   BHeadN *prev = bheadn->prev;
 
+  /* Blocks aren't read in file order when there is an index. */
+  BLI_assert(fd->bhead_index == NULL);
+  UNUSED_VARS_NDEBUG(fd);
+
   return (prev) ? &prev->bhead : NULL;
 }
 
@@ -979,12 +1271,28 @@ BHead *blo_bhead_next(FileData *fd, BHead *thisblock)
   if (thisblock) {
     /* bhead is actually a sub part of BHeadN
      * We calculate the BHeadN pointer from the BHead pointer below */
-    new_bhead = BHEADN_FROM_BHEAD(thisblock);
+    BHeadN *this_bhead = BHEADN_FROM_BHEAD(thisblock);
+
+    if (fd->bhead_index != NULL) {
+      if (thisblock->code == ENDB) {
+        return NULL;
+      }
+      const off64_t offset_next = this_bhead->bhead_offset + (off64_t)sizeof(BHead) +
+                                  thisblock->len;
+      new_bhead = this_bhead->next;
+      if (new_bhead != NULL && new_bhead->bhead_offset == offset_next) {
+        return &new_bhead->bhead;
+      }
+      return blo_bhead_index_bhead_at(fd, offset_next, this_bhead);
+    }
 
     /* get the next BHeadN. If it doesn't exist we read in the next one */
-    new_bhead = new_bhead->next;
+    new_bhead = this_bhead->next;
     if (new_bhead == NULL) {
       new_bhead = get_bhead(fd);
+      if (new_bhead) {
+        BLI_addtail(&fd->bhead_list, new_bhead);
+      }
     }
   }
 
@@ -1003,6 +1311,10 @@ static bool blo_bhead_read_data(FileData *fd, BHead *thisblock, void *buf)
   bool success = true;
   BHeadN *new_bhead = BHEADN_FROM_BHEAD(thisblock);
   BLI_assert(new_bhead->has_data == false && new_bhead->file_offset != 0);
+  if (fd->mmap_file != NULL && fd->zlib_frames == NULL) {
+    /* No need to move the read position around, the mapping supports random access. */
+    return BLI_mmap_read(fd->mmap_file, buf, (size_t)new_bhead->file_offset, new_bhead->bhead.len);
+  }
   off64_t offset_backup = fd->file_offset;
   if (UNLIKELY(fd->seek(fd, new_bhead->file_offset, SEEK_SET) == -1)) {
     success = false;
@@ -1025,6 +1337,10 @@ static BHead *blo_bhead_read_full(FileData *fd, BHead *thisblock)
   BHeadN *new_bhead_data = MEM_mallocN(sizeof(BHeadN) + new_bhead->bhead.len, "new_bhead");
   new_bhead_data->bhead = new_bhead->bhead;
   new_bhead_data->file_offset = new_bhead->file_offset;
+  new_bhead_data->bhead_offset = new_bhead->bhead_offset;
+#  ifdef USE_READ_DATA_PREFETCH
+  new_bhead_data->data_read = NULL;
+#  endif
   new_bhead_data->has_data = true;
   new_bhead_data->is_memchunk_identical = false;
   if (!blo_bhead_read_data(fd, thisblock, new_bhead_data + 1)) {
@@ -1033,6 +1349,22 @@ static BHead *blo_bhead_read_full(FileData *fd, BHead *thisblock)
   }
   return &new_bhead_data->bhead;
 }
+
+/**
+ * Zero-copy access to the data of a block which has not been read yet.
+ *
+ * \return NULL when the file isn't memory-mapped, callers must use #blo_bhead_read_full then.
+ * \note The returned memory is owned by the mapping and only valid while \a fd is open.
+ */
+static const void *blo_bhead_data_mapped(FileData *fd, BHead *thisblock)
+{
+  BHeadN *new_bhead = BHEADN_FROM_BHEAD(thisblock);
+  BLI_assert(new_bhead->has_data == false && new_bhead->file_offset != 0);
+  if (fd->mmap_file == NULL || fd->zlib_frames != NULL) {
+    return NULL;
+  }
+  return BLI_mmap_get_range(fd->mmap_file, (size_t)new_bhead->file_offset, thisblock->len);
+}
 #endif /* USE_BHEAD_READ_ON_DEMAND */
 
 /* Warning! Caller's responsibility to ensure given bhead **is** and ID one! */
@@ -1084,42 +1416,66 @@ static void decode_blender_header(FileData *fd)
 /**
  * \return Success if the file is read correctly, else set \a r_error_message.
  */
+static int read_file_dna_subversion(FileData *fd, BHead *bhead_glob)
+{
+  /* Before this, the subversion didn't exist in 'FileGlobal' so the subversion
+   * value isn't accessible for the purpose of DNA versioning in this case. */
+  if (fd->fileversion <= 242) {
+    return 0;
+  }
+  /* We can't use read_global because this needs 'DNA1' to be decoded,
+   * however the first 4 chars are _always_ the subversion. */
+  FileGlobal *fg = (void *)&bhead_glob[1];
+  BLI_STATIC_ASSERT(offsetof(FileGlobal, subvstr) == 0, "Must be first: subvstr")
+  char num[5];
+  memcpy(num, fg->subvstr, 4);
+  num[4] = 0;
+  return atoi(num);
+}
+
+static bool read_file_dna_decode(FileData *fd,
+                                 BHead *bhead_dna1,
+                                 const int subversion,
+                                 const char **r_error_message)
+{
+  const bool do_endian_swap = (fd->flags & FD_FLAGS_SWITCH_ENDIAN) != 0;
+
+  fd->filesdna = DNA_sdna_from_data(
+      &bhead_dna1[1], bhead_dna1->len, do_endian_swap, true, r_error_message);
+  if (fd->filesdna) {
+    blo_do_versions_dna(fd->filesdna, fd->fileversion, subversion);
+    fd->compflags = DNA_struct_get_compareflags(fd->filesdna, fd->memsdna);
+    fd->reconstruct_info = DNA_reconstruct_info_create(
+        fd->filesdna, fd->memsdna, fd->compflags);
+    /* used to retrieve ID names from (bhead+1) */
+    fd->id_name_offs = DNA_elem_offset(fd->filesdna, "ID", "char", "name[]");
+
+    return true;
+  }
+
+  return false;
+}
+
 static bool read_file_dna(FileData *fd, const char **r_error_message)
 {
   BHead *bhead;
   int subversion = 0;
 
+  if (fd->bhead_index != NULL) {
+    /* Both blocks are checked by #blo_bhead_index_read, the ones in between are skipped. */
+    subversion = read_file_dna_subversion(
+        fd, blo_bhead_index_bhead_at(fd, fd->bhead_index->glob_offset, NULL));
+    return read_file_dna_decode(
+        fd, blo_bhead_index_bhead_at(fd, fd->bhead_index->dna1_offset, NULL), subversion,
+        r_error_message);
+  }
+
   for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
     if (bhead->code == GLOB) {
-      /* Before this, the subversion didn't exist in 'FileGlobal' so the subversion
-       * value isn't accessible for the purpose of DNA versioning in this case. */
-      if (fd->fileversion <= 242) {
-        continue;
-      }
-      /* We can't use read_global because this needs 'DNA1' to be decoded,
-       * however the first 4 chars are _always_ the subversion. */
-      FileGlobal *fg = (void *)&bhead[1];
-      BLI_STATIC_ASSERT(offsetof(FileGlobal, subvstr) == 0, "Must be first: subvstr")
-      char num[5];
-      memcpy(num, fg->subvstr, 4);
-      num[4] = 0;
-      subversion = atoi(num);
+      subversion = read_file_dna_subversion(fd, bhead);
     }
     else if (bhead->code == DNA1) {
-      const bool do_endian_swap = (fd->flags & FD_FLAGS_SWITCH_ENDIAN) != 0;
-
-      fd->filesdna = DNA_sdna_from_data(
-          &bhead[1], bhead->len, do_endian_swap, true, r_error_message);
-      if (fd->filesdna) {
-        blo_do_versions_dna(fd->filesdna, fd->fileversion, subversion);
-        fd->compflags = DNA_struct_get_compareflags(fd->filesdna, fd->memsdna);
-        /* used to retrieve ID names from (bhead+1) */
-        fd->id_name_offs = DNA_elem_offset(fd->filesdna, "ID", "char", "name[]");
-
-        return true;
-      }
-
-      return false;
+      return read_file_dna_decode(fd, bhead, subversion, r_error_message);
     }
     else if (bhead->code == ENDB) {
       break;
@@ -1201,6 +1557,388 @@ static off64_t fd_seek_data_from_file(FileData *filedata, off64_t offset, int wh
   return filedata->file_offset;
 }
 
+/* Memory-mapped file reading. */
+
+static int fd_read_from_mmap(FileData *filedata,
+                             void *buffer,
+                             uint size,
+                             bool *UNUSED(r_is_memchunck_identical))
+{
+  /* don't read more bytes then there are available in the mapping */
+  const size_t length = BLI_mmap_get_length(filedata->mmap_file);
+  const size_t offset = (size_t)filedata->file_offset;
+  const size_t readsize = (offset < length) ? MIN2((size_t)size, length - offset) : 0;
+
+  if (!BLI_mmap_read(filedata->mmap_file, buffer, offset, readsize)) {
+    return 0;
+  }
+
+  filedata->file_offset += readsize;
+
+  return (int)readsize;
+}
+
+static off64_t fd_seek_from_mmap(FileData *filedata, off64_t offset, int whence)
+{
+  off64_t new_pos;
+  if (whence == SEEK_CUR) {
+    new_pos = filedata->file_offset + offset;
+  }
+  else if (whence == SEEK_SET) {
+    new_pos = offset;
+  }
+  else if (whence == SEEK_END) {
+    new_pos = (off64_t)BLI_mmap_get_length(filedata->mmap_file) + offset;
+  }
+  else {
+    return -1;
+  }
+
+  if (new_pos < 0 || new_pos > (off64_t)BLI_mmap_get_length(filedata->mmap_file)) {
+    return -1;
+  }
+  filedata->file_offset = new_pos;
+  return filedata->file_offset;
+}
+
+/* GZip frames reading.
+ *
+ * Frames are decompressed in parallel ahead of the parser and only a few of them are kept
+ * in memory. Seeking is cheap, which allows to skip the data of blocks that aren't needed. */
+
+typedef struct ZlibFrameRead {
+  /** Location of the gzip member in the file. */
+  size_t compressed_offset;
+  uint compressed_size;
+  /** Location of the frame's data in the uncompressed stream. */
+  off64_t uncompressed_offset;
+  uint uncompressed_size;
+
+  /** Decompressed data, NULL when not loaded. */
+  char *data;
+  /** To evict the least recently used frames. */
+  uint64_t last_used;
+} ZlibFrameRead;
+
+typedef struct BlendZlibFrames {
+  ZlibFrameRead *frames;
+  int frames_len;
+  off64_t uncompressed_size;
+
+  /** Number of frames decompressed ahead when reading sequentially. */
+  int read_ahead_len;
+  /** Maximum number of frames kept decompressed. */
+  int loaded_max;
+  int loaded_len;
+  /** Last frame that was read, used to detect sequential reading and as lookup hint. */
+  int frame_last;
+  uint64_t use_counter;
+} BlendZlibFrames;
+
+static uint zlib_frames_le32(const uchar *src)
+{
+  return (uint)src[0] | ((uint)src[1] << 8) | ((uint)src[2] << 16) | ((uint)src[3] << 24);
+}
+
+/**
+ * Read the frame table from the trailing gzip member written by a multi-threaded save.
+ * \return NULL when the file has no (valid) frame table, it is then a regular gzip stream.
+ */
+static BlendZlibFrames *blo_zlib_frames_table_read(BLI_mmap_file *mmap_file)
+{
+  const size_t file_len = BLI_mmap_get_length(mmap_file);
+  uchar tail[8 + BLEND_ZLIB_FRAMES_FOOTER_SIZE];
+  if (file_len < BLEND_ZLIB_FRAMES_HEADER_SIZE + sizeof(tail) ||
+      !BLI_mmap_read(mmap_file, tail, file_len - sizeof(tail), sizeof(tail))) {
+    return NULL;
+  }
+  /* Magic, an empty final deflate block, zero CRC32 and size. */
+  const uchar footer[BLEND_ZLIB_FRAMES_FOOTER_SIZE] = {0x03, 0x00};
+  if (memcmp(tail + 4, BLEND_ZLIB_FRAMES_MAGIC, 4) != 0 ||
+      memcmp(tail + 8, footer, sizeof(footer)) != 0) {
+    return NULL;
+  }
+
+  const uint frames_len = zlib_frames_le32(tail);
+  const size_t table_size = BLEND_ZLIB_FRAMES_TABLE_SIZE(frames_len);
+  if (frames_len == 0 || table_size > BLEND_ZLIB_FRAMES_TABLE_SIZE_MAX) {
+    return NULL;
+  }
+  const size_t member_size = BLEND_ZLIB_FRAMES_HEADER_SIZE + table_size +
+                             BLEND_ZLIB_FRAMES_FOOTER_SIZE;
+  if (member_size > file_len) {
+    return NULL;
+  }
+  const size_t member_offset = file_len - member_size;
+
+  uchar header[BLEND_ZLIB_FRAMES_HEADER_SIZE];
+  if (!BLI_mmap_read(mmap_file, header, member_offset, sizeof(header))) {
+    return NULL;
+  }
+  const uint xlen = (uint)header[10] | ((uint)header[11] << 8);
+  const uint subfield_len = (uint)header[14] | ((uint)header[15] << 8);
+  if (header[0] != 0x1f || header[1] != 0x8b || header[2] != 8 || header[3] != 4 ||
+      xlen != table_size + 4 || header[12] != BLEND_ZLIB_FRAMES_SI1 ||
+      header[13] != BLEND_ZLIB_FRAMES_SI2 || subfield_len != table_size) {
+    return NULL;
+  }
+
+  uchar *table = MEM_mallocN(table_size, __func__);
+  if (!BLI_mmap_read(mmap_file, table, member_offset + sizeof(header), table_size)) {
+    MEM_freeN(table);
+    return NULL;
+  }
+
+  BlendZlibFrames *zlib_frames = MEM_callocN(sizeof(*zlib_frames), __func__);
+  zlib_frames->frames = MEM_calloc_arrayN(frames_len, sizeof(ZlibFrameRead), __func__);
+  zlib_frames->frames_len = (int)frames_len;
+
+  size_t compressed_offset = 0;
+  off64_t uncompressed_offset = 0;
+  bool is_valid = true;
+  for (uint i = 0; i < frames_len; i++) {
+    ZlibFrameRead *frame = &zlib_frames->frames[i];
+    frame->compressed_offset = compressed_offset;
+    frame->compressed_size = zlib_frames_le32(&table[i * 8]);
+    frame->uncompressed_offset = uncompressed_offset;
+    frame->uncompressed_size = zlib_frames_le32(&table[i * 8 + 4]);
+    if (frame->compressed_size == 0 || frame->uncompressed_size == 0 ||
+        frame->uncompressed_size > BLEND_ZLIB_FRAME_SIZE) {
+      is_valid = false;
+      break;
+    }
+    compressed_offset += frame->compressed_size;
+    uncompressed_offset += frame->uncompressed_size;
+  }
+  MEM_freeN(table);
+
+  /* The frames must cover everything up to the table. */
+  if (!is_valid || compressed_offset != member_offset) {
+    MEM_freeN(zlib_frames->frames);
+    MEM_freeN(zlib_frames);
+    return NULL;
+  }
+
+  const int threads_len = BLI_task_scheduler_num_threads();
+  zlib_frames->uncompressed_size = uncompressed_offset;
+  zlib_frames->read_ahead_len = max_ii(1, threads_len);
+  zlib_frames->loaded_max = 2 * zlib_frames->read_ahead_len + 2;
+  zlib_frames->frame_last = -1;
+
+  return zlib_frames;
+}
+
+static void blo_zlib_frames_free(BlendZlibFrames *zlib_frames)
+{
+  for (int i = 0; i < zlib_frames->frames_len; i++) {
+    MEM_SAFE_FREE(zlib_frames->frames[i].data);
+  }
+  MEM_freeN(zlib_frames->frames);
+  MEM_freeN(zlib_frames);
+}
+
+typedef struct ZlibFramesLoadData {
+  BLI_mmap_file *mmap_file;
+  ZlibFrameRead **frames;
+} ZlibFramesLoadData;
+
+static void blo_zlib_frames_load_cb(void *__restrict userdata,
+                                    const int iter,
+                                    const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  ZlibFramesLoadData *data = userdata;
+  ZlibFrameRead *frame = data->frames[iter];
+
+  /* Inflate straight from the mapping when possible. */
+  void *compressed_copy = NULL;
+  const void *compressed = BLI_mmap_get_range(
+      data->mmap_file, frame->compressed_offset, frame->compressed_size);
+  if (compressed == NULL) {
+    compressed_copy = MEM_mallocN(frame->compressed_size, __func__);
+    if (!BLI_mmap_read(
+            data->mmap_file, compressed_copy, frame->compressed_offset, frame->compressed_size)) {
+      MEM_freeN(compressed_copy);
+      return;
+    }
+    compressed = compressed_copy;
+  }
+
+  char *uncompressed = MEM_mallocN(frame->uncompressed_size, "zlib frame");
+  bool is_ok = false;
+
+  z_stream strm = {NULL};
+  if (inflateInit2(&strm, 16 + MAX_WBITS) == Z_OK) {
+    strm.next_in = (Bytef *)compressed;
+    strm.avail_in = frame->compressed_size;
+    strm.next_out = (Bytef *)uncompressed;
+    strm.avail_out = frame->uncompressed_size;
+    is_ok = (inflate(&strm, Z_FINISH) == Z_STREAM_END) &&
+            (strm.total_out == frame->uncompressed_size);
+    inflateEnd(&strm);
+  }
+
+  if (compressed_copy != NULL) {
+    MEM_freeN(compressed_copy);
+  }
+  if (BLI_mmap_any_io_error(data->mmap_file)) {
+    is_ok = false;
+  }
+
+  if (is_ok) {
+    frame->data = uncompressed;
+  }
+  else {
+    MEM_freeN(uncompressed);
+  }
+}
+
+static bool blo_zlib_frames_ensure_loaded(FileData *fd, const int frame_index)
+{
+  BlendZlibFrames *zlib_frames = fd->zlib_frames;
+  ZlibFrameRead *frame = &zlib_frames->frames[frame_index];
+
+  const bool is_sequential = (frame_index == zlib_frames->frame_last + 1);
+  zlib_frames->frame_last = frame_index;
+  frame->last_used = ++zlib_frames->use_counter;
+  if (frame->data != NULL) {
+    return true;
+  }
+
+  /* Decompress frames ahead of the parser when reading sequentially,
+   * random access (reading data-blocks on demand) only needs the requested frame. */
+  const int load_len_max = is_sequential ?
+                               min_ii(zlib_frames->read_ahead_len,
+                                      zlib_frames->frames_len - frame_index) :
+                               1;
+  ZlibFrameRead **frames_load = BLI_array_alloca(frames_load, load_len_max);
+  int load_len = 0;
+  for (int i = 0; i < load_len_max; i++) {
+    ZlibFrameRead *frame_load = &zlib_frames->frames[frame_index + i];
+    if (frame_load->data == NULL) {
+      frames_load[load_len++] = frame_load;
+    }
+  }
+
+  /* Evict the least recently used frames to make room. */
+  while (zlib_frames->loaded_len > 0 &&
+         zlib_frames->loaded_len + load_len > zlib_frames->loaded_max) {
+    ZlibFrameRead *frame_evict = NULL;
+    for (int i = 0; i < zlib_frames->frames_len; i++) {
+      ZlibFrameRead *frame_test = &zlib_frames->frames[i];
+      if (frame_test->data != NULL &&
+          (frame_evict == NULL || frame_test->last_used < frame_evict->last_used)) {
+        frame_evict = frame_test;
+      }
+    }
+    MEM_freeN(frame_evict->data);
+    frame_evict->data = NULL;
+    zlib_frames->loaded_len--;
+  }
+
+  ZlibFramesLoadData data = {
+      .mmap_file = fd->mmap_file,
+      .frames = frames_load,
+  };
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (load_len > 1);
+  settings.min_iter_per_thread = 1;
+  BLI_task_parallel_range(0, load_len, &data, blo_zlib_frames_load_cb, &settings);
+
+  for (int i = 0; i < load_len; i++) {
+    if (frames_load[i]->data != NULL) {
+      zlib_frames->loaded_len++;
+    }
+  }
+
+  return frame->data != NULL;
+}
+
+/** \return The frame containing \a offset, -1 when past the end. */
+static int blo_zlib_frames_find(const BlendZlibFrames *zlib_frames, const off64_t offset)
+{
+  if (offset < 0 || offset >= zlib_frames->uncompressed_size) {
+    return -1;
+  }
+
+  /* Most reads are in the same or the next frame. */
+  for (int i = max_ii(zlib_frames->frame_last, 0);
+       i < min_ii(zlib_frames->frame_last + 2, zlib_frames->frames_len);
+       i++) {
+    const ZlibFrameRead *frame = &zlib_frames->frames[i];
+    if (offset >= frame->uncompressed_offset &&
+        offset < frame->uncompressed_offset + frame->uncompressed_size) {
+      return i;
+    }
+  }
+
+  int low = 0, high = zlib_frames->frames_len - 1;
+  while (low < high) {
+    const int mid = low + (high - low + 1) / 2;
+    if (zlib_frames->frames[mid].uncompressed_offset <= offset) {
+      low = mid;
+    }
+    else {
+      high = mid - 1;
+    }
+  }
+  return low;
+}
+
+static int fd_read_zlib_frames(FileData *filedata,
+                               void *buffer,
+                               uint size,
+                               bool *UNUSED(r_is_memchunck_identical))
+{
+  BlendZlibFrames *zlib_frames = filedata->zlib_frames;
+  uint totread = 0;
+
+  while (totread < size) {
+    const int frame_index = blo_zlib_frames_find(zlib_frames, filedata->file_offset);
+    if (frame_index == -1) {
+      /* End of file. */
+      break;
+    }
+    if (!blo_zlib_frames_ensure_loaded(filedata, frame_index)) {
+      return EOF;
+    }
+
+    const ZlibFrameRead *frame = &zlib_frames->frames[frame_index];
+    const uint frame_offset = (uint)(filedata->file_offset - frame->uncompressed_offset);
+    const uint readsize = MIN2(size - totread, frame->uncompressed_size - frame_offset);
+
+    memcpy(POINTER_OFFSET(buffer, totread), frame->data + frame_offset, readsize);
+    totread += readsize;
+    filedata->file_offset += readsize;
+  }
+
+  return (int)totread;
+}
+
+static off64_t fd_seek_zlib_frames(FileData *filedata, off64_t offset, int whence)
+{
+  const off64_t size = filedata->zlib_frames->uncompressed_size;
+  off64_t new_pos;
+  if (whence == SEEK_CUR) {
+    new_pos = filedata->file_offset + offset;
+  }
+  else if (whence == SEEK_SET) {
+    new_pos = offset;
+  }
+  else if (whence == SEEK_END) {
+    new_pos = size + offset;
+  }
+  else {
+    return -1;
+  }
+
+  if (new_pos < 0 || new_pos > size) {
+    return -1;
+  }
+  filedata->file_offset = new_pos;
+  return filedata->file_offset;
+}
+
 /* GZip file reading. */
 
 static int fd_read_gzip_from_file(FileData *filedata,
@@ -1340,6 +2078,9 @@ static FileData *blo_decode_and_check(FileData *fd, ReportList *reports)
 
   if (fd->flags & FD_FLAGS_FILE_OK) {
     const char *error_message = NULL;
+    if (fd->flags & FD_FLAGS_USE_BHEAD_INDEX) {
+      blo_bhead_index_read(fd);
+    }
     if (read_file_dna(fd, &error_message) == false) {
       BKE_reportf(
           reports, RPT_ERROR, "Failed to read blend file '%s': %s", fd->relabase, error_message);
@@ -1363,6 +2104,8 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
 {
   FileDataReadFn *read_fn = NULL;
   FileDataSeekFn *seek_fn = NULL; /* Optional. */
+  BLI_mmap_file *mmap_file = NULL;
+  BlendZlibFrames *zlib_frames = NULL;
 
   gzFile gzfile = (gzFile)Z_NULL;
 
@@ -1385,6 +2128,33 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
   if (memcmp(header, "BLENDER", sizeof(header)) == 0) {
     read_fn = fd_read_data_from_file;
     seek_fn = fd_seek_data_from_file;
+
+    /* Prefer mapping the file, this avoids a system call for every read and seek,
+     * and lets #read_struct access the data of blocks in place. */
+    mmap_file = BLI_mmap_open(file);
+    if (mmap_file != NULL) {
+      read_fn = fd_read_from_mmap;
+      seek_fn = fd_seek_from_mmap;
+    }
+    /* #BLI_mmap_open seeks to the end of the file. */
+    BLI_lseek(file, 0, SEEK_SET);
+  }
+
+  /* Gzip file written in frames, these can be decompressed in parallel. */
+  if ((read_fn == NULL) && (header[0] == 0x1f && header[1] == 0x8b)) {
+    mmap_file = BLI_mmap_open(file);
+    if (mmap_file != NULL) {
+      zlib_frames = blo_zlib_frames_table_read(mmap_file);
+      if (zlib_frames != NULL) {
+        read_fn = fd_read_zlib_frames;
+        seek_fn = fd_seek_zlib_frames;
+      }
+      else {
+        BLI_mmap_free(mmap_file);
+        mmap_file = NULL;
+      }
+    }
+    BLI_lseek(file, 0, SEEK_SET);
   }
 
   /* Gzip file. */
@@ -1417,6 +2187,8 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
 
   fd->filedes = file;
   fd->gzfiledes = gzfile;
+  fd->mmap_file = mmap_file;
+  fd->zlib_frames = zlib_frames;
 
   fd->read = read_fn;
   fd->seek = seek_fn;
@@ -1443,20 +2215,39 @@ static FileData *blo_filedata_from_file_open(const char *filepath, ReportList *r
   return fd;
 }
 
-/* cannot be called with relative paths anymore! */
-/* on each new library added, it now checks for the current FileData and expands relativeness */
-FileData *blo_filedata_from_file(const char *filepath, ReportList *reports)
+static FileData *blo_filedata_from_file_ex(const char *filepath,
+                                           ReportList *reports,
+                                           const bool use_bhead_index)
 {
   FileData *fd = blo_filedata_from_file_open(filepath, reports);
   if (fd != NULL) {
     /* needed for library_append and read_libraries */
     BLI_strncpy(fd->relabase, filepath, sizeof(fd->relabase));
 
+    if (use_bhead_index) {
+      fd->flags |= FD_FLAGS_USE_BHEAD_INDEX;
+    }
     return blo_decode_and_check(fd, reports);
   }
   return NULL;
 }
 
+/* cannot be called with relative paths anymore! */
+/* on each new library added, it now checks for the current FileData and expands relativeness */
+FileData *blo_filedata_from_file(const char *filepath, ReportList *reports)
+{
+  return blo_filedata_from_file_ex(filepath, reports, false);
+}
+
+/**
+ * Same as blo_filedata_from_file(), for reading only some ID's of the file (linking, listing
+ * the ID's of a file). Blocks are found with the block index of the file when it has one.
+ */
+FileData *blo_filedata_from_file_for_linking(const char *filepath, ReportList *reports)
+{
+  return blo_filedata_from_file_ex(filepath, reports, true);
+}
+
 /**
  * Same as blo_filedata_from_file(), but does not reads DNA data, only header.
  * Use it for light access (e.g. thumbnail reading).
@@ -1487,6 +2278,16 @@ static int fd_read_gzip_from_memory(FileData *filedata,
   // Inflate another chunk.
   err = inflate(&filedata->strm, Z_SYNC_FLUSH);
 
+  while (err == Z_STREAM_END && filedata->strm.avail_in > 0) {
+    /* Files compressed in frames consist of several gzip members,
+     * continue with the next one, see #BLEND_ZLIB_FRAMES_MAGIC. */
+    if (inflateReset(&filedata->strm) != Z_OK) {
+      err = Z_STREAM_ERROR;
+      break;
+    }
+    err = (filedata->strm.avail_out > 0) ? inflate(&filedata->strm, Z_SYNC_FLUSH) : Z_OK;
+  }
+
   if (err == Z_STREAM_END) {
     return 0;
   }
@@ -1577,6 +2378,14 @@ void blo_filedata_free(FileData *fd)
       gzclose(fd->gzfiledes);
     }
 
+    if (fd->zlib_frames != NULL) {
+      blo_zlib_frames_free(fd->zlib_frames);
+    }
+
+    if (fd->mmap_file != NULL) {
+      BLI_mmap_free(fd->mmap_file);
+    }
+
     if (fd->strm.next_in) {
       if (inflateEnd(&fd->strm) != Z_OK) {
         printf("close gzip stream error\n");
@@ -1588,6 +2397,13 @@ void blo_filedata_free(FileData *fd)
       fd->buffer = NULL;
     }
 
+#ifdef USE_READ_DATA_PREFETCH
+    /* Data of ID's which were skipped while reading. */
+    LISTBASE_FOREACH (BHeadN *, new_bhead, &fd->bhead_list) {
+      MEM_SAFE_FREE(new_bhead->data_read);
+    }
+#endif
+
     /* Free all BHeadN data blocks */
 #ifndef NDEBUG
     BLI_freelistN(&fd->bhead_list);
@@ -1607,6 +2423,9 @@ void blo_filedata_free(FileData *fd)
     if (fd->compflags) {
       MEM_freeN((void *)fd->compflags);
     }
+    if (fd->reconstruct_info) {
+      DNA_reconstruct_info_free(fd->reconstruct_info);
+    }
 
     if (fd->datamap) {
       oldnewmap_free(fd->datamap);
@@ -1634,6 +2453,10 @@ void blo_filedata_free(FileData *fd)
     }
 #endif
 
+    if (fd->bhead_index) {
+      blo_bhead_index_free(fd->bhead_index);
+    }
+
     MEM_freeN(fd);
   }
 }
@@ -2140,7 +2963,14 @@ static void switch_endian_structs(const struct SDNA *filesdna, BHead *bhead)
   }
 }
 
-static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
+/**
+ * Read the data of a block, converted to the current DNA.
+ *
+ * \param r_is_valid: Set to false when reading failed, the file is not OK then.
+ * \note Doesn't modify \a fd, so it can be used from multiple threads
+ * as long as blocks can be read in random order, see #read_data_prefetch.
+ */
+static void *read_struct_ex(FileData *fd, BHead *bh, const char *blockname, bool *r_is_valid)
 {
   void *temp = NULL;
 
@@ -2155,7 +2985,7 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
       if (BHEADN_FROM_BHEAD(bh)->has_data == false) {
         bh = blo_bhead_read_full(fd, bh);
         if (UNLIKELY(bh == NULL)) {
-          fd->flags &= ~FD_FLAGS_FILE_OK;
+          *r_is_valid = false;
           return NULL;
         }
       }
@@ -2165,17 +2995,28 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
 
     if (fd->compflags[bh->SDNAnr] != SDNA_CMP_REMOVED) {
       if (fd->compflags[bh->SDNAnr] == SDNA_CMP_NOT_EQUAL) {
+        const void *data = (bh + 1);
 #ifdef USE_BHEAD_READ_ON_DEMAND
         if (BHEADN_FROM_BHEAD(bh)->has_data == false) {
-          bh = blo_bhead_read_full(fd, bh);
-          if (UNLIKELY(bh == NULL)) {
-            fd->flags &= ~FD_FLAGS_FILE_OK;
-            return NULL;
+          /* Reconstruct straight from the mapped file when possible,
+           * the old struct layout is only read, so there is no need for a copy. */
+          data = blo_bhead_data_mapped(fd, bh);
+          if (data == NULL) {
+            bh = blo_bhead_read_full(fd, bh);
+            if (UNLIKELY(bh == NULL)) {
+              *r_is_valid = false;
+              return NULL;
+            }
+            data = (bh + 1);
           }
         }
 #endif
-        temp = DNA_struct_reconstruct(
-            fd->memsdna, fd->filesdna, fd->compflags, bh->SDNAnr, bh->nr, (bh + 1));
+        temp = DNA_struct_reconstruct(fd->reconstruct_info, bh->SDNAnr, bh->nr, data);
+#ifdef USE_BHEAD_READ_ON_DEMAND
+        if (fd->mmap_file != NULL && UNLIKELY(BLI_mmap_any_io_error(fd->mmap_file))) {
+          *r_is_valid = false;
+        }
+#endif
       }
       else {
         /* SDNA_CMP_EQUAL */
@@ -2188,7 +3029,7 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
           /* Instead of allocating the bhead, then copying it,
            * read the data from the file directly into the memory. */
           if (UNLIKELY(!blo_bhead_read_data(fd, bh, temp))) {
-            fd->flags &= ~FD_FLAGS_FILE_OK;
+            *r_is_valid = false;
             MEM_freeN(temp);
             temp = NULL;
           }
@@ -2209,6 +3050,25 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
   return temp;
 }
 
+static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
+{
+#ifdef USE_READ_DATA_PREFETCH
+  BHeadN *new_bhead = BHEADN_FROM_BHEAD(bh);
+  if (new_bhead->data_read != NULL) {
+    void *temp = new_bhead->data_read;
+    new_bhead->data_read = NULL;
+    return temp;
+  }
+#endif
+
+  bool is_valid = true;
+  void *temp = read_struct_ex(fd, bh, blockname, &is_valid);
+  if (UNLIKELY(!is_valid)) {
+    fd->flags &= ~FD_FLAGS_FILE_OK;
+  }
+  return temp;
+}
+
 /* Like read_struct, but gets a pointer without allocating. Only works for
  * undo since DNA must match. */
 static const void *peek_struct_undo(FileData *fd, BHead *bhead)
@@ -7181,6 +8041,179 @@ static BHead *read_userdef(BlendFileData *bfd, FileData *fd, BHead *bhead)
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Read Data in Parallel
+ *
+ * Files saved with another DNA, like files from older versions, need their blocks converted to
+ * the current DNA (#DNA_struct_reconstruct). This is a large part of the work of reading such
+ * files and doesn't depend on other blocks. When a whole file is read, the blocks which need the
+ * conversion are converted using multiple threads for a window of ID's ahead of
+ * #blo_read_file_internal, #read_libblock then takes the results. Only one window of converted
+ * blocks exists at a time.
+ *
+ * Blocks with the current DNA are only copied, so files saved with the current DNA don't use
+ * this at all. Linking the data (#direct_link_id) remains single threaded, since it adds to
+ * #Main, uses the maps and reports shared between all ID's and calls #IDTypeInfo callbacks which
+ * are not known to be thread safe.
+ * \{ */
+
+#ifdef USE_READ_DATA_PREFETCH
+
+/* Blocks are converted in windows of about this many bytes of file data, starting at the block
+ * #blo_read_file_internal reached. This limits the memory used by converted blocks which are not
+ * linked yet. A window always contains the whole data of its last ID. */
+#  define READ_DATA_PREFETCH_WINDOW_SIZE (32 * 1024 * 1024)
+#  define READ_DATA_PREFETCH_WINDOW_BLOCKS 4096
+
+typedef struct ReadDataPrefetch {
+  FileData *fd;
+  /** Blocks of the current window. */
+  BHead **bheads;
+  /** Allocation names, as used by #read_libblock. */
+  const char **allocnames;
+  int bheads_len;
+  int bheads_len_alloc;
+} ReadDataPrefetch;
+
+static void read_data_prefetch_cb(void *__restrict userdata,
+                                  const int index,
+                                  const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  ReadDataPrefetch *prefetch = userdata;
+  BHead *bhead = prefetch->bheads[index];
+
+  bool is_valid = true;
+  void *data = read_struct_ex(prefetch->fd, bhead, prefetch->allocnames[index], &is_valid);
+  if (UNLIKELY(!is_valid)) {
+    /* Leave it to #read_struct to fail again and report it. */
+    MEM_SAFE_FREE(data);
+  }
+  BHEADN_FROM_BHEAD(bhead)->data_read = data;
+}
+
+/* Blocks which are only copied are read by #read_struct, that is as fast as copying them in
+ * another thread. */
+static bool read_data_prefetch_block_needs_conversion(const FileData *fd, const BHead *bhead)
+{
+  return (bhead->SDNAnr && (fd->flags & FD_FLAGS_SWITCH_ENDIAN)) ||
+         fd->compflags[bhead->SDNAnr] == SDNA_CMP_NOT_EQUAL;
+}
+
+static bool read_data_prefetch_file_needs_conversion(const FileData *fd)
+{
+  if (fd->flags & FD_FLAGS_SWITCH_ENDIAN) {
+    return true;
+  }
+  for (int i = 0; i < fd->filesdna->structs_len; i++) {
+    if (fd->compflags[i] == SDNA_CMP_NOT_EQUAL) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * \return false when blocks are not read in parallel, in that case \a prefetch is not used.
+ */
+static bool read_data_prefetch_begin(FileData *fd, ReadDataPrefetch *prefetch)
+{
+  /* Undo restores unchanged ID's instead of reading them. Blocks which are not in memory yet
+   * can only be read in parallel when the file supports random access. */
+  if (fd->memfile != NULL || (fd->skip_flags & BLO_READ_SKIP_DATA) ||
+      (fd->seek != NULL && (fd->mmap_file == NULL || fd->zlib_frames != NULL)) ||
+      BLI_task_scheduler_num_threads() <= 1 || !read_data_prefetch_file_needs_conversion(fd)) {
+    return false;
+  }
+
+  prefetch->fd = fd;
+  prefetch->bheads_len = 0;
+  prefetch->bheads_len_alloc = 1024;
+  prefetch->bheads = MEM_malloc_arrayN(
+      prefetch->bheads_len_alloc, sizeof(*prefetch->bheads), __func__);
+  prefetch->allocnames = MEM_malloc_arrayN(
+      prefetch->bheads_len_alloc, sizeof(*prefetch->allocnames), __func__);
+  return true;
+}
+
+/* Free the data of blocks in the previous window which were skipped by #read_libblock. */
+static void read_data_prefetch_free_unused(ReadDataPrefetch *prefetch)
+{
+  for (int i = 0; i < prefetch->bheads_len; i++) {
+    MEM_SAFE_FREE(BHEADN_FROM_BHEAD(prefetch->bheads[i])->data_read);
+  }
+  prefetch->bheads_len = 0;
+}
+
+/**
+ * Convert the ID blocks starting at \a bhead and their data in parallel, when they need to be
+ * converted.
+ *
+ * \return The first block after the window, which is not a DATA block, so that
+ * #blo_read_file_internal reaches it. NULL when the window reaches the end of the file.
+ */
+static BHead *read_data_prefetch_window(ReadDataPrefetch *prefetch, BHead *bhead)
+{
+  FileData *fd = prefetch->fd;
+  read_data_prefetch_free_unused(prefetch);
+
+  /* Gather the ID blocks read by #blo_read_file_internal and their data. */
+  const char *allocname_data = NULL;
+  size_t window_size = 0;
+  for (; bhead && bhead->code != ENDB; bhead = blo_bhead_next(fd, bhead)) {
+    const char *allocname;
+    if (bhead->code == DATA) {
+      allocname = allocname_data;
+    }
+    else if ((window_size >= READ_DATA_PREFETCH_WINDOW_SIZE) ||
+             (prefetch->bheads_len >= READ_DATA_PREFETCH_WINDOW_BLOCKS)) {
+      break;
+    }
+    else if (BKE_idtype_idcode_is_valid(bhead->code) || bhead->code == ID_SCRN) {
+      allocname = "lib block";
+      allocname_data = dataname(GS(blo_bhead_id_name(fd, bhead)));
+    }
+    else {
+      allocname = allocname_data = NULL;
+    }
+
+    if (allocname == NULL || bhead->len == 0 ||
+        !read_data_prefetch_block_needs_conversion(fd, bhead)) {
+      continue;
+    }
+    if (prefetch->bheads_len == prefetch->bheads_len_alloc) {
+      prefetch->bheads_len_alloc *= 2;
+      prefetch->bheads = MEM_reallocN(prefetch->bheads,
+                                      sizeof(*prefetch->bheads) * prefetch->bheads_len_alloc);
+      prefetch->allocnames = MEM_reallocN(
+          (void *)prefetch->allocnames,
+          sizeof(*prefetch->allocnames) * prefetch->bheads_len_alloc);
+    }
+    prefetch->bheads[prefetch->bheads_len] = bhead;
+    prefetch->allocnames[prefetch->bheads_len] = allocname;
+    prefetch->bheads_len++;
+    window_size += (size_t)bhead->len;
+  }
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  /* Most blocks are small, avoid scheduling overhead. */
+  settings.min_iter_per_thread = 64;
+  BLI_task_parallel_range(0, prefetch->bheads_len, prefetch, read_data_prefetch_cb, &settings);
+
+  return (bhead && bhead->code != ENDB) ? bhead : NULL;
+}
+
+static void read_data_prefetch_end(ReadDataPrefetch *prefetch)
+{
+  read_data_prefetch_free_unused(prefetch);
+  MEM_freeN(prefetch->bheads);
+  MEM_freeN((void *)prefetch->allocnames);
+}
+
+#endif /* USE_READ_DATA_PREFETCH */
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name Read File (Internal)
  * \{ */
@@ -7230,7 +8263,18 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
     }
   }
 
+#ifdef USE_READ_DATA_PREFETCH
+  ReadDataPrefetch prefetch;
+  const bool use_prefetch = read_data_prefetch_begin(fd, &prefetch);
+  BHead *prefetch_window_start = use_prefetch ? bhead : NULL;
+#endif
+
   while (bhead) {
+#ifdef USE_READ_DATA_PREFETCH
+    if (bhead == prefetch_window_start) {
+      prefetch_window_start = read_data_prefetch_window(&prefetch, bhead);
+    }
+#endif
     switch (bhead->code) {
       case DATA:
       case DNA1:
@@ -7281,6 +8325,12 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
     }
   }
 
+#ifdef USE_READ_DATA_PREFETCH
+  if (use_prefetch) {
+    read_data_prefetch_end(&prefetch);
+  }
+#endif
+
   /* do before read_libraries, but skip undo case */
   if (fd->memfile == NULL) {
     if ((fd->skip_flags & BLO_READ_SKIP_DATA) == 0) {
@@ -7409,6 +8459,12 @@ static BHead *find_previous_lib(FileData *fd, BHead *bhead)
     return NULL;
   }
 
+  if (fd->bhead_index != NULL) {
+    const BlendBHeadIndexEntry *entry = blo_bhead_index_find_library(
+        fd->bhead_index, BHEADN_FROM_BHEAD(bhead)->bhead_offset);
+    return entry ? blo_bhead_index_entry_bhead(fd, entry) : NULL;
+  }
+
   for (; bhead; bhead = blo_bhead_prev(fd, bhead)) {
     if (bhead->code == ID_LI) {
       break;
@@ -7429,6 +8485,16 @@ static BHead *find_bhead(FileData *fd, void *old)
     return NULL;
   }
 
+  if (fd->bhead_index != NULL) {
+    /* Only ID's are looked up by address, which are all in the index. */
+    const BlendBHeadIndexEntry *entry = blo_bhead_index_find_old(fd->bhead_index, old);
+    BHead *bhead = entry ? blo_bhead_index_entry_bhead(fd, entry) : NULL;
+    if (bhead == NULL) {
+      printf("%s: no indexed block at address %p in '%s'\n", __func__, old, fd->relabase);
+    }
+    return bhead;
+  }
+
   if (fd->bheadmap == NULL) {
     sort_bhead_old_map(fd);
   }
@@ -7460,7 +8526,7 @@ static BHead *find_bhead_from_code_name(FileData *fd, const short idcode, const
   *((short *)idname_full) = idcode;
   BLI_strncpy(idname_full + 2, name, sizeof(idname_full) - 2);
 
-  return BLI_ghash_lookup(fd->bhead_idname_hash, idname_full);
+  return find_bhead_from_idname(fd, idname_full);
 
 #else
   BHead *bhead;
@@ -7484,6 +8550,11 @@ static BHead *find_bhead_from_code_name(FileData *fd, const short idcode, const
 static BHead *find_bhead_from_idname(FileData *fd, const char *idname)
 {
 #ifdef USE_GHASH_BHEAD
+  if (fd->bhead_index != NULL) {
+    const BlendBHeadIndexEntry *entry = BLI_ghash_lookup(fd->bhead_index->entry_from_idname,
+                                                         idname);
+    return entry ? blo_bhead_index_entry_bhead(fd, entry) : NULL;
+  }
   return BLI_ghash_lookup(fd->bhead_idname_hash, idname);
 #else
   return find_bhead_from_code_name(fd, GS(idname), idname + 2);
@@ -8867,7 +9938,7 @@ static FileData *read_library_file_data(FileData *basefd,
                      mainptr->curlib->filepath_abs,
                      mainptr->curlib->filepath,
                      library_parent_filepath(mainptr->curlib));
-    fd = blo_filedata_from_file(mainptr->curlib->filepath_abs, basefd->reports);
+    fd = blo_filedata_from_file_for_linking(mainptr->curlib->filepath_abs, basefd->reports);
   }
 
   if (fd) {
@@ -29,7 +29,11 @@
 #include "DNA_windowmanager_types.h" /* for ReportType */
 #include "zlib.h"
 
+struct BLI_mmap_file;
+struct BHeadIndex;
 struct BLOCacheStorage;
+struct BlendZlibFrames;
+struct DNA_ReconstructInfo;
 struct GSet;
 struct IDNameLib_Map;
 struct Key;
@@ -50,6 +54,8 @@ enum eFileDataFlag {
   FD_FLAGS_NOT_MY_BUFFER = 1 << 4,
   /* XXX Unused in practice (checked once but never set). */
   FD_FLAGS_NOT_MY_LIBMAP = 1 << 5,
+  /** Only some ID's are read, use the block index when the file has one. */
+  FD_FLAGS_USE_BHEAD_INDEX = 1 << 6,
 };
 
 /* Disallow since it's 32bit on ms-windows. */
@@ -81,6 +87,11 @@ typedef struct FileData {
   /** Regular file reading. */
   int filedes;
 
+  /** Variables needed for reading from a memory-mapped file. */
+  struct BLI_mmap_file *mmap_file;
+  /** Gzip frames of a compressed memory-mapped file, see #BLEND_ZLIB_FRAMES_MAGIC. */
+  struct BlendZlibFrames *zlib_frames;
+
   /** Variables needed for reading from memory / stream. */
   const char *buffer;
   /** Variables needed for reading from memfile (undo). */
@@ -102,6 +113,7 @@ typedef struct FileData {
   const struct SDNA *memsdna;
   /** Array of #eSDNA_StructCompare. */
   const char *compflags;
+  struct DNA_ReconstructInfo *reconstruct_info;
 
   int fileversion;
   /** Used to retrieve ID names from (bhead+1). */
@@ -124,6 +136,9 @@ typedef struct FileData {
   /** See: #USE_GHASH_BHEAD. */
   struct GHash *bhead_idname_hash;
 
+  /** Block index read from the end of the file, see #BLEND_BHEAD_INDEX_MAGIC. */
+  struct BHeadIndex *bhead_index;
+
   ListBase *mainlist;
   /** Used for undo. */
   ListBase *old_mainlist;
@@ -134,6 +149,67 @@ typedef struct FileData {
 
 #define SIZEOFBLENDERHEADER 12
 
+/* Compressed files saved using multiple threads are split into frames, each an independent
+ * gzip member, so they can be compressed and decompressed in parallel.
+ *
+ * The file ends with an empty gzip member, the header extra field of which has a single
+ * sub-field (#BLEND_ZLIB_FRAMES_SI1, #BLEND_ZLIB_FRAMES_SI2) holding the frame table:
+ * - per frame: `uint32` compressed size, `uint32` uncompressed size,
+ * - `uint32` number of frames,
+ * - #BLEND_ZLIB_FRAMES_MAGIC.
+ * All integers are little endian. */
+
+/** Uncompressed size of every frame but the last one. */
+#define BLEND_ZLIB_FRAME_SIZE (1 << 20)
+#define BLEND_ZLIB_FRAMES_MAGIC "BLZF"
+#define BLEND_ZLIB_FRAMES_SI1 'B'
+#define BLEND_ZLIB_FRAMES_SI2 'F'
+#define BLEND_ZLIB_FRAMES_TABLE_SIZE(frames_len) ((size_t)(frames_len)*8 + 8)
+/** The sub-field and its 4 byte header must fit in the 16 bit XLEN. */
+#define BLEND_ZLIB_FRAMES_TABLE_SIZE_MAX (0xffff - 4)
+/** Gzip header, XLEN and the sub-field header. */
+#define BLEND_ZLIB_FRAMES_HEADER_SIZE (10 + 2 + 4)
+/** Empty deflate block, CRC32 and ISIZE. */
+#define BLEND_ZLIB_FRAMES_FOOTER_SIZE (2 + 4 + 4)
+
+/* Files written by 64 bit builds store the offsets of their ID blocks in a #DATA block between
+ * #DNA1 and #ENDB, so linking from large libraries can seek to the blocks it needs instead of
+ * reading every block header. Readers which don't know about it skip it like any other #DATA
+ * block which isn't referenced.
+ *
+ * The block holds a #BlendBHeadIndexHeader, followed by one #BlendBHeadIndexEntry per #GLOB,
+ * #ID_LI, #ID_LINK_PLACEHOLDER, #ID_SCRN or ID block in file order and a #BlendBHeadIndexFooter,
+ * which ends right before the #ENDB block. Integers are in the byte order of the file. */
+
+#define BLEND_BHEAD_INDEX_MAGIC "BIDX"
+#define BLEND_BHEAD_INDEX_VERSION 2
+
+typedef struct BlendBHeadIndexHeader {
+  char magic[4];
+  int version;
+  int entries_len;
+  int _pad;
+  uint64_t glob_offset;
+  uint64_t dna1_offset;
+} BlendBHeadIndexHeader;
+
+typedef struct BlendBHeadIndexEntry {
+  /** Offset of the #BHead in the (uncompressed) file. */
+  uint64_t offset;
+  /** #BHead.old, to find ID blocks from pointers without reading them. */
+  uint64_t old;
+  int code;
+  char name[MAX_ID_NAME];
+  char _pad[2];
+} BlendBHeadIndexEntry;
+
+typedef struct BlendBHeadIndexFooter {
+  /** Offset of the #BHead of the index block. */
+  uint64_t offset;
+  char magic[4];
+  int _pad;
+} BlendBHeadIndexFooter;
+
 /***/
 struct Main;
 void blo_join_main(ListBase *mainlist);
@@ -142,6 +218,7 @@ void blo_split_main(ListBase *mainlist, struct Main *main);
 BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath);
 
 FileData *blo_filedata_from_file(const char *filepath, struct ReportList *reports);
+FileData *blo_filedata_from_file_for_linking(const char *filepath, struct ReportList *reports);
 FileData *blo_filedata_from_memory(const void *mem, int memsize, struct ReportList *reports);
 FileData *blo_filedata_from_memfile(struct MemFile *memfile,
                                     const struct BlendFileReadParams *params,
@@ -42,6 +42,8 @@
 
 #include "BLI_blenlib.h"
 #include "BLI_ghash.h"
+#include "BLI_hash_mm2a.h"
+#include "BLI_threads.h"
 
 #include "BLO_readfile.h"
 #include "BLO_undofile.h"
@@ -52,57 +54,169 @@
 /* keep last */
 #include "BLI_strict_flags.h"
 
-/* **************** support for memory-write, for undo buffers *************** */
+/* -------------------------------------------------------------------- */
+/** \name Shared Pages
+ *
+ * The data of chunks is split into pages of at most #MEMFILE_PAGE_SIZE bytes. Pages with the
+ * same content are shared by all memory files (found by hash), not only with the chunk at the
+ * same position in the previous undo step. When a small part of a large array changes, only
+ * the pages containing the change are stored again.
+ *
+ * Each page is accounted for in the #MemFile.size of one memory file which uses it, so the
+ * undo memory limit applies to the actual memory used.
+ * \{ */
+
+/** Data of chunks is split into pages of (at most) this size. */
+#define MEMFILE_PAGE_SIZE (1 << 12)
+
+typedef struct MemFilePage {
+  uint hash;
+  uint size;
+  /** Points to the memory after this struct, or the data to look up when used as a key. */
+  const char *data;
+  /** Number of chunks using this page. */
+  uint users;
+  /** The memory file accounting for this page, NULL when it has been freed. */
+  MemFile *owner;
+} MemFilePage;
+
+/** All pages used by any memory file, the set is freed once it's empty. */
+static GSet *memfile_pages = NULL;
+static ThreadMutex memfile_pages_lock = BLI_MUTEX_INITIALIZER;
+
+static uint memfile_page_hash(const void *key)
+{
+  return ((const MemFilePage *)key)->hash;
+}
 
-/* not memfile itself */
-void BLO_memfile_free(MemFile *memfile)
+static bool memfile_page_cmp(const void *a_v, const void *b_v)
+{
+  const MemFilePage *a = a_v, *b = b_v;
+  return (a->hash != b->hash) || (a->size != b->size) || (memcmp(a->data, b->data, a->size) != 0);
+}
+
+static MemFilePage *memfile_page_from_buf(const char *buf)
+{
+  return (MemFilePage *)buf - 1;
+}
+
+/**
+ * Add a user to the page with the content of \a buf, allocating it when needed,
+ * in which case it's accounted for in \a memfile.
+ */
+static MemFilePage *memfile_page_ensure(MemFile *memfile, const char *buf, uint size)
+{
+  MemFilePage page_key = {
+      .hash = BLI_hash_mm2((const uchar *)buf, size, 0),
+      .size = size,
+      .data = buf,
+  };
+
+  BLI_mutex_lock(&memfile_pages_lock);
+  if (memfile_pages == NULL) {
+    memfile_pages = BLI_gset_new(memfile_page_hash, memfile_page_cmp, __func__);
+  }
+  MemFilePage *page = BLI_gset_lookup(memfile_pages, &page_key);
+  if (page == NULL) {
+    page = MEM_mallocN(sizeof(*page) + size, "MemFilePage");
+    memcpy(page + 1, buf, size);
+    *page = page_key;
+    page->data = (const char *)(page + 1);
+    page->owner = memfile;
+    memfile->size += size;
+    BLI_gset_insert(memfile_pages, page);
+  }
+  page->users++;
+  BLI_mutex_unlock(&memfile_pages_lock);
+
+  return page;
+}
+
+static void memfile_page_user_add(MemFilePage *page)
+{
+  BLI_mutex_lock(&memfile_pages_lock);
+  BLI_assert(page->users > 0);
+  page->users++;
+  BLI_mutex_unlock(&memfile_pages_lock);
+}
+
+/**
+ * Remove a user of \a memfile from the page, the lock must be held.
+ *
+ * \param memfile_next: When not NULL, pages which are still used and were accounted for
+ * in \a memfile are accounted for in \a memfile_next instead.
+ */
+static void memfile_page_user_remove_locked(MemFilePage *page,
+                                            const MemFile *memfile,
+                                            MemFile *memfile_next)
+{
+  BLI_assert(page->users > 0);
+  page->users--;
+  if (page->users == 0) {
+    BLI_gset_remove(memfile_pages, page, NULL);
+    MEM_freeN(page);
+  }
+  else if (page->owner == memfile) {
+    page->owner = memfile_next;
+    if (memfile_next != NULL) {
+      memfile_next->size += page->size;
+    }
+  }
+}
+
+static void memfile_free_ex(MemFile *memfile, MemFile *memfile_next)
 {
   MemFileChunk *chunk;
 
+  BLI_mutex_lock(&memfile_pages_lock);
   while ((chunk = BLI_pophead(&memfile->chunks))) {
-    if (chunk->is_identical == false) {
-      MEM_freeN((void *)chunk->buf);
-    }
+    memfile_page_user_remove_locked(memfile_page_from_buf(chunk->buf), memfile, memfile_next);
     MEM_freeN(chunk);
   }
+  if (memfile_pages != NULL && BLI_gset_len(memfile_pages) == 0) {
+    BLI_gset_free(memfile_pages, NULL);
+    memfile_pages = NULL;
+  }
+  BLI_mutex_unlock(&memfile_pages_lock);
+
   memfile->size = 0;
 }
 
+/** \} */
+
+/* **************** support for memory-write, for undo buffers *************** */
+
+/* not memfile itself */
+void BLO_memfile_free(MemFile *memfile)
+{
+  memfile_free_ex(memfile, NULL);
+}
+
 /* to keep list of memfiles consistent, 'first' is always first in list */
 /* result is that 'first' is being freed */
 void BLO_memfile_merge(MemFile *first, MemFile *second)
 {
-  /* We use this mapping to store the memory buffers from second memfile chunks which are not owned
-   * by it (i.e. shared with some previous memory steps). */
-  GHash *buffer_to_second_memchunk = BLI_ghash_new(
-      BLI_ghashutil_ptrhash, BLI_ghashutil_ptrcmp, __func__);
-
-  /* First, detect all memchunks in second memfile that are not owned by it. */
-  for (MemFileChunk *sc = second->chunks.first; sc != NULL; sc = sc->next) {
-    if (sc->is_identical) {
-      BLI_ghash_insert(buffer_to_second_memchunk, (void *)sc->buf, sc);
-    }
-  }
+  /* Pages are reference counted, only the accounting of the memory which is still used
+   * needs to move to the second memfile. */
+  memfile_free_ex(first, second);
+}
 
-  /* Now, check all chunks from first memfile (the one we are removing), and if a memchunk owned by
-   * it is also used by the second memfile, transfer the ownership. */
-  for (MemFileChunk *fc = first->chunks.first; fc != NULL; fc = fc->next) {
-    if (!fc->is_identical) {
-      MemFileChunk *sc = BLI_ghash_lookup(buffer_to_second_memchunk, fc->buf);
-      if (sc != NULL) {
-        BLI_assert(sc->is_identical);
-        sc->is_identical = false;
-        fc->is_identical = true;
-      }
-      /* Note that if the second memfile does not use that chunk, we assume that the first one
-       * fully owns it without sharing it with any other memfile, and hence it should be freed with
-       * it. */
-    }
+/**
+ * Create a memfile sharing the memory of \a memfile,
+ * which stays valid when \a memfile is freed (the memory isn't accounted for in its size).
+ */
+void BLO_memfile_duplicate(const MemFile *memfile, MemFile *r_memfile)
+{
+  BLI_listbase_clear(&r_memfile->chunks);
+  r_memfile->size = 0;
+
+  BLI_mutex_lock(&memfile_pages_lock);
+  LISTBASE_FOREACH (const MemFileChunk *, chunk, &memfile->chunks) {
+    MemFileChunk *chunk_new = MEM_dupallocN(chunk);
+    memfile_page_from_buf(chunk->buf)->users++;
+    BLI_addtail(&r_memfile->chunks, chunk_new);
   }
-
-  BLI_ghash_free(buffer_to_second_memchunk, NULL, NULL);
-
-  BLO_memfile_free(first);
+  BLI_mutex_unlock(&memfile_pages_lock);
 }
 
 /* Clear is_identical_future before adding next memfile. */
@@ -154,7 +268,7 @@ void BLO_memfile_write_finalize(MemFileWriteData *mem_data)
   }
 }
 
-void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, uint size)
+static void memfile_chunk_add_page(MemFileWriteData *mem_data, const char *buf, uint size)
 {
   MemFile *memfile = mem_data->written_memfile;
   MemFileChunk **compchunk_step = &mem_data->reference_current_chunk;
@@ -178,18 +292,27 @@ void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, uint siz
         curchunk->buf = compchunk->buf;
         curchunk->is_identical = true;
         compchunk->is_identical_future = true;
+        memfile_page_user_add(memfile_page_from_buf(curchunk->buf));
       }
     }
     *compchunk_step = compchunk->next;
   }
 
-  /* not equal... */
+  /* not equal, the content may still exist in another undo step. */
   if (curchunk->buf == NULL) {
-    char *buf_new = MEM_mallocN(size, "Chunk buffer");
-    memcpy(buf_new, buf, size);
-    curchunk->buf = buf_new;
-    memfile->size += size;
+    curchunk->buf = memfile_page_ensure(memfile, buf, size)->data;
+  }
+}
+
+void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, uint size)
+{
+  /* Reference pages so a change in a large block only stores the pages around it again. */
+  while (size > MEMFILE_PAGE_SIZE) {
+    memfile_chunk_add_page(mem_data, buf, MEMFILE_PAGE_SIZE);
+    buf += MEMFILE_PAGE_SIZE;
+    size -= MEMFILE_PAGE_SIZE;
   }
+  memfile_chunk_add_page(mem_data, buf, size);
 }
 
 struct Main *BLO_memfile_main_get(struct MemFile *memfile,
@@ -782,6 +782,10 @@ void BLO_version_defaults_userpref_blend(Main *bmain, UserDef *userdef)
    */
   {
     /* Keep this block, even when empty. */
+
+    if (userdef->modifier_cache_limit == 0) {
+      userdef->modifier_cache_limit = 1024;
+    }
   }
 
   if (userdef->pixelsize == 0.0f) {
@@ -811,6 +815,7 @@ void BLO_sanitize_experimental_features_userpref_blend(UserDef *userdef)
   userdef->experimental.use_new_particle_system = false;
   userdef->experimental.use_new_hair_type = false;
   userdef->experimental.use_sculpt_vertex_colors = false;
+  userdef->experimental.use_depsgraph_critical_path = false;
 }
 
 #undef USER_LMOUSESELECT
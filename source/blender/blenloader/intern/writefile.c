@@ -125,6 +125,9 @@
 #include "BLI_bitmap.h"
 #include "BLI_blenlib.h"
 #include "BLI_mempool.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+#include "BLI_trace.h"
 #include "MEM_guardedalloc.h"  // MEM_freeN
 
 #include "BKE_action.h"
@@ -180,9 +183,6 @@
 #define MYWRITE_BUFFER_SIZE (MEM_SIZE_OPTIMAL(1 << 17)) /* 128kb */
 #define MYWRITE_MAX_CHUNK (MEM_SIZE_OPTIMAL(1 << 15))   /* ~32kb */
 
-/** Use if we want to store how many bytes have been written to the file. */
-// #define USE_WRITE_DATA_LEN
-
 /* -------------------------------------------------------------------- */
 /** \name Internal Write Wrapper's (Abstracts Compression)
  * \{ */
@@ -190,9 +190,11 @@
 typedef enum {
   WW_WRAP_NONE = 1,
   WW_WRAP_ZLIB,
+  WW_WRAP_ZLIB_FRAMES,
 } eWriteWrapType;
 
 typedef struct WriteWrap WriteWrap;
+typedef struct ZlibFramesWriter ZlibFramesWriter;
 struct WriteWrap {
   /* callbacks */
   bool (*open)(WriteWrap *ww, const char *filepath);
@@ -206,6 +208,7 @@ struct WriteWrap {
   union {
     int file_handle;
     gzFile gz_handle;
+    ZlibFramesWriter *zlib_frames;
   } _user_data;
 };
 
@@ -261,6 +264,290 @@ static size_t ww_write_zlib(WriteWrap *ww, const char *buf, size_t buf_len)
 }
 #undef FILE_HANDLE
 
+/* zlib, multi-threaded
+ *
+ * The stream is cut into frames of #BLEND_ZLIB_FRAME_SIZE which are compressed independently,
+ * each as its own gzip member, on the task pool. Frames are written in order as soon as they
+ * are done while the caller keeps serializing the next ones.
+ *
+ * A gzip stream may consist of any number of members, so the result is still read by `gzread`
+ * (and older Blender versions). The file ends with an empty member whose header extra field
+ * holds the size of every frame, which lets the reader decompress frames in parallel and seek,
+ * see #blo_zlib_frames_table_read. */
+
+typedef struct ZlibFrame {
+  struct ZlibFrame *next, *prev;
+
+  char *uncompressed;
+  uint uncompressed_size;
+  char *compressed;
+  uint compressed_size;
+
+  /** Set by the compressing task, protected by #ZlibFramesWriter.mutex. */
+  bool is_done;
+  bool is_ok;
+} ZlibFrame;
+
+struct ZlibFramesWriter {
+  int file_handle;
+
+  TaskPool *task_pool;
+  ThreadMutex mutex;
+  ThreadCondition condition;
+
+  /** Frames pushed to the task pool that are not written yet, in file order. */
+  ListBase frames_pending;
+  int frames_pending_len;
+  /** Limits memory use when serializing is faster than compression. */
+  int frames_pending_max;
+
+  /** Frame currently being filled by #ww_write_zlib_frames. */
+  ZlibFrame *frame_active;
+
+  /** Compressed and uncompressed size of every written frame, for the frame table. */
+  uint (*frame_sizes)[2];
+  int frame_sizes_len;
+  int frame_sizes_alloc;
+
+  bool error;
+};
+
+#define FRAMES_WRITER(ww) (ww)->_user_data.zlib_frames
+
+static void zlib_frame_compress_task(TaskPool *__restrict pool, void *taskdata)
+{
+  ZlibFrame *frame = taskdata;
+  ZlibFramesWriter *writer = BLI_task_pool_user_data(pool);
+  bool is_ok = false;
+
+  z_stream strm = {NULL};
+  /* Same compression level as #ww_open_zlib, 16 + MAX_WBITS writes a gzip header. */
+  if (deflateInit2(&strm, 1, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK) {
+    const uLong compressed_size_max = deflateBound(&strm, frame->uncompressed_size);
+    frame->compressed = MEM_mallocN(compressed_size_max, __func__);
+
+    strm.next_in = (Bytef *)frame->uncompressed;
+    strm.avail_in = frame->uncompressed_size;
+    strm.next_out = (Bytef *)frame->compressed;
+    strm.avail_out = (uInt)compressed_size_max;
+    if (deflate(&strm, Z_FINISH) == Z_STREAM_END) {
+      frame->compressed_size = (uint)strm.total_out;
+      is_ok = true;
+    }
+    deflateEnd(&strm);
+  }
+
+  MEM_SAFE_FREE(frame->uncompressed);
+
+  BLI_mutex_lock(&writer->mutex);
+  frame->is_ok = is_ok;
+  frame->is_done = true;
+  BLI_condition_notify_all(&writer->condition);
+  BLI_mutex_unlock(&writer->mutex);
+}
+
+/**
+ * Write compressed frames to the file in order.
+ * \param wait_len: Wait until no more than this many frames are pending.
+ */
+static void zlib_frames_write_done(ZlibFramesWriter *writer, const int wait_len)
+{
+  BLI_mutex_lock(&writer->mutex);
+  while (writer->frames_pending.first != NULL) {
+    ZlibFrame *frame = writer->frames_pending.first;
+    if (!frame->is_done) {
+      if (writer->frames_pending_len <= wait_len) {
+        break;
+      }
+      BLI_condition_wait(&writer->condition, &writer->mutex);
+      continue;
+    }
+    BLI_remlink(&writer->frames_pending, frame);
+    writer->frames_pending_len--;
+    /* Tasks only touch their own frame, so no need to hold the lock while writing. */
+    BLI_mutex_unlock(&writer->mutex);
+
+    if (!frame->is_ok || write(writer->file_handle, frame->compressed, frame->compressed_size) !=
+                             (ssize_t)frame->compressed_size) {
+      writer->error = true;
+    }
+
+    if (writer->frame_sizes_len == writer->frame_sizes_alloc) {
+      writer->frame_sizes_alloc = MAX2(256, writer->frame_sizes_alloc * 2);
+      writer->frame_sizes = MEM_reallocN(writer->frame_sizes,
+                                         sizeof(*writer->frame_sizes) *
+                                             (size_t)writer->frame_sizes_alloc);
+    }
+    writer->frame_sizes[writer->frame_sizes_len][0] = frame->compressed_size;
+    writer->frame_sizes[writer->frame_sizes_len][1] = frame->uncompressed_size;
+    writer->frame_sizes_len++;
+
+    MEM_SAFE_FREE(frame->compressed);
+    MEM_freeN(frame);
+
+    BLI_mutex_lock(&writer->mutex);
+  }
+  BLI_mutex_unlock(&writer->mutex);
+}
+
+static void zlib_frames_push_active(ZlibFramesWriter *writer)
+{
+  ZlibFrame *frame = writer->frame_active;
+  writer->frame_active = NULL;
+  if (frame == NULL || frame->uncompressed_size == 0) {
+    if (frame) {
+      MEM_freeN(frame->uncompressed);
+      MEM_freeN(frame);
+    }
+    return;
+  }
+
+  BLI_mutex_lock(&writer->mutex);
+  BLI_addtail(&writer->frames_pending, frame);
+  writer->frames_pending_len++;
+  BLI_mutex_unlock(&writer->mutex);
+
+  BLI_task_pool_push(writer->task_pool, zlib_frame_compress_task, frame, false, NULL);
+
+  /* Write what's already done, only block when too many frames are in flight. */
+  zlib_frames_write_done(writer, writer->frames_pending_max);
+}
+
+static void zlib_frames_le32(uchar *dst, uint value)
+{
+  dst[0] = (uchar)(value & 0xff);
+  dst[1] = (uchar)((value >> 8) & 0xff);
+  dst[2] = (uchar)((value >> 16) & 0xff);
+  dst[3] = (uchar)((value >> 24) & 0xff);
+}
+
+/**
+ * The trailing empty gzip member holding the frame table,
+ * see #BLEND_ZLIB_FRAMES_MAGIC for the layout.
+ */
+static bool zlib_frames_write_table(ZlibFramesWriter *writer)
+{
+  const size_t table_size = BLEND_ZLIB_FRAMES_TABLE_SIZE(writer->frame_sizes_len);
+  if (table_size > BLEND_ZLIB_FRAMES_TABLE_SIZE_MAX) {
+    /* Still a valid gzip stream, it can only be read sequentially. */
+    return true;
+  }
+
+  const size_t member_size = BLEND_ZLIB_FRAMES_HEADER_SIZE + table_size +
+                             BLEND_ZLIB_FRAMES_FOOTER_SIZE;
+  uchar *member = MEM_callocN(member_size, __func__);
+  uchar *p = member;
+
+  /* Header: magic, deflate, FEXTRA, zero mtime, no extra flags, unknown OS. */
+  const uchar header[10] = {0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff};
+  memcpy(p, header, sizeof(header));
+  p += sizeof(header);
+  /* XLEN, followed by a single sub-field. */
+  const uint subfield_len = (uint)table_size;
+  p[0] = (uchar)((subfield_len + 4) & 0xff);
+  p[1] = (uchar)((subfield_len + 4) >> 8);
+  p[2] = BLEND_ZLIB_FRAMES_SI1;
+  p[3] = BLEND_ZLIB_FRAMES_SI2;
+  p[4] = (uchar)(subfield_len & 0xff);
+  p[5] = (uchar)(subfield_len >> 8);
+  p += 6;
+
+  for (int i = 0; i < writer->frame_sizes_len; i++) {
+    zlib_frames_le32(p, writer->frame_sizes[i][0]);
+    zlib_frames_le32(p + 4, writer->frame_sizes[i][1]);
+    p += 8;
+  }
+  zlib_frames_le32(p, (uint)writer->frame_sizes_len);
+  memcpy(p + 4, BLEND_ZLIB_FRAMES_MAGIC, 4);
+  p += 8;
+
+  /* Empty final deflate block, then CRC32 and ISIZE of the empty content (both zero). */
+  p[0] = 0x03;
+  p[1] = 0x00;
+  p += 2 + 8;
+  BLI_assert(p == member + member_size);
+
+  const bool success = (write(writer->file_handle, member, member_size) == (ssize_t)member_size);
+  MEM_freeN(member);
+  return success;
+}
+
+static bool ww_open_zlib_frames(WriteWrap *ww, const char *filepath)
+{
+  int file = BLI_open(filepath, O_BINARY + O_WRONLY + O_CREAT + O_TRUNC, 0666);
+  if (file == -1) {
+    return false;
+  }
+
+  ZlibFramesWriter *writer = MEM_callocN(sizeof(*writer), __func__);
+  writer->file_handle = file;
+  writer->task_pool = BLI_task_pool_create(writer, TASK_PRIORITY_HIGH);
+  BLI_mutex_init(&writer->mutex);
+  BLI_condition_init(&writer->condition);
+  writer->frames_pending_max = 2 * BLI_task_scheduler_num_threads();
+
+  FRAMES_WRITER(ww) = writer;
+  return true;
+}
+
+static bool ww_close_zlib_frames(WriteWrap *ww)
+{
+  ZlibFramesWriter *writer = FRAMES_WRITER(ww);
+
+  zlib_frames_push_active(writer);
+  BLI_task_pool_work_and_wait(writer->task_pool);
+  zlib_frames_write_done(writer, 0);
+  BLI_assert(BLI_listbase_is_empty(&writer->frames_pending));
+
+  if (!writer->error) {
+    writer->error = !zlib_frames_write_table(writer);
+  }
+  if (close(writer->file_handle) == -1) {
+    writer->error = true;
+  }
+  const bool success = !writer->error;
+
+  BLI_task_pool_free(writer->task_pool);
+  BLI_condition_end(&writer->condition);
+  BLI_mutex_end(&writer->mutex);
+  MEM_SAFE_FREE(writer->frame_sizes);
+  MEM_freeN(writer);
+  FRAMES_WRITER(ww) = NULL;
+
+  return success;
+}
+
+static size_t ww_write_zlib_frames(WriteWrap *ww, const char *buf, size_t buf_len)
+{
+  ZlibFramesWriter *writer = FRAMES_WRITER(ww);
+  if (writer->error) {
+    return 0;
+  }
+
+  size_t buf_offset = 0;
+  while (buf_offset < buf_len) {
+    ZlibFrame *frame = writer->frame_active;
+    if (frame == NULL) {
+      frame = MEM_callocN(sizeof(*frame), __func__);
+      frame->uncompressed = MEM_mallocN(BLEND_ZLIB_FRAME_SIZE, __func__);
+      writer->frame_active = frame;
+    }
+
+    const size_t len = MIN2(buf_len - buf_offset,
+                            (size_t)(BLEND_ZLIB_FRAME_SIZE - frame->uncompressed_size));
+    memcpy(frame->uncompressed + frame->uncompressed_size, buf + buf_offset, len);
+    frame->uncompressed_size += (uint)len;
+    buf_offset += len;
+
+    if (frame->uncompressed_size == BLEND_ZLIB_FRAME_SIZE) {
+      zlib_frames_push_active(writer);
+    }
+  }
+
+  return writer->error ? 0 : buf_len;
+}
+#undef FRAMES_WRITER
+
 /* --- end compression types --- */
 
 static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
@@ -275,6 +562,14 @@ static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
       r_ww->use_buf = false;
       break;
     }
+    case WW_WRAP_ZLIB_FRAMES: {
+      r_ww->open = ww_open_zlib_frames;
+      r_ww->close = ww_close_zlib_frames;
+      r_ww->write = ww_write_zlib_frames;
+      /* Frames are buffered already. */
+      r_ww->use_buf = false;
+      break;
+    }
     default: {
       r_ww->open = ww_open_none;
       r_ww->close = ww_close_none;
@@ -299,10 +594,19 @@ typedef struct {
   /** Number of bytes used in #WriteData.buf (flushed when exceeded). */
   int buf_used_len;
 
-#ifdef USE_WRITE_DATA_LEN
-  /** Total number of bytes written. */
+  /** Total number of bytes written, the file offset of the next block. */
   size_t write_len;
-#endif
+
+  /** Offsets of the blocks needed for linking, see #BLEND_BHEAD_INDEX_MAGIC. */
+  struct {
+    /** Not used for undo, memory files are always read in full. */
+    bool use;
+    BlendBHeadIndexEntry *entries;
+    int entries_len;
+    int entries_len_alloc;
+    uint64_t glob_offset;
+    uint64_t dna1_offset;
+  } bhead_index;
 
   /** Set on unlikely case of an error (ignores further file writing).  */
   bool error;
@@ -365,6 +669,7 @@ static void writedata_free(WriteData *wd)
   if (wd->buf) {
     MEM_freeN(wd->buf);
   }
+  MEM_SAFE_FREE(wd->bhead_index.entries);
   MEM_freeN(wd);
 }
 
@@ -402,9 +707,7 @@ static void mywrite(WriteData *wd, const void *adr, int len)
     return;
   }
 
-#ifdef USE_WRITE_DATA_LEN
   wd->write_len += len;
-#endif
 
   if (wd->buf == NULL) {
     writedata_do_write(wd, adr, len);
@@ -530,6 +833,74 @@ static void mywrite_id_end(WriteData *wd, ID *UNUSED(id))
 /** \name Generic DNA File Writing
  * \{ */
 
+/**
+ * Store the location of the block about to be written,
+ * for #GLOB and ID blocks (where \a data starts with the #ID).
+ */
+static void bhead_index_add(WriteData *wd, const BHead *bh, const void *data)
+{
+  if (bh->code == GLOB) {
+    wd->bhead_index.glob_offset = wd->write_len;
+    return;
+  }
+  /* Screens are written as #ID_SCRN, they are found by address from their workspace. */
+  if (!BKE_idtype_idcode_is_valid(bh->code) && !ELEM(bh->code, ID_SCRN, ID_LINK_PLACEHOLDER)) {
+    return;
+  }
+
+  if (wd->bhead_index.entries_len == wd->bhead_index.entries_len_alloc) {
+    wd->bhead_index.entries_len_alloc = MAX2(wd->bhead_index.entries_len_alloc * 2, 256);
+    wd->bhead_index.entries = MEM_reallocN(
+        wd->bhead_index.entries,
+        sizeof(*wd->bhead_index.entries) * (size_t)wd->bhead_index.entries_len_alloc);
+  }
+
+  BlendBHeadIndexEntry *entry = &wd->bhead_index.entries[wd->bhead_index.entries_len++];
+  memset(entry, 0, sizeof(*entry));
+  entry->offset = wd->write_len;
+  entry->old = (uint64_t)(uintptr_t)bh->old;
+  entry->code = bh->code;
+  BLI_strncpy(entry->name, ((const ID *)data)->name, sizeof(entry->name));
+}
+
+/**
+ * Write the index as the last #DATA block, the reader finds it from the end of the file.
+ */
+static void bhead_index_write(WriteData *wd)
+{
+  const size_t entries_size = sizeof(BlendBHeadIndexEntry) * (size_t)wd->bhead_index.entries_len;
+  const size_t len = sizeof(BlendBHeadIndexHeader) + entries_size +
+                     sizeof(BlendBHeadIndexFooter);
+  if (len > INT_MAX) {
+    return;
+  }
+
+  BlendBHeadIndexHeader header = {{0}};
+  memcpy(header.magic, BLEND_BHEAD_INDEX_MAGIC, sizeof(header.magic));
+  header.version = BLEND_BHEAD_INDEX_VERSION;
+  header.entries_len = wd->bhead_index.entries_len;
+  header.glob_offset = wd->bhead_index.glob_offset;
+  header.dna1_offset = wd->bhead_index.dna1_offset;
+
+  BlendBHeadIndexFooter footer = {0};
+  footer.offset = wd->write_len;
+  memcpy(footer.magic, BLEND_BHEAD_INDEX_MAGIC, sizeof(footer.magic));
+
+  /* Not referenced by anything, so there is no address to store. */
+  BHead bh = {0};
+  bh.code = DATA;
+  bh.len = (int)len;
+  bh.SDNAnr = 0;
+  bh.nr = 1;
+
+  mywrite(wd, &bh, sizeof(BHead));
+  mywrite(wd, &header, sizeof(header));
+  if (entries_size != 0) {
+    mywrite(wd, wd->bhead_index.entries, (int)entries_size);
+  }
+  mywrite(wd, &footer, sizeof(footer));
+}
+
 static void writestruct_at_address_nr(
     WriteData *wd, int filecode, const int struct_nr, int nr, const void *adr, const void *data)
 {
@@ -556,6 +927,10 @@ static void writestruct_at_address_nr(
     return;
   }
 
+  if (wd->bhead_index.use && filecode != DATA) {
+    bhead_index_add(wd, &bh, data);
+  }
+
   mywrite(wd, &bh, sizeof(BHead));
   mywrite(wd, data, bh.len);
 }
@@ -2203,11 +2578,16 @@ static bool write_file_handle(Main *mainvar,
   char buf[16];
   WriteData *wd;
 
+  TRACE_ZONE_BEGIN("io", current ? "Write undo step" : "Write file");
+
   blo_split_main(&mainlist, mainvar);
 
   wd = mywrite_begin(ww, compare, current);
   BlendWriter writer = {wd};
 
+  /* The index holds addresses, only 64 bit builds are supported by the reader. */
+  wd->bhead_index.use = !wd->use_memfile && (sizeof(void *) == 8);
+
   sprintf(buf,
           "BLENDER%c%c%.3d",
           (sizeof(void *) == 8) ? '-' : '_',
@@ -2404,8 +2784,13 @@ static bool write_file_handle(Main *mainvar,
    *
    * Note that we *borrow* the pointer to 'DNAstr',
    * so writing each time uses the same address and doesn't cause unnecessary undo overhead. */
+  wd->bhead_index.dna1_offset = wd->write_len;
   writedata(wd, DNA1, wd->sdna->data_len, wd->sdna->data);
 
+  if (wd->bhead_index.use) {
+    bhead_index_write(wd);
+  }
+
   /* end of file */
   memset(&bhead, 0, sizeof(BHead));
   bhead.code = ENDB;
@@ -2413,7 +2798,11 @@ static bool write_file_handle(Main *mainvar,
 
   blo_join_main(&mainlist);
 
-  return mywrite_end(wd);
+  const bool err = mywrite_end(wd);
+
+  TRACE_ZONE_END();
+
+  return err;
 }
 
 /* do reverse file history: .blend1 -> .blend2, .blend -> .blend1 */
@@ -2497,7 +2886,9 @@ bool BLO_write_file(Main *mainvar,
   BLI_snprintf(tempname, sizeof(tempname), "%s@", filepath);
 
   if (write_flags & G_FILE_COMPRESS) {
-    ww_type = WW_WRAP_ZLIB;
+    /* Frames compress in parallel and can be read back in parallel too,
+     * only fall back to a single zlib stream when there is nothing to gain. */
+    ww_type = (BLI_task_scheduler_num_threads() > 1) ? WW_WRAP_ZLIB_FRAMES : WW_WRAP_ZLIB;
   }
   else {
     ww_type = WW_WRAP_NONE;
@@ -2573,9 +2964,12 @@ bool BLO_write_file(Main *mainvar,
   }
 
   /* actual file writing */
-  const bool err = write_file_handle(mainvar, &ww, NULL, NULL, write_flags, use_userdef, thumb);
+  bool err = write_file_handle(mainvar, &ww, NULL, NULL, write_flags, use_userdef, thumb);
 
-  ww.close(&ww);
+  /* Buffered (compressed) data may only be written on close. */
+  if (ww.close(&ww) == false) {
+    err = true;
+  }
 
   if (UNLIKELY(path_list_backup)) {
     BKE_bpath_list_restore(mainvar, path_list_flag, path_list_backup);
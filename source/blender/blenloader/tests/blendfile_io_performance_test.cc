@@ -0,0 +1,382 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2020 by Blender Foundation.
+ */
+
+/** \file
+ * Throughput of reading and writing .blend files and memfile undo steps, on synthetic data.
+ *
+ * These tests are disabled by default since they take a while, run them with:
+ * `blender_test --gtest_also_run_disabled_tests --gtest_filter='*BlendfileIOPerformance*'`
+ *
+ * Results are printed as JSON, pass `--blendfile-io-performance-json=<path>`
+ * to write them to a file instead, to track them across releases.
+ */
+
+#include <cfloat>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "blendfile_loading_base_test.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_fileops.h"
+#include "BLI_listbase.h"
+#include "BLI_path_util.h"
+#include "BLI_task.h"
+#include "BLI_utildefines.h"
+
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_node_types.h"
+#include "DNA_object_types.h"
+
+#include "BKE_appdir.h"
+#include "BKE_blender_undo.h"
+#include "BKE_blender_version.h"
+#include "BKE_customdata.h"
+#include "BKE_global.h"
+#include "BKE_lib_id.h"
+#include "BKE_main.h"
+#include "BKE_material.h"
+#include "BKE_mesh.h"
+#include "BKE_node.h"
+#include "BKE_object.h"
+
+#include "BLO_readfile.h"
+#include "BLO_undofile.h"
+#include "BLO_writefile.h"
+
+#include "PIL_time.h"
+
+DEFINE_string(blendfile_io_performance_json,
+              "",
+              "File to write the results of the BlendfileIOPerformance tests to.");
+
+#define NUM_RUN_AVERAGED 5
+
+/* -------------------------------------------------------------------- */
+/** \name Synthetic Data
+ * \{ */
+
+static void mesh_add_grid(Main *bmain, const char *name, const int size)
+{
+  Mesh *me = BKE_mesh_add(bmain, name);
+
+  me->totvert = size * size;
+  me->totpoly = (size - 1) * (size - 1);
+  me->totloop = me->totpoly * 4;
+  CustomData_add_layer(&me->vdata, CD_MVERT, CD_CALLOC, nullptr, me->totvert);
+  CustomData_add_layer(&me->pdata, CD_MPOLY, CD_CALLOC, nullptr, me->totpoly);
+  CustomData_add_layer(&me->ldata, CD_MLOOP, CD_CALLOC, nullptr, me->totloop);
+  BKE_mesh_update_customdata_pointers(me, false);
+
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      MVert *mv = &me->mvert[y * size + x];
+      mv->co[0] = (float)x;
+      mv->co[1] = (float)y;
+      mv->co[2] = (float)((x ^ y) & 7) * 0.1f;
+    }
+  }
+
+  MPoly *mp = me->mpoly;
+  MLoop *ml = me->mloop;
+  for (int y = 0; y < size - 1; y++) {
+    for (int x = 0; x < size - 1; x++, mp++) {
+      mp->loopstart = (int)(ml - me->mloop);
+      mp->totloop = 4;
+      (ml++)->v = y * size + x;
+      (ml++)->v = y * size + x + 1;
+      (ml++)->v = (y + 1) * size + x + 1;
+      (ml++)->v = (y + 1) * size + x;
+    }
+  }
+
+  BKE_mesh_calc_edges(me, false, false);
+
+  Object *ob = BKE_object_add_only_object(bmain, OB_MESH, name);
+  ob->data = me;
+  id_us_plus(&me->id);
+}
+
+/** Adds a node tree of math nodes linked into a chain of \a chain_len nodes. */
+static bNodeTree *node_tree_add_chain(Main *bmain, const char *name, const int chain_len)
+{
+  bNodeTree *ntree = ntreeAddTree(bmain, name, "ShaderNodeTree");
+
+  bNode *node_prev = nullptr;
+  for (int i = 0; i < chain_len; i++) {
+    bNode *node = nodeAddStaticNode(nullptr, ntree, SH_NODE_MATH);
+    node->locx = (float)i * 200.0f;
+    if (node_prev != nullptr) {
+      nodeAddLink(ntree,
+                  node_prev,
+                  nodeFindSocket(node_prev, SOCK_OUT, "Value"),
+                  node,
+                  nodeFindSocket(node, SOCK_IN, "Value"));
+    }
+    node_prev = node;
+  }
+  return ntree;
+}
+
+static Main *main_add_many_ids(const int ids_len)
+{
+  Main *bmain = BKE_main_new();
+  for (int i = 0; i < ids_len; i++) {
+    BKE_object_add_only_object(bmain, OB_EMPTY, "Empty");
+    if ((i % 10) == 0) {
+      BKE_material_add(bmain, "Material");
+    }
+  }
+  return bmain;
+}
+
+static Main *main_add_large_meshes(const int meshes_len, const int size)
+{
+  Main *bmain = BKE_main_new();
+  for (int i = 0; i < meshes_len; i++) {
+    mesh_add_grid(bmain, "Grid", size);
+  }
+  return bmain;
+}
+
+/** Adds node groups nested \a depth levels deep, each containing a chain of nodes. */
+static Main *main_add_deep_node_trees(const int depth, const int chain_len)
+{
+  Main *bmain = BKE_main_new();
+  bNodeTree *ntree_child = nullptr;
+  for (int i = 0; i < depth; i++) {
+    bNodeTree *ntree = node_tree_add_chain(bmain, "NodeGroup", chain_len);
+    if (ntree_child != nullptr) {
+      bNode *node = nodeAddStaticNode(nullptr, ntree, NODE_GROUP);
+      node->id = &ntree_child->id;
+      id_us_plus(node->id);
+      ntreeUpdateTree(bmain, ntree);
+    }
+    ntree_child = ntree;
+  }
+  return bmain;
+}
+
+/** Makes a small change to the first object or node tree, as an edit between undo steps. */
+static void main_change_single_id(Main *bmain)
+{
+  Object *ob = static_cast<Object *>(bmain->objects.first);
+  bNodeTree *ntree = static_cast<bNodeTree *>(bmain->nodetrees.first);
+  if (ob != nullptr) {
+    ob->loc[0] += 1.0f;
+  }
+  else if (ntree != nullptr && ntree->nodes.first != nullptr) {
+    static_cast<bNode *>(ntree->nodes.first)->locx += 1.0f;
+  }
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Measuring
+ * \{ */
+
+struct BlendfileIOTiming {
+  double time_min = 0.0;
+  double time_avg = 0.0;
+  /** Peak memory allocated on top of what was in use before. */
+  size_t peak_memory = 0;
+};
+
+template<typename Fn> static BlendfileIOTiming blendfile_io_measure(const Fn &fn)
+{
+  BlendfileIOTiming timing;
+  timing.time_min = DBL_MAX;
+  for (int i = 0; i < NUM_RUN_AVERAGED; i++) {
+    const size_t memory_in_use = MEM_get_memory_in_use();
+    MEM_reset_peak_memory();
+    const double time_start = PIL_check_seconds_timer();
+
+    fn();
+
+    const double time = PIL_check_seconds_timer() - time_start;
+    const size_t peak_memory = MEM_get_peak_memory();
+    timing.time_min = MIN2(timing.time_min, time);
+    timing.time_avg += time / NUM_RUN_AVERAGED;
+    if (peak_memory > memory_in_use) {
+      timing.peak_memory = MAX2(timing.peak_memory, peak_memory - memory_in_use);
+    }
+  }
+  return timing;
+}
+
+class BlendfileIOPerformanceTest : public BlendfileLoadingBaseTest {
+ protected:
+  /** JSON objects of all cases that ran. */
+  static std::vector<std::string> results;
+
+ public:
+  static void SetUpTestCase()
+  {
+    BlendfileLoadingBaseTest::SetUpTestCase();
+    BKE_tempdir_init(nullptr);
+  }
+
+  static void TearDownTestCase()
+  {
+    std::stringstream json;
+    json << "{\n";
+    json << "  \"blender_version\": " << BLENDER_VERSION << ",\n";
+    json << "  \"threads\": " << BLI_task_scheduler_num_threads() << ",\n";
+    json << "  \"runs\": " << NUM_RUN_AVERAGED << ",\n";
+    json << "  \"cases\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+      json << (i ? ",\n" : "\n") << results[i];
+    }
+    json << "\n  ]\n}\n";
+    results.clear();
+
+    if (FLAGS_blendfile_io_performance_json.empty()) {
+      printf("%s", json.str().c_str());
+    }
+    else {
+      std::ofstream file(FLAGS_blendfile_io_performance_json);
+      file << json.str();
+    }
+
+    BlendfileLoadingBaseTest::TearDownTestCase();
+  }
+
+ protected:
+  /**
+   * Measures saving \a bmain to disk, loading it again, and pushing & reading undo steps.
+   * Takes ownership of \a bmain.
+   */
+  void run_case(const char *name, Main *bmain)
+  {
+    char filepath[FILE_MAX];
+    BLI_join_dirfile(filepath, sizeof(filepath), BKE_tempdir_session(), "blendfile_io.blend");
+
+    int ids_len = 0;
+    ListBase *lbarray[MAX_LIBARRAY];
+    int a = set_listbasepointers(bmain, lbarray);
+    while (a--) {
+      ids_len += BLI_listbase_count(lbarray[a]);
+    }
+
+    BlendFileWriteParams write_params{};
+    write_params.remap_mode = BLO_WRITE_PATH_REMAP_NONE;
+
+    const BlendfileIOTiming write = blendfile_io_measure([&]() {
+      EXPECT_TRUE(BLO_write_file(bmain, filepath, G.fileflags, &write_params, nullptr));
+    });
+    const size_t file_size = BLI_file_size(filepath);
+
+    const BlendfileIOTiming read = blendfile_io_measure([&]() {
+      BlendFileData *bfd = BLO_read_from_file(filepath, BLO_READ_SKIP_USERDEF, nullptr);
+      EXPECT_NE(bfd, nullptr);
+      if (bfd) {
+        BLO_blendfiledata_free(bfd);
+      }
+    });
+
+    /* A full undo step, as done for the first undo push. */
+    const BlendfileIOTiming undo_push_full = blendfile_io_measure([&]() {
+      MemFileUndoData *mfu = BKE_memfile_undo_encode(bmain, nullptr);
+      BKE_memfile_undo_free(mfu);
+    });
+
+    /* An undo step on top of a previous one, only a single ID changed in between. */
+    MemFileUndoData *mfu_prev = BKE_memfile_undo_encode(bmain, nullptr);
+    const size_t undo_size_full = mfu_prev->undo_size;
+    const BlendfileIOTiming undo_push = blendfile_io_measure([&]() {
+      main_change_single_id(bmain);
+      MemFileUndoData *mfu = BKE_memfile_undo_encode(bmain, mfu_prev);
+      BKE_memfile_undo_free(mfu);
+    });
+
+    const BlendfileIOTiming undo_read = blendfile_io_measure([&]() {
+      BlendFileReadParams read_params{};
+      read_params.skip_flags = BLO_READ_SKIP_USERDEF | BLO_READ_SKIP_UNDO_OLD_MAIN;
+      BlendFileData *bfd = BLO_read_from_memfile(
+          bmain, filepath, &mfu_prev->memfile, &read_params, nullptr);
+      EXPECT_NE(bfd, nullptr);
+      if (bfd) {
+        BLO_blendfiledata_free(bfd);
+      }
+    });
+
+    const BlendfileIOTiming memfile_write = blendfile_io_measure(
+        [&]() { EXPECT_TRUE(BLO_memfile_write_file(&mfu_prev->memfile, filepath)); });
+
+    BKE_memfile_undo_free(mfu_prev);
+    BKE_main_free(bmain);
+    BLI_delete(filepath, false, false);
+
+    std::stringstream json;
+    json << "    {\n";
+    json << "      \"name\": \"" << name << "\",\n";
+    json << "      \"ids\": " << ids_len << ",\n";
+    json << "      \"file_size\": " << file_size << ",\n";
+    json << "      \"undo_size\": " << undo_size_full << ",\n";
+    const std::pair<const char *, const BlendfileIOTiming *> timings[] = {
+        {"write", &write},
+        {"read", &read},
+        {"undo_push_full", &undo_push_full},
+        {"undo_push", &undo_push},
+        {"undo_read", &undo_read},
+        {"memfile_write", &memfile_write},
+    };
+    const int timings_len = (int)ARRAY_SIZE(timings);
+    for (int i = 0; i < timings_len; i++) {
+      const BlendfileIOTiming *timing = timings[i].second;
+      json << "      \"" << timings[i].first << "\": {";
+      json << "\"time_min\": " << timing->time_min << ", ";
+      json << "\"time_avg\": " << timing->time_avg << ", ";
+      json << "\"peak_memory\": " << timing->peak_memory << "}";
+      json << ((i + 1 < timings_len) ? ",\n" : "\n");
+    }
+    json << "    }";
+    results.push_back(json.str());
+  }
+};
+
+std::vector<std::string> BlendfileIOPerformanceTest::results;
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Tests
+ * \{ */
+
+TEST_F(BlendfileIOPerformanceTest, DISABLED_ManyIDs)
+{
+  run_case("many_ids", main_add_many_ids(20000));
+}
+
+TEST_F(BlendfileIOPerformanceTest, DISABLED_LargeMeshes)
+{
+  run_case("large_meshes", main_add_large_meshes(4, 512));
+}
+
+TEST_F(BlendfileIOPerformanceTest, DISABLED_DeepNodeTrees)
+{
+  run_case("deep_node_trees", main_add_deep_node_trees(64, 200));
+}
+
+/** \} */
@@ -161,6 +161,35 @@ void DEG_evaluate_on_framechange(Depsgraph *graph, float ctime);
 /* Data changed recalculation entry point. */
 void DEG_evaluate_on_refresh(Depsgraph *graph);
 
+/* Frame-Parallel Evaluation  -------------------- */
+
+/* Build the relations of a depsgraph created by DEG_evaluate_frames_parallel(). */
+typedef void (*DEG_FrameBuildCb)(struct Depsgraph *depsgraph, void *user_data);
+/* Use the depsgraph which is evaluated at the given frame, return false to stop evaluating
+ * frames. Called from the calling thread, in the order of the frames. */
+typedef bool (*DEG_FrameEvaluatedCb)(struct Depsgraph *depsgraph, float frame, void *user_data);
+
+/* Evaluate scene frames concurrently, each in its own depsgraph, at the time the frame maps to
+ * with time remapping. The original data is shared and only read, so no frame change handlers
+ * are run, and nothing is written back to the original data. Frames are evaluated in a single
+ * depsgraph when the scene contains simulations which depend on the previous frame.
+ *
+ * Every depsgraph holds a full evaluated copy of the scene. max_depsgraphs limits their number,
+ * zero uses one per thread, at most #DEG_FRAMES_PARALLEL_DEFAULT_MAX, and only as many as fit
+ * in the memory which was in use before, measured with the first evaluated frame. */
+#define DEG_FRAMES_PARALLEL_DEFAULT_MAX 4
+
+void DEG_evaluate_frames_parallel(struct Main *bmain,
+                                  struct Scene *scene,
+                                  struct ViewLayer *view_layer,
+                                  eEvaluationMode mode,
+                                  const float *frames,
+                                  int num_frames,
+                                  int max_depsgraphs,
+                                  DEG_FrameBuildCb build_cb,
+                                  DEG_FrameEvaluatedCb evaluated_cb,
+                                  void *user_data);
+
 /* Editors Integration  -------------------------- */
 
 /* Mechanism to allow editors to be informed of depsgraph updates,
@@ -32,6 +32,7 @@
 #include "DNA_object_types.h"
 
 #include "BLI_stack.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 
 #include "BKE_action.h"
@@ -202,6 +203,14 @@ void deg_graph_build_flush_visibility(Depsgraph *graph)
   BLI_stack_free(stack);
 }
 
+void finalize_build_id_node_func(void *__restrict data_v,
+                                 const int i,
+                                 const TaskParallelTLS *__restrict /*tls*/)
+{
+  Depsgraph *graph = (Depsgraph *)data_v;
+  graph->id_nodes[i]->finalize_build(graph);
+}
+
 }  // namespace
 
 void deg_graph_build_finalize(Main *bmain, Depsgraph *graph)
@@ -210,11 +219,17 @@ void deg_graph_build_finalize(Main *bmain, Depsgraph *graph)
   deg_graph_build_flush_visibility(graph);
   deg_graph_remove_unused_noops(graph);
 
+  /* Finalizing only accesses the nodes of the ID itself, do it in parallel. */
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 256;
+  BLI_task_parallel_range(
+      0, graph->id_nodes.size(), graph, finalize_build_id_node_func, &settings);
+
   /* Re-tag IDs for update if it was tagged before the relations
    * update tag. */
   for (IDNode *id_node : graph->id_nodes) {
     ID *id_orig = id_node->id_orig;
-    id_node->finalize_build(graph);
     int flag = 0;
     /* Tag rebuild if special evaluation flags changed. */
     if (id_node->eval_flags != id_node->previous_eval_flags) {
@@ -152,10 +152,12 @@ bool AnimatedPropertyStorage::isPropertyAnimated(const PointerRNA *pointer_rna,
 
 DepsgraphBuilderCache::DepsgraphBuilderCache()
 {
+  BLI_mutex_init(&mutex_);
 }
 
 DepsgraphBuilderCache::~DepsgraphBuilderCache()
 {
+  BLI_mutex_end(&mutex_);
   for (AnimatedPropertyStorage *animated_property_storage :
        animated_property_storage_map_.values()) {
     delete animated_property_storage;
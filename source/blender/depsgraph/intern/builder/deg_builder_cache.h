@@ -25,6 +25,8 @@
 
 #include "MEM_guardedalloc.h"
 
+#include "BLI_threads.h"
+
 #include "intern/depsgraph_type.h"
 
 #include "RNA_access.h"
@@ -95,16 +97,25 @@ class DepsgraphBuilderCache {
    * the storage.
    *
    * TODO(sergey): Technically, this makes this class something else than just a cache, but what is
-   * the better name? */
+   * the better name?
+   *
+   * NOTE: Is safe to be called from multiple threads. */
   template<typename... Args> bool isPropertyAnimated(ID *id, Args... args)
   {
+    BLI_mutex_lock(&mutex_);
     AnimatedPropertyStorage *animated_property_storage = ensureInitializedAnimatedPropertyStorage(
         id);
-    return animated_property_storage->isPropertyAnimated(args...);
+    const bool is_animated = animated_property_storage->isPropertyAnimated(args...);
+    BLI_mutex_unlock(&mutex_);
+    return is_animated;
   }
 
   Map<ID *, AnimatedPropertyStorage *> animated_property_storage_map_;
 
+ protected:
+  /* Relations of view layer objects are built from multiple threads. */
+  ThreadMutex mutex_;
+
   MEM_CXX_CLASS_ALLOC_FUNCS("DepsgraphBuilderCache");
 };
 
@@ -61,7 +61,8 @@ struct CyclesSolverState {
   CyclesSolverState(Depsgraph *graph)
       : graph(graph),
         traversal_stack(BLI_stack_new(sizeof(StackEntry), "DEG detect cycles stack")),
-        num_cycles(0)
+        num_cycles(0),
+        num_checked_operations(0)
   {
     /* pass */
   }
@@ -75,6 +76,9 @@ struct CyclesSolverState {
   Depsgraph *graph;
   BLI_Stack *traversal_stack;
   int num_cycles;
+  /* Operations before this index are known to be visited already, so that finding the next
+   * non-checked node doesn't start over for every closed loop cycle. */
+  int64_t num_checked_operations;
 };
 
 inline void set_node_visited_state(Node *node, eCyclicCheckVisitedState state)
@@ -132,7 +136,9 @@ void schedule_leaf_nodes(CyclesSolverState *state)
  */
 bool schedule_non_checked_node(CyclesSolverState *state)
 {
-  for (OperationNode *node : state->graph->operations) {
+  const Vector<OperationNode *> &operations = state->graph->operations;
+  for (; state->num_checked_operations < operations.size(); state->num_checked_operations++) {
+    OperationNode *node = operations[state->num_checked_operations];
     if (get_node_visited_state(node) == NODE_NOT_VISITED) {
       schedule_node_to_stack(state, node);
       return true;
@@ -25,15 +25,19 @@
 
 #include "DNA_ID.h"
 
+#include "atomic_ops.h"
+
 namespace blender {
 namespace deg {
 
-BuilderMap::BuilderMap()
+BuilderMap::BuilderMap() : is_concurrent_(false)
 {
+  BLI_mutex_init(&concurrent_id_tags_mutex_);
 }
 
 BuilderMap::~BuilderMap()
 {
+  BLI_mutex_end(&concurrent_id_tags_mutex_);
 }
 
 bool BuilderMap::checkIsBuilt(ID *id, int tag) const
@@ -43,19 +47,61 @@ bool BuilderMap::checkIsBuilt(ID *id, int tag) const
 
 void BuilderMap::tagBuild(ID *id, int tag)
 {
-  id_tags_.lookup_or_add(id, 0) |= tag;
+  checkIsBuiltAndTag(id, tag);
 }
 
 bool BuilderMap::checkIsBuiltAndTag(ID *id, int tag)
 {
+  if (is_concurrent_) {
+    int *id_tag = id_tags_.lookup_ptr(id);
+    if (id_tag != nullptr) {
+      const int old_tag = atomic_fetch_and_or_int32(id_tag, tag);
+      return (old_tag & tag) == tag;
+    }
+    BLI_mutex_lock(&concurrent_id_tags_mutex_);
+    int &concurrent_id_tag = concurrent_id_tags_.lookup_or_add(id, 0);
+    const bool result = (concurrent_id_tag & tag) == tag;
+    concurrent_id_tag |= tag;
+    BLI_mutex_unlock(&concurrent_id_tags_mutex_);
+    return result;
+  }
   int &id_tag = id_tags_.lookup_or_add(id, 0);
   const bool result = (id_tag & tag) == tag;
   id_tag |= tag;
   return result;
 }
 
+void BuilderMap::begin_concurrent_use(Span<ID *> ids)
+{
+  BLI_assert(!is_concurrent_);
+  for (ID *id : ids) {
+    id_tags_.lookup_or_add(id, 0);
+  }
+  is_concurrent_ = true;
+}
+
+void BuilderMap::end_concurrent_use()
+{
+  BLI_assert(is_concurrent_);
+  for (const auto item : concurrent_id_tags_.items()) {
+    id_tags_.lookup_or_add(item.key, 0) |= item.value;
+  }
+  concurrent_id_tags_.clear();
+  is_concurrent_ = false;
+}
+
 int BuilderMap::getIDTag(ID *id) const
 {
+  if (is_concurrent_) {
+    const int *id_tag = id_tags_.lookup_ptr(id);
+    if (id_tag != nullptr) {
+      return *id_tag;
+    }
+    BLI_mutex_lock(&concurrent_id_tags_mutex_);
+    const int concurrent_id_tag = concurrent_id_tags_.lookup_default(id, 0);
+    BLI_mutex_unlock(&concurrent_id_tags_mutex_);
+    return concurrent_id_tag;
+  }
   return id_tags_.lookup_default(id, 0);
 }
 
@@ -23,6 +23,9 @@
 
 #pragma once
 
+#include "BLI_span.hh"
+#include "BLI_threads.h"
+
 #include "intern/depsgraph_type.h"
 
 struct ID;
@@ -60,6 +63,12 @@ class BuilderMap {
    * handled otherwise and return false. */
   bool checkIsBuiltAndTag(ID *id, int tag = TAG_COMPLETE);
 
+  /* Allow the map to be used from multiple threads until end_concurrent_use() is called. The given
+   * IDs get their entry up-front, so that tagging them does not modify the map itself. Other IDs
+   * are tagged under a lock. */
+  void begin_concurrent_use(Span<ID *> ids);
+  void end_concurrent_use();
+
   template<typename T> bool checkIsBuilt(T *datablock, int tag = TAG_COMPLETE) const
   {
     return checkIsBuilt(&datablock->id, tag);
@@ -77,6 +86,11 @@ class BuilderMap {
   int getIDTag(ID *id) const;
 
   Map<ID *, int> id_tags_;
+
+  /* Tags of IDs which are not in id_tags_ while the map is used from multiple threads. */
+  bool is_concurrent_;
+  Map<ID *, int> concurrent_id_tags_;
+  mutable ThreadMutex concurrent_id_tags_mutex_;
 };
 
 }  // namespace deg
@@ -32,6 +32,7 @@
 #include "MEM_guardedalloc.h"
 
 #include "BLI_blenlib.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 
 #include "DNA_action_types.h"
@@ -239,13 +240,131 @@ bool object_have_geometry_component(const Object *object)
 
 }  // namespace
 
+/* **** Pending relations ****  */
+
+PendingRelations::PendingRelations(Depsgraph *graph, int num_bases) : graph_(graph)
+{
+  BLI_mutex_init(&id_nodes_mutex);
+  BLI_mutex_init(&id_relations_mutex_);
+  base_relations_.resize(num_bases);
+}
+
+PendingRelations::~PendingRelations()
+{
+  BLI_mutex_end(&id_relations_mutex_);
+  BLI_mutex_end(&id_nodes_mutex);
+}
+
+Vector<Relation *> *PendingRelations::ensure_id_relations(ID *id, int tag)
+{
+  BLI_mutex_lock(&id_relations_mutex_);
+  unique_ptr<Vector<Relation *>> &relations = id_relations_.lookup_or_add_default(
+      make_pair(id, tag));
+  if (!relations) {
+    relations = std::make_unique<Vector<Relation *>>();
+  }
+  Vector<Relation *> *result = relations.get();
+  BLI_mutex_unlock(&id_relations_mutex_);
+  return result;
+}
+
+Vector<Relation *> *PendingRelations::base_relations(int base_index)
+{
+  return &base_relations_[base_index];
+}
+
+void PendingRelations::link_relations()
+{
+  Map<const ID *, int> id_node_indices;
+  for (const int i : graph_->id_nodes.index_range()) {
+    id_node_indices.add(graph_->id_nodes[i]->id_orig, i);
+  }
+  struct IDRelations {
+    int id_node_index;
+    uint session_uuid;
+    int tag;
+    Vector<Relation *> *relations;
+  };
+  Vector<IDRelations> sorted_id_relations;
+  for (const auto item : id_relations_.items()) {
+    ID *id = item.key.first;
+    sorted_id_relations.append({id_node_indices.lookup_default(id, INT_MAX),
+                                id->session_uuid,
+                                item.key.second,
+                                item.value.get()});
+  }
+  /* IDs without a node are not expected, still keep their order stable. */
+  std::sort(sorted_id_relations.begin(),
+            sorted_id_relations.end(),
+            [](const IDRelations &a, const IDRelations &b) {
+              if (a.id_node_index != b.id_node_index) {
+                return a.id_node_index < b.id_node_index;
+              }
+              if (a.session_uuid != b.session_uuid) {
+                return a.session_uuid < b.session_uuid;
+              }
+              return a.tag < b.tag;
+            });
+  for (const IDRelations &id_relations : sorted_id_relations) {
+    link_relations(*id_relations.relations);
+  }
+  for (const Vector<Relation *> &relations : base_relations_) {
+    link_relations(relations);
+  }
+  id_relations_.clear();
+  base_relations_.clear();
+}
+
+void PendingRelations::link_relations(Span<Relation *> relations)
+{
+  for (Relation *relation : relations) {
+    if (relation->flag & RELATION_CHECK_BEFORE_ADD) {
+      Relation *existing_relation = graph_->check_nodes_connected(
+          relation->from, relation->to, relation->name);
+      if (existing_relation != nullptr) {
+        existing_relation->flag |= relation->flag;
+        delete relation;
+        continue;
+      }
+    }
+#ifndef NDEBUG
+    graph_->validate_new_relation(relation->from, relation->to);
+#endif
+    relation->link();
+  }
+}
+
 /* **** General purpose functions ****  */
 
 DepsgraphRelationBuilder::DepsgraphRelationBuilder(Main *bmain,
                                                    Depsgraph *graph,
                                                    DepsgraphBuilderCache *cache)
-    : DepsgraphBuilder(bmain, graph, cache), scene_(nullptr), rna_node_query_(graph, this)
+    : DepsgraphBuilder(bmain, graph, cache),
+      scene_(nullptr),
+      built_map_(&own_built_map_),
+      rna_node_query_(graph, this),
+      pending_relations_(nullptr),
+      current_relations_(nullptr)
+{
+}
+
+void DepsgraphRelationBuilder::set_worker_factory(const WorkerFactory &worker_factory)
 {
+  worker_factory_ = worker_factory;
+}
+
+DepsgraphRelationBuilder::PendingRelationsScope::PendingRelationsScope(
+    DepsgraphRelationBuilder *builder, ID *id, int tag)
+    : builder_(builder), previous_relations_(builder->current_relations_)
+{
+  if (builder->pending_relations_ != nullptr) {
+    builder->current_relations_ = builder->pending_relations_->ensure_id_relations(id, tag);
+  }
+}
+
+DepsgraphRelationBuilder::PendingRelationsScope::~PendingRelationsScope()
+{
+  builder_->current_relations_ = previous_relations_;
 }
 
 TimeSourceNode *DepsgraphRelationBuilder::get_node(const TimeSourceKey &key) const
@@ -327,6 +446,11 @@ void DepsgraphRelationBuilder::add_customdata_mask(Object *object,
     if (id_node == nullptr) {
       BLI_assert(!"ID should always be valid");
     }
+    else if (pending_relations_ != nullptr) {
+      BLI_mutex_lock(&pending_relations_->id_nodes_mutex);
+      id_node->customdata_masks |= customdata_masks;
+      BLI_mutex_unlock(&pending_relations_->id_nodes_mutex);
+    }
     else {
       id_node->customdata_masks |= customdata_masks;
     }
@@ -339,6 +463,11 @@ void DepsgraphRelationBuilder::add_special_eval_flag(ID *id, uint32_t flag)
   if (id_node == nullptr) {
     BLI_assert(!"ID should always be valid");
   }
+  else if (pending_relations_ != nullptr) {
+    BLI_mutex_lock(&pending_relations_->id_nodes_mutex);
+    id_node->eval_flags |= flag;
+    BLI_mutex_unlock(&pending_relations_->id_nodes_mutex);
+  }
   else {
     id_node->eval_flags |= flag;
   }
@@ -350,7 +479,7 @@ Relation *DepsgraphRelationBuilder::add_time_relation(TimeSourceNode *timesrc,
                                                       int flags)
 {
   if (timesrc && node_to) {
-    return graph_->add_new_relation(timesrc, node_to, description, flags);
+    return add_new_relation(timesrc, node_to, description, flags);
   }
 
   DEG_DEBUG_PRINTF((::Depsgraph *)graph_,
@@ -365,13 +494,28 @@ Relation *DepsgraphRelationBuilder::add_time_relation(TimeSourceNode *timesrc,
   return nullptr;
 }
 
+Relation *DepsgraphRelationBuilder::add_new_relation(Node *node_from,
+                                                     Node *node_to,
+                                                     const char *description,
+                                                     int flags)
+{
+  if (current_relations_ == nullptr) {
+    return graph_->add_new_relation(node_from, node_to, description, flags);
+  }
+  /* Nodes are shared with other threads, the relation is linked once they are done. */
+  Relation *relation = new Relation(node_from, node_to, description);
+  relation->flag |= flags;
+  current_relations_->append(relation);
+  return relation;
+}
+
 Relation *DepsgraphRelationBuilder::add_operation_relation(OperationNode *node_from,
                                                            OperationNode *node_to,
                                                            const char *description,
                                                            int flags)
 {
   if (node_from && node_to) {
-    return graph_->add_new_relation(node_from, node_to, description, flags);
+    return add_new_relation(node_from, node_to, description, flags);
   }
 
   DEG_DEBUG_PRINTF((::Depsgraph *)graph_,
@@ -592,12 +736,13 @@ void DepsgraphRelationBuilder::build_collection(LayerCollection *from_layer_coll
     return;
   }
   build_idproperties(collection->id.properties);
-  const bool group_done = built_map_.checkIsBuiltAndTag(collection);
+  const bool group_done = built_map_->checkIsBuiltAndTag(collection);
   OperationKey object_transform_final_key(object != nullptr ? &object->id : nullptr,
                                           NodeType::TRANSFORM,
                                           OperationCode::TRANSFORM_FINAL);
   ComponentKey duplicator_key(object != nullptr ? &object->id : nullptr, NodeType::DUPLI);
   if (!group_done) {
+    PendingRelationsScope id_relations_scope(this, &collection->id);
     LISTBASE_FOREACH (CollectionObject *, cob, &collection->gobject) {
       build_object(cob->ob);
     }
@@ -624,9 +769,10 @@ void DepsgraphRelationBuilder::build_collection(LayerCollection *from_layer_coll
 
 void DepsgraphRelationBuilder::build_object(Object *object)
 {
-  if (built_map_.checkIsBuiltAndTag(object)) {
+  if (built_map_->checkIsBuiltAndTag(object)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &object->id);
   /* Object Transforms */
   OperationCode base_op = (object->parent) ? OperationCode::TRANSFORM_PARENT :
                                              OperationCode::TRANSFORM_LOCAL;
@@ -787,11 +933,6 @@ void DepsgraphRelationBuilder::build_object_data(Object *object)
   if (object->data == nullptr) {
     return;
   }
-  ID *obdata_id = (ID *)object->data;
-  /* Object data animation. */
-  if (!built_map_.checkIsBuilt(obdata_id)) {
-    build_animdata(obdata_id);
-  }
   /* type-specific data. */
   switch (object->type) {
     case OB_MESH:
@@ -1325,8 +1466,7 @@ void DepsgraphRelationBuilder::build_animdata_curves_targets(ID *id,
       add_relation(adt_key, pose_init_key, "Animation -> Prop", RELATION_CHECK_BEFORE_ADD);
       continue;
     }
-    graph_->add_new_relation(
-        operation_from, operation_to, "Animation -> Prop", RELATION_CHECK_BEFORE_ADD);
+    add_new_relation(operation_from, operation_to, "Animation -> Prop", RELATION_CHECK_BEFORE_ADD);
     /* It is possible that animation is writing to a nested ID data-block,
      * need to make sure animation is evaluated after target ID is copied. */
     const IDNode *id_node_from = operation_from->owner->owner;
@@ -1398,9 +1538,10 @@ void DepsgraphRelationBuilder::build_animation_images(ID *id)
 
 void DepsgraphRelationBuilder::build_action(bAction *action)
 {
-  if (built_map_.checkIsBuiltAndTag(action)) {
+  if (built_map_->checkIsBuiltAndTag(action)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &action->id);
   build_idproperties(action->id.properties);
   if (!BLI_listbase_is_empty(&action->curves)) {
     TimeSourceKey time_src_key;
@@ -1647,9 +1788,10 @@ void DepsgraphRelationBuilder::build_dimensions(Object *object)
 
 void DepsgraphRelationBuilder::build_world(World *world)
 {
-  if (built_map_.checkIsBuiltAndTag(world)) {
+  if (built_map_->checkIsBuiltAndTag(world)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &world->id);
   build_idproperties(world->id.properties);
   /* animation */
   build_animdata(&world->id);
@@ -1863,9 +2005,10 @@ void DepsgraphRelationBuilder::build_particle_systems(Object *object)
 
 void DepsgraphRelationBuilder::build_particle_settings(ParticleSettings *part)
 {
-  if (built_map_.checkIsBuiltAndTag(part)) {
+  if (built_map_->checkIsBuiltAndTag(part)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &part->id);
   /* Animation data relations. */
   build_animdata(&part->id);
   build_parameters(&part->id);
@@ -1922,9 +2065,10 @@ void DepsgraphRelationBuilder::build_particle_system_visualization_object(Object
 /* Shapekeys */
 void DepsgraphRelationBuilder::build_shapekeys(Key *key)
 {
-  if (built_map_.checkIsBuiltAndTag(key)) {
+  if (built_map_->checkIsBuiltAndTag(key)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &key->id);
   build_idproperties(key->id.properties);
   /* Attach animdata to geometry. */
   build_animdata(&key->id);
@@ -2102,9 +2246,10 @@ void DepsgraphRelationBuilder::build_object_data_geometry(Object *object)
 
 void DepsgraphRelationBuilder::build_object_data_geometry_datablock(ID *obdata)
 {
-  if (built_map_.checkIsBuiltAndTag(obdata)) {
+  if (built_map_->checkIsBuiltAndTag(obdata)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, obdata);
   build_idproperties(obdata->properties);
   /* Animation. */
   build_animdata(obdata);
@@ -2215,9 +2360,10 @@ void DepsgraphRelationBuilder::build_object_data_geometry_datablock(ID *obdata)
 
 void DepsgraphRelationBuilder::build_armature(bArmature *armature)
 {
-  if (built_map_.checkIsBuiltAndTag(armature)) {
+  if (built_map_->checkIsBuiltAndTag(armature)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &armature->id);
   build_idproperties(armature->id.properties);
   build_animdata(&armature->id);
   build_parameters(&armature->id);
@@ -2234,9 +2380,10 @@ void DepsgraphRelationBuilder::build_armature_bones(ListBase *bones)
 
 void DepsgraphRelationBuilder::build_camera(Camera *camera)
 {
-  if (built_map_.checkIsBuiltAndTag(camera)) {
+  if (built_map_->checkIsBuiltAndTag(camera)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &camera->id);
   build_idproperties(camera->id.properties);
   build_animdata(&camera->id);
   build_parameters(&camera->id);
@@ -2251,9 +2398,10 @@ void DepsgraphRelationBuilder::build_camera(Camera *camera)
 /* Lights */
 void DepsgraphRelationBuilder::build_light(Light *lamp)
 {
-  if (built_map_.checkIsBuiltAndTag(lamp)) {
+  if (built_map_->checkIsBuiltAndTag(lamp)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &lamp->id);
   build_idproperties(lamp->id.properties);
   build_animdata(&lamp->id);
   build_parameters(&lamp->id);
@@ -2296,9 +2444,10 @@ void DepsgraphRelationBuilder::build_nodetree(bNodeTree *ntree)
   if (ntree == nullptr) {
     return;
   }
-  if (built_map_.checkIsBuiltAndTag(ntree)) {
+  if (built_map_->checkIsBuiltAndTag(ntree)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &ntree->id);
   build_idproperties(ntree->id.properties);
   build_animdata(&ntree->id);
   build_parameters(&ntree->id);
@@ -2400,9 +2549,10 @@ void DepsgraphRelationBuilder::build_nodetree(bNodeTree *ntree)
 /* Recursively build graph for material */
 void DepsgraphRelationBuilder::build_material(Material *material)
 {
-  if (built_map_.checkIsBuiltAndTag(material)) {
+  if (built_map_->checkIsBuiltAndTag(material)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &material->id);
   build_idproperties(material->id.properties);
   /* animation */
   build_animdata(&material->id);
@@ -2431,9 +2581,10 @@ void DepsgraphRelationBuilder::build_materials(Material **materials, int num_mat
 /* Recursively build graph for texture */
 void DepsgraphRelationBuilder::build_texture(Tex *texture)
 {
-  if (built_map_.checkIsBuiltAndTag(texture)) {
+  if (built_map_->checkIsBuiltAndTag(texture)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &texture->id);
   /* texture itself */
   ComponentKey texture_key(&texture->id, NodeType::GENERIC_DATABLOCK);
   build_idproperties(texture->id.properties);
@@ -2467,18 +2618,20 @@ void DepsgraphRelationBuilder::build_texture(Tex *texture)
 
 void DepsgraphRelationBuilder::build_image(Image *image)
 {
-  if (built_map_.checkIsBuiltAndTag(image)) {
+  if (built_map_->checkIsBuiltAndTag(image)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &image->id);
   build_idproperties(image->id.properties);
   build_parameters(&image->id);
 }
 
 void DepsgraphRelationBuilder::build_gpencil(bGPdata *gpd)
 {
-  if (built_map_.checkIsBuiltAndTag(gpd)) {
+  if (built_map_->checkIsBuiltAndTag(gpd)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &gpd->id);
   /* animation */
   build_animdata(&gpd->id);
   build_parameters(&gpd->id);
@@ -2488,9 +2641,10 @@ void DepsgraphRelationBuilder::build_gpencil(bGPdata *gpd)
 
 void DepsgraphRelationBuilder::build_cachefile(CacheFile *cache_file)
 {
-  if (built_map_.checkIsBuiltAndTag(cache_file)) {
+  if (built_map_->checkIsBuiltAndTag(cache_file)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &cache_file->id);
   build_idproperties(cache_file->id.properties);
   /* Animation. */
   build_animdata(&cache_file->id);
@@ -2517,9 +2671,10 @@ void DepsgraphRelationBuilder::build_cachefile(CacheFile *cache_file)
 
 void DepsgraphRelationBuilder::build_mask(Mask *mask)
 {
-  if (built_map_.checkIsBuiltAndTag(mask)) {
+  if (built_map_->checkIsBuiltAndTag(mask)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &mask->id);
   ID *mask_id = &mask->id;
   build_idproperties(mask_id->properties);
   /* F-Curve animation. */
@@ -2554,9 +2709,10 @@ void DepsgraphRelationBuilder::build_mask(Mask *mask)
 
 void DepsgraphRelationBuilder::build_freestyle_linestyle(FreestyleLineStyle *linestyle)
 {
-  if (built_map_.checkIsBuiltAndTag(linestyle)) {
+  if (built_map_->checkIsBuiltAndTag(linestyle)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &linestyle->id);
 
   ID *linestyle_id = &linestyle->id;
   build_parameters(linestyle_id);
@@ -2567,9 +2723,10 @@ void DepsgraphRelationBuilder::build_freestyle_linestyle(FreestyleLineStyle *lin
 
 void DepsgraphRelationBuilder::build_movieclip(MovieClip *clip)
 {
-  if (built_map_.checkIsBuiltAndTag(clip)) {
+  if (built_map_->checkIsBuiltAndTag(clip)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &clip->id);
   /* Animation. */
   build_idproperties(clip->id.properties);
   build_animdata(&clip->id);
@@ -2578,9 +2735,10 @@ void DepsgraphRelationBuilder::build_movieclip(MovieClip *clip)
 
 void DepsgraphRelationBuilder::build_lightprobe(LightProbe *probe)
 {
-  if (built_map_.checkIsBuiltAndTag(probe)) {
+  if (built_map_->checkIsBuiltAndTag(probe)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &probe->id);
   build_idproperties(probe->id.properties);
   build_animdata(&probe->id);
   build_parameters(&probe->id);
@@ -2588,9 +2746,10 @@ void DepsgraphRelationBuilder::build_lightprobe(LightProbe *probe)
 
 void DepsgraphRelationBuilder::build_speaker(Speaker *speaker)
 {
-  if (built_map_.checkIsBuiltAndTag(speaker)) {
+  if (built_map_->checkIsBuiltAndTag(speaker)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &speaker->id);
   build_idproperties(speaker->id.properties);
   build_animdata(&speaker->id);
   build_parameters(&speaker->id);
@@ -2604,9 +2763,10 @@ void DepsgraphRelationBuilder::build_speaker(Speaker *speaker)
 
 void DepsgraphRelationBuilder::build_sound(bSound *sound)
 {
-  if (built_map_.checkIsBuiltAndTag(sound)) {
+  if (built_map_->checkIsBuiltAndTag(sound)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &sound->id);
   build_idproperties(sound->id.properties);
   build_animdata(&sound->id);
   build_parameters(&sound->id);
@@ -2614,9 +2774,10 @@ void DepsgraphRelationBuilder::build_sound(bSound *sound)
 
 void DepsgraphRelationBuilder::build_simulation(Simulation *simulation)
 {
-  if (built_map_.checkIsBuiltAndTag(simulation)) {
+  if (built_map_->checkIsBuiltAndTag(simulation)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &simulation->id);
   build_idproperties(simulation->id.properties);
   build_animdata(&simulation->id);
   build_parameters(&simulation->id);
@@ -2720,10 +2881,26 @@ void DepsgraphRelationBuilder::build_scene_speakers(Scene * /*scene*/, ViewLayer
   }
 }
 
+static void build_copy_on_write_relations_func(void *__restrict data_v,
+                                               const int i,
+                                               const TaskParallelTLS *__restrict /*tls*/)
+{
+  DepsgraphRelationBuilder *builder = (DepsgraphRelationBuilder *)data_v;
+  builder->build_copy_on_write_relations(builder->getGraph()->id_nodes[i]);
+}
+
 void DepsgraphRelationBuilder::build_copy_on_write_relations()
 {
+  /* Relations within an ID only modify the nodes of that ID, so they are built in parallel.
+   * Relations to other IDs are added afterwards in the order of the ID nodes, which keeps the
+   * order of relations in the nodes the same for every build. */
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 256;
+  BLI_task_parallel_range(
+      0, graph_->id_nodes.size(), this, build_copy_on_write_relations_func, &settings);
   for (IDNode *id_node : graph_->id_nodes) {
-    build_copy_on_write_relations(id_node);
+    build_copy_on_write_object_data_relation(id_node);
   }
 }
 
@@ -2756,6 +2933,8 @@ void DepsgraphRelationBuilder::build_nested_shapekey(ID *owner, Key *key)
   build_nested_datablock(owner, &key->id);
 }
 
+/* NOTE: Is called for multiple IDs in parallel, it must only add relations between the nodes of
+ * the given ID. */
 void DepsgraphRelationBuilder::build_copy_on_write_relations(IDNode *id_node)
 {
   ID *id_orig = id_node->id_orig;
@@ -2846,6 +3025,12 @@ void DepsgraphRelationBuilder::build_copy_on_write_relations(IDNode *id_node)
      * evaluation step needs geometry, it will have transitive dependency
      * to Mesh copy-on-write already. */
   }
+}
+
+void DepsgraphRelationBuilder::build_copy_on_write_object_data_relation(IDNode *id_node)
+{
+  ID *id_orig = id_node->id_orig;
+  OperationKey copy_on_write_key(id_orig, NodeType::COPY_ON_WRITE, OperationCode::COPY_ON_WRITE);
   /* TODO(sergey): This solves crash for now, but causes too many
    * updates potentially. */
   if (GS(id_orig->name) == ID_OB) {
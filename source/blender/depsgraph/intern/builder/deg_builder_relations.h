@@ -34,6 +34,7 @@
 #include "RNA_types.h"
 
 #include "BLI_string.h"
+#include "BLI_threads.h"
 #include "BLI_utildefines.h"
 
 #include "intern/builder/deg_builder.h"
@@ -84,6 +85,7 @@ struct bPoseChannel;
 struct bSound;
 
 struct PropertyRNA;
+struct TaskParallelTLS;
 
 namespace blender {
 namespace deg {
@@ -159,12 +161,50 @@ struct RNAPathKey {
   RNAPointerSource source;
 };
 
+/* Relations which are added while the bases of a view layer are built from multiple threads.
+ *
+ * The nodes are shared between the threads, so the relations are not linked to them right away.
+ * They are collected per ID whose build added them, and linked once all threads are done, in the
+ * order of the ID nodes. Every ID is built by one thread only, so the order of relations in the
+ * nodes does not depend on how the threads were scheduled. */
+class PendingRelations {
+ public:
+  PendingRelations(Depsgraph *graph, int num_bases);
+  ~PendingRelations();
+
+  /* Relations which are added while building the given ID, which was tagged as built with the
+   * given tag by the calling thread. */
+  Vector<Relation *> *ensure_id_relations(ID *id, int tag);
+  /* Relations which are added while building the given base, outside of the build of an ID. */
+  Vector<Relation *> *base_relations(int base_index);
+
+  /* Link all collected relations. A relation which is to be checked before being added is merged
+   * into the existing relation between the same nodes, if there is one. */
+  void link_relations();
+
+  /* Protects the data of ID nodes which is modified when building relations. */
+  ThreadMutex id_nodes_mutex;
+
+ protected:
+  void link_relations(Span<Relation *> relations);
+
+  Depsgraph *graph_;
+  Map<pair<ID *, int>, unique_ptr<Vector<Relation *>>> id_relations_;
+  ThreadMutex id_relations_mutex_;
+  Vector<Vector<Relation *>> base_relations_;
+};
+
 class DepsgraphRelationBuilder : public DepsgraphBuilder {
  public:
   DepsgraphRelationBuilder(Main *bmain, Depsgraph *graph, DepsgraphBuilderCache *cache);
 
   void begin_build();
 
+  /* Constructs builders of the same type as this one, which build relations of view layer bases
+   * from worker threads. Without it, the bases are built on the calling thread. */
+  using WorkerFactory = function<unique_ptr<DepsgraphRelationBuilder>()>;
+  void set_worker_factory(const WorkerFactory &worker_factory);
+
   template<typename KeyFrom, typename KeyTo>
   Relation *add_relation(const KeyFrom &key_from,
                          const KeyTo &key_to,
@@ -312,6 +352,7 @@ class DepsgraphRelationBuilder : public DepsgraphBuilder {
 
   virtual void build_copy_on_write_relations();
   virtual void build_copy_on_write_relations(IDNode *id_node);
+  virtual void build_copy_on_write_object_data_relation(IDNode *id_node);
   virtual void build_driver_relations();
   virtual void build_driver_relations(IDNode *id_node);
 
@@ -337,9 +378,29 @@ class DepsgraphRelationBuilder : public DepsgraphBuilder {
                                    const char *description,
                                    int flags = 0);
 
+  /* Adds relation to the graph, or to the pending relations on a worker thread. */
+  Relation *add_new_relation(Node *node_from,
+                             Node *node_to,
+                             const char *description,
+                             int flags = 0);
+
   template<typename KeyType>
   DepsNodeHandle create_node_handle(const KeyType &key, const char *default_name = "");
 
+  /* Relations which are added from a worker thread while the scope exists are collected for the
+   * given ID. Is to be created right after the ID was tagged as built. */
+  class PendingRelationsScope {
+   public:
+    PendingRelationsScope(DepsgraphRelationBuilder *builder,
+                          ID *id,
+                          int tag = BuilderMap::TAG_COMPLETE);
+    ~PendingRelationsScope();
+
+   protected:
+    DepsgraphRelationBuilder *builder_;
+    Vector<Relation *> *previous_relations_;
+  };
+
   /* TODO(sergey): All those is_same* functions are to be generalized. */
 
   /* Check whether two keys corresponds to the same bone from same armature.
@@ -367,11 +428,25 @@ class DepsgraphRelationBuilder : public DepsgraphBuilder {
 
   static void constraint_walk(bConstraint *con, ID **idpoin, bool is_reference, void *user_data);
 
+  void build_view_layer_bases(ViewLayer *view_layer);
+  static void build_view_layer_base_func(void *__restrict userdata,
+                                         const int index,
+                                         const TaskParallelTLS *__restrict tls);
+  static void build_view_layer_base_free(const void *__restrict userdata,
+                                         void *__restrict chunk);
+
   /* State which demotes currently built entities. */
   Scene *scene_;
 
-  BuilderMap built_map_;
+  /* Points to own_built_map_, or to the map of the builder which started the worker thread. */
+  BuilderMap *built_map_;
+  BuilderMap own_built_map_;
   RNANodeQuery rna_node_query_;
+
+  WorkerFactory worker_factory_;
+  /* Are set while the builder runs on a worker thread. */
+  PendingRelations *pending_relations_;
+  Vector<Relation *> *current_relations_;
 };
 
 struct DepsNodeHandle {
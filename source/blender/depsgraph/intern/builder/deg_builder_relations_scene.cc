@@ -50,9 +50,10 @@ void DepsgraphRelationBuilder::build_scene_render(Scene *scene, ViewLayer *view_
 
 void DepsgraphRelationBuilder::build_scene_parameters(Scene *scene)
 {
-  if (built_map_.checkIsBuiltAndTag(scene, BuilderMap::TAG_PARAMETERS)) {
+  if (built_map_->checkIsBuiltAndTag(scene, BuilderMap::TAG_PARAMETERS)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &scene->id, BuilderMap::TAG_PARAMETERS);
   build_idproperties(scene->id.properties);
   build_parameters(&scene->id);
   OperationKey parameters_eval_key(
@@ -63,9 +64,10 @@ void DepsgraphRelationBuilder::build_scene_parameters(Scene *scene)
 
 void DepsgraphRelationBuilder::build_scene_compositor(Scene *scene)
 {
-  if (built_map_.checkIsBuiltAndTag(scene, BuilderMap::TAG_SCENE_COMPOSITOR)) {
+  if (built_map_->checkIsBuiltAndTag(scene, BuilderMap::TAG_SCENE_COMPOSITOR)) {
     return;
   }
+  PendingRelationsScope id_relations_scope(this, &scene->id, BuilderMap::TAG_SCENE_COMPOSITOR);
   if (scene->nodetree == nullptr) {
     return;
   }
@@ -0,0 +1,195 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2020 Blender Foundation.
+ * All rights reserved.
+ */
+
+/** \file
+ * \ingroup depsgraph
+ */
+
+/* Before the depsgraph headers, the #ThreadLocal macro of BLI_threads.h breaks GTest. */
+#include "tests/blendfile_loading_base_test.h"
+
+#include "intern/builder/deg_builder_relations.h"
+#include "intern/builder/pipeline_view_layer.h"
+#include "intern/depsgraph.h"
+#include "intern/depsgraph_relation.h"
+#include "intern/node/deg_node_operation.h"
+
+#include "BLI_vector.hh"
+
+#include "BKE_collection.h"
+#include "BKE_layer.h"
+#include "BKE_lib_id.h"
+#include "BKE_main.h"
+#include "BKE_mesh.h"
+#include "BKE_modifier.h"
+#include "BKE_object.h"
+#include "BKE_scene.h"
+
+#include "DEG_depsgraph.h"
+
+#include "DNA_mesh_types.h"
+#include "DNA_modifier_types.h"
+#include "DNA_object_types.h"
+#include "DNA_scene_types.h"
+
+#include <algorithm>
+#include <string>
+
+namespace blender {
+namespace deg {
+namespace tests {
+
+/* Builds the relations of the view layer from a single thread, like for scenes with few bases. */
+class SerialViewLayerBuilderPipeline : public ViewLayerBuilderPipeline {
+ public:
+  using ViewLayerBuilderPipeline::ViewLayerBuilderPipeline;
+
+ protected:
+  void build_relations(DepsgraphRelationBuilder &relation_builder) override
+  {
+    relation_builder.set_worker_factory(DepsgraphRelationBuilder::WorkerFactory());
+    ViewLayerBuilderPipeline::build_relations(relation_builder);
+  }
+};
+
+class DepsgraphRelationsBuilderTest : public BlendfileLoadingBaseTest {
+ protected:
+  Main *bmain = nullptr;
+  Scene *scene = nullptr;
+
+  void SetUp() override
+  {
+    BlendfileLoadingBaseTest::SetUp();
+    bmain = BKE_main_new();
+    scene = BKE_scene_add(bmain, "Scene");
+  }
+
+  void TearDown() override
+  {
+    BKE_main_free(bmain);
+    BlendfileLoadingBaseTest::TearDown();
+  }
+
+  /* Objects share meshes, are parented in chains and use each other in modifiers, so that the
+   * threads building the bases of the view layer add relations to the same IDs. */
+  void add_objects(const int objects_len)
+  {
+    Vector<Mesh *> meshes;
+    for (int i = 0; i < 4; i++) {
+      meshes.append(BKE_mesh_add(bmain, "Mesh"));
+    }
+    Vector<Object *> objects;
+    for (int i = 0; i < objects_len; i++) {
+      Object *ob = BKE_object_add_only_object(bmain, OB_MESH, "Object");
+      ob->data = meshes[i % meshes.size()];
+      id_us_plus((ID *)ob->data);
+      if (i % 3 != 0) {
+        ob->parent = objects.last();
+      }
+      if (i % 5 == 0 && i != 0) {
+        ArrayModifierData *amd = (ArrayModifierData *)BKE_modifier_new(eModifierType_Array);
+        amd->offset_ob = objects[i / 2];
+        amd->offset_type |= MOD_ARR_OFF_OBJ;
+        BLI_addtail(&ob->modifiers, amd);
+      }
+      BKE_collection_object_add(bmain, scene->master_collection, ob);
+      objects.append(ob);
+    }
+    BKE_main_collection_sync(bmain);
+  }
+
+  ::Depsgraph *depsgraph_build(const bool use_serial_builder)
+  {
+    ViewLayer *view_layer = (ViewLayer *)scene->view_layers.first;
+    ::Depsgraph *graph = DEG_graph_new(bmain, scene, view_layer, DAG_EVAL_VIEWPORT);
+    if (use_serial_builder) {
+      SerialViewLayerBuilderPipeline builder(graph);
+      builder.build();
+    }
+    else {
+      ViewLayerBuilderPipeline builder(graph);
+      builder.build();
+    }
+    return graph;
+  }
+};
+
+static std::string node_name(const Node *node)
+{
+  if (node->type == NodeType::OPERATION) {
+    return static_cast<const OperationNode *>(node)->full_identifier();
+  }
+  return node->identifier();
+}
+
+/* All relations of the graph, in the order they are stored in the operations. */
+static Vector<std::string> graph_relations(::Depsgraph *graph)
+{
+  const Depsgraph *deg_graph = reinterpret_cast<const Depsgraph *>(graph);
+  Vector<std::string> relations;
+  for (const OperationNode *operation : deg_graph->operations) {
+    for (const Relation *relation : operation->inlinks) {
+      relations.append(node_name(relation->from) + " -> " + node_name(relation->to) + " (" +
+                       relation->name + ", " + std::to_string(relation->flag) + ")");
+    }
+  }
+  return relations;
+}
+
+TEST_F(DepsgraphRelationsBuilderTest, ParallelMatchesSerial)
+{
+  add_objects(200);
+
+  ::Depsgraph *graph_serial = depsgraph_build(true);
+  ::Depsgraph *graph_parallel = depsgraph_build(false);
+  Vector<std::string> relations_serial = graph_relations(graph_serial);
+  Vector<std::string> relations_parallel = graph_relations(graph_parallel);
+  DEG_graph_free(graph_serial);
+  DEG_graph_free(graph_parallel);
+
+  /* Relations to shared IDs are linked in another order, the relations themselves are equal. */
+  std::sort(relations_serial.begin(), relations_serial.end());
+  std::sort(relations_parallel.begin(), relations_parallel.end());
+  EXPECT_GT(relations_serial.size(), 200);
+  ASSERT_EQ(relations_serial.size(), relations_parallel.size());
+  for (const int i : relations_serial.index_range()) {
+    EXPECT_EQ(relations_serial[i], relations_parallel[i]);
+  }
+}
+
+TEST_F(DepsgraphRelationsBuilderTest, ParallelIsDeterministic)
+{
+  add_objects(200);
+
+  ::Depsgraph *graph_a = depsgraph_build(false);
+  ::Depsgraph *graph_b = depsgraph_build(false);
+  const Vector<std::string> relations_a = graph_relations(graph_a);
+  const Vector<std::string> relations_b = graph_relations(graph_b);
+  DEG_graph_free(graph_a);
+  DEG_graph_free(graph_b);
+
+  ASSERT_EQ(relations_a.size(), relations_b.size());
+  for (const int i : relations_a.index_range()) {
+    EXPECT_EQ(relations_a[i], relations_b[i]);
+  }
+}
+
+}  // namespace tests
+}  // namespace deg
+}  // namespace blender
@@ -32,6 +32,7 @@
 #include "MEM_guardedalloc.h"
 
 #include "BLI_blenlib.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 
 #include "DNA_linestyle_types.h"
@@ -59,6 +60,89 @@
 namespace blender {
 namespace deg {
 
+namespace {
+
+/* Relations of bases are built from multiple threads when there are at least this many of them.
+ * Does not depend on the number of threads, so that the order of relations only depends on the
+ * scene. */
+const int MIN_BASES_FOR_PARALLEL_BUILD = 64;
+
+struct BuildViewLayerBasesData {
+  DepsgraphRelationBuilder *builder;
+  Span<Base *> bases;
+  PendingRelations *pending_relations;
+};
+
+struct BuildViewLayerBasesChunk {
+  DepsgraphRelationBuilder *worker;
+};
+
+}  // namespace
+
+void DepsgraphRelationBuilder::build_view_layer_base_func(void *__restrict userdata,
+                                                          const int index,
+                                                          const TaskParallelTLS *__restrict tls)
+{
+  BuildViewLayerBasesData *data = (BuildViewLayerBasesData *)userdata;
+  BuildViewLayerBasesChunk *chunk = (BuildViewLayerBasesChunk *)tls->userdata_chunk;
+  if (chunk->worker == nullptr) {
+    DepsgraphRelationBuilder *builder = data->builder;
+    DepsgraphRelationBuilder *worker = builder->worker_factory_().release();
+    worker->begin_build();
+    worker->scene_ = builder->scene_;
+    worker->built_map_ = builder->built_map_;
+    worker->pending_relations_ = data->pending_relations;
+    chunk->worker = worker;
+  }
+  DepsgraphRelationBuilder *worker = chunk->worker;
+  worker->current_relations_ = data->pending_relations->base_relations(index);
+  worker->build_object(data->bases[index]->object);
+  worker->current_relations_ = nullptr;
+}
+
+void DepsgraphRelationBuilder::build_view_layer_base_free(const void *__restrict /*userdata*/,
+                                                          void *__restrict chunk_v)
+{
+  BuildViewLayerBasesChunk *chunk = (BuildViewLayerBasesChunk *)chunk_v;
+  delete chunk->worker;
+}
+
+void DepsgraphRelationBuilder::build_view_layer_bases(ViewLayer *view_layer)
+{
+  Vector<Base *> bases;
+  LISTBASE_FOREACH (Base *, base, &view_layer->object_bases) {
+    if (need_pull_base_into_graph(base)) {
+      bases.append(base);
+    }
+  }
+  if (!worker_factory_ || bases.size() < MIN_BASES_FOR_PARALLEL_BUILD) {
+    for (Base *base : bases) {
+      build_object(base->object);
+    }
+    return;
+  }
+  /* Objects share the data-blocks they use, the first thread which tags one as built builds its
+   * relations. All IDs which have a node get their entry in the map up-front. */
+  Vector<ID *> ids;
+  ids.reserve(graph_->id_nodes.size());
+  for (IDNode *id_node : graph_->id_nodes) {
+    ids.append(id_node->id_orig);
+  }
+  built_map_->begin_concurrent_use(ids);
+  PendingRelations pending_relations(graph_, bases.size());
+  BuildViewLayerBasesData data = {this, bases, &pending_relations};
+  BuildViewLayerBasesChunk chunk = {nullptr};
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 8;
+  settings.userdata_chunk = &chunk;
+  settings.userdata_chunk_size = sizeof(chunk);
+  settings.func_free = build_view_layer_base_free;
+  BLI_task_parallel_range(0, bases.size(), &data, build_view_layer_base_func, &settings);
+  built_map_->end_concurrent_use();
+  pending_relations.link_relations();
+}
+
 void DepsgraphRelationBuilder::build_layer_collections(ListBase *lb)
 {
   const int restrict_flag = (graph_->mode == DAG_EVAL_VIEWPORT) ? COLLECTION_RESTRICT_VIEWPORT :
@@ -95,11 +179,7 @@ void DepsgraphRelationBuilder::build_view_layer(Scene *scene,
   /* NOTE: Nodes builder requires us to pass CoW base because it's being
    * passed to the evaluation functions. During relations builder we only
    * do nullptr-pointer check of the base, so it's fine to pass original one. */
-  LISTBASE_FOREACH (Base *, base, &view_layer->object_bases) {
-    if (need_pull_base_into_graph(base)) {
-      build_object(base->object);
-    }
-  }
+  build_view_layer_bases(view_layer);
 
   build_layer_collections(&view_layer->layer_collections);
 
@@ -25,6 +25,7 @@
 
 #include "BLI_console.h"
 #include "BLI_hash.h"
+#include "BLI_math_base.h"
 #include "BLI_string.h"
 #include "BLI_utildefines.h"
 
@@ -38,6 +39,7 @@ namespace deg {
 DepsgraphDebug::DepsgraphDebug()
     : flags(G.debug), is_ever_evaluated(false), graph_evaluation_start_time_(0)
 {
+  memset(&task_pool_stats_, 0, sizeof(task_pool_stats_));
 }
 
 bool DepsgraphDebug::do_time_debug() const
@@ -58,6 +60,7 @@ void DepsgraphDebug::begin_graph_evaluation()
   }
 
   graph_evaluation_start_time_ = current_time;
+  memset(&task_pool_stats_, 0, sizeof(task_pool_stats_));
 }
 
 void DepsgraphDebug::end_graph_evaluation()
@@ -69,10 +72,32 @@ void DepsgraphDebug::end_graph_evaluation()
   const double graph_eval_end_time = PIL_check_seconds_timer();
   printf("Depsgraph updated in %f seconds.\n", graph_eval_end_time - graph_evaluation_start_time_);
   printf("Depsgraph evaluation FPS: %f\n", 1.0f / fps_samples_.get_averaged());
+  if (task_pool_stats_.num_affinity_tasks != 0) {
+    printf("Depsgraph evaluated %d operations, %d of them right after an operation of the same ID, "
+           "at most %d in a row.\n",
+           task_pool_stats_.num_tasks,
+           task_pool_stats_.num_affinity_tasks - task_pool_stats_.num_affinity_runs,
+           task_pool_stats_.max_affinity_run_len);
+  }
 
   is_ever_evaluated = true;
 }
 
+void DepsgraphDebug::add_task_pool_stats(TaskPool *pool)
+{
+  if (!do_time_debug()) {
+    return;
+  }
+
+  TaskPoolStats stats;
+  BLI_task_pool_stats_get(pool, &stats);
+  task_pool_stats_.num_tasks += stats.num_tasks;
+  task_pool_stats_.num_affinity_tasks += stats.num_affinity_tasks;
+  task_pool_stats_.num_affinity_runs += stats.num_affinity_runs;
+  task_pool_stats_.max_affinity_run_len = max_ii(task_pool_stats_.max_affinity_run_len,
+                                                 stats.max_affinity_run_len);
+}
+
 bool terminal_do_color(void)
 {
   return (G.debug & G_DEBUG_DEPSGRAPH_PRETTY) != 0;
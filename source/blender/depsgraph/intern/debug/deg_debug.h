@@ -26,6 +26,8 @@
 #include "intern/debug/deg_time_average.h"
 #include "intern/depsgraph_type.h"
 
+#include "BLI_task.h"
+
 #include "BKE_global.h"
 
 #include "DEG_depsgraph_debug.h"
@@ -42,6 +44,10 @@ class DepsgraphDebug {
   void begin_graph_evaluation();
   void end_graph_evaluation();
 
+  /* Accumulate statistics of a task pool used for the evaluation, printed together with the
+   * evaluation time. */
+  void add_task_pool_stats(TaskPool *pool);
+
   /* NOTE: Corresponds to G_DEBUG_DEPSGRAPH_* flags. */
   int flags;
 
@@ -63,6 +69,9 @@ class DepsgraphDebug {
   double graph_evaluation_start_time_;
 
   AveragedTimeSampler<MAX_FPS_COUNTERS> fps_samples_;
+
+  /* Statistics of the task pools used since begin_graph_evaluation(). */
+  TaskPoolStats task_pool_stats_;
 };
 
 #define DEG_DEBUG_PRINTF(depsgraph, type, ...) \
@@ -32,6 +32,7 @@
 
 #include "BLI_console.h"
 #include "BLI_hash.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 
 #include "BKE_global.h"
@@ -71,9 +72,11 @@ Depsgraph::Depsgraph(Main *bmain, Scene *scene, ViewLayer *view_layer, eEvaluati
       scene_cow(nullptr),
       is_active(false),
       is_evaluating(false),
-      is_render_pipeline_depsgraph(false)
+      is_render_pipeline_depsgraph(false),
+      is_frame_parallel_depsgraph(false)
 {
   BLI_spin_init(&lock);
+  BLI_mutex_init(&physics_relations_lock);
   memset(id_type_updated, 0, sizeof(id_type_updated));
   memset(id_type_exist, 0, sizeof(id_type_exist));
   memset(physics_relations, 0, sizeof(physics_relations));
@@ -85,6 +88,7 @@ Depsgraph::~Depsgraph()
 {
   clear_id_nodes();
   delete time_source;
+  BLI_mutex_end(&physics_relations_lock);
   BLI_spin_end(&lock);
 }
 
@@ -147,11 +151,19 @@ void Depsgraph::clear_id_nodes_conditional(const std::function<bool(ID_Type id_t
     }
     const ID_Type id_type = GS(id_node->id_cow->name);
     if (filter(id_type)) {
-      id_node->destroy();
+      id_node->free_copy_on_write();
     }
   }
 }
 
+static void free_id_node_func(void *__restrict data_v,
+                              const int i,
+                              const TaskParallelTLS *__restrict /*tls*/)
+{
+  Depsgraph *graph = (Depsgraph *)data_v;
+  delete graph->id_nodes[i];
+}
+
 void Depsgraph::clear_id_nodes()
 {
   /* Free memory used by ID nodes. */
@@ -159,10 +171,18 @@ void Depsgraph::clear_id_nodes()
   /* Stupid workaround to ensure we free IDs in a proper order. */
   clear_id_nodes_conditional([](ID_Type id_type) { return id_type == ID_SCE; });
   clear_id_nodes_conditional([](ID_Type id_type) { return id_type != ID_PA; });
-
   for (IDNode *id_node : id_nodes) {
-    delete id_node;
+    id_node->free_copy_on_write();
   }
+
+  /* The copy-on-write datablocks are freed in the order above, which has to be serial. What is
+   * left is deleting the component and operation nodes of every ID and their incoming relations.
+   * That does not touch other IDs, and is a lot of small allocations for big scenes, so it is
+   * done in parallel. */
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 256;
+  BLI_task_parallel_range(0, id_nodes.size(), this, free_id_node_func, &settings);
   /* Clear containers. */
   id_hash.clear();
   id_nodes.clear();
@@ -183,20 +203,27 @@ Relation *Depsgraph::add_new_relation(Node *from, Node *to, const char *descript
   }
 
 #ifndef NDEBUG
-  if (from->type == NodeType::OPERATION && to->type == NodeType::OPERATION) {
-    OperationNode *operation_from = static_cast<OperationNode *>(from);
-    OperationNode *operation_to = static_cast<OperationNode *>(to);
-    BLI_assert(operation_to->owner->type != NodeType::COPY_ON_WRITE ||
-               operation_from->owner->type == NodeType::COPY_ON_WRITE);
-  }
+  validate_new_relation(from, to);
 #endif
 
   /* Create new relation, and add it to the graph. */
   rel = new Relation(from, to, description);
   rel->flag |= flags;
+  rel->link();
   return rel;
 }
 
+void Depsgraph::validate_new_relation(const Node *from, const Node *to) const
+{
+  if (from->type == NodeType::OPERATION && to->type == NodeType::OPERATION) {
+    const OperationNode *operation_from = static_cast<const OperationNode *>(from);
+    const OperationNode *operation_to = static_cast<const OperationNode *>(to);
+    BLI_assert(operation_to->owner->type != NodeType::COPY_ON_WRITE ||
+               operation_from->owner->type == NodeType::COPY_ON_WRITE);
+    UNUSED_VARS_NDEBUG(operation_from, operation_to);
+  }
+}
+
 Relation *Depsgraph::check_nodes_connected(const Node *from,
                                            const Node *to,
                                            const char *description)
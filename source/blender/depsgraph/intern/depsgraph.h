@@ -37,7 +37,7 @@
 
 #include "BKE_main.h" /* for MAX_LIBARRAY */
 
-#include "BLI_threads.h" /* for SpinLock */
+#include "BLI_threads.h" /* for SpinLock and ThreadMutex */
 
 #include "DEG_depsgraph.h"
 #include "DEG_depsgraph_physics.h"
@@ -83,6 +83,10 @@ struct Depsgraph {
    * given nodes. */
   Relation *check_nodes_connected(const Node *from, const Node *to, const char *description);
 
+  /* Assert that a relation between the nodes is allowed, for the relations which are created
+   * directly as well as for those linked later on by the relations builder. */
+  void validate_new_relation(const Node *from, const Node *to) const;
+
   /* Tag a specific node as needing updates. */
   void add_entry_tag(OperationNode *node);
 
@@ -164,9 +168,17 @@ struct Depsgraph {
    * does not need any bases. */
   bool is_render_pipeline_depsgraph;
 
+  /* Is set to truth for dependency graphs created by #DEG_evaluate_frames_parallel.
+   * Their copy-on-write scene gets the frame they are evaluated at, the frame of the original
+   * scene is not changed. */
+  bool is_frame_parallel_depsgraph;
+
   /* Cached list of colliders/effectors for collections and the scene
    * created along with relations, for fast lookup during evaluation. */
   Map<const ID *, ListBase *> *physics_relations[DEG_PHYSICS_RELATIONS_NUM];
+  /* Protects creation of the physics relations, relation builders ask for them from multiple
+   * threads. */
+  ThreadMutex physics_relations_lock;
 
   MEM_CXX_CLASS_ALLOC_FUNCS("Depsgraph");
 };
@@ -26,8 +26,12 @@
 #include "MEM_guardedalloc.h"
 
 #include "BLI_listbase.h"
+#include "BLI_math_base.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
+#include "BLI_vector.hh"
 
+#include "BKE_pointcache.h"
 #include "BKE_scene.h"
 
 #include "DNA_object_types.h"
@@ -40,6 +44,7 @@
 #include "intern/eval/deg_eval_flush.h"
 
 #include "intern/node/deg_node.h"
+#include "intern/node/deg_node_id.h"
 #include "intern/node/deg_node_operation.h"
 #include "intern/node/deg_node_time.h"
 
@@ -51,7 +56,11 @@ static void deg_flush_updates_and_refresh(deg::Depsgraph *deg_graph)
 {
   /* Update the time on the cow scene. */
   if (deg_graph->scene_cow) {
-    BKE_scene_frame_set(deg_graph->scene_cow, deg_graph->ctime);
+    Scene *scene_cow = deg_graph->scene_cow;
+    BKE_scene_frame_set(scene_cow,
+                        deg_graph->is_frame_parallel_depsgraph ?
+                            deg_graph->ctime / scene_cow->r.framelen :
+                            deg_graph->ctime);
   }
 
   deg::deg_graph_flush_updates(deg_graph);
@@ -81,3 +90,140 @@ void DEG_evaluate_on_framechange(Depsgraph *graph, float ctime)
   deg_graph->ctime = ctime;
   deg_flush_updates_and_refresh(deg_graph);
 }
+
+namespace {
+
+struct FrameBatchData {
+  Depsgraph **graphs;
+  const float *frames;
+  /* Scale from frames to the remapped time the graphs are evaluated at. */
+  float framelen;
+};
+
+static void evaluate_frame_func(void *__restrict userdata,
+                                const int i,
+                                const TaskParallelTLS *__restrict /*tls*/)
+{
+  FrameBatchData *data = static_cast<FrameBatchData *>(userdata);
+  DEG_evaluate_on_framechange(data->graphs[i], data->frames[i] * data->framelen);
+}
+
+static Depsgraph *frame_graph_new(
+    Main *bmain, Scene *scene, ViewLayer *view_layer, eEvaluationMode mode)
+{
+  Depsgraph *graph = DEG_graph_new(bmain, scene, view_layer, mode);
+  reinterpret_cast<deg::Depsgraph *>(graph)->is_frame_parallel_depsgraph = true;
+  return graph;
+}
+
+/* Simulations and point caches step from the state of the previous frame, which is not available
+ * when frames are evaluated out of order in several depsgraphs. */
+static bool frames_parallel_supported(Depsgraph *graph)
+{
+  deg::Depsgraph *deg_graph = reinterpret_cast<deg::Depsgraph *>(graph);
+  if (deg_graph->scene->rigidbody_world != NULL) {
+    return false;
+  }
+  for (deg::IDNode *id_node : deg_graph->id_nodes) {
+    if (GS(id_node->id_orig->name) != ID_OB) {
+      continue;
+    }
+    Object *object = reinterpret_cast<Object *>(id_node->id_orig);
+    if (BKE_ptcache_object_has(deg_graph->scene, object, 0)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+void DEG_evaluate_frames_parallel(Main *bmain,
+                                  Scene *scene,
+                                  ViewLayer *view_layer,
+                                  eEvaluationMode mode,
+                                  const float *frames,
+                                  int num_frames,
+                                  int max_depsgraphs,
+                                  DEG_FrameBuildCb build_cb,
+                                  DEG_FrameEvaluatedCb evaluated_cb,
+                                  void *user_data)
+{
+  if (num_frames == 0) {
+    return;
+  }
+
+  const size_t memory_in_use = MEM_get_memory_in_use();
+  /* Building is not thread safe, but it is cheap compared to the evaluation of all frames. */
+  Depsgraph *first_graph = frame_graph_new(bmain, scene, view_layer, mode);
+  build_cb(first_graph, user_data);
+
+  /* Evaluate the first frame on its own, to know how much memory an evaluated depsgraph uses
+   * before creating more of them. */
+  DEG_evaluate_on_framechange(first_graph, frames[0] * scene->r.framelen);
+  if (!evaluated_cb(first_graph, frames[0], user_data) || num_frames == 1) {
+    DEG_graph_free(first_graph);
+    return;
+  }
+
+  int num_graphs = 1;
+  if (frames_parallel_supported(first_graph)) {
+    if (max_depsgraphs > 0) {
+      num_graphs = max_depsgraphs;
+    }
+    else {
+      /* Keep the memory used by all depsgraphs below the memory which was in use before. */
+      const size_t memory_evaluated = MEM_get_memory_in_use();
+      const size_t graph_memory = (memory_evaluated > memory_in_use) ?
+                                      memory_evaluated - memory_in_use :
+                                      0;
+      num_graphs = min_ii(BLI_task_scheduler_num_threads(), DEG_FRAMES_PARALLEL_DEFAULT_MAX);
+      if (graph_memory != 0 && memory_in_use / graph_memory < (size_t)num_graphs) {
+        num_graphs = max_ii(1, (int)(memory_in_use / graph_memory));
+      }
+    }
+    num_graphs = min_ii(num_graphs, num_frames - 1);
+  }
+
+  blender::Vector<Depsgraph *> graphs;
+  graphs.append(first_graph);
+  for (int i = 1; i < num_graphs; i++) {
+    Depsgraph *graph = frame_graph_new(bmain, scene, view_layer, mode);
+    build_cb(graph, user_data);
+    graphs.append(graph);
+  }
+
+  for (int batch_start = 1; batch_start < num_frames; batch_start += num_graphs) {
+    const int batch_len = min_ii(num_graphs, num_frames - batch_start);
+    FrameBatchData data;
+    data.graphs = graphs.data();
+    data.frames = frames + batch_start;
+    data.framelen = scene->r.framelen;
+
+    if (batch_start == 1) {
+      /* The first evaluation copies all datablocks from the original ones, which also touches
+       * runtime data of the originals. Do that one depsgraph at a time. */
+      for (int i = 0; i < batch_len; i++) {
+        DEG_evaluate_on_framechange(graphs[i], data.frames[i] * data.framelen);
+      }
+    }
+    else {
+      TaskParallelSettings settings;
+      BLI_parallel_range_settings_defaults(&settings);
+      settings.min_iter_per_thread = 1;
+      BLI_task_parallel_range(0, batch_len, &data, evaluate_frame_func, &settings);
+    }
+
+    bool stop = false;
+    for (int i = 0; i < batch_len && !stop; i++) {
+      stop = !evaluated_cb(graphs[i], data.frames[i], user_data);
+    }
+    if (stop) {
+      break;
+    }
+  }
+
+  for (Depsgraph *graph : graphs) {
+    DEG_graph_free(graph);
+  }
+}
@@ -179,6 +179,7 @@ namespace deg {
 
 ListBase *build_effector_relations(Depsgraph *graph, Collection *collection)
 {
+  BLI_mutex_lock(&graph->physics_relations_lock);
   Map<const ID *, ListBase *> *hash = graph->physics_relations[DEG_PHYSICS_EFFECTOR];
   if (hash == nullptr) {
     graph->physics_relations[DEG_PHYSICS_EFFECTOR] = new Map<const ID *, ListBase *>();
@@ -189,10 +190,12 @@ ListBase *build_effector_relations(Depsgraph *graph, Collection *collection)
    * view layer.
    */
   ID *collection_id = object_id_safe(collection);
-  return hash->lookup_or_add_cb(collection_id, [&]() {
+  ListBase *relations = hash->lookup_or_add_cb(collection_id, [&]() {
     ::Depsgraph *depsgraph = reinterpret_cast<::Depsgraph *>(graph);
     return BKE_effector_relations_create(depsgraph, graph->view_layer, collection);
   });
+  BLI_mutex_unlock(&graph->physics_relations_lock);
+  return relations;
 }
 
 ListBase *build_collision_relations(Depsgraph *graph,
@@ -200,6 +203,7 @@ ListBase *build_collision_relations(Depsgraph *graph,
                                     unsigned int modifier_type)
 {
   const ePhysicsRelationType type = modifier_to_relation_type(modifier_type);
+  BLI_mutex_lock(&graph->physics_relations_lock);
   Map<const ID *, ListBase *> *hash = graph->physics_relations[type];
   if (hash == nullptr) {
     graph->physics_relations[type] = new Map<const ID *, ListBase *>();
@@ -210,10 +214,12 @@ ListBase *build_collision_relations(Depsgraph *graph,
    * view layer.
    */
   ID *collection_id = object_id_safe(collection);
-  return hash->lookup_or_add_cb(collection_id, [&]() {
+  ListBase *relations = hash->lookup_or_add_cb(collection_id, [&]() {
     ::Depsgraph *depsgraph = reinterpret_cast<::Depsgraph *>(graph);
     return BKE_collision_relations_create(depsgraph, collection, modifier_type);
   });
+  BLI_mutex_unlock(&graph->physics_relations_lock);
+  return relations;
 }
 
 void clear_physics_relations(Depsgraph *graph)
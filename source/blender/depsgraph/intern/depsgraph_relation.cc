@@ -34,10 +34,20 @@ namespace deg {
 Relation::Relation(Node *from, Node *to, const char *description)
     : from(from), to(to), name(description), flag(0)
 {
-  /* Hook it up to the nodes which use it.
-   *
-   * NOTE: We register relation in the nodes which this link connects to here
-   * in constructor but we don't un-register it in the destructor.
+}
+
+Relation::~Relation()
+{
+  /* Sanity check. */
+  BLI_assert(from != nullptr && to != nullptr);
+}
+
+void Relation::link()
+{
+  /* Sanity check. */
+  BLI_assert(from != nullptr && to != nullptr);
+  /* NOTE: We register relation in the nodes which this link connects to here, but we don't
+   * un-register it in the destructor.
    *
    * Reasoning:
    *
@@ -51,12 +61,6 @@ Relation::Relation(Node *from, Node *to, const char *description)
   to->inlinks.append(this);
 }
 
-Relation::~Relation()
-{
-  /* Sanity check. */
-  BLI_assert(from != nullptr && to != nullptr);
-}
-
 void Relation::unlink()
 {
   /* Sanity check. */
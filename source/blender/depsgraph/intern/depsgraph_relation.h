@@ -52,6 +52,8 @@ struct Relation {
   Relation(Node *from, Node *to, const char *description);
   ~Relation();
 
+  /* Register the relation in the nodes it connects. */
+  void link();
   void unlink();
 
   /* the nodes in the relationship (since this is shared between the nodes) */
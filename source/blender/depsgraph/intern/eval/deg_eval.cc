@@ -29,14 +29,21 @@
 
 #include "BLI_compiler_attrs.h"
 #include "BLI_gsqueue.h"
+#include "BLI_heap.h"
+#include "BLI_math_base.h"
+#include "BLI_string.h"
 #include "BLI_task.h"
+#include "BLI_threads.h"
+#include "BLI_trace.h"
 #include "BLI_utildefines.h"
 
 #include "BKE_global.h"
+#include "BKE_scene.h"
 
 #include "DNA_node_types.h"
 #include "DNA_object_types.h"
 #include "DNA_scene_types.h"
+#include "DNA_userdef_types.h"
 
 #include "DEG_depsgraph.h"
 #include "DEG_depsgraph_query.h"
@@ -62,6 +69,7 @@ namespace {
 struct DepsgraphEvalState;
 
 void deg_task_run_func(TaskPool *pool, void *taskdata);
+void deg_task_run_ready_queue_func(TaskPool *pool, void *taskdata);
 
 template<typename ScheduleFunction, typename... ScheduleFunctionArgs>
 void schedule_children(DepsgraphEvalState *state,
@@ -71,9 +79,14 @@ void schedule_children(DepsgraphEvalState *state,
 
 void schedule_node_to_pool(OperationNode *node, const int UNUSED(thread_id), TaskPool *pool)
 {
-  BLI_task_pool_push(pool, deg_task_run_func, node, false, NULL);
+  /* Operations of the same ID mostly depend on each other and work on the same data, prefer
+   * running the next one on the thread which finished the previous one. This is only a hint,
+   * an idle thread still picks up the operation right away. */
+  BLI_task_pool_push_affinity(pool, deg_task_run_func, node, false, NULL, node->owner->owner);
 }
 
+void schedule_node_to_ready_queue(OperationNode *node, const int thread_id, TaskPool *pool);
+
 /* Denotes which part of dependency graph is being evaluated. */
 enum class EvaluationStage {
   /* Stage 1: Only  Copy-on-Write operations are to be evaluated, prior to anything else.
@@ -96,6 +109,12 @@ struct DepsgraphEvalState {
   bool do_stats;
   EvaluationStage stage;
   bool need_single_thread_pass;
+  /* Dispatch the operations on the longest chains of dependencies first. */
+  bool use_critical_path;
+  /* Operations which are ready to be evaluated, ordered by their critical path time.
+   * Only used for the threaded evaluation with critical path scheduling. */
+  Heap *ready_queue;
+  SpinLock ready_queue_lock;
 };
 
 void evaluate_node(const DepsgraphEvalState *state, OperationNode *operation_node)
@@ -104,6 +123,18 @@ void evaluate_node(const DepsgraphEvalState *state, OperationNode *operation_nod
 
   /* Sanity checks. */
   BLI_assert(!operation_node->is_noop() && "NOOP nodes should not actually be scheduled");
+#ifdef WITH_TRACE
+  /* Name the zone after the ID and the operation, like "OBCube GEOMETRY_EVAL". */
+  char trace_name[64] = "";
+  if (BLI_trace_is_active()) {
+    BLI_snprintf(trace_name,
+                 sizeof(trace_name),
+                 "%s %s",
+                 operation_node->owner->owner->name.c_str(),
+                 operationCodeAsString(operation_node->opcode));
+  }
+  TRACE_SCOPE("depsgraph", trace_name);
+#endif
   /* Perform operation. */
   if (state->do_stats) {
     const double start_time = PIL_check_seconds_timer();
@@ -128,6 +159,35 @@ void deg_task_run_func(TaskPool *pool, void *taskdata)
   schedule_children(state, operation_node, schedule_node_to_pool, pool);
 }
 
+/* The task pool has no priorities, so every task evaluates the most important operation of the
+ * ready queue instead of a specific one. There is one task per operation in the queue. */
+void deg_task_run_ready_queue_func(TaskPool *pool, void *UNUSED(taskdata))
+{
+  void *userdata_v = BLI_task_pool_user_data(pool);
+  DepsgraphEvalState *state = (DepsgraphEvalState *)userdata_v;
+
+  BLI_spin_lock(&state->ready_queue_lock);
+  OperationNode *operation_node = (OperationNode *)BLI_heap_pop_min(state->ready_queue);
+  BLI_spin_unlock(&state->ready_queue_lock);
+
+  evaluate_node(state, operation_node);
+
+  schedule_children(state, operation_node, schedule_node_to_ready_queue, pool);
+}
+
+void schedule_node_to_ready_queue(OperationNode *node, const int UNUSED(thread_id), TaskPool *pool)
+{
+  void *userdata_v = BLI_task_pool_user_data(pool);
+  DepsgraphEvalState *state = (DepsgraphEvalState *)userdata_v;
+
+  /* The heap pops the lowest value first. */
+  BLI_spin_lock(&state->ready_queue_lock);
+  BLI_heap_insert(state->ready_queue, -(float)node->critical_path_time, node);
+  BLI_spin_unlock(&state->ready_queue_lock);
+
+  BLI_task_pool_push(pool, deg_task_run_ready_queue_func, NULL, false, NULL);
+}
+
 bool check_operation_node_visible(OperationNode *op_node)
 {
   const ComponentNode *comp_node = op_node->owner;
@@ -139,6 +199,13 @@ bool check_operation_node_visible(OperationNode *op_node)
   return comp_node->affects_directly_visible;
 }
 
+/* Visible operations which are tagged for update are evaluated. */
+bool need_evaluate_operation(const OperationNode *op_node)
+{
+  return check_operation_node_visible((OperationNode *)op_node) &&
+         (op_node->flag & DEPSOP_FLAG_NEEDS_UPDATE);
+}
+
 void calculate_pending_parents_for_node(OperationNode *node)
 {
   /* Update counters, applies for both visible and invisible IDs. */
@@ -178,10 +245,71 @@ void calculate_pending_parents(Depsgraph *graph)
   }
 }
 
+/* Operations which were not timed yet still count a little, so that long chains of them are
+ * preferred over short ones. */
+static const double UNTIMED_OPERATION_TIME = 1e-6;
+
+double operation_estimated_time(const OperationNode *node)
+{
+  if (node->is_noop()) {
+    return 0.0;
+  }
+  if (node->stats.average_time > 0.0) {
+    return node->stats.average_time;
+  }
+  return UNTIMED_OPERATION_TIME;
+}
+
+/* Calculate the time of the longest chain of operations which need evaluation, starting at every
+ * operation which needs evaluation. This is done in a depth-first traversal of the dependencies,
+ * with an explicit stack because the chains can be very long. */
+void calculate_critical_path_times(Depsgraph *graph)
+{
+  for (OperationNode *node : graph->operations) {
+    node->critical_path_time = -1.0;
+  }
+  /* Operations and the index of the next link to visit. */
+  Vector<std::pair<OperationNode *, int64_t>> stack;
+  for (OperationNode *root : graph->operations) {
+    if (root->critical_path_time >= 0.0 || !need_evaluate_operation(root)) {
+      continue;
+    }
+    /* Operations on the stack count as zero, which only matters for dependency cycles. */
+    root->critical_path_time = 0.0;
+    stack.append({root, 0});
+    while (!stack.is_empty()) {
+      OperationNode *node = stack.last().first;
+      int64_t &link_index = stack.last().second;
+      if (link_index < node->outlinks.size()) {
+        const Relation *rel = node->outlinks[link_index++];
+        OperationNode *child = (OperationNode *)rel->to;
+        if ((rel->flag & RELATION_FLAG_CYCLIC) == 0 && child->critical_path_time < 0.0 &&
+            need_evaluate_operation(child)) {
+          child->critical_path_time = 0.0;
+          stack.append({child, 0});
+        }
+        continue;
+      }
+      double children_time = 0.0;
+      for (const Relation *rel : node->outlinks) {
+        const OperationNode *child = (const OperationNode *)rel->to;
+        if ((rel->flag & RELATION_FLAG_CYCLIC) == 0 && need_evaluate_operation(child)) {
+          children_time = max_dd(children_time, child->critical_path_time);
+        }
+      }
+      node->critical_path_time = operation_estimated_time(node) + children_time;
+      stack.remove_last();
+    }
+  }
+}
+
 void initialize_execution(DepsgraphEvalState *state, Depsgraph *graph)
 {
   const bool do_stats = state->do_stats;
   calculate_pending_parents(graph);
+  if (state->use_critical_path) {
+    calculate_critical_path_times(graph);
+  }
   /* Clear tags and other things which needs to be clear. */
   for (OperationNode *node : graph->operations) {
     if (do_stats) {
@@ -344,6 +472,11 @@ void depsgraph_ensure_view_layer(Depsgraph *graph)
 
   const IDNode *scene_id_node = graph->find_id_node(&graph->scene->id);
   deg_update_copy_on_write_datablock(graph, scene_id_node);
+  if (graph->is_frame_parallel_depsgraph) {
+    /* The copy has the frame of the original scene, not the one this graph is evaluated at.
+     * The time is remapped, convert it back to a frame. */
+    BKE_scene_frame_set(scene_cow, graph->ctime / scene_cow->r.framelen);
+  }
 }
 
 }  // namespace
@@ -371,6 +504,8 @@ void deg_evaluate_on_refresh(Depsgraph *graph)
     return;
   }
 
+  TRACE_SCOPE("depsgraph", "Evaluate");
+
   graph->debug.begin_graph_evaluation();
 
   graph->is_evaluating = true;
@@ -378,8 +513,11 @@ void deg_evaluate_on_refresh(Depsgraph *graph)
   /* Set up evaluation state. */
   DepsgraphEvalState state;
   state.graph = graph;
-  state.do_stats = graph->debug.do_time_debug();
+  /* Critical path scheduling relies on the timings of previous evaluations. */
+  state.use_critical_path = USER_EXPERIMENTAL_TEST(&U, use_depsgraph_critical_path);
+  state.do_stats = graph->debug.do_time_debug() || state.use_critical_path;
   state.need_single_thread_pass = false;
+  state.ready_queue = NULL;
   /* Prepare all nodes for evaluation. */
   initialize_execution(&state, graph);
 
@@ -394,9 +532,21 @@ void deg_evaluate_on_refresh(Depsgraph *graph)
   /* After that, process all other nodes. */
   state.stage = EvaluationStage::THREADED_EVALUATION;
   task_pool = deg_evaluate_task_pool_create(&state);
-  schedule_graph(&state, schedule_node_to_pool, task_pool);
+  if (state.use_critical_path) {
+    state.ready_queue = BLI_heap_new();
+    BLI_spin_init(&state.ready_queue_lock);
+    schedule_graph(&state, schedule_node_to_ready_queue, task_pool);
+  }
+  else {
+    schedule_graph(&state, schedule_node_to_pool, task_pool);
+  }
   BLI_task_pool_work_and_wait(task_pool);
+  graph->debug.add_task_pool_stats(task_pool);
   BLI_task_pool_free(task_pool);
+  if (state.ready_queue != NULL) {
+    BLI_heap_free(state.ready_queue, NULL);
+    BLI_spin_end(&state.ready_queue_lock);
+  }
 
   if (state.need_single_thread_pass) {
     state.stage = EvaluationStage::SINGLE_THREADED_WORKAROUND;
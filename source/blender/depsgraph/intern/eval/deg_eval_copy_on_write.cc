@@ -284,7 +284,7 @@ struct ValidateData {
 
 /* Similar to generic BKE_id_copy() but does not require main and assumes pointer
  * is already allocated. */
-bool id_copy_inplace_no_main(const ID *id, ID *newid)
+bool id_copy_inplace_no_main(const ID *id, ID *newid, const int extra_flag = 0)
 {
   const ID *id_for_copy = id;
 
@@ -301,8 +301,10 @@ bool id_copy_inplace_no_main(const ID *id, ID *newid)
   id_for_copy = nested_id_hack_get_discarded_pointers(&id_hack_storage, id);
 #endif
 
-  bool result = BKE_id_copy_ex(
-      nullptr, (ID *)id_for_copy, &newid, (LIB_ID_COPY_LOCALIZE | LIB_ID_CREATE_NO_ALLOCATE));
+  bool result = BKE_id_copy_ex(nullptr,
+                               (ID *)id_for_copy,
+                               &newid,
+                               (LIB_ID_COPY_LOCALIZE | LIB_ID_CREATE_NO_ALLOCATE | extra_flag));
 
 #ifdef NESTED_ID_NASTY_WORKAROUND
   if (result) {
@@ -835,11 +837,15 @@ int foreach_libblock_validate_callback(LibraryIDLinkCallbackData *cb_data)
 /* Actual implementation of logic which "expands" all the data which was not
  * yet copied-on-write.
  *
+ * The id_copy_flag is passed on to the copy of meshes, to reference the original geometry
+ * arrays instead of duplicating them.
+ *
  * NOTE: Expects that CoW datablock is empty. */
-ID *deg_expand_copy_on_write_datablock(const Depsgraph *depsgraph,
-                                       const IDNode *id_node,
-                                       DepsgraphNodeBuilder *node_builder,
-                                       bool create_placeholders)
+static ID *expand_copy_on_write_datablock(const Depsgraph *depsgraph,
+                                          const IDNode *id_node,
+                                          DepsgraphNodeBuilder *node_builder,
+                                          bool create_placeholders,
+                                          const int id_copy_flag)
 {
   const ID *id_orig = id_node->id_orig;
   ID *id_cow = id_node->id_cow;
@@ -859,8 +865,6 @@ ID *deg_expand_copy_on_write_datablock(const Depsgraph *depsgraph,
   }
   // BLI_assert(check_datablock_expanded(id_cow) == false);
   /* Copy data from original ID to a copied version. */
-  /* TODO(sergey): Avoid doing full ID copy somehow, make Mesh to reference
-   * original geometry arrays for until those are modified. */
   /* TODO(sergey): We do some trickery with temp bmain and extra ID pointer
    * just to be able to use existing API. Ideally we need to replace this with
    * in-place copy from existing datablock to a prepared memory.
@@ -884,8 +888,11 @@ ID *deg_expand_copy_on_write_datablock(const Depsgraph *depsgraph,
       break;
     }
     case ID_ME: {
-      /* TODO(sergey): Ideally we want to handle meshes in a special
-       * manner here to avoid initial copy of all the geometry arrays. */
+      /* When updating, the geometry arrays which did not change are reused from the previous
+       * copy, see #MeshBackup.
+       * TODO(sergey): Ideally we want to avoid the initial copy of all the geometry arrays as
+       * well. */
+      done = id_copy_inplace_no_main(id_orig, id_cow, id_copy_flag);
       break;
     }
     default:
@@ -924,6 +931,14 @@ ID *deg_expand_copy_on_write_datablock(const Depsgraph *depsgraph,
   return id_cow;
 }
 
+ID *deg_expand_copy_on_write_datablock(const Depsgraph *depsgraph,
+                                       const IDNode *id_node,
+                                       DepsgraphNodeBuilder *node_builder,
+                                       bool create_placeholders)
+{
+  return expand_copy_on_write_datablock(depsgraph, id_node, node_builder, create_placeholders, 0);
+}
+
 /* NOTE: Depsgraph is supposed to have ID node already. */
 ID *deg_expand_copy_on_write_datablock(const Depsgraph *depsgraph,
                                        ID *id_orig,
@@ -946,7 +961,9 @@ ID *deg_update_copy_on_write_datablock(const Depsgraph *depsgraph, const IDNode
   RuntimeBackup backup(depsgraph);
   backup.init_from_id(id_cow);
   deg_free_copy_on_write_datablock(id_cow);
-  deg_expand_copy_on_write_datablock(depsgraph, id_node);
+  /* Reference the original geometry, the backup duplicates the arrays which changed. */
+  const int id_copy_flag = backup.mesh_backup.has_geometry ? LIB_ID_COPY_CD_REFERENCE : 0;
+  expand_copy_on_write_datablock(depsgraph, id_node, nullptr, false, id_copy_flag);
   backup.restore_to_id(id_cow);
   return id_cow;
 }
@@ -0,0 +1,91 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2020 Blender Foundation.
+ * All rights reserved.
+ */
+
+/** \file
+ * \ingroup depsgraph
+ */
+
+#include "intern/eval/deg_eval_runtime_backup_mesh.h"
+
+#include "BLI_utildefines.h"
+
+#include "DNA_mesh_types.h"
+
+#include "BKE_customdata.h"
+#include "BKE_mesh.h"
+
+namespace blender {
+namespace deg {
+
+MeshBackup::MeshBackup(const Depsgraph * /*depsgraph*/)
+    : has_geometry(false), totvert(0), totedge(0), totface(0), totloop(0), totpoly(0)
+{
+  CustomData_reset(&vdata);
+  CustomData_reset(&edata);
+  CustomData_reset(&fdata);
+  CustomData_reset(&ldata);
+  CustomData_reset(&pdata);
+}
+
+void MeshBackup::init_from_mesh(Mesh *mesh)
+{
+  /* Take the geometry over, so that it is not freed with the copy-on-write mesh. */
+  vdata = mesh->vdata;
+  edata = mesh->edata;
+  fdata = mesh->fdata;
+  ldata = mesh->ldata;
+  pdata = mesh->pdata;
+  totvert = mesh->totvert;
+  totedge = mesh->totedge;
+  totface = mesh->totface;
+  totloop = mesh->totloop;
+  totpoly = mesh->totpoly;
+  CustomData_reset(&mesh->vdata);
+  CustomData_reset(&mesh->edata);
+  CustomData_reset(&mesh->fdata);
+  CustomData_reset(&mesh->ldata);
+  CustomData_reset(&mesh->pdata);
+  BKE_mesh_update_customdata_pointers(mesh, false);
+  has_geometry = true;
+}
+
+void MeshBackup::restore_to_mesh(Mesh *mesh)
+{
+  if (!has_geometry) {
+    return;
+  }
+  CustomData_duplicate_referenced_layers_reuse(&mesh->vdata, mesh->totvert, &vdata, totvert);
+  CustomData_duplicate_referenced_layers_reuse(&mesh->edata, mesh->totedge, &edata, totedge);
+  CustomData_duplicate_referenced_layers_reuse(&mesh->fdata, mesh->totface, &fdata, totface);
+  CustomData_duplicate_referenced_layers_reuse(&mesh->ldata, mesh->totloop, &ldata, totloop);
+  CustomData_duplicate_referenced_layers_reuse(&mesh->pdata, mesh->totpoly, &pdata, totpoly);
+  const bool do_tessface = ((mesh->totface != 0) && (mesh->totpoly == 0));
+  BKE_mesh_update_customdata_pointers(mesh, do_tessface);
+
+  /* Free the arrays which have not been reused. */
+  CustomData_free(&vdata, totvert);
+  CustomData_free(&edata, totedge);
+  CustomData_free(&fdata, totface);
+  CustomData_free(&ldata, totloop);
+  CustomData_free(&pdata, totpoly);
+  has_geometry = false;
+}
+
+}  // namespace deg
+}  // namespace blender
@@ -0,0 +1,56 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2020 Blender Foundation.
+ * All rights reserved.
+ */
+
+/** \file
+ * \ingroup depsgraph
+ */
+
+#pragma once
+
+#include "DNA_customdata_types.h"
+
+struct Mesh;
+
+namespace blender {
+namespace deg {
+
+struct Depsgraph;
+
+/* Backup of the geometry of mesh datablocks.
+ *
+ * The geometry is not runtime data, but copying all of it again is the most expensive part of
+ * updating a copy-on-write mesh. The copy references the arrays of the original mesh instead, and
+ * only the arrays which are different from the backup are duplicated. */
+class MeshBackup {
+ public:
+  MeshBackup(const Depsgraph *depsgraph);
+
+  void init_from_mesh(Mesh *mesh);
+  void restore_to_mesh(Mesh *mesh);
+
+  /* The copy-on-write mesh had geometry which can be reused, the new copy of the original mesh
+   * is to reference the original geometry arrays then. */
+  bool has_geometry;
+
+  CustomData vdata, edata, fdata, ldata, pdata;
+  int totvert, totedge, totface, totloop, totpoly;
+};
+
+}  // namespace deg
+}  // namespace blender
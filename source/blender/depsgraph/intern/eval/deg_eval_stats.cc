@@ -35,6 +35,10 @@
 namespace blender {
 namespace deg {
 
+/* Weight of the latest evaluation in the average time, high enough to follow changes in the
+ * scene within a few frames. */
+static const double AVERAGE_TIME_WEIGHT = 0.25;
+
 void deg_eval_stats_aggregate(Depsgraph *graph)
 {
   /* Reset current evaluation stats for ID and component nodes.
@@ -52,6 +56,18 @@ void deg_eval_stats_aggregate(Depsgraph *graph)
     IDNode *id_node = comp_node->owner;
     id_node->stats.current_time += op_node->stats.current_time;
     comp_node->stats.current_time += op_node->stats.current_time;
+    /* Only average over the evaluations which actually ran the operation. */
+    if (op_node->is_noop() || (op_node->flag & DEPSOP_FLAG_NEEDS_UPDATE) == 0 ||
+        !op_node->scheduled) {
+      continue;
+    }
+    double &average_time = op_node->stats.average_time;
+    if (average_time == 0.0) {
+      average_time = op_node->stats.current_time;
+    }
+    else {
+      average_time += (op_node->stats.current_time - average_time) * AVERAGE_TIME_WEIGHT;
+    }
   }
 }
 
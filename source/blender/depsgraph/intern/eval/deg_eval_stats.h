@@ -28,7 +28,8 @@ namespace deg {
 
 struct Depsgraph;
 
-/* Aggregate operation timings to overall component and ID nodes timing. */
+/* Aggregate operation timings to overall component and ID nodes timing,
+ * and update the average time of the evaluated operations. */
 void deg_eval_stats_aggregate(Depsgraph *graph);
 
 }  // namespace deg
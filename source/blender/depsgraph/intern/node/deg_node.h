@@ -163,6 +163,9 @@ struct Node {
     void reset_current();
     /* Time spend on this node during current graph evaluation. */
     double current_time;
+    /* Moving average of the time spent on this node over the evaluations it was part of,
+     * zero when it was not timed yet. Only updated for operation nodes. */
+    double average_time;
   };
   /* Relationships between nodes
    * The reason why all depsgraph nodes are descended from this type (apart
@@ -136,6 +136,14 @@ void IDNode::destroy()
     delete comp_node;
   }
 
+  free_copy_on_write();
+
+  /* Tag that the node is freed. */
+  id_orig = nullptr;
+}
+
+void IDNode::free_copy_on_write()
+{
   /* Free memory used by this CoW ID. */
   if (id_cow != id_orig && id_cow != nullptr) {
     deg_free_copy_on_write_datablock(id_cow);
@@ -143,9 +151,6 @@ void IDNode::destroy()
     id_cow = nullptr;
     DEG_COW_PRINT("Destroy CoW for %s: id_orig=%p id_cow=%p\n", id_orig->name, id_orig, id_cow);
   }
-
-  /* Tag that the node is freed. */
-  id_orig = nullptr;
 }
 
 string IDNode::identifier() const
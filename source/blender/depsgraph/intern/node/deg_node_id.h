@@ -62,6 +62,8 @@ struct IDNode : public Node {
   void init_copy_on_write(ID *id_cow_hint = nullptr);
   ~IDNode();
   void destroy();
+  /* Free the copy-on-write data-block, keeping the component nodes. */
+  void free_copy_on_write();
 
   virtual string identifier() const override;
 
@@ -265,6 +265,9 @@ struct OperationNode : public Node {
   /* How many inlinks are we still waiting on before we can be evaluated. */
   uint32_t num_links_pending;
   bool scheduled;
+  /* Estimated time of the longest chain of operations starting with this one, in seconds.
+   * Only calculated for critical path scheduling. */
+  double critical_path_time;
 
   /* Identifier for the operation being performed. */
   OperationCode opcode;
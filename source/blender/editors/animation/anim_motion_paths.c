@@ -32,6 +32,7 @@
 
 #include "BKE_action.h"
 #include "BKE_anim_data.h"
+#include "BKE_callbacks.h"
 #include "BKE_main.h"
 #include "BKE_scene.h"
 
@@ -74,14 +75,9 @@ static void motionpaths_calc_update_scene(struct Depsgraph *depsgraph)
   BKE_scene_graph_update_for_newframe(depsgraph);
 }
 
-Depsgraph *animviz_depsgraph_build(Main *bmain,
-                                   Scene *scene,
-                                   ViewLayer *view_layer,
-                                   ListBase *targets)
+/* Build graph from all requested IDs. */
+static void motionpaths_depsgraph_build_targets(Depsgraph *depsgraph, ListBase *targets)
 {
-  /* Allocate dependency graph. */
-  Depsgraph *depsgraph = DEG_graph_new(bmain, scene, view_layer, DAG_EVAL_VIEWPORT);
-
   /* Make a flat array of IDs for the DEG API. */
   const int num_ids = BLI_listbase_count(targets);
   ID **ids = MEM_malloc_arrayN(sizeof(ID *), num_ids, "animviz IDS");
@@ -90,9 +86,19 @@ Depsgraph *animviz_depsgraph_build(Main *bmain,
     ids[current_id_index++] = &mpt->ob->id;
   }
 
-  /* Build graph from all requested IDs. */
   DEG_graph_build_from_ids(depsgraph, ids, num_ids);
   MEM_freeN(ids);
+}
+
+Depsgraph *animviz_depsgraph_build(Main *bmain,
+                                   Scene *scene,
+                                   ViewLayer *view_layer,
+                                   ListBase *targets)
+{
+  /* Allocate dependency graph. */
+  Depsgraph *depsgraph = DEG_graph_new(bmain, scene, view_layer, DAG_EVAL_VIEWPORT);
+
+  motionpaths_depsgraph_build_targets(depsgraph, targets);
 
   /* Update once so we can access pointers of evaluated animation data. */
   motionpaths_calc_update_scene(depsgraph);
@@ -139,7 +145,8 @@ void animviz_get_object_motionpaths(Object *ob, ListBase *targets)
 /* ........ */
 
 /* perform baking for the targets on the current frame */
-static void motionpaths_calc_bake_targets(ListBase *targets, int cframe)
+/* Bake the targets from the given depsgraph, which is evaluated at the frame. */
+static void motionpaths_calc_bake_targets(ListBase *targets, int cframe, Depsgraph *depsgraph)
 {
   MPathTarget *mpt;
 
@@ -157,7 +164,7 @@ static void motionpaths_calc_bake_targets(ListBase *targets, int cframe)
     /* get the relevant cache vert to write to */
     bMotionPathVert *mpv = mpath->points + (cframe - mpath->start_frame);
 
-    Object *ob_eval = mpt->ob_eval;
+    Object *ob_eval = DEG_get_evaluated_object(depsgraph, mpt->ob);
 
     /* Lookup evaluated pose channel, here because the depsgraph
      * evaluation can change them so they are not cached in mpt. */
@@ -195,13 +202,17 @@ static void motionpaths_calc_bake_targets(ListBase *targets, int cframe)
     }
 
     /* Incremental update on evaluated object if possible, for fast updating
-     * while dragging in transform. */
+     * while dragging in transform. This is the object of the depsgraph the paths are
+     * calculated for, which is not the given one when frames are evaluated in parallel. */
     bMotionPath *mpath_eval = NULL;
     if (mpt->pchan) {
+      if (ob_eval != mpt->ob_eval) {
+        pchan_eval = BKE_pose_channel_find_name(mpt->ob_eval->pose, mpt->pchan->name);
+      }
       mpath_eval = (pchan_eval) ? pchan_eval->mpath : NULL;
     }
     else {
-      mpath_eval = ob_eval->mpath;
+      mpath_eval = mpt->ob_eval->mpath;
     }
 
     if (mpath_eval && mpath_eval->length == mpath->length) {
@@ -215,6 +226,17 @@ static void motionpaths_calc_bake_targets(ListBase *targets, int cframe)
   }
 }
 
+static void motionpaths_frame_depsgraph_build(Depsgraph *depsgraph, void *user_data)
+{
+  motionpaths_depsgraph_build_targets(depsgraph, user_data);
+}
+
+static bool motionpaths_frame_bake(Depsgraph *depsgraph, float frame, void *user_data)
+{
+  motionpaths_calc_bake_targets(user_data, (int)frame, depsgraph);
+  return true;
+}
+
 /* Get pointer to animviz settings for the given target. */
 static bAnimVizSettings *animviz_target_settings_get(MPathTarget *mpt)
 {
@@ -464,27 +486,55 @@ void animviz_calc_motionpaths(Depsgraph *depsgraph,
             sfra,
             efra,
             efra - sfra + 1);
-  for (CFRA = sfra; CFRA <= efra; CFRA++) {
-    if (range == ANIMVIZ_CALC_RANGE_CURRENT_FRAME) {
-      /* For current frame, only update tagged. */
-      BKE_scene_graph_update_tagged(depsgraph, bmain);
-    }
-    else {
-      /* Update relevant data for new frame. */
-      motionpaths_calc_update_scene(depsgraph);
+  /* Frame change handlers need the frames to be evaluated one by one in the scene itself. */
+  const bool use_frames_parallel = range == ANIMVIZ_CALC_RANGE_FULL && sfra < efra &&
+                                   !BKE_callback_is_used(BKE_CB_EVT_FRAME_CHANGE_PRE) &&
+                                   !BKE_callback_is_used(BKE_CB_EVT_FRAME_CHANGE_POST);
+  if (use_frames_parallel) {
+    /* Evaluate the frames in parallel, in depsgraphs which only contain the targets. The
+     * depsgraph and the current frame are not changed, so there is nothing to restore.
+     * Updates of changed ranges are usually short and interactive, building new depsgraphs
+     * costs more than it gains there. */
+    const int num_frames = efra - sfra + 1;
+    float *frames = MEM_malloc_arrayN(num_frames, sizeof(float), __func__);
+    for (int i = 0; i < num_frames; i++) {
+      frames[i] = (float)(sfra + i);
     }
-
-    /* perform baking for targets */
-    motionpaths_calc_bake_targets(targets, CFRA);
+    DEG_evaluate_frames_parallel(bmain,
+                                 scene,
+                                 DEG_get_input_view_layer(depsgraph),
+                                 DAG_EVAL_VIEWPORT,
+                                 frames,
+                                 num_frames,
+                                 0,
+                                 motionpaths_frame_depsgraph_build,
+                                 motionpaths_frame_bake,
+                                 targets);
+    MEM_freeN(frames);
   }
+  else {
+    for (CFRA = sfra; CFRA <= efra; CFRA++) {
+      if (range == ANIMVIZ_CALC_RANGE_CURRENT_FRAME) {
+        /* For current frame, only update tagged. */
+        BKE_scene_graph_update_tagged(depsgraph, bmain);
+      }
+      else {
+        /* Update relevant data for new frame. */
+        motionpaths_calc_update_scene(depsgraph);
+      }
 
-  /* reset original environment */
-  /* NOTE: We don't always need to reevaluate the main scene, as the depsgraph
-   * may be a temporary one that works on a subset of the data.
-   * We always have to restore the current frame though. */
-  CFRA = cfra;
-  if (range != ANIMVIZ_CALC_RANGE_CURRENT_FRAME && restore) {
-    motionpaths_calc_update_scene(depsgraph);
+      /* perform baking for targets */
+      motionpaths_calc_bake_targets(targets, CFRA, depsgraph);
+    }
+
+    /* reset original environment */
+    /* NOTE: We don't always need to reevaluate the main scene, as the depsgraph
+     * may be a temporary one that works on a subset of the data.
+     * We always have to restore the current frame though. */
+    CFRA = cfra;
+    if (range != ANIMVIZ_CALC_RANGE_CURRENT_FRAME && restore) {
+      motionpaths_calc_update_scene(depsgraph);
+    }
   }
 
   if (is_active_depsgraph) {
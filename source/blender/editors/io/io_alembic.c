@@ -140,6 +140,8 @@ static int wm_alembic_export_exec(bContext *C, wmOperator *op)
       .ngon_method = RNA_enum_get(op->ptr, "ngon_method"),
 
       .global_scale = RNA_float_get(op->ptr, "global_scale"),
+
+      .parallel_frames = RNA_int_get(op->ptr, "parallel_frames"),
   };
 
   /* Take some defaults from the scene, if not specified explicitly. */
@@ -182,6 +184,7 @@ static void ui_alembic_export_settings(uiLayout *layout, PointerRNA *imfptr)
 
   uiItemR(col, imfptr, "xsamples", 0, IFACE_("Samples Transform"), ICON_NONE);
   uiItemR(col, imfptr, "gsamples", 0, IFACE_("Geometry"), ICON_NONE);
+  uiItemR(col, imfptr, "parallel_frames", 0, NULL, ICON_NONE);
 
   sub = uiLayoutColumn(col, true);
   uiItemR(sub, imfptr, "sh_open", UI_ITEM_R_SLIDER, NULL, ICON_NONE);
@@ -333,6 +336,18 @@ void WM_OT_alembic_export(wmOperatorType *ot)
               1,
               128);
 
+  RNA_def_int(ot->srna,
+              "parallel_frames",
+              0,
+              0,
+              64,
+              "Parallel Frames",
+              "Number of frames evaluated at the same time, each one uses memory for a copy of "
+              "the scene data. Use 0 to pick a number based on the memory used by one frame, "
+              "and 1 to evaluate the frames in the scene itself, running frame change handlers",
+              0,
+              64);
+
   RNA_def_float(ot->srna,
                 "sh_open",
                 0.0f,
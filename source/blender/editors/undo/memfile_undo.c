@@ -262,6 +262,9 @@ static void memfile_undosys_step_free(UndoStep *us_p)
     if (us_next_p != NULL) {
       MemFileUndoStep *us_next = (MemFileUndoStep *)us_next_p;
       BLO_memfile_merge(&us->data->memfile, &us_next->data->memfile);
+      /* Memory still in use is accounted for by the next step now. */
+      us_next->data->undo_size = us_next->data->memfile.size;
+      us_next_p->data_size = us_next->data->undo_size;
     }
   }
 
@@ -68,6 +68,11 @@ struct AlembicExportParams {
   int ngon_method;
 
   float global_scale;
+
+  /* Number of frames evaluated at the same time, each in its own copy of the scene data.
+   * Zero picks a number based on the memory used by one frame, one evaluates the frames in the
+   * scene itself. */
+  int parallel_frames;
 };
 
 /* The ABC_export and ABC_import functions both take a as_background_job
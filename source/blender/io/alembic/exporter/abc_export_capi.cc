@@ -32,6 +32,7 @@
 #include "DNA_scene_types.h"
 
 #include "BKE_blender_version.h"
+#include "BKE_callbacks.h"
 #include "BKE_context.h"
 #include "BKE_global.h"
 #include "BKE_main.h"
@@ -49,6 +50,7 @@ static CLG_LogRef LOG = {"io.alembic"};
 
 #include <algorithm>
 #include <memory>
+#include <vector>
 
 struct ExportJobData {
   Main *bmain;
@@ -57,6 +59,8 @@ struct ExportJobData {
 
   char filename[FILE_MAX];
   AlembicExportParams params;
+  /* Decided on the main thread, the job can't query the frame change handlers. */
+  bool export_frames_parallel;
 
   bool was_canceled;
   bool export_ok;
@@ -75,6 +79,46 @@ static void build_depsgraph(Depsgraph *depsgraph, const bool visible_objects_onl
   }
 }
 
+struct ExportFramesData {
+  ExportJobData *job;
+  ABCArchive *abc_archive;
+  ABCHierarchyIterator *iter;
+  ABCArchive::Frames::const_iterator frame_it;
+  float progress_per_frame;
+  short *stop;
+  short *do_update;
+  float *progress;
+};
+
+static void export_frame_depsgraph_build(Depsgraph *depsgraph, void *user_data)
+{
+  ExportFramesData *frames_data = static_cast<ExportFramesData *>(user_data);
+  build_depsgraph(depsgraph, frames_data->job->params.visible_objects_only);
+}
+
+static bool export_frame_write(Depsgraph *depsgraph, float /*frame*/, void *user_data)
+{
+  ExportFramesData *frames_data = static_cast<ExportFramesData *>(user_data);
+  if (G.is_break || (frames_data->stop != nullptr && *frames_data->stop)) {
+    return false;
+  }
+
+  // The frames are written in order. The frame is taken from the archive, as the evaluated time
+  // is only single precision.
+  const double frame = *frames_data->frame_it;
+  frames_data->frame_it++;
+
+  CLOG_INFO(&LOG, 2, "Exporting frame %.2f", frame);
+  ExportSubset export_subset = frames_data->abc_archive->export_subset_for_frame(frame);
+  frames_data->iter->set_depsgraph(depsgraph);
+  frames_data->iter->set_export_subset(export_subset);
+  frames_data->iter->iterate_and_write();
+
+  *frames_data->progress += frames_data->progress_per_frame;
+  *frames_data->do_update = true;
+  return true;
+}
+
 static void export_startjob(void *customdata,
                             /* Cannot be const, this function implements wm_jobs_start_callback.
                              * NOLINTNEXTLINE: readability-non-const-parameter. */
@@ -133,7 +177,7 @@ static void export_startjob(void *customdata,
 
   ABCHierarchyIterator iter(data->depsgraph, abc_archive.get(), data->params);
 
-  if (export_animation) {
+  if (export_animation && !data->export_frames_parallel) {
     CLOG_INFO(&LOG, 2, "Exporting animation");
 
     // Writing the animated frames is not 100% of the work, but it's our best guess.
@@ -162,6 +206,36 @@ static void export_startjob(void *customdata,
       *do_update = true;
     }
   }
+  else if (export_animation) {
+    CLOG_INFO(&LOG, 2, "Exporting animation");
+
+    ExportFramesData frames_data;
+    frames_data.job = data;
+    frames_data.abc_archive = abc_archive.get();
+    frames_data.iter = &iter;
+    frames_data.frame_it = abc_archive->frames_begin();
+    // Writing the animated frames is not 100% of the work, but it's our best guess.
+    frames_data.progress_per_frame = 1.0f /
+                                     std::max(size_t(1), abc_archive->total_frame_count());
+    frames_data.stop = stop;
+    frames_data.do_update = do_update;
+    frames_data.progress = progress;
+
+    // The frames are evaluated in parallel, in depsgraphs separate from the one of the job. The
+    // scene's current frame is not changed, so no frame change handlers are run.
+    const std::vector<float> frames(abc_archive->frames_begin(), abc_archive->frames_end());
+    DEG_evaluate_frames_parallel(data->bmain,
+                                 scene,
+                                 DEG_get_input_view_layer(data->depsgraph),
+                                 DAG_EVAL_RENDER,
+                                 frames.data(),
+                                 static_cast<int>(frames.size()),
+                                 data->params.parallel_frames,
+                                 export_frame_depsgraph_build,
+                                 export_frame_write,
+                                 &frames_data);
+    iter.set_depsgraph(data->depsgraph);
+  }
   else {
     // If we're not animating, a single iteration over all objects is enough.
     iter.iterate_and_write();
@@ -216,6 +290,11 @@ bool ABC_export(Scene *scene,
   job->depsgraph = DEG_graph_new(
       job->bmain, scene, view_layer, DAG_EVAL_RENDER /* TODO(Sybren): params->evaluation_mode */);
   job->params = *params;
+  /* Frame change handlers may change the scene for every frame, they need the frames to be
+   * evaluated one by one in the scene itself. */
+  job->export_frames_parallel = params->parallel_frames != 1 &&
+                                !BKE_callback_is_used(BKE_CB_EVT_FRAME_CHANGE_PRE) &&
+                                !BKE_callback_is_used(BKE_CB_EVT_FRAME_CHANGE_POST);
 
   bool export_ok = false;
   if (as_background_job) {
@@ -168,6 +168,11 @@ void ABCGenericMeshWriter::do_write(HierarchyContext &context)
   Object *object = context.object;
   bool needsfree = false;
 
+  /* The evaluated object can be from another depsgraph than the one this writer was created
+   * for, see #AbstractHierarchyIterator::set_depsgraph(). */
+  Scene *scene_eval = DEG_get_evaluated_scene(args_.hierarchy_iterator->get_depsgraph());
+  liquid_sim_modifier_ = get_liquid_sim_modifier(scene_eval, object);
+
   Mesh *mesh = get_export_mesh(object, needsfree);
 
   if (mesh == nullptr) {
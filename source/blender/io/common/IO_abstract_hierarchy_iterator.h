@@ -250,6 +250,12 @@ class AbstractHierarchyIterator {
    * previous iteration. */
   void set_export_subset(ExportSubset export_subset_);
 
+  /* Iterate over another depsgraph in the next call to iterate_and_write(), for example one that
+   * is evaluated at the next frame to export. The writers are kept, so they must get evaluated
+   * data from the depsgraph returned by get_depsgraph() instead of holding on to it. */
+  void set_depsgraph(Depsgraph *depsgraph);
+  Depsgraph *get_depsgraph() const;
+
   /* Convert the given name to something that is valid for the exported file format.
    * This base implementation is a no-op; override in a concrete subclass. */
   virtual std::string make_valid_name(const std::string &name) const;
@@ -220,6 +220,22 @@ void AbstractHierarchyIterator::set_export_subset(ExportSubset export_subset)
   export_subset_ = export_subset;
 }
 
+void AbstractHierarchyIterator::set_depsgraph(Depsgraph *depsgraph)
+{
+  if (depsgraph == depsgraph_) {
+    return;
+  }
+  depsgraph_ = depsgraph;
+  /* The paths are stored by evaluated ID, those of the previous depsgraph are never found
+   * again. */
+  duplisource_export_path_.clear();
+}
+
+Depsgraph *AbstractHierarchyIterator::get_depsgraph() const
+{
+  return depsgraph_;
+}
+
 std::string AbstractHierarchyIterator::make_valid_name(const std::string &name) const
 {
   return name;
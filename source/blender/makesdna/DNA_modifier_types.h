@@ -138,6 +138,8 @@ typedef enum {
   eModifierFlag_OverrideLibrary_Local = (1 << 0),
   /* This modifier does not own its caches, but instead shares them with another modifier. */
   eModifierFlag_SharedCaches = (1 << 1),
+  /* Keep the result of the stack up to this modifier, see #BKE_modifier_stack_cache_keys. */
+  eModifierFlag_CacheResult = (1 << 2),
 } ModifierFlag;
 
 /* not a real modifier */
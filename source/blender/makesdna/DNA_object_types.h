@@ -177,6 +177,12 @@ typedef struct Object_Runtime {
   /** Runtime evaluated curve-specific data, not stored in the file. */
   struct CurveCache *curve_cache;
 
+  /**
+   * Results of the modifier stack at modifiers with #eModifierFlag_CacheResult.
+   * Kept across copy-on-write updates of the evaluated object.
+   */
+  struct ModifierStackCache *modifier_stack_cache;
+
   unsigned short local_collections_bits;
   short _pad2[3];
 } Object_Runtime;
@@ -622,8 +622,7 @@ typedef struct UserDef_Experimental {
   char use_sculpt_vertex_colors;
   char use_image_editor_legacy_drawing;
   char use_tools_missing_icons;
-  /** `makesdna` does not allow empty structs. */
-  char _pad[1];
+  char use_depsgraph_critical_path;
 } UserDef_Experimental;
 
 #define USER_EXPERIMENTAL_TEST(userdef, member) \
@@ -750,7 +749,8 @@ typedef struct UserDef {
   int prefetchframes;
   /** Control the rotation step of the view when PAD2, PAD4, PAD6&PAD8 is use. */
   float pad_rot_angle;
-  char _pad12[4];
+  /** Memory limit of the cached modifier stack results (in megabytes). */
+  int modifier_cache_limit;
   /** Rotating view icon size. */
   short rvisize;
   /** Rotating view icon brightness. */
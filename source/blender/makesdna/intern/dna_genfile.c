@@ -796,20 +796,18 @@ static eSDNA_Type sdna_type_nr(const char *dna_type)
  * Note there is no optimization for the case where otype and ctype are the same:
  * assumption is that caller will handle this case.
  *
- * \param ctype: Name of type to convert to
- * \param otype: Name of type to convert from
+ * \param ctypenr: Type to convert to
+ * \param otypenr: Type to convert from
  * \param name_array_len: Result of #DNA_elem_array_size for this element.
  * \param curdata: Where to put converted data
  * \param olddata: Data of type otype to convert
  */
-static void cast_elem(
-    const char *ctype, const char *otype, int name_array_len, char *curdata, const char *olddata)
+static void cast_elem(const eSDNA_Type ctypenr,
+                      const eSDNA_Type otypenr,
+                      int name_array_len,
+                      char *curdata,
+                      const char *olddata)
 {
-  eSDNA_Type ctypenr, otypenr;
-  if ((otypenr = sdna_type_nr(otype)) == -1 || (ctypenr = sdna_type_nr(ctype)) == -1) {
-    return;
-  }
-
   /* define lengths */
   const int oldlen = DNA_elem_type_size(otypenr);
   const int curlen = DNA_elem_type_size(ctypenr);
@@ -1030,31 +1028,22 @@ static bool elem_exists_alias(const SDNA *sdna,
 }
 
 /**
- * Returns the address of the data for the specified field within olddata
- * according to the struct format pointed to by old, or NULL if no such
- * field can be found.
- *
- * Passing olddata=NULL doesn't work reliably for existence checks; it will
- * return NULL both when the field is found at offset 0 and when it is not
- * found at all. For field existence checks, use #elem_exists() instead.
+ * Returns the byte offset of the specified field within the struct format pointed to by old,
+ * or -1 if no such field can be found.
  *
  * \param sdna: Old SDNA
  * \param type: Current field type name
  * \param name: Current field name
  * \param old: Pointer to struct information in sdna
- * \param olddata: Struct data
  * \param sppo: Optional place to return pointer to field info in sdna
- * \return Data address.
+ * \return Offset of the field.
  */
-static const char *find_elem(const SDNA *sdna,
-                             const char *type,
-                             const char *name,
-                             const short *old,
-                             const char *olddata,
-                             const short **sppo)
+static int find_elem_offset(
+    const SDNA *sdna, const char *type, const char *name, const short *old, const short **sppo)
 {
   int a, elemcount, len;
   const char *otype, *oname;
+  int offset = 0;
 
   /* without arraypart, so names can differ: return old namenr and type */
 
@@ -1073,36 +1062,297 @@ static const char *find_elem(const SDNA *sdna,
         if (sppo) {
           *sppo = old;
         }
-        return olddata;
+        return offset;
       }
 
-      return NULL;
+      return -1;
     }
 
-    olddata += len;
+    offset += len;
   }
-  return NULL;
+  return -1;
 }
 
 /**
- * Converts the contents of a single field of a struct, of a non-struct type,
- * from \a oldsdna to \a newsdna format.
+ * Returns the address of the data for the specified field within olddata
+ * according to the struct format pointed to by old, or NULL if no such
+ * field can be found.
  *
- * \param newsdna: SDNA of current Blender
- * \param oldsdna: SDNA of Blender that saved file
- * \param type: current field type name
- * \param new_name_nr: current field name number.
- * \param curdata: put field data converted to newsdna here
- * \param old: pointer to struct info in oldsdna
- * \param olddata: struct contents laid out according to oldsdna
+ * Passing olddata=NULL doesn't work reliably for existence checks; it will
+ * return NULL both when the field is found at offset 0 and when it is not
+ * found at all. For field existence checks, use #elem_exists() instead.
+ *
+ * \param sdna: Old SDNA
+ * \param type: Current field type name
+ * \param name: Current field name
+ * \param old: Pointer to struct information in sdna
+ * \param olddata: Struct data
+ * \param sppo: Optional place to return pointer to field info in sdna
+ * \return Data address.
  */
-static void reconstruct_elem(const SDNA *newsdna,
-                             const SDNA *oldsdna,
+static const char *find_elem(const SDNA *sdna,
                              const char *type,
-                             const int new_name_nr,
-                             char *curdata,
+                             const char *name,
                              const short *old,
-                             const char *olddata)
+                             const char *olddata,
+                             const short **sppo)
+{
+  const int offset = find_elem_offset(sdna, type, name, old, sppo);
+  if (offset == -1) {
+    return NULL;
+  }
+  return olddata + offset;
+}
+
+/**
+ * Does endian swapping on the fields of a struct value.
+ *
+ * \param oldsdna: SDNA of Blender that saved file
+ * \param oldSDNAnr: Index of struct info within oldsdna
+ * \param data: Struct data
+ */
+void DNA_struct_switch_endian(const SDNA *oldsdna, int oldSDNAnr, char *data)
+{
+  /* Recursive!
+   * If element is a struct, call recursive.
+   */
+  int a, mul, elemcount, elen, elena, firststructtypenr;
+  const short *spo, *spc;
+  char *cur;
+  const char *type, *name;
+  unsigned int oldsdna_index_last = UINT_MAX;
+
+  if (oldSDNAnr == -1) {
+    return;
+  }
+  firststructtypenr = *(oldsdna->structs[0]);
+
+  spo = spc = oldsdna->structs[oldSDNAnr];
+
+  elemcount = spo[1];
+
+  spc += 2;
+  cur = data;
+
+  for (a = 0; a < elemcount; a++, spc += 2) {
+    type = oldsdna->types[spc[0]];
+    name = oldsdna->names[spc[1]];
+    const int old_name_array_len = oldsdna->names_array_len[spc[1]];
+
+    /* DNA_elem_size_nr = including arraysize */
+    elen = DNA_elem_size_nr(oldsdna, spc[0], spc[1]);
+
+    /* test: is type a struct? */
+    if (spc[0] >= firststructtypenr && !ispointer(name)) {
+      /* struct field type */
+      /* where does the old data start (is there one?) */
+      char *cpo = (char *)find_elem(oldsdna, type, name, spo, data, NULL);
+      if (cpo) {
+        oldSDNAnr = DNA_struct_find_nr_ex(oldsdna, type, &oldsdna_index_last);
+
+        mul = old_name_array_len;
+        elena = elen / mul;
+
+        while (mul--) {
+          DNA_struct_switch_endian(oldsdna, oldSDNAnr, cpo);
+          cpo += elena;
+        }
+      }
+    }
+    else {
+      /* non-struct field type */
+      if (ispointer(name)) {
+        if (oldsdna->pointer_size == 8) {
+          BLI_endian_switch_int64_array((int64_t *)cur, old_name_array_len);
+        }
+      }
+      else {
+        if (ELEM(spc[0], SDNA_TYPE_SHORT, SDNA_TYPE_USHORT)) {
+
+          /* exception: variable called blocktype: derived from ID_  */
+          bool skip = false;
+          if (name[0] == 'b' && name[1] == 'l') {
+            if (STREQ(name, "blocktype")) {
+              skip = true;
+            }
+          }
+
+          if (skip == false) {
+            BLI_endian_switch_int16_array((int16_t *)cur, old_name_array_len);
+          }
+        }
+        else if (ELEM(spc[0], SDNA_TYPE_INT, SDNA_TYPE_FLOAT)) {
+          /* note, intentionally ignore long/ulong here these could be 4 or 8 bits,
+           * but turns out we only used for runtime vars and
+           * only once for a struct type that's no longer used. */
+
+          BLI_endian_switch_int32_array((int32_t *)cur, old_name_array_len);
+        }
+        else if (ELEM(spc[0], SDNA_TYPE_INT64, SDNA_TYPE_UINT64, SDNA_TYPE_DOUBLE)) {
+          BLI_endian_switch_int64_array((int64_t *)cur, old_name_array_len);
+        }
+      }
+    }
+    cur += elen;
+  }
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Struct Reconstruction
+ *
+ * Converting a struct from the SDNA of the file to the current SDNA requires looking up each
+ * member of the current struct in the old struct. Instead of doing that for every struct that is
+ * read, the conversion is compiled into a flat list of steps once per struct type,
+ * so reconstructing an instance only has to run those steps.
+ * \{ */
+
+typedef enum eReconstructStepType {
+  /** Copy bytes unchanged, adjacent copies are merged into one step. */
+  RECONSTRUCT_STEP_MEMCPY = 0,
+  /** Convert an array of primitive values to another primitive type. */
+  RECONSTRUCT_STEP_CAST_PRIMITIVE = 1,
+  /** Convert an array of pointers to a different pointer size. */
+  RECONSTRUCT_STEP_CAST_POINTER = 2,
+  /** Reconstruct an array of nested structs which changed. */
+  RECONSTRUCT_STEP_SUBSTRUCT = 3,
+} eReconstructStepType;
+
+typedef struct ReconstructStep {
+  eReconstructStepType type;
+  /** Offset of the member in the old and the new struct. */
+  int old_offset;
+  int new_offset;
+  union {
+    struct {
+      int size;
+    } copy;
+    struct {
+      eSDNA_Type old_type;
+      eSDNA_Type new_type;
+      int array_len;
+    } cast_primitive;
+    struct {
+      int array_len;
+    } cast_pointer;
+    struct {
+      int old_struct_nr;
+      int array_len;
+      int old_stride;
+      int new_stride;
+    } substruct;
+  } data;
+} ReconstructStep;
+
+typedef struct DNA_ReconstructInfo {
+  const SDNA *oldsdna;
+  const SDNA *newsdna;
+
+  /** Index of the matching struct in `newsdna` for every struct in `oldsdna`, or -1. */
+  int *new_struct_nrs;
+  /** Steps for every struct in `oldsdna`, `steps_len` is -1 while not compiled yet. */
+  ReconstructStep **steps;
+  int *steps_len;
+
+  /** Storage for all steps. */
+  MemArena *memarena;
+} DNA_ReconstructInfo;
+
+/** Growing array of steps, only used while compiling. */
+typedef struct ReconstructStepList {
+  ReconstructStep *steps;
+  int steps_len;
+  int steps_len_alloc;
+} ReconstructStepList;
+
+static ReconstructStep *reconstruct_steps_add(ReconstructStepList *list,
+                                              const eReconstructStepType type,
+                                              const int old_offset,
+                                              const int new_offset)
+{
+  if (list->steps_len == list->steps_len_alloc) {
+    list->steps_len_alloc = list->steps_len_alloc ? list->steps_len_alloc * 2 : 64;
+    list->steps = MEM_reallocN(list->steps, sizeof(*list->steps) * list->steps_len_alloc);
+  }
+  ReconstructStep *step = &list->steps[list->steps_len++];
+  step->type = type;
+  step->old_offset = old_offset;
+  step->new_offset = new_offset;
+  return step;
+}
+
+static void reconstruct_steps_add_memcpy(ReconstructStepList *list,
+                                         const int old_offset,
+                                         const int new_offset,
+                                         const int size)
+{
+  if (size <= 0) {
+    return;
+  }
+  if (list->steps_len != 0) {
+    /* Members which are unchanged and adjacent in both structs are copied at once. */
+    ReconstructStep *step_prev = &list->steps[list->steps_len - 1];
+    if (step_prev->type == RECONSTRUCT_STEP_MEMCPY &&
+        step_prev->old_offset + step_prev->data.copy.size == old_offset &&
+        step_prev->new_offset + step_prev->data.copy.size == new_offset) {
+      step_prev->data.copy.size += size;
+      return;
+    }
+  }
+  ReconstructStep *step = reconstruct_steps_add(
+      list, RECONSTRUCT_STEP_MEMCPY, old_offset, new_offset);
+  step->data.copy.size = size;
+}
+
+static void reconstruct_steps_add_cast_pointer(const DNA_ReconstructInfo *info,
+                                               ReconstructStepList *list,
+                                               const int old_offset,
+                                               const int new_offset,
+                                               const int array_len)
+{
+  if (info->newsdna->pointer_size == info->oldsdna->pointer_size) {
+    reconstruct_steps_add_memcpy(
+        list, old_offset, new_offset, info->newsdna->pointer_size * array_len);
+  }
+  else {
+    ReconstructStep *step = reconstruct_steps_add(
+        list, RECONSTRUCT_STEP_CAST_POINTER, old_offset, new_offset);
+    step->data.cast_pointer.array_len = array_len;
+  }
+}
+
+static void reconstruct_steps_add_cast_primitive(ReconstructStepList *list,
+                                                 const int old_offset,
+                                                 const int new_offset,
+                                                 const char *otype,
+                                                 const char *ctype,
+                                                 const int array_len)
+{
+  const eSDNA_Type otypenr = sdna_type_nr(otype);
+  const eSDNA_Type ctypenr = sdna_type_nr(ctype);
+  if (otypenr == -1 || ctypenr == -1) {
+    return;
+  }
+  ReconstructStep *step = reconstruct_steps_add(
+      list, RECONSTRUCT_STEP_CAST_PRIMITIVE, old_offset, new_offset);
+  step->data.cast_primitive.old_type = otypenr;
+  step->data.cast_primitive.new_type = ctypenr;
+  step->data.cast_primitive.array_len = array_len;
+}
+
+/**
+ * Adds the steps to convert a single member of a struct, of a non-struct type.
+ *
+ * \param type: Current member type name.
+ * \param new_name_nr: Current member name number.
+ * \param new_offset: Offset of the member in the current struct.
+ * \param old: Pointer to struct info in oldsdna.
+ */
+static void reconstruct_compile_elem(const DNA_ReconstructInfo *info,
+                                     ReconstructStepList *list,
+                                     const char *type,
+                                     const int new_name_nr,
+                                     const int new_offset,
+                                     const short *old)
 {
   /* rules: test for NAME:
    *      - name equal:
@@ -1110,10 +1360,10 @@ static void reconstruct_elem(const SDNA *newsdna,
    *      - name partially equal (array differs)
    *          - type equal: memcpy
    *          - type cast (per element).
-   * (nzc 2-4-2001 I want the 'unsigned' bit to be parsed as well. Where
-   * can I force this?)
    */
-  int a, elemcount, len, countpos, mul;
+  const SDNA *newsdna = info->newsdna;
+  const SDNA *oldsdna = info->oldsdna;
+  int a, elemcount, len, countpos;
   const char *otype, *oname, *cp;
 
   /* is 'name' an array? */
@@ -1129,6 +1379,7 @@ static void reconstruct_elem(const SDNA *newsdna,
   }
 
   /* in old is the old struct */
+  int old_offset = 0;
   elemcount = old[1];
   old += 2;
   for (a = 0; a < elemcount; a++, old += 2) {
@@ -1138,19 +1389,18 @@ static void reconstruct_elem(const SDNA *newsdna,
     len = DNA_elem_size_nr(oldsdna, old[0], old[1]);
 
     if (STREQ(name, oname)) { /* name equal */
+      const int new_name_array_len = newsdna->names_array_len[new_name_nr];
 
-      if (ispointer(name)) { /* pointer of functionpointer afhandelen */
-        cast_pointer(newsdna->pointer_size,
-                     oldsdna->pointer_size,
-                     newsdna->names_array_len[new_name_nr],
-                     curdata,
-                     olddata);
+      if (ispointer(name)) { /* handle pointer or functionpointer */
+        reconstruct_steps_add_cast_pointer(
+            info, list, old_offset, new_offset, new_name_array_len);
       }
       else if (STREQ(type, otype)) { /* type equal */
-        memcpy(curdata, olddata, len);
+        reconstruct_steps_add_memcpy(list, old_offset, new_offset, len);
       }
       else {
-        cast_elem(type, otype, newsdna->names_array_len[new_name_nr], curdata, olddata);
+        reconstruct_steps_add_cast_primitive(
+            list, old_offset, new_offset, otype, type, new_name_array_len);
       }
 
       return;
@@ -1163,292 +1413,319 @@ static void reconstruct_elem(const SDNA *newsdna,
         const int min_name_array_len = MIN2(new_name_array_len, old_name_array_len);
 
         if (ispointer(name)) { /* handle pointer or functionpointer */
-          cast_pointer(
-              newsdna->pointer_size, oldsdna->pointer_size, min_name_array_len, curdata, olddata);
+          reconstruct_steps_add_cast_pointer(
+              info, list, old_offset, new_offset, min_name_array_len);
         }
         else if (STREQ(type, otype)) { /* type equal */
           /* size of single old array element */
-          mul = len / old_name_array_len;
+          int mul = len / old_name_array_len;
           /* smaller of sizes of old and new arrays */
           mul *= min_name_array_len;
 
-          memcpy(curdata, olddata, mul);
-
           if (old_name_array_len > new_name_array_len && STREQ(type, "char")) {
-            /* string had to be truncated, ensure it's still null-terminated */
-            curdata[mul - 1] = '\0';
+            /* String has to be truncated, leave out the last byte so it stays null-terminated
+             * (the reconstructed struct is zero initialized). */
+            mul -= 1;
           }
+          reconstruct_steps_add_memcpy(list, old_offset, new_offset, mul);
         }
         else {
-          cast_elem(type, otype, min_name_array_len, curdata, olddata);
+          reconstruct_steps_add_cast_primitive(
+              list, old_offset, new_offset, otype, type, min_name_array_len);
         }
         return;
       }
     }
-    olddata += len;
+    old_offset += len;
   }
 }
 
+static void reconstruct_compile_struct(DNA_ReconstructInfo *info,
+                                       const char *compflags,
+                                       const int old_struct_nr);
+
 /**
- * Converts the contents of an entire struct from oldsdna to newsdna format.
- *
- * \param newsdna: SDNA of current Blender
- * \param oldsdna: SDNA of Blender that saved file
- * \param compflags:
- *
- * Result from DNA_struct_get_compareflags to avoid needless conversions.
- * \param oldSDNAnr: Index of old struct definition in oldsdna
- * \param data: Struct contents laid out according to oldsdna
- * \param curSDNAnr: Index of current struct definition in newsdna
- * \param cur: Where to put converted struct contents
+ * Adds the steps to convert a member of a struct type.
+ * Nested structs which are not arrays are inlined into the steps of the parent struct.
  */
-static void reconstruct_struct(const SDNA *newsdna,
-                               const SDNA *oldsdna,
-                               const char *compflags,
-
-                               int oldSDNAnr,
-                               const char *data,
-                               int curSDNAnr,
-                               char *cur)
+static void reconstruct_compile_substruct(DNA_ReconstructInfo *info,
+                                          const char *compflags,
+                                          ReconstructStepList *list,
+                                          const short *spc,
+                                          const int new_offset,
+                                          const short *spo)
 {
-  /* Recursive!
-   * Per element from cur_struct, read data from old_struct.
-   * If element is a struct, call recursive.
-   */
-  int a, elemcount, elen, eleno, mul, mulo, firststructtypenr;
-  const short *spo, *spc, *sppo;
-  const char *type;
-  const char *cpo;
-  char *cpc;
-  const char *name;
-
-  unsigned int oldsdna_index_last = UINT_MAX;
-  unsigned int cursdna_index_last = UINT_MAX;
-
-  if (oldSDNAnr == -1) {
+  const SDNA *newsdna = info->newsdna;
+  const SDNA *oldsdna = info->oldsdna;
+  const char *type = newsdna->types[spc[0]];
+  const char *name = newsdna->names[spc[1]];
+
+  /* where does the old struct data start (and is there an old one?) */
+  const short *sppo = NULL;
+  const int old_offset = find_elem_offset(oldsdna, type, name, spo, &sppo);
+  if (old_offset == -1) {
+    /* skip field no longer present */
     return;
   }
-  if (curSDNAnr == -1) {
+
+  const int old_struct_nr = DNA_struct_find_nr(oldsdna, type);
+  if (old_struct_nr == -1 || info->new_struct_nrs[old_struct_nr] == -1) {
     return;
   }
 
-  if (compflags[oldSDNAnr] == SDNA_CMP_EQUAL) {
-    /* if recursive: test for equal */
-    spo = oldsdna->structs[oldSDNAnr];
-    elen = oldsdna->types_size[spo[0]];
-    memcpy(cur, data, elen);
+  /* array! */
+  const int mul = newsdna->names_array_len[spc[1]];
+  const int mulo = oldsdna->names_array_len[sppo[1]];
+  const int new_stride = DNA_elem_size_nr(newsdna, spc[0], spc[1]) / mul;
+  const int old_stride = DNA_elem_size_nr(oldsdna, sppo[0], sppo[1]) / mulo;
+  /* new struct array may be larger than old */
+  const int array_len = MIN2(mul, mulo);
 
+  if (compflags[old_struct_nr] == SDNA_CMP_EQUAL) {
+    reconstruct_steps_add_memcpy(list, old_offset, new_offset, old_stride * array_len);
     return;
   }
 
-  firststructtypenr = *(newsdna->structs[0]);
-
-  spo = oldsdna->structs[oldSDNAnr];
-  spc = newsdna->structs[curSDNAnr];
-
-  elemcount = spc[1];
-
-  spc += 2;
-  cpc = cur;
-  for (a = 0; a < elemcount; a++, spc += 2) { /* convert each field */
-    type = newsdna->types[spc[0]];
-    name = newsdna->names[spc[1]];
-
-    elen = DNA_elem_size_nr(newsdna, spc[0], spc[1]);
-
-    /* Skip pad bytes which must start with '_pad', see makesdna.c 'is_name_legal'.
-     * for exact rules. Note that if we fail to skip a pad byte it's harmless,
-     * this just avoids unnecessary reconstruction. */
-    if (name[0] == '_' || (name[0] == '*' && name[1] == '_')) {
-      cpc += elen;
-    }
-    else if (spc[0] >= firststructtypenr && !ispointer(name)) {
-      /* struct field type */
+  reconstruct_compile_struct(info, compflags, old_struct_nr);
 
-      /* where does the old struct data start (and is there an old one?) */
-      cpo = (char *)find_elem(oldsdna, type, name, spo, data, &sppo);
-
-      if (cpo) {
-        oldSDNAnr = DNA_struct_find_nr_ex(oldsdna, type, &oldsdna_index_last);
-        curSDNAnr = DNA_struct_find_nr_ex(newsdna, type, &cursdna_index_last);
-
-        /* array! */
-        mul = newsdna->names_array_len[spc[1]];
-        mulo = oldsdna->names_array_len[sppo[1]];
-
-        eleno = DNA_elem_size_nr(oldsdna, sppo[0], sppo[1]);
-
-        elen /= mul;
-        eleno /= mulo;
-
-        while (mul--) {
-          reconstruct_struct(newsdna, oldsdna, compflags, oldSDNAnr, cpo, curSDNAnr, cpc);
-          cpo += eleno;
-          cpc += elen;
-
-          /* new struct array larger than old */
-          mulo--;
-          if (mulo <= 0) {
-            break;
-          }
-        }
+  if (array_len == 1) {
+    const ReconstructStep *sub_steps = info->steps[old_struct_nr];
+    const int sub_steps_len = info->steps_len[old_struct_nr];
+    for (int a = 0; a < sub_steps_len; a++) {
+      const ReconstructStep *sub_step = &sub_steps[a];
+      if (sub_step->type == RECONSTRUCT_STEP_MEMCPY) {
+        reconstruct_steps_add_memcpy(list,
+                                     old_offset + sub_step->old_offset,
+                                     new_offset + sub_step->new_offset,
+                                     sub_step->data.copy.size);
       }
       else {
-        cpc += elen; /* skip field no longer present */
+        ReconstructStep *step = reconstruct_steps_add(list,
+                                                      sub_step->type,
+                                                      old_offset + sub_step->old_offset,
+                                                      new_offset + sub_step->new_offset);
+        step->data = sub_step->data;
       }
     }
-    else {
-      /* non-struct field type */
-      reconstruct_elem(newsdna, oldsdna, type, spc[1], cpc, spo, data);
-      cpc += elen;
-    }
+  }
+  else {
+    ReconstructStep *step = reconstruct_steps_add(
+        list, RECONSTRUCT_STEP_SUBSTRUCT, old_offset, new_offset);
+    step->data.substruct.old_struct_nr = old_struct_nr;
+    step->data.substruct.array_len = array_len;
+    step->data.substruct.old_stride = old_stride;
+    step->data.substruct.new_stride = new_stride;
   }
 }
 
 /**
- * Does endian swapping on the fields of a struct value.
- *
- * \param oldsdna: SDNA of Blender that saved file
- * \param oldSDNAnr: Index of struct info within oldsdna
- * \param data: Struct data
+ * Compiles the steps to convert the struct \a old_struct_nr from oldsdna to newsdna format,
+ * including the structs nested in it.
  */
-void DNA_struct_switch_endian(const SDNA *oldsdna, int oldSDNAnr, char *data)
+static void reconstruct_compile_struct(DNA_ReconstructInfo *info,
+                                       const char *compflags,
+                                       const int old_struct_nr)
 {
-  /* Recursive!
-   * If element is a struct, call recursive.
-   */
-  int a, mul, elemcount, elen, elena, firststructtypenr;
-  const short *spo, *spc;
-  char *cur;
-  const char *type, *name;
-  unsigned int oldsdna_index_last = UINT_MAX;
-
-  if (oldSDNAnr == -1) {
+  if (info->steps_len[old_struct_nr] != -1) {
+    return;
+  }
+  const int new_struct_nr = info->new_struct_nrs[old_struct_nr];
+  if (new_struct_nr == -1) {
+    info->steps_len[old_struct_nr] = 0;
     return;
   }
-  firststructtypenr = *(oldsdna->structs[0]);
 
-  spo = spc = oldsdna->structs[oldSDNAnr];
+  const SDNA *newsdna = info->newsdna;
+  const SDNA *oldsdna = info->oldsdna;
+  const short *spo = oldsdna->structs[old_struct_nr];
+  const short *spc = newsdna->structs[new_struct_nr];
+  ReconstructStepList list = {NULL};
 
-  elemcount = spo[1];
+  if (compflags[old_struct_nr] == SDNA_CMP_EQUAL) {
+    reconstruct_steps_add_memcpy(&list, 0, 0, oldsdna->types_size[spo[0]]);
+  }
+  else {
+    const int firststructtypenr = *(newsdna->structs[0]);
+    const int elemcount = spc[1];
+    int new_offset = 0;
+
+    spc += 2;
+    for (int a = 0; a < elemcount; a++, spc += 2) { /* convert each field */
+      const char *name = newsdna->names[spc[1]];
+      const int elen = DNA_elem_size_nr(newsdna, spc[0], spc[1]);
+
+      /* Skip pad bytes which must start with '_pad', see makesdna.c 'is_name_legal'.
+       * for exact rules. Note that if we fail to skip a pad byte it's harmless,
+       * this just avoids unnecessary reconstruction. */
+      if (name[0] == '_' || (name[0] == '*' && name[1] == '_')) {
+        /* pass */
+      }
+      else if (spc[0] >= firststructtypenr && !ispointer(name)) {
+        /* struct field type */
+        reconstruct_compile_substruct(info, compflags, &list, spc, new_offset, spo);
+      }
+      else {
+        /* non-struct field type */
+        reconstruct_compile_elem(info, &list, newsdna->types[spc[0]], spc[1], new_offset, spo);
+      }
+      new_offset += elen;
+    }
+  }
 
-  spc += 2;
-  cur = data;
+  if (list.steps_len != 0) {
+    const size_t steps_size = sizeof(*list.steps) * list.steps_len;
+    info->steps[old_struct_nr] = BLI_memarena_alloc(info->memarena, steps_size);
+    memcpy(info->steps[old_struct_nr], list.steps, steps_size);
+    MEM_freeN(list.steps);
+  }
+  info->steps_len[old_struct_nr] = list.steps_len;
+}
 
-  for (a = 0; a < elemcount; a++, spc += 2) {
-    type = oldsdna->types[spc[0]];
-    name = oldsdna->names[spc[1]];
-    const int old_name_array_len = oldsdna->names_array_len[spc[1]];
+/**
+ * Prepares the conversion of all structs from \a oldsdna to \a newsdna format.
+ * The result is read-only afterwards, so it can be used from multiple threads.
+ *
+ * \param compflags: Result from #DNA_struct_get_compareflags to avoid needless conversions.
+ */
+DNA_ReconstructInfo *DNA_reconstruct_info_create(const SDNA *oldsdna,
+                                                 const SDNA *newsdna,
+                                                 const char *compflags)
+{
+  DNA_ReconstructInfo *info = MEM_callocN(sizeof(*info), __func__);
+  info->oldsdna = oldsdna;
+  info->newsdna = newsdna;
+  info->new_struct_nrs = MEM_mallocN(sizeof(*info->new_struct_nrs) * oldsdna->structs_len,
+                                     __func__);
+  info->steps = MEM_callocN(sizeof(*info->steps) * oldsdna->structs_len, __func__);
+  info->steps_len = MEM_mallocN(sizeof(*info->steps_len) * oldsdna->structs_len, __func__);
+  info->memarena = BLI_memarena_new(BLI_MEMARENA_STD_BUFSIZE, __func__);
 
-    /* DNA_elem_size_nr = including arraysize */
-    elen = DNA_elem_size_nr(oldsdna, spc[0], spc[1]);
+  unsigned int newsdna_index_last = UINT_MAX;
+  for (int a = 0; a < oldsdna->structs_len; a++) {
+    const short *spo = oldsdna->structs[a];
+    info->new_struct_nrs[a] = DNA_struct_find_nr_ex(
+        newsdna, oldsdna->types[spo[0]], &newsdna_index_last);
+    info->steps_len[a] = -1;
+  }
 
-    /* test: is type a struct? */
-    if (spc[0] >= firststructtypenr && !ispointer(name)) {
-      /* struct field type */
-      /* where does the old data start (is there one?) */
-      char *cpo = (char *)find_elem(oldsdna, type, name, spo, data, NULL);
-      if (cpo) {
-        oldSDNAnr = DNA_struct_find_nr_ex(oldsdna, type, &oldsdna_index_last);
+  for (int a = 0; a < oldsdna->structs_len; a++) {
+    reconstruct_compile_struct(info, compflags, a);
+  }
 
-        mul = old_name_array_len;
-        elena = elen / mul;
+  return info;
+}
 
-        while (mul--) {
-          DNA_struct_switch_endian(oldsdna, oldSDNAnr, cpo);
-          cpo += elena;
-        }
-      }
-    }
-    else {
-      /* non-struct field type */
-      if (ispointer(name)) {
-        if (oldsdna->pointer_size == 8) {
-          BLI_endian_switch_int64_array((int64_t *)cur, old_name_array_len);
-        }
-      }
-      else {
-        if (ELEM(spc[0], SDNA_TYPE_SHORT, SDNA_TYPE_USHORT)) {
+void DNA_reconstruct_info_free(DNA_ReconstructInfo *info)
+{
+  BLI_memarena_free(info->memarena);
+  MEM_freeN(info->new_struct_nrs);
+  MEM_freeN(info->steps);
+  MEM_freeN(info->steps_len);
+  MEM_freeN(info);
+}
 
-          /* exception: variable called blocktype: derived from ID_  */
-          bool skip = false;
-          if (name[0] == 'b' && name[1] == 'l') {
-            if (STREQ(name, "blocktype")) {
-              skip = true;
-            }
-          }
+/**
+ * Converts the contents of an entire struct from oldsdna to newsdna format,
+ * \a new_data is expected to be zero initialized.
+ */
+static void reconstruct_struct(const DNA_ReconstructInfo *info,
+                               const int old_struct_nr,
+                               const char *old_data,
+                               char *new_data)
+{
+  const ReconstructStep *steps = info->steps[old_struct_nr];
+  const int steps_len = info->steps_len[old_struct_nr];
 
-          if (skip == false) {
-            BLI_endian_switch_int16_array((int16_t *)cur, old_name_array_len);
-          }
-        }
-        else if (ELEM(spc[0], SDNA_TYPE_INT, SDNA_TYPE_FLOAT)) {
-          /* note, intentionally ignore long/ulong here these could be 4 or 8 bits,
-           * but turns out we only used for runtime vars and
-           * only once for a struct type that's no longer used. */
+  for (int a = 0; a < steps_len; a++) {
+    const ReconstructStep *step = &steps[a];
+    const char *cpo = old_data + step->old_offset;
+    char *cpc = new_data + step->new_offset;
 
-          BLI_endian_switch_int32_array((int32_t *)cur, old_name_array_len);
-        }
-        else if (ELEM(spc[0], SDNA_TYPE_INT64, SDNA_TYPE_UINT64, SDNA_TYPE_DOUBLE)) {
-          BLI_endian_switch_int64_array((int64_t *)cur, old_name_array_len);
+    switch (step->type) {
+      case RECONSTRUCT_STEP_MEMCPY:
+        memcpy(cpc, cpo, step->data.copy.size);
+        break;
+      case RECONSTRUCT_STEP_CAST_PRIMITIVE:
+        cast_elem(step->data.cast_primitive.new_type,
+                  step->data.cast_primitive.old_type,
+                  step->data.cast_primitive.array_len,
+                  cpc,
+                  cpo);
+        break;
+      case RECONSTRUCT_STEP_CAST_POINTER:
+        cast_pointer(info->newsdna->pointer_size,
+                     info->oldsdna->pointer_size,
+                     step->data.cast_pointer.array_len,
+                     cpc,
+                     cpo);
+        break;
+      case RECONSTRUCT_STEP_SUBSTRUCT:
+        for (int i = 0; i < step->data.substruct.array_len; i++) {
+          reconstruct_struct(info, step->data.substruct.old_struct_nr, cpo, cpc);
+          cpo += step->data.substruct.old_stride;
+          cpc += step->data.substruct.new_stride;
         }
-      }
+        break;
     }
-    cur += elen;
   }
 }
 
 /**
- * \param newsdna: SDNA of current Blender
- * \param oldsdna: SDNA of Blender that saved file
- * \param compflags:
- *
- * Result from DNA_struct_get_compareflags to avoid needless conversions
- * \param oldSDNAnr: Index of struct info within oldsdna
+ * \param reconstruct_info: Result from #DNA_reconstruct_info_create.
+ * \param old_struct_nr: Index of struct info within oldsdna
  * \param blocks: The number of array elements
- * \param data: Array of struct data
+ * \param old_blocks: Array of struct data
  * \return An allocated reconstructed struct
  */
-void *DNA_struct_reconstruct(const SDNA *newsdna,
-                             const SDNA *oldsdna,
-                             const char *compflags,
-                             int oldSDNAnr,
+void *DNA_struct_reconstruct(const DNA_ReconstructInfo *reconstruct_info,
+                             int old_struct_nr,
                              int blocks,
-                             const void *data)
+                             const void *old_blocks)
 {
-  int a, curSDNAnr, curlen = 0, oldlen;
-  const short *spo, *spc;
-  char *cur, *cpc;
-  const char *cpo;
-  const char *type;
-
-  /* oldSDNAnr == structnr, we're looking for the corresponding 'cur' number */
-  spo = oldsdna->structs[oldSDNAnr];
-  type = oldsdna->types[spo[0]];
-  oldlen = oldsdna->types_size[spo[0]];
-  curSDNAnr = DNA_struct_find_nr(newsdna, type);
-
-  /* init data and alloc */
-  if (curSDNAnr != -1) {
-    spc = newsdna->structs[curSDNAnr];
-    curlen = newsdna->types_size[spc[0]];
-  }
-  if (curlen == 0) {
+  const SDNA *oldsdna = reconstruct_info->oldsdna;
+  const SDNA *newsdna = reconstruct_info->newsdna;
+  const int new_struct_nr = reconstruct_info->new_struct_nrs[old_struct_nr];
+
+  if (new_struct_nr == -1) {
+    return NULL;
+  }
+  const int old_block_size = oldsdna->types_size[oldsdna->structs[old_struct_nr][0]];
+  const int new_block_size = newsdna->types_size[newsdna->structs[new_struct_nr][0]];
+  if (new_block_size == 0) {
     return NULL;
   }
 
-  cur = MEM_callocN(blocks * curlen, "reconstruct");
-  cpc = cur;
-  cpo = data;
-  for (a = 0; a < blocks; a++) {
-    reconstruct_struct(newsdna, oldsdna, compflags, oldSDNAnr, cpo, curSDNAnr, cpc);
-    cpc += curlen;
-    cpo += oldlen;
+  char *new_blocks = MEM_callocN(blocks * new_block_size, "reconstruct");
+  const char *cpo = old_blocks;
+  char *cpc = new_blocks;
+
+  const ReconstructStep *steps = reconstruct_info->steps[old_struct_nr];
+  if (reconstruct_info->steps_len[old_struct_nr] == 1 &&
+      steps[0].type == RECONSTRUCT_STEP_MEMCPY) {
+    /* Common case of members only being added or removed at the end of the struct,
+     * only the shared part has to be copied. */
+    const int old_offset = steps[0].old_offset;
+    const int new_offset = steps[0].new_offset;
+    const int size = steps[0].data.copy.size;
+    for (int a = 0; a < blocks; a++) {
+      memcpy(cpc + new_offset, cpo + old_offset, size);
+      cpc += new_block_size;
+      cpo += old_block_size;
+    }
+  }
+  else {
+    for (int a = 0; a < blocks; a++) {
+      reconstruct_struct(reconstruct_info, old_struct_nr, cpo, cpc);
+      cpc += new_block_size;
+      cpo += old_block_size;
+    }
   }
 
-  return cur;
+  return new_blocks;
 }
 
+/** \} */
+
 /**
  * Returns the offset of the field with the specified name and type within the specified
  * struct type in sdna.
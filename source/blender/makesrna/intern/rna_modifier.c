@@ -7137,6 +7137,17 @@ void RNA_def_modifier(BlenderRNA *brna)
   RNA_def_property_ui_icon(prop, ICON_SURFACE_DATA, 0);
   RNA_def_property_update(prop, 0, "rna_Modifier_update");
 
+  prop = RNA_def_property(srna, "use_cache_result", PROP_BOOLEAN, PROP_NONE);
+  RNA_def_property_boolean_sdna(prop, NULL, "flag", eModifierFlag_CacheResult);
+  RNA_def_property_ui_text(prop,
+                           "Cache Result",
+                           "Keep the result of the stack up to this modifier, so that changes to "
+                           "the following modifiers don't evaluate it again. Only used when this "
+                           "and the preceding modifiers don't change over time and don't use "
+                           "other data-blocks, except for the objects used by Boolean, Array "
+                           "and Mirror modifiers");
+  RNA_def_property_update(prop, 0, "rna_Modifier_update");
+
   /* types */
   rna_def_modifier_subsurf(brna);
   rna_def_modifier_lattice(brna);
@@ -257,6 +257,12 @@ static void modifier_ops_extra_draw(bContext *C, uiLayout *layout, void *md_v)
             "OBJECT_OT_modifier_copy");
   }
 
+  /* Cache result, deform modifiers are cheap to evaluate again. */
+  if (ob->type == OB_MESH &&
+      BKE_modifier_get_info(md->type)->type != eModifierTypeType_OnlyDeform) {
+    uiItemR(layout, &ptr, "use_cache_result", 0, NULL, ICON_NONE);
+  }
+
   uiItemS(layout);
 
   /* Move to first. */
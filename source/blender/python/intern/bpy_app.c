@@ -43,6 +43,7 @@
 
 /* modules */
 #include "bpy_app_icons.h"
+#include "bpy_app_memory.h"
 #include "bpy_app_timers.h"
 
 #include "BLI_utildefines.h"
@@ -121,6 +122,7 @@ static PyStructSequence_Field app_info_fields[] = {
 
     /* Modules (not struct sequence). */
     {"icons", "Manage custom icons"},
+    {"memory", "Memory accounting of the allocator"},
     {"timers", "Manage timers"},
     {NULL},
 };
@@ -135,6 +137,7 @@ PyDoc_STRVAR(bpy_app_doc,
              "\n"
              "   bpy.app.handlers.rst\n"
              "   bpy.app.icons.rst\n"
+             "   bpy.app.memory.rst\n"
              "   bpy.app.timers.rst\n"
              "   bpy.app.translations.rst\n");
 
@@ -215,6 +218,7 @@ static PyObject *make_app_info(void)
 
   /* modules */
   SetObjItem(BPY_app_icons_module());
+  SetObjItem(BPY_app_memory_module());
   SetObjItem(BPY_app_timers_module());
 
 #undef SetIntItem
@@ -0,0 +1,207 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup pythonintern
+ *
+ * Memory accounting of the allocator, see #MEM_enable_memory_accounting.
+ */
+
+#include <Python.h>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_utildefines.h"
+
+#include "../generic/python_utildefines.h"
+
+#include "bpy_app_memory.h"
+
+PyDoc_STRVAR(bpy_app_memory_enable_accounting_doc,
+             ".. function:: enable_accounting()\n"
+             "\n"
+             "   Start keeping track of memory by allocation name, memory allocated before is not "
+             "counted.\n"
+             "   Use the ``--debug-memory-accounting`` command line argument to count all memory.\n"
+             "   Has no effect when Blender runs with ``--debug-memory``.\n");
+static PyObject *bpy_app_memory_enable_accounting(PyObject *UNUSED(self))
+{
+  MEM_enable_memory_accounting();
+  Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(bpy_app_memory_is_accounting_enabled_doc,
+             ".. function:: is_accounting_enabled()\n"
+             "\n"
+             "   :return: True when memory is counted by allocation name.\n"
+             "   :rtype: bool\n");
+static PyObject *bpy_app_memory_is_accounting_enabled(PyObject *UNUSED(self))
+{
+  return PyBool_FromLong(MEM_memory_accounting_is_enabled());
+}
+
+PyDoc_STRVAR(bpy_app_memory_sampling_interval_set_doc,
+             ".. function:: sampling_interval_set(interval)\n"
+             "\n"
+             "   Record the call stack of one in ``interval`` allocations on average, "
+             "see :func:`samples`.\n"
+             "   Enables accounting.\n"
+             "\n"
+             "   :arg interval: Average number of allocations between samples, zero disables "
+             "sampling.\n"
+             "   :type interval: int\n");
+static PyObject *bpy_app_memory_sampling_interval_set(PyObject *UNUSED(self), PyObject *value)
+{
+  const long interval = PyLong_AsLong(value);
+  if (interval == -1 && PyErr_Occurred()) {
+    return NULL;
+  }
+  if (interval < 0 || interval > UINT_MAX) {
+    PyErr_SetString(PyExc_ValueError, "sampling_interval_set(interval): out of range");
+    return NULL;
+  }
+  MEM_set_memory_sampling_interval((unsigned int)interval);
+  Py_RETURN_NONE;
+}
+
+static void tags_add_fn(const MemAccountingTag *tag, void *user_data)
+{
+  PyObject *dict = user_data;
+  size_t bytes = tag->bytes, peak_bytes = tag->peak_bytes, blocks = tag->blocks;
+
+  /* The same name can be used in multiple places. */
+  PyObject *item_prev = PyDict_GetItemString(dict, tag->name);
+  if (item_prev) {
+    bytes += PyLong_AsSize_t(PyTuple_GET_ITEM(item_prev, 0));
+    peak_bytes += PyLong_AsSize_t(PyTuple_GET_ITEM(item_prev, 1));
+    blocks += PyLong_AsSize_t(PyTuple_GET_ITEM(item_prev, 2));
+  }
+
+  PyObject *item = PyTuple_New(3);
+  PyTuple_SET_ITEMS(item,
+                    PyLong_FromSize_t(bytes),
+                    PyLong_FromSize_t(peak_bytes),
+                    PyLong_FromSize_t(blocks));
+  PyDict_SetItemString(dict, tag->name, item);
+  Py_DECREF(item);
+}
+
+PyDoc_STRVAR(bpy_app_memory_tags_doc,
+             ".. function:: tags()\n"
+             "\n"
+             "   Memory allocated by allocation name, since accounting was enabled.\n"
+             "\n"
+             "   :return: Dictionary of names and (bytes in use, peak bytes, blocks in use) "
+             "tuples.\n"
+             "   :rtype: dict\n");
+static PyObject *bpy_app_memory_tags(PyObject *UNUSED(self))
+{
+  PyObject *dict = PyDict_New();
+  MEM_memory_accounting_foreach_tag(tags_add_fn, dict);
+  return dict;
+}
+
+static void samples_add_fn(const MemAccountingSample *sample, void *user_data)
+{
+  PyObject *list = user_data;
+
+  char **symbols = MEM_memory_accounting_stack_symbols(sample->stack, sample->stack_len);
+  PyObject *stack = PyTuple_New(sample->stack_len);
+  for (int i = 0; i < sample->stack_len; i++) {
+    PyTuple_SET_ITEM(stack,
+                     i,
+                     symbols ? PyUnicode_DecodeFSDefault(symbols[i]) :
+                               PyUnicode_FromFormat("%p", sample->stack[i]));
+  }
+  free(symbols);
+
+  PyObject *item = PyTuple_New(3);
+  PyTuple_SET_ITEMS(
+      item, PyUnicode_FromString(sample->name), PyLong_FromSize_t(sample->len), stack);
+  PyList_Append(list, item);
+  Py_DECREF(item);
+}
+
+PyDoc_STRVAR(bpy_app_memory_samples_doc,
+             ".. function:: samples()\n"
+             "\n"
+             "   Sampled allocations that have not been freed, see "
+             ":func:`sampling_interval_set`.\n"
+             "\n"
+             "   :return: List of (name, bytes, call stack) tuples, the call stack is a tuple of "
+             "strings, innermost first.\n"
+             "   :rtype: list\n");
+static PyObject *bpy_app_memory_samples(PyObject *UNUSED(self))
+{
+  PyObject *list = PyList_New(0);
+  MEM_memory_accounting_foreach_sample(samples_add_fn, list);
+  return list;
+}
+
+PyDoc_STRVAR(bpy_app_memory_print_statistics_doc,
+             ".. function:: print_statistics()\n"
+             "\n"
+             "   Print the memory by allocation name and the sampled call stacks, largest first.\n");
+static PyObject *bpy_app_memory_print_statistics(PyObject *UNUSED(self))
+{
+  MEM_memory_accounting_print(stdout);
+  Py_RETURN_NONE;
+}
+
+static struct PyMethodDef M_AppMemory_methods[] = {
+    {"enable_accounting",
+     (PyCFunction)bpy_app_memory_enable_accounting,
+     METH_NOARGS,
+     bpy_app_memory_enable_accounting_doc},
+    {"is_accounting_enabled",
+     (PyCFunction)bpy_app_memory_is_accounting_enabled,
+     METH_NOARGS,
+     bpy_app_memory_is_accounting_enabled_doc},
+    {"sampling_interval_set",
+     (PyCFunction)bpy_app_memory_sampling_interval_set,
+     METH_O,
+     bpy_app_memory_sampling_interval_set_doc},
+    {"tags", (PyCFunction)bpy_app_memory_tags, METH_NOARGS, bpy_app_memory_tags_doc},
+    {"samples", (PyCFunction)bpy_app_memory_samples, METH_NOARGS, bpy_app_memory_samples_doc},
+    {"print_statistics",
+     (PyCFunction)bpy_app_memory_print_statistics,
+     METH_NOARGS,
+     bpy_app_memory_print_statistics_doc},
+    {NULL, NULL, 0, NULL},
+};
+
+static struct PyModuleDef M_AppMemory_module_def = {
+    PyModuleDef_HEAD_INIT,
+    "bpy.app.memory",    /* m_name */
+    NULL,                /* m_doc */
+    0,                   /* m_size */
+    M_AppMemory_methods, /* m_methods */
+    NULL,                /* m_reload */
+    NULL,                /* m_traverse */
+    NULL,                /* m_clear */
+    NULL,                /* m_free */
+};
+
+PyObject *BPY_app_memory_module(void)
+{
+  PyObject *sys_modules = PyImport_GetModuleDict();
+
+  PyObject *mod = PyModule_Create(&M_AppMemory_module_def);
+
+  PyDict_SetItem(sys_modules, PyModule_GetNameObject(mod), mod);
+
+  return mod;
+}
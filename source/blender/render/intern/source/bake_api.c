@@ -88,6 +88,9 @@
 #include "render_types.h"
 #include "zbuf.h"
 
+/* Number of rays cast at once against the highpoly objects. */
+#define BAKE_HIGHPOLY_RAYS_BATCH_SIZE 65536
+
 typedef struct BakeDataZSpan {
   BakePixel *pixel_array;
   int primitive_id;
@@ -309,20 +312,22 @@ static void barycentric_differentials_from_position(const float co[3],
 }
 
 /**
- * This function populates pixel_array and returns TRUE if things are correct
+ * This function populates pixel_array from the nearest of the ray hits on the highpoly objects
+ * and returns TRUE if things are correct
  */
-static bool cast_ray_highpoly(BVHTreeFromMesh *treeData,
-                              TriTessFace *triangle_low,
-                              TriTessFace *triangles[],
-                              BakePixel *pixel_array_low,
-                              BakePixel *pixel_array,
-                              const float mat_low[4][4],
-                              BakeHighPolyData *highpoly,
-                              const float co[3],
-                              const float dir[3],
-                              const int pixel_id,
-                              const int tot_highpoly,
-                              const float max_ray_distance)
+static bool bake_highpoly_pixel_from_hits(BVHTreeRayHit *hits[],
+                                          const int ray_id,
+                                          TriTessFace *triangle_low,
+                                          TriTessFace *triangles[],
+                                          BakePixel *pixel_array_low,
+                                          BakePixel *pixel_array,
+                                          const float mat_low[4][4],
+                                          BakeHighPolyData *highpoly,
+                                          const float co[3],
+                                          const float dir[3],
+                                          const int pixel_id,
+                                          const int tot_highpoly,
+                                          const float max_ray_distance)
 {
   int i;
   int hit_mesh = -1;
@@ -332,40 +337,15 @@ static bool cast_ray_highpoly(BVHTreeFromMesh *treeData,
     hit_distance = FLT_MAX;
   }
 
-  BVHTreeRayHit *hits;
-  hits = MEM_mallocN(sizeof(BVHTreeRayHit) * tot_highpoly, "Bake Highpoly to Lowpoly: BVH Rays");
-
   for (i = 0; i < tot_highpoly; i++) {
-    float co_high[3], dir_high[3];
-
-    hits[i].index = -1;
-    /* TODO: we should use FLT_MAX here, but sweepsphere code isn't prepared for that */
-    hits[i].dist = BVH_RAYCAST_DIST_MAX;
-
-    /* transform the ray from the world space to the highpoly space */
-    mul_v3_m4v3(co_high, highpoly[i].imat, co);
+    const BVHTreeRayHit *hit = &hits[i][ray_id];
 
-    /* rotates */
-    mul_v3_mat3_m4v3(dir_high, highpoly[i].imat, dir);
-    normalize_v3(dir_high);
-
-    /* cast ray */
-    if (treeData[i].tree) {
-      BLI_bvhtree_ray_cast(treeData[i].tree,
-                           co_high,
-                           dir_high,
-                           0.0f,
-                           &hits[i],
-                           treeData[i].raycast_callback,
-                           &treeData[i]);
-    }
-
-    if (hits[i].index != -1) {
+    if (hit->index != -1) {
       float distance;
       float hit_world[3];
 
       /* distance comparison in world space */
-      mul_v3_m4v3(hit_world, highpoly[i].obmat, hits[i].co);
+      mul_v3_m4v3(hit_world, highpoly[i].obmat, hit->co);
       distance = len_squared_v3v3(hit_world, co);
 
       if (distance < hit_distance) {
@@ -376,7 +356,8 @@ static bool cast_ray_highpoly(BVHTreeFromMesh *treeData,
   }
 
   if (hit_mesh != -1) {
-    int primitive_id_high = hits[hit_mesh].index;
+    const BVHTreeRayHit *hit = &hits[hit_mesh][ray_id];
+    int primitive_id_high = hit->index;
     TriTessFace *triangle_high = &triangles[hit_mesh][primitive_id_high];
     BakePixel *pixel_low = &pixel_array_low[pixel_id];
     BakePixel *pixel_high = &pixel_array[pixel_id];
@@ -412,7 +393,7 @@ static bool cast_ray_highpoly(BVHTreeFromMesh *treeData,
     madd_v3_v3fl(dyco, tmp, -dot_v3v3(dyco, triangle_high->normal));
 
     /* compute barycentric differentials from position differentials */
-    barycentric_differentials_from_position(hits[hit_mesh].co,
+    barycentric_differentials_from_position(hit->co,
                                             triangle_high->mverts[0]->co,
                                             triangle_high->mverts[1]->co,
                                             triangle_high->mverts[2]->co,
@@ -436,7 +417,6 @@ static bool cast_ray_highpoly(BVHTreeFromMesh *treeData,
     pixel_array[pixel_id].object_id = -1;
   }
 
-  MEM_freeN(hits);
   return hit_mesh != -1;
 }
 
@@ -586,56 +566,125 @@ bool RE_bake_pixels_populate_from_objects(struct Mesh *me_low,
     }
   }
 
-  for (i = 0; i < num_pixels; i++) {
-    float co[3];
-    float dir[3];
-    TriTessFace *tri_low;
+  /* Rays are cast in batches, to bound the memory used for the rays and hits. */
+  const int batch_size = (int)min_zz(max_zz(num_pixels, 1), BAKE_HIGHPOLY_RAYS_BATCH_SIZE);
+  float(*rays_co)[3] = MEM_malloc_arrayN((size_t)batch_size, sizeof(*rays_co), __func__);
+  float(*rays_dir)[3] = MEM_malloc_arrayN((size_t)batch_size, sizeof(*rays_dir), __func__);
+  float(*rays_co_high)[3] = MEM_malloc_arrayN((size_t)batch_size, sizeof(*rays_co_high), __func__);
+  float(*rays_dir_high)[3] = MEM_malloc_arrayN(
+      (size_t)batch_size, sizeof(*rays_dir_high), __func__);
+  TriTessFace **rays_tri_low = MEM_malloc_arrayN(
+      (size_t)batch_size, sizeof(*rays_tri_low), __func__);
+  size_t *rays_pixel = MEM_malloc_arrayN((size_t)batch_size, sizeof(*rays_pixel), __func__);
+  BVHTreeRayHit **hits = MEM_malloc_arrayN((size_t)tot_highpoly, sizeof(*hits), __func__);
+  for (i = 0; i < tot_highpoly; i++) {
+    hits[i] = MEM_malloc_arrayN(
+        (size_t)batch_size, sizeof(**hits), "Bake Highpoly to Lowpoly: BVH Rays");
+  }
 
-    primitive_id = pixel_array_from[i].primitive_id;
+  i = 0;
+  while (i < num_pixels) {
+    int rays_len = 0;
 
-    if (primitive_id == -1) {
-      pixel_array_to[i].primitive_id = -1;
-      continue;
-    }
+    /* Gather the rays from the low poly mesh (cage). */
+    for (; i < num_pixels && rays_len < batch_size; i++) {
+      float *co = rays_co[rays_len];
+      float *dir = rays_dir[rays_len];
+      TriTessFace *tri_low;
 
-    u = pixel_array_from[i].uv[0];
-    v = pixel_array_from[i].uv[1];
+      primitive_id = pixel_array_from[i].primitive_id;
 
-    /* calculate from low poly mesh cage */
-    if (is_custom_cage) {
-      calc_point_from_barycentric_cage(
-          tris_low, tris_cage, mat_low, mat_cage, primitive_id, u, v, co, dir);
-      tri_low = &tris_cage[primitive_id];
-    }
-    else if (is_cage) {
-      calc_point_from_barycentric_extrusion(
-          tris_cage, mat_low, imat_low, primitive_id, u, v, cage_extrusion, co, dir, true);
-      tri_low = &tris_cage[primitive_id];
+      if (primitive_id == -1) {
+        pixel_array_to[i].primitive_id = -1;
+        continue;
+      }
+
+      u = pixel_array_from[i].uv[0];
+      v = pixel_array_from[i].uv[1];
+
+      /* calculate from low poly mesh cage */
+      if (is_custom_cage) {
+        calc_point_from_barycentric_cage(
+            tris_low, tris_cage, mat_low, mat_cage, primitive_id, u, v, co, dir);
+        tri_low = &tris_cage[primitive_id];
+      }
+      else if (is_cage) {
+        calc_point_from_barycentric_extrusion(
+            tris_cage, mat_low, imat_low, primitive_id, u, v, cage_extrusion, co, dir, true);
+        tri_low = &tris_cage[primitive_id];
+      }
+      else {
+        calc_point_from_barycentric_extrusion(
+            tris_low, mat_low, imat_low, primitive_id, u, v, cage_extrusion, co, dir, false);
+        tri_low = &tris_low[primitive_id];
+      }
+
+      rays_tri_low[rays_len] = tri_low;
+      rays_pixel[rays_len] = i;
+      rays_len++;
     }
-    else {
-      calc_point_from_barycentric_extrusion(
-          tris_low, mat_low, imat_low, primitive_id, u, v, cage_extrusion, co, dir, false);
-      tri_low = &tris_low[primitive_id];
+
+    /* Cast the rays against each highpoly object. */
+    for (int h = 0; h < tot_highpoly; h++) {
+      for (int r = 0; r < rays_len; r++) {
+        hits[h][r].index = -1;
+        /* TODO: we should use FLT_MAX here, but sweepsphere code isn't prepared for that */
+        hits[h][r].dist = BVH_RAYCAST_DIST_MAX;
+
+        /* transform the ray from the world space to the highpoly space */
+        mul_v3_m4v3(rays_co_high[r], highpoly[h].imat, rays_co[r]);
+
+        /* rotates */
+        mul_v3_mat3_m4v3(rays_dir_high[r], highpoly[h].imat, rays_dir[r]);
+        normalize_v3(rays_dir_high[r]);
+      }
+
+      if (treeData[h].tree) {
+        BLI_bvhtree_ray_cast_batch(treeData[h].tree,
+                                   (const float(*)[3])rays_co_high,
+                                   (const float(*)[3])rays_dir_high,
+                                   rays_len,
+                                   0.0f,
+                                   hits[h],
+                                   treeData[h].raycast_callback,
+                                   &treeData[h],
+                                   BVH_RAYCAST_DEFAULT);
+      }
     }
 
-    /* cast ray */
-    if (!cast_ray_highpoly(treeData,
-                           tri_low,
-                           tris_high,
-                           pixel_array_from,
-                           pixel_array_to,
-                           mat_low,
-                           highpoly,
-                           co,
-                           dir,
-                           i,
-                           tot_highpoly,
-                           max_ray_distance)) {
-      /* if it fails mask out the original pixel array */
-      pixel_array_from[i].primitive_id = -1;
+    for (int r = 0; r < rays_len; r++) {
+      const size_t pixel_id = rays_pixel[r];
+
+      if (!bake_highpoly_pixel_from_hits(hits,
+                                         r,
+                                         rays_tri_low[r],
+                                         tris_high,
+                                         pixel_array_from,
+                                         pixel_array_to,
+                                         mat_low,
+                                         highpoly,
+                                         rays_co[r],
+                                         rays_dir[r],
+                                         (int)pixel_id,
+                                         tot_highpoly,
+                                         max_ray_distance)) {
+        /* if it fails mask out the original pixel array */
+        pixel_array_from[pixel_id].primitive_id = -1;
+      }
     }
   }
 
+  for (i = 0; i < tot_highpoly; i++) {
+    MEM_freeN(hits[i]);
+  }
+  MEM_freeN(hits);
+  MEM_freeN(rays_co);
+  MEM_freeN(rays_dir);
+  MEM_freeN(rays_co_high);
+  MEM_freeN(rays_dir_high);
+  MEM_freeN(rays_tri_low);
+  MEM_freeN(rays_pixel);
+
   /* garbage collection */
 cleanup:
   for (i = 0; i < tot_highpoly; i++) {
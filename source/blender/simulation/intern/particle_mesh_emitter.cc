@@ -17,6 +17,7 @@
 #include "particle_mesh_emitter.hh"
 
 #include "BLI_float4x4.hh"
+#include "BLI_math_batch.hh"
 #include "BLI_rand.hh"
 #include "BLI_vector_adaptor.hh"
 
@@ -273,25 +274,20 @@ static BLI_NOINLINE bool compute_new_particle_attributes(ParticleEmitterContext
     context.solve_context.dependency_animations.get_object_transforms(
         *settings.object, r_birth_times, local_to_world_matrices);
 
+    math::transform_points(local_to_world_matrices, r_positions);
     for (int i : IndexRange(particle_amount)) {
-      const float4x4 &position_to_world = local_to_world_matrices[i];
-      const float4x4 normal_to_world = position_to_world.inverted_transposed_affine();
-      r_positions[i] = position_to_world * r_positions[i];
-      r_velocities[i] = normal_to_world * r_velocities[i];
+      local_to_world_matrices[i] = local_to_world_matrices[i].inverted_transposed_affine();
     }
+    math::transform_points(local_to_world_matrices, r_velocities);
   }
   else {
     const float4x4 position_to_world = settings.object->obmat;
     const float4x4 normal_to_world = position_to_world.inverted_transposed_affine();
-    for (int i : IndexRange(particle_amount)) {
-      r_positions[i] = position_to_world * r_positions[i];
-      r_velocities[i] = normal_to_world * r_velocities[i];
-    }
+    math::transform_points(position_to_world, r_positions);
+    math::transform_points(normal_to_world, r_velocities);
   }
 
-  for (int i : IndexRange(particle_amount)) {
-    r_velocities[i].normalize();
-  }
+  math::normalize(r_velocities);
 
   state.last_birth_time = last_birth_time;
   return true;
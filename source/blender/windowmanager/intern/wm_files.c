@@ -52,6 +52,7 @@
 #include "BLI_blenlib.h"
 #include "BLI_linklist.h"
 #include "BLI_system.h"
+#include "BLI_task.h"
 #include "BLI_threads.h"
 #include "BLI_timer.h"
 #include "BLI_utildefines.h"
@@ -1597,6 +1598,80 @@ void WM_autosave_init(wmWindowManager *wm)
   }
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Auto-Save Writing in the Background
+ *
+ * With global undo, the active undo memfile is written in a background task. It doesn't even need
+ * to be copied, its memory is shared (see #BLO_memfile_duplicate).
+ * \{ */
+
+typedef struct AutosaveWriteData {
+  MemFile memfile;
+  char filepath[FILE_MAX];
+} AutosaveWriteData;
+
+static TaskPool *wm_autosave_write_pool = NULL;
+static ThreadMutex wm_autosave_write_lock = BLI_MUTEX_INITIALIZER;
+static bool wm_autosave_write_is_running = false;
+
+static void wm_autosave_write_task(TaskPool *__restrict UNUSED(pool), void *taskdata)
+{
+  AutosaveWriteData *data = taskdata;
+  char filepath_temp[FILE_MAX + 1];
+
+  /* Write to a temporary file first, so the previous auto-save remains
+   * usable when Blender crashes while writing. */
+  BLI_snprintf(filepath_temp, sizeof(filepath_temp), "%s@", data->filepath);
+  if (BLO_memfile_write_file(&data->memfile, filepath_temp)) {
+    if (BLI_rename(filepath_temp, data->filepath) != 0) {
+      fprintf(stderr, "Unable to save '%s': cannot rename temporary file\n", data->filepath);
+    }
+  }
+  BLO_memfile_free(&data->memfile);
+
+  BLI_mutex_lock(&wm_autosave_write_lock);
+  wm_autosave_write_is_running = false;
+  BLI_mutex_unlock(&wm_autosave_write_lock);
+}
+
+static bool wm_autosave_write_running(void)
+{
+  BLI_mutex_lock(&wm_autosave_write_lock);
+  const bool is_running = wm_autosave_write_is_running;
+  BLI_mutex_unlock(&wm_autosave_write_lock);
+  return is_running;
+}
+
+/**
+ * Write \a data in the background, taking ownership of it.
+ */
+static void wm_autosave_write_async(AutosaveWriteData *data)
+{
+  if (wm_autosave_write_pool == NULL) {
+    wm_autosave_write_pool = BLI_task_pool_create_background(NULL, TASK_PRIORITY_LOW);
+  }
+
+  BLI_mutex_lock(&wm_autosave_write_lock);
+  wm_autosave_write_is_running = true;
+  BLI_mutex_unlock(&wm_autosave_write_lock);
+
+  BLI_task_pool_push(wm_autosave_write_pool, wm_autosave_write_task, data, true, NULL);
+}
+
+/**
+ * Wait for the auto-save being written in the background to be finished.
+ */
+void wm_autosave_write_wait(void)
+{
+  if (wm_autosave_write_pool != NULL) {
+    BLI_task_pool_work_and_wait(wm_autosave_write_pool);
+    BLI_task_pool_free(wm_autosave_write_pool);
+    wm_autosave_write_pool = NULL;
+  }
+}
+
+/** \} */
+
 void wm_autosave_timer(Main *bmain, wmWindowManager *wm, wmTimer *UNUSED(wt))
 {
   char filepath[FILE_MAX];
@@ -1617,17 +1692,27 @@ void wm_autosave_timer(Main *bmain, wmWindowManager *wm, wmTimer *UNUSED(wt))
     }
   }
 
+  /* The previous auto-save is still being written, try again in a second. */
+  if (wm_autosave_write_running()) {
+    wm->autosavetimer = WM_event_add_timer(wm, NULL, TIMERAUTOSAVE, 1.0);
+    return;
+  }
+
   wm_autosave_location(filepath);
 
   if (U.uiflag & USER_GLOBALUNDO) {
     /* fast save of last undobuffer, now with UI */
     struct MemFile *memfile = ED_undosys_stack_memfile_get_active(wm->undo_stack);
     if (memfile) {
-      BLO_memfile_write_file(memfile, filepath);
+      AutosaveWriteData *data = MEM_callocN(sizeof(*data), __func__);
+      STRNCPY(data->filepath, filepath);
+      BLO_memfile_duplicate(memfile, &data->memfile);
+      wm_autosave_write_async(data);
     }
   }
   else {
-    /* Save as regular blend file. */
+    /* Save as regular blend file. Writing into a memfile like undo does would change the undo
+     * state of Main and skip library overrides, so this stays a blocking write. */
     const int fileflags = G.fileflags & ~G_FILE_COMPRESS;
 
     ED_editors_flush_edits(bmain);
@@ -1671,6 +1756,8 @@ void wm_autosave_read(bContext *C, ReportList *reports)
 {
   char filename[FILE_MAX];
 
+  wm_autosave_write_wait();
+
   wm_autosave_location(filename);
   WM_file_read(C, filename, reports);
 }
@@ -47,6 +47,7 @@
 #include "BLI_task.h"
 #include "BLI_threads.h"
 #include "BLI_timer.h"
+#include "BLI_trace.h"
 #include "BLI_utildefines.h"
 
 #include "BLO_undofile.h"
@@ -525,6 +526,21 @@ void WM_exit_ex(bContext *C, const bool do_python)
     }
   }
 
+  /* Auto-save may still be written in the background, which needs the task scheduler. */
+  wm_autosave_write_wait();
+
+  /* Write the trace now that all jobs have finished, freeing isn't interesting to profile. */
+  if (BLI_trace_is_active()) {
+    if (!BLI_trace_session_end()) {
+      printf("Error: could not write the trace file\n");
+    }
+  }
+
+  /* Print before freeing, so the memory that was in use is shown. */
+  if (MEM_memory_accounting_is_enabled()) {
+    MEM_memory_accounting_print(stdout);
+  }
+
   BLI_timer_free();
 
   WM_paneltype_clear();
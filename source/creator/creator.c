@@ -293,6 +293,12 @@ int main(int argc,
         MEM_use_guarded_allocator();
         break;
       }
+      else if (STREQ(argv[i], "--enable-memory-thread-cache")) {
+        MEM_use_thread_cached_allocator();
+      }
+      else if (STREQ(argv[i], "--debug-memory-accounting")) {
+        MEM_enable_memory_accounting();
+      }
       else if (STREQ(argv[i], "--")) {
         break;
       }
@@ -41,6 +41,7 @@
 #  include "BLI_string_utf8.h"
 #  include "BLI_system.h"
 #  include "BLI_threads.h"
+#  include "BLI_trace.h"
 #  include "BLI_utildefines.h"
 
 #  include "BLO_readfile.h" /* only for BLO_has_bfile_extension */
@@ -589,6 +590,8 @@ static int arg_handle_print_help(int UNUSED(argc), const char **UNUSED(argv), vo
   BLI_argsPrintArgDoc(ba, "--debug-cycles");
 #  endif
   BLI_argsPrintArgDoc(ba, "--debug-memory");
+  BLI_argsPrintArgDoc(ba, "--debug-memory-accounting");
+  BLI_argsPrintArgDoc(ba, "--debug-memory-sampling");
   BLI_argsPrintArgDoc(ba, "--debug-jobs");
   BLI_argsPrintArgDoc(ba, "--debug-python");
   BLI_argsPrintArgDoc(ba, "--debug-depsgraph");
@@ -612,6 +615,9 @@ static int arg_handle_print_help(int UNUSED(argc), const char **UNUSED(argv), vo
 
   printf("\n");
   BLI_argsPrintArgDoc(ba, "--debug-fpe");
+#  ifdef WITH_TRACE
+  BLI_argsPrintArgDoc(ba, "--debug-trace");
+#  endif
   BLI_argsPrintArgDoc(ba, "--disable-crash-handler");
   BLI_argsPrintArgDoc(ba, "--disable-abort-handler");
 
@@ -620,6 +626,7 @@ static int arg_handle_print_help(int UNUSED(argc), const char **UNUSED(argv), vo
   BLI_argsPrintArgDoc(ba, "--app-template");
   BLI_argsPrintArgDoc(ba, "--factory-startup");
   BLI_argsPrintArgDoc(ba, "--enable-event-simulate");
+  BLI_argsPrintArgDoc(ba, "--enable-memory-thread-cache");
   printf("\n");
   BLI_argsPrintArgDoc(ba, "--env-system-datafiles");
   BLI_argsPrintArgDoc(ba, "--env-system-scripts");
@@ -1076,6 +1083,42 @@ static int arg_handle_debug_mode_memory_set(int UNUSED(argc),
   return 0;
 }
 
+static const char arg_handle_debug_mode_memory_accounting_set_doc[] =
+    "\n\t"
+    "Keep track of memory by allocation name, printed on exit. Cheaper than '--debug-memory'.";
+static int arg_handle_debug_mode_memory_accounting_set(int UNUSED(argc),
+                                                       const char **UNUSED(argv),
+                                                       void *UNUSED(data))
+{
+  /* Handled in creator.c, so that allocations during startup are counted. */
+  return 0;
+}
+
+static const char arg_handle_debug_memory_sampling_set_doc[] =
+    "<interval>\n"
+    "\tRecord the call stack of one in <interval> allocations on average, printed on exit.\n"
+    "\tEnables '--debug-memory-accounting'.";
+static int arg_handle_debug_memory_sampling_set(int argc, const char **argv, void *UNUSED(data))
+{
+  const char *arg_id = "--debug-memory-sampling";
+  if (argc > 1) {
+    const char *err_msg = NULL;
+    int interval;
+    if (!parse_int_strict_range(argv[1], NULL, 1, INT_MAX, &interval, &err_msg)) {
+      printf("\nError: %s '%s %s'.\n", err_msg, arg_id, argv[1]);
+      return 1;
+    }
+
+    MEM_set_memory_sampling_interval((unsigned int)interval);
+
+    return 1;
+  }
+  else {
+    printf("\nError: you must specify the sampling interval.\n");
+    return 0;
+  }
+}
+
 static const char arg_handle_debug_value_set_doc[] =
     "<value>\n"
     "\tSet debug value of <value> on startup.";
@@ -1111,6 +1154,30 @@ static int arg_handle_debug_fpe_set(int UNUSED(argc),
   return 0;
 }
 
+#  ifdef WITH_TRACE
+static const char arg_handle_debug_trace_set_doc[] =
+    "<filename>\n"
+    "\tRecord the time spent in evaluation, drawing and file I/O, and write it to the file on exit\n"
+    "\tin the Chrome trace event format (see chrome://tracing or https://ui.perfetto.dev).";
+static int arg_handle_debug_trace_set(int argc, const char **argv, void *UNUSED(data))
+{
+  const char *arg_id = "--debug-trace";
+  if (argc > 1) {
+    if (BLI_trace_is_active()) {
+      printf("\nError: '%s' given more than once.\n", arg_id);
+    }
+    else {
+      BLI_trace_session_begin(argv[1]);
+    }
+    return 1;
+  }
+  else {
+    printf("\nError: '%s' no args given.\n", arg_id);
+    return 0;
+  }
+}
+#  endif
+
 static const char arg_handle_app_template_doc[] =
     "<template>\n"
     "\tSet the application template (matching the directory name), use 'default' for none.";
@@ -1150,6 +1217,18 @@ static int arg_handle_enable_event_simulate(int UNUSED(argc),
   return 0;
 }
 
+static const char arg_handle_memory_thread_cache_set_doc[] =
+    "\n\t"
+    "Cache small memory blocks per thread, to reduce lock contention in multi-threaded code.\n"
+    "\tHas no effect in combination with '--debug-memory'.";
+static int arg_handle_memory_thread_cache_set(int UNUSED(argc),
+                                              const char **UNUSED(argv),
+                                              void *UNUSED(data))
+{
+  /* Handled in creator.c, the allocator has to be chosen before any allocation. */
+  return 0;
+}
+
 static const char arg_handle_env_system_set_doc_datafiles[] =
     "\n\t"
     "Set the " STRINGIFY_ARG(BLENDER_SYSTEM_DATAFILES) " environment variable.";
@@ -2145,6 +2224,9 @@ void main_args_setup(bContext *C, bArgs *ba)
   BLI_argsAdd(ba, 1, NULL, "--debug-io", CB(arg_handle_debug_mode_io), NULL);
 
   BLI_argsAdd(ba, 1, NULL, "--debug-fpe", CB(arg_handle_debug_fpe_set), NULL);
+#  ifdef WITH_TRACE
+  BLI_argsAdd(ba, 1, NULL, "--debug-trace", CB(arg_handle_debug_trace_set), NULL);
+#  endif
 
 #  ifdef WITH_LIBMV
   BLI_argsAdd(ba, 1, NULL, "--debug-libmv", CB(arg_handle_debug_mode_libmv), NULL);
@@ -2153,6 +2235,14 @@ void main_args_setup(bContext *C, bArgs *ba)
   BLI_argsAdd(ba, 1, NULL, "--debug-cycles", CB(arg_handle_debug_mode_cycles), NULL);
 #  endif
   BLI_argsAdd(ba, 1, NULL, "--debug-memory", CB(arg_handle_debug_mode_memory_set), NULL);
+  BLI_argsAdd(ba,
+              1,
+              NULL,
+              "--debug-memory-accounting",
+              CB(arg_handle_debug_mode_memory_accounting_set),
+              NULL);
+  BLI_argsAdd(
+      ba, 1, NULL, "--debug-memory-sampling", CB(arg_handle_debug_memory_sampling_set), NULL);
 
   BLI_argsAdd(ba, 1, NULL, "--debug-value", CB(arg_handle_debug_value_set), NULL);
   BLI_argsAdd(ba,
@@ -2240,6 +2330,12 @@ void main_args_setup(bContext *C, bArgs *ba)
   BLI_argsAdd(ba, 1, NULL, "--app-template", CB(arg_handle_app_template), NULL);
   BLI_argsAdd(ba, 1, NULL, "--factory-startup", CB(arg_handle_factory_startup_set), NULL);
   BLI_argsAdd(ba, 1, NULL, "--enable-event-simulate", CB(arg_handle_enable_event_simulate), NULL);
+  BLI_argsAdd(ba,
+              1,
+              NULL,
+              "--enable-memory-thread-cache",
+              CB(arg_handle_memory_thread_cache_set),
+              NULL);
 
   /* TODO, add user env vars? */
   BLI_argsAdd(
@@ -0,0 +1,124 @@
+# Apache License, Version 2.0
+
+# ./blender.bin --background -noaudio --factory-startup --python tests/python/bl_modifier_stack_cache.py -- --verbose
+import sys
+import unittest
+
+import bmesh
+import bpy
+
+
+def mesh_cube_new(name):
+    me = bpy.data.meshes.new(name)
+    bm = bmesh.new()
+    bmesh.ops.create_cube(bm, size=2.0)
+    bm.to_mesh(me)
+    bm.free()
+    return me
+
+
+def object_evaluated_state(ob):
+    """Vertex positions and polygons of the evaluated object, to compare results."""
+    depsgraph = bpy.context.evaluated_depsgraph_get()
+    ob_eval = ob.evaluated_get(depsgraph)
+    me = ob_eval.to_mesh()
+    verts = [tuple(round(value, 5) for value in v.co) for v in me.vertices]
+    polys = [tuple(p.vertices) for p in me.polygons]
+    ob_eval.to_mesh_clear()
+    return verts, polys
+
+
+class TestModifierStackCache(unittest.TestCase):
+    """
+    Compare the object with a cached result in its stack to an equal object without, which always
+    evaluates the whole stack.
+    """
+
+    def setUp(self):
+        bpy.ops.wm.read_factory_settings(use_empty=True)
+        scene = bpy.context.scene
+
+        self.cutter = bpy.data.objects.new("Cutter", mesh_cube_new("Cutter"))
+        self.cutter.location = (1.0, 1.0, 1.0)
+        scene.collection.objects.link(self.cutter)
+
+        self.ob_cached = self.object_new("Cached")
+        self.ob_full = self.object_new("Full")
+        self.ob_cached.modifiers["Boolean"].use_cache_result = True
+
+        state_cached, state_full = self.evaluated_states()
+        self.assertEqual(state_cached, state_full)
+
+    def object_new(self, name):
+        ob = bpy.data.objects.new(name, mesh_cube_new(name))
+        bpy.context.scene.collection.objects.link(ob)
+
+        # Not Subdivision Surface, which does nothing in builds without OpenSubdiv.
+        md = ob.modifiers.new("Array", 'ARRAY')
+        md.count = 2
+        md = ob.modifiers.new("Boolean", 'BOOLEAN')
+        md.object = self.cutter
+        md.solver = 'FAST'
+        md = ob.modifiers.new("Solidify", 'SOLIDIFY')
+        md.thickness = 0.1
+        return ob
+
+    def evaluated_states(self):
+        bpy.context.view_layer.update()
+        return object_evaluated_state(self.ob_cached), object_evaluated_state(self.ob_full)
+
+    def objects_modifier_set(self, modifier_name, attr, value):
+        for ob in (self.ob_cached, self.ob_full):
+            setattr(ob.modifiers[modifier_name], attr, value)
+
+    def assertChangedAndEqual(self, state_prev):
+        state_cached, state_full = self.evaluated_states()
+        self.assertNotEqual(state_full, state_prev)
+        self.assertEqual(state_cached, state_full)
+
+    def test_resume_after_cached_modifier(self):
+        state_prev = self.evaluated_states()[1]
+        self.objects_modifier_set("Solidify", "thickness", 0.3)
+        self.assertChangedAndEqual(state_prev)
+
+        # Going back to settings of a stored result.
+        self.objects_modifier_set("Solidify", "thickness", 0.1)
+        state_cached, state_full = self.evaluated_states()
+        self.assertEqual(state_full, state_prev)
+        self.assertEqual(state_cached, state_full)
+
+    def test_upstream_setting_invalidates(self):
+        state_prev = self.evaluated_states()[1]
+        self.objects_modifier_set("Array", "count", 3)
+        self.assertChangedAndEqual(state_prev)
+
+        state_prev = self.evaluated_states()[1]
+        self.objects_modifier_set("Boolean", "operation", 'UNION')
+        self.assertChangedAndEqual(state_prev)
+
+    def test_input_mesh_invalidates(self):
+        state_prev = self.evaluated_states()[1]
+        for ob in (self.ob_cached, self.ob_full):
+            ob.data.vertices[0].co.x -= 0.5
+            ob.data.update()
+        self.assertChangedAndEqual(state_prev)
+
+    def test_operand_invalidates(self):
+        state_prev = self.evaluated_states()[1]
+        self.cutter.location.x += 0.25
+        self.assertChangedAndEqual(state_prev)
+
+        state_prev = self.evaluated_states()[1]
+        self.cutter.data.vertices[0].co.z += 0.5
+        self.cutter.data.update()
+        self.assertChangedAndEqual(state_prev)
+
+    def test_disabled_modifier_invalidates(self):
+        state_prev = self.evaluated_states()[1]
+        self.objects_modifier_set("Array", "show_viewport", False)
+        self.assertChangedAndEqual(state_prev)
+
+
+if __name__ == '__main__':
+    sys.argv = [__file__] + (sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else [])
+    unittest.main()